@@ -0,0 +1,108 @@
+#version 450
+
+layout (location = 0) in vec3 inWorldPosition;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec3 inColor;
+layout (location = 3) in float inViewDepth;
+
+layout (location = 0) out vec4 outFragColor;
+
+// matches Light in light_cluster.comp
+struct Light {
+    vec4 position_range;
+    vec4 color_intensity;
+    vec4 direction_cos_outer;
+    vec4 spot;
+};
+
+layout (std430, set = 2, binding = 0) readonly buffer LightBuffer {
+    Light lights[];
+};
+
+layout (std430, set = 2, binding = 1) readonly buffer ClusterBuffer {
+    uvec2 clusters[];
+};
+
+layout (std430, set = 2, binding = 2) readonly buffer LightIndexBuffer {
+    uint light_indices[];
+};
+
+// matches ShadowData in shadow_cascades.hpp
+layout (set = 3, binding = 0) uniform ShadowBuffer {
+    // world to light clip space of every cascade
+    mat4 cascades[4];
+    // view depth where each cascade ends
+    vec4 splits;
+    // world space size of a shadow map texel of each cascade
+    vec4 texel_sizes;
+    // xyz: direction the light travels, w: depth bias
+    vec4 light_direction;
+    // rgb: color times intensity
+    vec4 light_color;
+    uint refresh_mask;
+} shadow;
+
+layout (set = 3, binding = 1) uniform sampler2DArrayShadow shadow_map;
+
+layout (push_constant) uniform ClusterParams {
+    // xyz: cluster grid size
+    uvec4 grid;
+    // xy: 1 / render extent, z: depth slice scale, w: depth slice bias
+    vec4 screen_to_cluster;
+    // rgb: ambient light
+    vec4 ambient;
+} pc;
+
+vec3 shade(Light light, vec3 normal)
+{
+    vec3 to_light = light.position_range.xyz - inWorldPosition;
+    float distance = length(to_light);
+    vec3 direction = to_light / max(distance, 1e-4);
+    // smooth falloff reaching 0 at the range
+    float falloff = clamp(1.0 - pow(distance / light.position_range.w, 4.0), 0.0, 1.0);
+    float attenuation = falloff * falloff / (distance * distance + 1.0);
+    if (light.direction_cos_outer.w > -1.0) {
+        float cos_angle = dot(-direction, light.direction_cos_outer.xyz);
+        attenuation *= smoothstep(light.direction_cos_outer.w, light.spot.x, cos_angle);
+    }
+    return light.color_intensity.rgb * light.color_intensity.w * attenuation *
+           max(dot(normal, direction), 0.0);
+}
+
+// 1 if lit by the directional light, filtered over 2x2 texels by the compare sampler
+float sun_visibility(vec3 normal)
+{
+    if (inViewDepth >= shadow.splits[3]) {
+        return 1.0;
+    }
+    uint cascade = 0;
+    while (inViewDepth >= shadow.splits[cascade]) {
+        cascade++;
+    }
+    // moving along the normal by a texel or two keeps lit surfaces out of their own shadow
+    vec3 position = inWorldPosition + normal * shadow.texel_sizes[cascade] * 1.5;
+    vec4 light_position = shadow.cascades[cascade] * vec4(position, 1.0);
+    vec2 uv = light_position.xy * 0.5 + 0.5;
+    float depth = light_position.z - shadow.light_direction.w;
+    return texture(shadow_map, vec4(uv, float(cascade), depth));
+}
+
+void main()
+{
+    // exponential depth slices, uniform tiles on screen
+    uvec2 tile = uvec2(gl_FragCoord.xy * pc.screen_to_cluster.xy * vec2(pc.grid.xy));
+    uint slice = uint(max(log(inViewDepth) * pc.screen_to_cluster.z + pc.screen_to_cluster.w, 0.0));
+    uvec3 cell = min(uvec3(tile, slice), pc.grid.xyz - 1);
+    uvec2 cluster = clusters[(cell.z * pc.grid.y + cell.y) * pc.grid.x + cell.x];
+
+    vec3 normal = normalize(inNormal);
+    vec3 light = pc.ambient.rgb;
+    for (uint i = 0; i < cluster.y; i++) {
+        light += shade(lights[light_indices[cluster.x + i]], normal);
+    }
+    float sun = max(dot(normal, -shadow.light_direction.xyz), 0.0);
+    if (sun > 0.0) {
+        light += shadow.light_color.rgb * sun * sun_visibility(normal);
+    }
+    outFragColor = vec4(inColor * light, 1.0);
+}
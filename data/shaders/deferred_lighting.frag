@@ -0,0 +1,45 @@
+#version 450
+
+// G-buffer of the previous subpass, read from tile memory at the current pixel
+layout (input_attachment_index = 0, set = 0, binding = 0) uniform subpassInput in_albedo;
+layout (input_attachment_index = 1, set = 0, binding = 1) uniform subpassInput in_normal;
+layout (input_attachment_index = 2, set = 0, binding = 2) uniform subpassInput in_depth;
+
+layout (push_constant) uniform Constants {
+    mat4 inv_view_proj;
+    // x: time
+    vec4 params;
+} pc;
+
+layout (location = 0) in vec2 in_uv;
+
+layout (location = 0) out vec4 out_color;
+
+const int LIGHT_COUNT = 8;
+
+void main()
+{
+    float depth = subpassLoad(in_depth).r;
+    if (depth >= 1.0) {
+        out_color = vec4(0.1, 0.1, 0.1, 1.0);
+        return;
+    }
+    vec4 world = pc.inv_view_proj * vec4(in_uv * 2.0 - 1.0, depth, 1.0);
+    vec3 position = world.xyz / world.w;
+    vec3 albedo = subpassLoad(in_albedo).rgb;
+    vec3 normal = normalize(subpassLoad(in_normal).xyz * 2.0 - 1.0);
+
+    vec3 color = albedo * 0.05;
+    for (int i = 0; i < LIGHT_COUNT; i++) {
+        float angle = pc.params.x * 0.5 + float(i) * 6.2831853 / float(LIGHT_COUNT);
+        float radius = 3.0 + 2.0 * float(i % 2);
+        vec3 light_pos = vec3(cos(angle) * radius, 1.5, sin(angle) * radius);
+        vec3 light_color = 0.5 + 0.5 * cos(vec3(0.0, 2.0, 4.0) + float(i));
+
+        vec3 to_light = light_pos - position;
+        float dist2 = dot(to_light, to_light);
+        float n_dot_l = max(dot(normal, to_light * inversesqrt(dist2)), 0.0);
+        color += albedo * light_color * n_dot_l * 4.0 / (1.0 + dist2);
+    }
+    out_color = vec4(color, 1.0);
+}
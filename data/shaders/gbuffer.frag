@@ -0,0 +1,17 @@
+#version 450
+
+layout (location = 0) in vec3 in_normal;
+
+layout (set = 1, binding = 0) uniform Material {
+    vec4 albedo;
+} material;
+
+layout (location = 0) out vec4 out_albedo;
+layout (location = 1) out vec4 out_normal;
+
+void main()
+{
+    out_albedo = vec4(material.albedo.rgb, 1.0);
+    // unorm encoding of the world space normal
+    out_normal = vec4(normalize(in_normal) * 0.5 + 0.5, 0.0);
+}
@@ -0,0 +1,27 @@
+#version 450
+
+layout (location = 0) in vec3 in_position;
+layout (location = 1) in vec3 in_normal;
+
+layout (push_constant) uniform Constants {
+    mat4 view_proj;
+} pc;
+
+struct ObjectData {
+    mat4 model;
+};
+
+layout (std140, set = 0, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} object_buffer;
+
+layout (location = 0) out vec3 out_normal;
+
+// gl_InstanceIndex includes the first instance of the draw, which selects the object.
+void main()
+{
+    mat4 model = object_buffer.objects[gl_InstanceIndex].model;
+    gl_Position = pc.view_proj * model * vec4(in_position, 1.0);
+    // the models only scale along their axes, the direction of the face normals is kept
+    out_normal = mat3(model) * in_normal;
+}
@@ -0,0 +1,37 @@
+#version 460
+
+layout (location = 0) in vec3 vPosition;
+layout (location = 1) in vec3 vNormal;
+layout (location = 2) in vec3 vColor;
+layout (location = 3) in vec2 vTexCoord;
+
+layout (location = 0) out vec3 outWorldPosition;
+layout (location = 1) out vec3 outNormal;
+layout (location = 2) out vec3 outColor;
+// positive distance along the view direction, selects the cluster slice
+layout (location = 3) out float outViewDepth;
+
+layout (set = 0, binding = 0) uniform CameraBuffer {
+    mat4 view;
+    mat4 proj;
+    mat4 viewproj;
+} cameraData;
+
+struct ObjectData {
+    mat4 model;
+};
+
+layout (std140, set = 1, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} objectBuffer;
+
+void main()
+{
+    mat4 model = objectBuffer.objects[gl_BaseInstance].model;
+    vec4 world_position = model * vec4(vPosition, 1.0);
+    gl_Position = cameraData.viewproj * world_position;
+    outWorldPosition = world_position.xyz;
+    outNormal = mat3(model) * vNormal;
+    outColor = vColor;
+    outViewDepth = -(cameraData.view * world_position).z;
+}
@@ -0,0 +1,34 @@
+#version 460
+#extension GL_EXT_multiview : require
+
+layout (location = 0) in vec3 vPosition;
+
+// matches ShadowData in shadow_cascades.hpp
+layout (set = 0, binding = 0) uniform ShadowBuffer {
+    mat4 cascades[4];
+    vec4 splits;
+    vec4 texel_sizes;
+    vec4 light_direction;
+    vec4 light_color;
+    uint refresh_mask;
+} shadow;
+
+struct ObjectData {
+    mat4 model;
+};
+
+layout (std140, set = 1, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} objectBuffer;
+
+// One view per cascade, cascades kept from earlier frames are left alone.
+void main()
+{
+    if ((shadow.refresh_mask & (1u << gl_ViewIndex)) == 0) {
+        // in front of the near plane, the whole triangle is clipped
+        gl_Position = vec4(0.0, 0.0, -1.0, 1.0);
+        return;
+    }
+    mat4 model = objectBuffer.objects[gl_BaseInstance].model;
+    gl_Position = shadow.cascades[gl_ViewIndex] * model * vec4(vPosition, 1.0);
+}
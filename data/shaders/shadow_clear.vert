@@ -0,0 +1,24 @@
+#version 450
+#extension GL_EXT_multiview : require
+
+// matches ShadowData in shadow_cascades.hpp
+layout (set = 0, binding = 0) uniform ShadowBuffer {
+    mat4 cascades[4];
+    vec4 splits;
+    vec4 texel_sizes;
+    vec4 light_direction;
+    vec4 light_color;
+    uint refresh_mask;
+} shadow;
+
+// One triangle at the far plane covering the cascades which are rendered again. A multiview
+// render pass can only clear all views at once.
+void main()
+{
+    if ((shadow.refresh_mask & (1u << gl_ViewIndex)) == 0) {
+        gl_Position = vec4(0.0, 0.0, -1.0, 1.0);
+        return;
+    }
+    vec2 uv = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(uv * 2.0 - 1.0, 1.0, 1.0);
+}
@@ -0,0 +1,71 @@
+#version 450
+
+// Scene rendered at the dynamic resolution, it covers the top left corner of the image.
+layout (set = 0, binding = 0) uniform sampler2D source;
+
+// matches UpscaleConstants in dynamic_resolution.hpp
+layout (push_constant) uniform Constants {
+    // output uv to source uv
+    vec2 uv_scale;
+    // size of a source texel in uv
+    vec2 texel_size;
+    // center of the last texel of the scene, the taps never read past it
+    vec2 uv_max;
+    // 0: lightest, 1: strongest sharpening
+    float sharpness;
+} pc;
+
+layout (location = 0) in vec2 in_uv;
+
+layout (location = 0) out vec4 out_color;
+
+vec3 fetch(vec2 uv)
+{
+    return textureLod(source, min(uv, pc.uv_max), 0.0).rgb;
+}
+
+// Catmull-Rom filter of the 4x4 source texels around uv in five bilinear taps, the corner taps
+// of the full 3x3 tap version contribute little and are left out.
+vec3 catmull_rom(vec2 uv)
+{
+    vec2 position = uv / pc.texel_size;
+    vec2 center = floor(position - 0.5) + 0.5;
+    vec2 f = position - center;
+    vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+    vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+    vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+    vec2 w3 = f * f * (-0.5 + 0.5 * f);
+    // the two middle texels are read with one bilinear tap
+    vec2 w12 = w1 + w2;
+    vec2 uv0 = (center - 1.0) * pc.texel_size;
+    vec2 uv3 = (center + 2.0) * pc.texel_size;
+    vec2 uv12 = (center + w2 / w12) * pc.texel_size;
+
+    vec3 color = fetch(vec2(uv12.x, uv0.y)) * (w12.x * w0.y) +
+                 fetch(vec2(uv0.x, uv12.y)) * (w0.x * w12.y) +
+                 fetch(uv12) * (w12.x * w12.y) +
+                 fetch(vec2(uv3.x, uv12.y)) * (w3.x * w12.y) +
+                 fetch(vec2(uv12.x, uv3.y)) * (w12.x * w3.y);
+    float weight = w12.x * w0.y + w0.x * w12.y + w12.x * w12.y + w3.x * w12.y + w12.x * w3.y;
+    return color / weight;
+}
+
+// Upscales with Catmull-Rom, then sharpens like AMD's contrast adaptive sharpening: the cross of
+// source texels around the pixel is subtracted with a weight which shrinks where the cross
+// already has a high contrast, so edges do not ring and flat areas keep their noise level.
+void main()
+{
+    vec2 uv = in_uv * pc.uv_scale;
+    vec3 center = catmull_rom(uv);
+    vec3 north = fetch(uv - vec2(0.0, pc.texel_size.y));
+    vec3 south = fetch(uv + vec2(0.0, pc.texel_size.y));
+    vec3 west = fetch(uv - vec2(pc.texel_size.x, 0.0));
+    vec3 east = fetch(uv + vec2(pc.texel_size.x, 0.0));
+
+    vec3 lo = min(center, min(min(north, south), min(west, east)));
+    vec3 hi = max(center, max(max(north, south), max(west, east)));
+    vec3 amount = sqrt(clamp(min(lo, 1.0 - hi) / max(hi, 1e-4), 0.0, 1.0));
+    vec3 weight = amount * mix(-0.125, -0.2, pc.sharpness);
+    vec3 color = (center + (north + south + west + east) * weight) / (1.0 + 4.0 * weight);
+    out_color = vec4(clamp(color, 0.0, 1.0), 1.0);
+}
@@ -27,7 +27,8 @@ int main() {
 
   vkh::Device device;
   device.set_context(context);
-  vkh::Swapchain swapchain(device, surface.handle(), window.get_width(), window.get_height(), true);
+  vkh::Swapchain swapchain(device, surface.handle(), window.get_width(), window.get_height(),
+                           vkh::PresentPolicy::Vsync);
   vkh::Semaphore semaphore(device, "test");
   vkh::Fence fence(device, "test", false);
   while (!window.should_close()) {
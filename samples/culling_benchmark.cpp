@@ -0,0 +1,87 @@
+#include <array>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+#include <logging.hpp>
+#include <renderer/frustum_culler.hpp>
+#include <utils/thread_pool.hpp>
+
+using namespace zen;
+using Milliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>;
+
+constexpr uint32_t OBJECT_COUNT = 1'000'000;
+constexpr uint32_t ITERATIONS   = 20;
+
+// objects scattered in a cube around the camera, about a tenth inside the frustum
+void fill(FrustumCuller& culler) {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> position_dist(-1000.0f, 1000.0f);
+  std::uniform_real_distribution<float> size_dist(0.5f, 5.0f);
+  for (uint32_t i = 0; i < OBJECT_COUNT; i++) {
+    const glm::vec3 center(position_dist(rng), position_dist(rng), position_dist(rng));
+    const glm::vec3 extent(size_dist(rng), size_dist(rng), size_dist(rng));
+    culler.add_object(center - extent, center + extent);
+  }
+}
+
+void run(FrustumCuller& culler, const FrustumPlanes& planes, CullVolume volume,
+         CullKernel kernel, uint32_t cores) {
+  culler.cull(planes, volume, kernel);
+  const auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    culler.cull(planes, volume, kernel);
+  }
+  const float ms = Milliseconds(std::chrono::steady_clock::now() - start).count() / ITERATIONS;
+  logger::info("  {:<6} {:<6} {:>2} cores: {:7.3f} ms, {:>7} visible, {:>8.0f} objects/ms/core",
+               FrustumCuller::get_kernel_name(kernel),
+               volume == CullVolume::Sphere ? "sphere" : "aabb", cores, ms,
+               culler.get_visible().size(), float(OBJECT_COUNT) / ms / float(cores));
+}
+
+int main() {
+  util::ThreadPool thread_pool;
+  FrustumCuller serial_culler;
+  FrustumCuller parallel_culler(&thread_pool);
+  fill(serial_culler);
+  fill(parallel_culler);
+
+  const glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+  const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+                                     glm::vec3(0.0f, 1.0f, 0.0f));
+  const FrustumPlanes planes = extract_frustum_planes(proj * view);
+
+  std::vector<CullKernel> kernels = {CullKernel::Scalar};
+  if (FrustumCuller::get_default_kernel() != CullKernel::Scalar) {
+    kernels.push_back(CullKernel::Sse);
+  }
+  if (FrustumCuller::get_default_kernel() == CullKernel::Avx2) {
+    kernels.push_back(CullKernel::Avx2);
+  }
+  logger::info("Culling {} objects, {} worker threads", OBJECT_COUNT, thread_pool.size());
+  for (const CullVolume volume : {CullVolume::Sphere, CullVolume::Aabb}) {
+    for (const CullKernel kernel : kernels) {
+      run(serial_culler, planes, volume, kernel, 1);
+      run(parallel_culler, planes, volume, kernel, thread_pool.size());
+    }
+  }
+
+  // four LODs, each with four times the error of the previous one
+  const uint32_t chain = parallel_culler.add_lod_chain({4, {0.0f, 0.1f, 0.4f, 1.6f}});
+  for (uint32_t i = 0; i < OBJECT_COUNT; i++) {
+    parallel_culler.set_lod_chain(i, chain);
+  }
+  const LodView lod_view = {.projection_scale = get_lod_projection_scale(proj, 1080.0f)};
+  parallel_culler.cull(planes);
+  const auto start = std::chrono::steady_clock::now();
+  parallel_culler.select_lods(lod_view);
+  const float lod_ms = Milliseconds(std::chrono::steady_clock::now() - start).count();
+  std::array<uint32_t, MAX_LODS> lod_counts{};
+  for (uint32_t object : parallel_culler.get_visible()) {
+    lod_counts[parallel_culler.get_lod(object)]++;
+  }
+  logger::info("LOD selection of {} visible objects: {:.3f} ms, LOD 0-3: {} {} {} {}",
+               parallel_culler.get_visible().size(), lod_ms, lod_counts[0], lod_counts[1],
+               lod_counts[2], lod_counts[3]);
+  return 0;
+}
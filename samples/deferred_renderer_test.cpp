@@ -0,0 +1,27 @@
+#include <logging.hpp>
+#include <zen.hpp>
+#include <renderer/deferred_renderer.hpp>
+#include <systems/window_system.hpp>
+#include <vk_helper/context.hpp>
+#include <vk_helper/surface.hpp>
+using namespace zen;
+
+int main(int argc, char** argv) {
+  auto window_config      = sys::Window::default_config();
+  window_config.resizable = true;
+  Ref<sys::Window> window = CreateRef<sys::Window>(window_config);
+  auto instance_exts = vkh::Surface::get_instance_exts();
+  Ref<vkh::Context> context = CreateRef<vkh::Context>();
+  if (!context->create_instance(instance_exts.data(), instance_exts.size())) {
+    logger::error("Failed to create instance");
+    return 1;
+  }
+  DeferredRenderer deferred_renderer{context, window};
+  deferred_renderer.init();
+  while (!window->should_close()) {
+    deferred_renderer.wait_for_frame_start();
+    window->update();
+    deferred_renderer.render();
+  }
+  return 0;
+}
\ No newline at end of file
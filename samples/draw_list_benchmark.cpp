@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <logging.hpp>
+#include <renderer/draw_list.hpp>
+
+using namespace zen;
+using Milliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>;
+
+constexpr uint16_t PIPELINE_COUNT = 16;
+constexpr uint16_t MATERIAL_COUNT = 256;
+constexpr uint32_t MESH_COUNT     = 64;
+constexpr uint8_t OPAQUE_PASS     = 0;
+constexpr uint8_t BLENDED_PASS    = 1;
+
+// Handles are never dereferenced, submission state only depends on their identity.
+template <typename T> T fake_handle(uint64_t id) {
+  return reinterpret_cast<T>(static_cast<uintptr_t>(id + 1));
+}
+
+// Scene order: objects come with random pipelines, materials, meshes and depths, a tenth blended.
+void fill(DrawList& list, uint32_t count, std::mt19937& rng, std::vector<uint64_t>& keys) {
+  std::uniform_int_distribution<uint32_t> pipeline_dist(0, PIPELINE_COUNT - 1);
+  std::uniform_int_distribution<uint32_t> material_dist(0, MATERIAL_COUNT - 1);
+  std::uniform_int_distribution<uint32_t> mesh_dist(0, MESH_COUNT - 1);
+  std::uniform_real_distribution<float> depth_dist(0.1f, 500.0f);
+  list.clear();
+  keys.clear();
+  for (uint32_t i = 0; i < count; i++) {
+    const bool blended   = i % 10 == 0;
+    const uint8_t pass   = blended ? BLENDED_PASS : OPAQUE_PASS;
+    const auto pipeline  = static_cast<uint16_t>(pipeline_dist(rng));
+    const auto material  = static_cast<uint16_t>(material_dist(rng));
+    const uint32_t mesh  = mesh_dist(rng);
+    const uint32_t depth = draw_key::depth_bucket(depth_dist(rng), 0.1f, 500.0f);
+    DrawItem item{
+        .key            = blended ? draw_key::blended(pass, pipeline, material, depth)
+                                  : draw_key::opaque(pass, pipeline, material, depth),
+        .pipeline       = pipeline,
+        .material       = material,
+        .vertex_buffer  = fake_handle<VkBuffer>(mesh),
+        .index_buffer   = fake_handle<VkBuffer>(mesh),
+        .index_count    = 36,
+        .first_index    = 0,
+        .vertex_offset  = 0,
+        .first_instance = i,
+        .instance_count = 1,
+    };
+    list.push(item);
+    keys.push_back(item.key);
+  }
+}
+
+void log_binds(const char* order, const DrawListStats& stats) {
+  logger::info("  {:<6} draws {:>6}  pipeline binds {:>6}  material binds {:>6}"
+               "  buffer binds {:>6}",
+               order, stats.draws, stats.pipeline_binds, stats.material_binds,
+               stats.buffer_binds);
+}
+
+int main() {
+  DrawList list;
+  for (uint16_t i = 0; i < PIPELINE_COUNT; i++) {
+    list.add_pipeline(fake_handle<VkPipeline>(i), fake_handle<VkPipelineLayout>(i % 4));
+  }
+  for (uint16_t i = 0; i < MATERIAL_COUNT; i++) {
+    list.add_material(fake_handle<VkDescriptorSet>(i));
+  }
+  std::mt19937 rng(42);
+  std::vector<uint64_t> keys;
+
+  logger::info("Sort time vs. item count (radix sort / std::sort on the same keys)");
+  for (const uint32_t count : {1'000u, 10'000u, 50'000u, 100'000u, 250'000u, 1'000'000u}) {
+    const uint32_t iterations = std::max(1'000'000u / count, 5u);
+    float radix_ms            = 0.0f;
+    float std_ms              = 0.0f;
+    for (uint32_t i = 0; i < iterations; i++) {
+      fill(list, count, rng, keys);
+      auto start = std::chrono::steady_clock::now();
+      list.sort();
+      radix_ms += Milliseconds(std::chrono::steady_clock::now() - start).count();
+
+      start = std::chrono::steady_clock::now();
+      std::sort(keys.begin(), keys.end());
+      std_ms += Milliseconds(std::chrono::steady_clock::now() - start).count();
+    }
+    logger::info("  {:>8} items: radix {:8.3f} ms  std::sort {:8.3f} ms", count,
+                 radix_ms / float(iterations), std_ms / float(iterations));
+  }
+
+  constexpr uint32_t BIND_COUNT = 100'000;
+  logger::info("State changes for {} items, {} pipelines, {} materials, {} meshes", BIND_COUNT,
+               PIPELINE_COUNT, MATERIAL_COUNT, MESH_COUNT);
+  for (const uint8_t pass : {OPAQUE_PASS, BLENDED_PASS}) {
+    logger::info(" {} pass", pass == OPAQUE_PASS ? "opaque" : "blended");
+    fill(list, BIND_COUNT, rng, keys);
+    log_binds("scene", list.count_binds(pass));
+    list.sort();
+    log_binds("sorted", list.count_binds(pass));
+  }
+
+  // foliage and props: many objects, few meshes and materials
+  constexpr uint32_t INSTANCE_COUNT = 100'000;
+  std::vector<glm::mat4> models(INSTANCE_COUNT, glm::mat4(1.0f));
+  std::vector<glm::mat4> objects(INSTANCE_COUNT);
+  std::uniform_int_distribution<uint32_t> prop_dist(0, 7);
+  std::uniform_real_distribution<float> depth_dist(0.1f, 500.0f);
+  list.clear();
+  for (uint32_t i = 0; i < INSTANCE_COUNT; i++) {
+    const uint32_t prop  = prop_dist(rng);
+    const auto pipeline  = static_cast<uint16_t>(prop % 2);
+    const auto material  = static_cast<uint16_t>(prop % 4);
+    const uint32_t depth = draw_key::depth_bucket(depth_dist(rng), 0.1f, 500.0f);
+    list.push({
+        .key            = draw_key::opaque(OPAQUE_PASS, pipeline, material, depth),
+        .pipeline       = pipeline,
+        .material       = material,
+        .vertex_buffer  = fake_handle<VkBuffer>(0),
+        .index_buffer   = fake_handle<VkBuffer>(0),
+        .index_count    = 36,
+        .first_index    = prop * 36,
+        .vertex_offset  = 0,
+        .first_instance = i,
+        .instance_count = 1,
+    });
+  }
+  logger::info("Instancing {} objects of 8 meshes with 4 materials", INSTANCE_COUNT);
+  list.sort();
+  log_binds("sorted", list.count_binds(OPAQUE_PASS));
+  const auto start = std::chrono::steady_clock::now();
+  list.build_instances(OPAQUE_PASS, models.data(), objects.data(), 0, INSTANCE_COUNT);
+  const float instance_ms = Milliseconds(std::chrono::steady_clock::now() - start).count();
+  log_binds("inst", list.count_binds(OPAQUE_PASS));
+  logger::info("  grouping and packing took {:.3f} ms", instance_ms);
+  return 0;
+}
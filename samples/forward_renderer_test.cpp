@@ -16,5 +16,9 @@ int main(int argc, char** argv) {
   }
   ForwardRenderer forward_renderer{context, window};
   forward_renderer.init();
+  while (!window->should_close()) {
+    window->update();
+    forward_renderer.render();
+  }
   return 0;
 }
\ No newline at end of file
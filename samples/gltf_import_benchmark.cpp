@@ -0,0 +1,219 @@
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <json.hpp>
+#include <stb_image_write.h>
+#include <tiny_gltf.h>
+#include <assets/gltf_importer.hpp>
+#include <logging.hpp>
+#include <utils/thread_pool.hpp>
+#include <vk_helper/context.hpp>
+#include <vk_helper/device.hpp>
+
+using namespace zen;
+using Milliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>;
+
+// 129x129 vertices of 32 bytes and 128x128 quads of 32-bit indices, about 0.9 MB per mesh
+constexpr uint32_t GRID_SIZE      = 129;
+constexpr uint32_t VERTEX_SIZE    = 32;
+constexpr uint32_t IMAGE_COUNT    = 8;
+constexpr uint32_t IMAGE_SIZE     = 1024;
+constexpr uint32_t DEFAULT_MESHES = 512;
+
+uint32_t pad4(size_t size) {
+  return uint32_t((size + 3) & ~size_t(3));
+}
+
+std::vector<std::byte> encode_image(uint32_t image) {
+  std::vector<uint8_t> pixels(size_t(IMAGE_SIZE) * IMAGE_SIZE * 4);
+  for (uint32_t y = 0; y < IMAGE_SIZE; y++) {
+    for (uint32_t x = 0; x < IMAGE_SIZE; x++) {
+      uint8_t* pixel = &pixels[(size_t(y) * IMAGE_SIZE + x) * 4];
+      pixel[0]       = uint8_t(x ^ y);
+      pixel[1]       = uint8_t(x * (image + 1));
+      pixel[2]       = uint8_t(y * 7 + image * 31);
+      pixel[3]       = 255;
+    }
+  }
+  std::vector<std::byte> png;
+  stbi_write_png_to_func(
+      [](void* context, void* data, int size) {
+        auto* bytes = static_cast<std::vector<std::byte>*>(context);
+        bytes->insert(bytes->end(), static_cast<std::byte*>(data),
+                      static_cast<std::byte*>(data) + size);
+      },
+      &png, IMAGE_SIZE, IMAGE_SIZE, 4, pixels.data(), IMAGE_SIZE * 4);
+  return png;
+}
+
+// A .glb with mesh_count wavy grids, every one with an interleaved vertex buffer view, and
+// IMAGE_COUNT embedded PNG textures.
+void write_scene(const std::string& path, uint32_t mesh_count) {
+  using Json                  = nlohmann::json;
+  const uint32_t vertex_count = GRID_SIZE * GRID_SIZE;
+  const uint32_t index_count  = (GRID_SIZE - 1) * (GRID_SIZE - 1) * 6;
+  const uint32_t vertex_bytes = vertex_count * VERTEX_SIZE;
+  const uint32_t index_bytes  = index_count * sizeof(uint32_t);
+  std::vector<std::vector<std::byte>> images;
+  for (uint32_t i = 0; i < IMAGE_COUNT; i++) {
+    images.push_back(encode_image(i));
+  }
+
+  Json document = {{"asset", {{"version", "2.0"}}}, {"scene", 0}};
+  Json views    = Json::array();
+  Json nodes    = Json::array();
+  size_t offset = 0;
+  for (uint32_t i = 0; i < IMAGE_COUNT; i++) {
+    views.push_back({{"buffer", 0}, {"byteOffset", offset}, {"byteLength", images[i].size()}});
+    document["images"].push_back({{"bufferView", i}, {"mimeType", "image/png"}});
+    document["textures"].push_back({{"source", i}});
+    document["materials"].push_back(
+        {{"pbrMetallicRoughness", {{"baseColorTexture", {{"index", i}}}}}});
+    offset += pad4(images[i].size());
+  }
+  for (uint32_t mesh = 0; mesh < mesh_count; mesh++) {
+    const uint32_t view     = uint32_t(views.size());
+    const uint32_t accessor = mesh * 4;
+    views.push_back({{"buffer", 0},
+                     {"byteOffset", offset},
+                     {"byteLength", vertex_bytes},
+                     {"byteStride", VERTEX_SIZE}});
+    views.push_back(
+        {{"buffer", 0}, {"byteOffset", offset + vertex_bytes}, {"byteLength", index_bytes}});
+    offset += vertex_bytes + index_bytes;
+    // position, normal and uv
+    for (const auto& [type, attribute_offset] :
+         {std::pair{"VEC3", 0}, {"VEC3", 12}, {"VEC2", 24}}) {
+      document["accessors"].push_back({{"bufferView", view},
+                                       {"byteOffset", attribute_offset},
+                                       {"componentType", TINYGLTF_COMPONENT_TYPE_FLOAT},
+                                       {"count", vertex_count},
+                                       {"type", type}});
+    }
+    document["accessors"].push_back({{"bufferView", view + 1},
+                                     {"componentType", TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT},
+                                     {"count", index_count},
+                                     {"type", "SCALAR"}});
+    const Json attributes  = {
+        {"POSITION", accessor}, {"NORMAL", accessor + 1}, {"TEXCOORD_0", accessor + 2}};
+    const Json primitive   = {
+        {"attributes", attributes}, {"indices", accessor + 3}, {"material", mesh % IMAGE_COUNT}};
+    const Json translation = {float(mesh % 32) * 2.0f, 0.0f, float(mesh / 32) * 2.0f};
+    document["meshes"].push_back({{"primitives", Json::array({primitive})}});
+    document["nodes"].push_back({{"mesh", mesh}, {"translation", translation}});
+    nodes.push_back(mesh);
+  }
+  document["bufferViews"] = views;
+  document["buffers"]     = Json::array({{{"byteLength", offset}}});
+  document["scenes"]      = Json::array({{{"nodes", nodes}}});
+
+  std::string json = document.dump();
+  json.resize(pad4(json.size()), ' ');
+  const auto write_u32 = [](std::ofstream& file, uint32_t value) {
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+  };
+  std::ofstream file(path, std::ios::binary);
+  write_u32(file, 0x46546C67);
+  write_u32(file, 2);
+  write_u32(file, uint32_t(12 + 8 + json.size() + 8 + offset));
+  write_u32(file, uint32_t(json.size()));
+  write_u32(file, 0x4E4F534A);
+  file.write(json.data(), std::streamsize(json.size()));
+  write_u32(file, uint32_t(offset));
+  write_u32(file, 0x004E4942);
+  for (const auto& image : images) {
+    std::vector<std::byte> padded(image);
+    padded.resize(pad4(image.size()));
+    file.write(reinterpret_cast<const char*>(padded.data()), std::streamsize(padded.size()));
+  }
+  std::vector<float> vertices(size_t(vertex_count) * VERTEX_SIZE / sizeof(float));
+  std::vector<uint32_t> indices;
+  for (uint32_t y = 0; y + 1 < GRID_SIZE; y++) {
+    for (uint32_t x = 0; x + 1 < GRID_SIZE; x++) {
+      const uint32_t i = y * GRID_SIZE + x;
+      indices.insert(indices.end(),
+                     {i, i + GRID_SIZE, i + 1, i + 1, i + GRID_SIZE, i + GRID_SIZE + 1});
+    }
+  }
+  for (uint32_t mesh = 0; mesh < mesh_count; mesh++) {
+    for (uint32_t i = 0; i < vertex_count; i++) {
+      const float u      = float(i % GRID_SIZE) / float(GRID_SIZE - 1);
+      const float v      = float(i / GRID_SIZE) / float(GRID_SIZE - 1);
+      const float height = 0.05f * std::sin(u * 12.0f + float(mesh)) * std::cos(v * 9.0f);
+      float* vertex      = &vertices[size_t(i) * VERTEX_SIZE / sizeof(float)];
+      const float data[] = {u, height, v, 0.0f, 1.0f, 0.0f, u, v};
+      std::memcpy(vertex, data, sizeof(data));
+    }
+    file.write(reinterpret_cast<const char*>(vertices.data()), vertex_bytes);
+    file.write(reinterpret_cast<const char*>(indices.data()), index_bytes);
+  }
+}
+
+// Imports the geometry straight into mapped vertex and index buffers like a renderer would.
+float import(GltfImporter& importer, const std::string& path, const vkh::Device& device,
+             std::byte* image_dst) {
+  const auto start = std::chrono::steady_clock::now();
+  if (!importer.open(path)) {
+    return 0.0f;
+  }
+  importer.create_geometry_buffers(device, image_dst);
+  return Milliseconds(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+  vkh::Context context;
+  if (!context.create_instance(nullptr, 0) ||
+      !context.create_device(VK_NULL_HANDLE, nullptr, 0, nullptr)) {
+    logger::error("Failed to create device");
+    return 1;
+  }
+  vkh::Device device;
+  device.set_context(context);
+
+  const uint32_t mesh_count = argc > 1 ? uint32_t(std::stoul(argv[1])) : DEFAULT_MESHES;
+  const std::string path =
+      (std::filesystem::temp_directory_path() / "zen_gltf_import_benchmark.glb").string();
+  write_scene(path, mesh_count);
+  const auto file_size = float(std::filesystem::file_size(path)) / (1024.0f * 1024.0f);
+  // the file was just written, all runs read it from the page cache
+  logger::info("Importing {} meshes and {} images, {:.1f} MB", mesh_count, IMAGE_COUNT,
+               file_size);
+
+  {
+    tinygltf::TinyGLTF loader;
+    tinygltf::Model model;
+    std::string error;
+    std::string warning;
+    const auto start = std::chrono::steady_clock::now();
+    loader.LoadBinaryFromFile(&model, &error, &warning, path);
+    const float ms = Milliseconds(std::chrono::steady_clock::now() - start).count();
+    // copies the buffers and decodes the images, but converts no vertices
+    logger::info("  tinygltf:               {:8.1f} ms, {:7.1f} MB/s", ms,
+                 file_size / ms * 1000.0f);
+  }
+
+  util::ThreadPool thread_pool;
+  GltfImporter serial_importer;
+  GltfImporter parallel_importer(&thread_pool);
+  serial_importer.open(path);
+  const size_t image_size = serial_importer.get_image_data_size();
+  const size_t upload_size =
+      serial_importer.get_vertex_data_size() + serial_importer.get_index_data_size() + image_size;
+  // stands in for the staging buffer of the textures
+  auto image_data         = std::make_unique_for_overwrite<std::byte[]>(image_size);
+  const float serial_ms   = import(serial_importer, path, device, image_data.get());
+  const float parallel_ms = import(parallel_importer, path, device, image_data.get());
+  logger::info("  GltfImporter  1 thread: {:8.1f} ms, {:7.1f} MB/s", serial_ms,
+               file_size / serial_ms * 1000.0f);
+  logger::info("  GltfImporter {:>2} threads: {:7.1f} ms, {:7.1f} MB/s", thread_pool.size(),
+               parallel_ms, file_size / parallel_ms * 1000.0f);
+  logger::info("  {:.1f} MB of vertices, indices and RGBA8 images written",
+               float(upload_size) / (1024.0f * 1024.0f));
+  std::filesystem::remove(path);
+  return 0;
+}
@@ -0,0 +1,180 @@
+#include "cooked_mesh.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include "assets/gltf_importer.hpp"
+#include "logging.hpp"
+
+namespace zen {
+namespace {
+static_assert(std::endian::native == std::endian::little, "cooked meshes are little endian");
+
+uint64_t align_up(uint64_t offset, uint64_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+}  // namespace
+
+bool write_cooked_mesh(const std::string& path, const GltfImporter& importer,
+                       const std::byte* vertex_data, const std::byte* index_data) {
+  std::vector<CookedMesh> meshes;
+  uint32_t vertex_count = 0;
+  uint32_t index_count  = 0;
+  for (const auto& mesh : importer.get_meshes()) {
+    const bool blended = importer.get_materials()[mesh.material].blended;
+    meshes.push_back({
+        .sphere       = mesh.sphere,
+        .first_vertex = mesh.first_vertex,
+        .vertex_count = mesh.vertex_count,
+        .first_index  = mesh.first_index,
+        .index_count  = mesh.index_count,
+        .flags        = blended ? COOKED_MESH_FLAG_BLENDED : 0,
+        .reserved     = {},
+    });
+    vertex_count = std::max(vertex_count, mesh.first_vertex + mesh.vertex_count);
+    index_count  = std::max(index_count, mesh.first_index + mesh.index_count);
+  }
+  std::vector<CookedInstance> instances;
+  for (const auto& instance : importer.get_instances()) {
+    instances.push_back({.transform = instance.transform, .mesh = instance.mesh, .reserved = {}});
+  }
+
+  const uint64_t vertex_size     = uint64_t(vertex_count) * sizeof(MeshVertex);
+  const uint64_t index_size      = uint64_t(index_count) * sizeof(uint32_t);
+  const uint64_t instance_offset = sizeof(CookedMeshHeader) + meshes.size() * sizeof(CookedMesh);
+  const uint64_t vertex_offset   = align_up(
+      instance_offset + instances.size() * sizeof(CookedInstance), COOKED_MESH_BLOB_ALIGNMENT);
+  const CookedMeshHeader header  = {
+      .magic           = COOKED_MESH_MAGIC,
+      .version         = COOKED_MESH_VERSION,
+      .vertex_stride   = sizeof(MeshVertex),
+      .mesh_count      = uint32_t(meshes.size()),
+      .instance_count  = uint32_t(instances.size()),
+      .vertex_count    = vertex_count,
+      .index_count     = index_count,
+      .reserved        = 0,
+      .mesh_offset     = sizeof(CookedMeshHeader),
+      .instance_offset = instance_offset,
+      .vertex_offset   = vertex_offset,
+      .index_offset    = align_up(vertex_offset + vertex_size, COOKED_MESH_BLOB_ALIGNMENT),
+  };
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  const auto write_at = [&](uint64_t offset, const void* data, uint64_t size) {
+    // the gaps before the blobs are zeroed
+    static constexpr char zeros[COOKED_MESH_BLOB_ALIGNMENT] = {};
+    while (uint64_t(file.tellp()) < offset) {
+      const uint64_t gap = std::min<uint64_t>(offset - uint64_t(file.tellp()), sizeof(zeros));
+      file.write(zeros, std::streamsize(gap));
+    }
+    file.write(static_cast<const char*>(data), std::streamsize(size));
+  };
+  write_at(0, &header, sizeof(header));
+  write_at(header.mesh_offset, meshes.data(), meshes.size() * sizeof(CookedMesh));
+  write_at(header.instance_offset, instances.data(), instances.size() * sizeof(CookedInstance));
+  write_at(header.vertex_offset, vertex_data, vertex_size);
+  write_at(header.index_offset, index_data, index_size);
+  file.close();
+  if (!file) {
+    logger::error("Failed to write cooked mesh file {}", path);
+    return false;
+  }
+  return true;
+}
+
+bool CookedMeshFile::open(const std::string& path) {
+  m_meshes      = {};
+  m_instances   = {};
+  m_vertex_data = {};
+  m_index_data  = {};
+  m_file        = util::MappedFile(path);
+  if (!m_file.is_open()) {
+    logger::error("Failed to map cooked mesh file {}", path);
+    return false;
+  }
+  CookedMeshHeader header;
+  if (m_file.size() < sizeof(header)) {
+    logger::error("Cooked mesh file {} is truncated", path);
+    return false;
+  }
+  std::memcpy(&header, m_file.data(), sizeof(header));
+  if (header.magic != COOKED_MESH_MAGIC) {
+    logger::error("{} is no cooked mesh file", path);
+    return false;
+  }
+  if (header.version != COOKED_MESH_VERSION) {
+    logger::error("Cooked mesh file {} has version {} instead of {}, it has to be cooked again",
+                  path, header.version, COOKED_MESH_VERSION);
+    return false;
+  }
+  if (header.vertex_stride != sizeof(MeshVertex)) {
+    logger::error(
+        "Cooked mesh file {} has {} byte vertices instead of {}, it has to be cooked again", path,
+        header.vertex_stride, sizeof(MeshVertex));
+    return false;
+  }
+  // all of it is checked once here, nothing is read outside the file later
+  const auto fits = [&](uint64_t offset, uint64_t count, uint64_t size) {
+    return offset % alignof(uint32_t) == 0 && offset <= m_file.size() &&
+           count <= (m_file.size() - offset) / size;
+  };
+  if (!fits(header.mesh_offset, header.mesh_count, sizeof(CookedMesh)) ||
+      !fits(header.instance_offset, header.instance_count, sizeof(CookedInstance)) ||
+      !fits(header.vertex_offset, header.vertex_count, sizeof(MeshVertex)) ||
+      !fits(header.index_offset, header.index_count, sizeof(uint32_t))) {
+    logger::error("Cooked mesh file {} is truncated", path);
+    return false;
+  }
+  const std::byte* data = m_file.data();
+  const std::span meshes(reinterpret_cast<const CookedMesh*>(data + header.mesh_offset),
+                         header.mesh_count);
+  const std::span instances(
+      reinterpret_cast<const CookedInstance*>(data + header.instance_offset),
+      header.instance_count);
+  for (const auto& mesh : meshes) {
+    if (uint64_t(mesh.first_vertex) + mesh.vertex_count > header.vertex_count ||
+        uint64_t(mesh.first_index) + mesh.index_count > header.index_count) {
+      logger::error("Cooked mesh file {} has a mesh outside of its blobs", path);
+      return false;
+    }
+  }
+  for (const auto& instance : instances) {
+    if (instance.mesh >= header.mesh_count) {
+      logger::error("Cooked mesh file {} has an instance of a missing mesh", path);
+      return false;
+    }
+  }
+  m_meshes      = meshes;
+  m_instances   = instances;
+  m_vertex_data = {data + header.vertex_offset, header.vertex_count * sizeof(MeshVertex)};
+  m_index_data  = {data + header.index_offset, header.index_count * sizeof(uint32_t)};
+  return true;
+}
+
+void CookedMeshFile::add_to_scene(GpuScene& scene, uint32_t opaque_batch,
+                                  uint32_t blended_batch) const {
+  std::vector<uint32_t> scene_meshes;
+  scene_meshes.reserve(m_meshes.size());
+  for (const auto& mesh : m_meshes) {
+    scene_meshes.push_back(scene.add_mesh_range(mesh.sphere, int32_t(mesh.first_vertex),
+                                                mesh.first_index, mesh.index_count));
+  }
+  for (const auto& instance : m_instances) {
+    const bool blended = m_meshes[instance.mesh].flags & COOKED_MESH_FLAG_BLENDED;
+    scene.add_object(instance.transform, scene_meshes[instance.mesh],
+                     blended ? blended_batch : opaque_batch);
+  }
+}
+
+std::pair<std::unique_ptr<vkh::Buffer>, std::unique_ptr<vkh::Buffer>>
+CookedMeshFile::create_geometry_buffers(const vkh::Device& device) const {
+  auto buffers = GpuScene::create_geometry_buffers(device, "cooked", m_vertex_data.size(),
+                                                   m_index_data.size());
+  std::memcpy(buffers.first->map(), m_vertex_data.data(), m_vertex_data.size());
+  std::memcpy(buffers.second->map(), m_index_data.data(), m_index_data.size());
+  buffers.first->unmap();
+  buffers.second->unmap();
+  return buffers;
+}
+}  // namespace zen
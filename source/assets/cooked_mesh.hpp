@@ -0,0 +1,96 @@
+#ifndef ZENENGINE_COOKED_MESH_HPP
+#define ZENENGINE_COOKED_MESH_HPP
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <glm/glm.hpp>
+#include "renderer/gpu_scene.hpp"
+#include "utils/mapped_file.hpp"
+
+namespace zen {
+class GltfImporter;
+
+// "ZMSH", version is bumped with every layout change, old files have to be cooked again
+constexpr uint32_t COOKED_MESH_MAGIC   = 0x48534D5A;
+constexpr uint32_t COOKED_MESH_VERSION = 1;
+// the vertex and index blobs start on page boundaries of the file
+constexpr uint64_t COOKED_MESH_BLOB_ALIGNMENT = 4096;
+
+// Little endian, the tables follow the header and the blobs follow the tables.
+struct CookedMeshHeader {
+  uint32_t magic;
+  uint32_t version;
+  // sizeof(MeshVertex) when cooked
+  uint32_t vertex_stride;
+  uint32_t mesh_count;
+  uint32_t instance_count;
+  uint32_t vertex_count;
+  uint32_t index_count;
+  uint32_t reserved;
+  // byte offsets in the file
+  uint64_t mesh_offset;
+  uint64_t instance_offset;
+  uint64_t vertex_offset;
+  uint64_t index_offset;
+};
+
+constexpr uint32_t COOKED_MESH_FLAG_BLENDED = 1;
+
+struct CookedMesh {
+  glm::vec4 sphere;
+  uint32_t first_vertex;
+  uint32_t vertex_count;
+  uint32_t first_index;
+  // indices are relative to first_vertex
+  uint32_t index_count;
+  uint32_t flags;
+  uint32_t reserved[3];
+};
+
+struct CookedInstance {
+  glm::mat4 transform;
+  uint32_t mesh;
+  uint32_t reserved[3];
+};
+
+static_assert(sizeof(CookedMeshHeader) == 64 && sizeof(CookedMesh) == 48 &&
+              sizeof(CookedInstance) == 80);
+
+// Cooks the meshes and instances of importer with the vertex and index data its decode()
+// wrote. Returns false if the file cannot be written.
+bool write_cooked_mesh(const std::string& path, const GltfImporter& importer,
+                       const std::byte* vertex_data, const std::byte* index_data);
+
+/// Meshes in the cooked format of write_cooked_mesh(), ready for the GPU without any parsing.
+///
+/// open() maps the file and checks the header and tables. The vertex and index blobs are laid
+/// out like the geometry buffers of a GpuScene, each of them reaches its buffer with a single
+/// copy from the mapping, so loading is bound by the read bandwidth of the disk.
+class CookedMeshFile {
+public:
+  // Returns false if the file cannot be read, has another version or is invalid.
+  bool open(const std::string& path);
+
+  std::span<const CookedMesh> get_meshes() const { return m_meshes; }
+  std::span<const CookedInstance> get_instances() const { return m_instances; }
+  std::span<const std::byte> get_vertex_data() const { return m_vertex_data; }
+  std::span<const std::byte> get_index_data() const { return m_index_data; }
+
+  // Adds the meshes and instances to scene, instances of blended meshes go into blended_batch.
+  // The scene has to be uploaded with the buffers of create_geometry_buffers().
+  void add_to_scene(GpuScene& scene, uint32_t opaque_batch, uint32_t blended_batch) const;
+  // Copies the blobs into new vertex and index buffers, e.g. for GpuScene::upload().
+  std::pair<std::unique_ptr<vkh::Buffer>, std::unique_ptr<vkh::Buffer>> create_geometry_buffers(
+      const vkh::Device& device) const;
+
+private:
+  util::MappedFile m_file;
+  std::span<const CookedMesh> m_meshes;
+  std::span<const CookedInstance> m_instances;
+  std::span<const std::byte> m_vertex_data;
+  std::span<const std::byte> m_index_data;
+};
+}  // namespace zen
+#endif  //ZENENGINE_COOKED_MESH_HPP
@@ -0,0 +1,655 @@
+#include "gltf_importer.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <json.hpp>
+#include <stb_image.h>
+#include <tiny_gltf.h>
+#include "logging.hpp"
+
+namespace zen {
+namespace {
+using Json = nlohmann::json;
+
+constexpr uint32_t GLB_MAGIC       = 0x46546C67;  // "glTF"
+constexpr uint32_t GLB_CHUNK_JSON  = 0x4E4F534A;
+constexpr uint32_t GLB_CHUNK_BIN   = 0x004E4942;
+constexpr size_t GLB_HEADER_SIZE   = 12;
+constexpr size_t GLB_CHUNK_HEADER  = 8;
+// deeper node hierarchies are cut off, which also stops cycles in invalid files
+constexpr uint32_t MAX_NODE_DEPTH = 256;
+
+uint32_t read_u32(const std::byte* data) {
+  uint32_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+// URIs in glTF are percent-encoded
+std::string decode_uri(const std::string& uri) {
+  std::string decoded;
+  for (size_t i = 0; i < uri.size(); i++) {
+    // isxdigit() of a negative char is undefined
+    if (uri[i] == '%' && i + 2 < uri.size() &&
+        std::isxdigit(static_cast<unsigned char>(uri[i + 1])) &&
+        std::isxdigit(static_cast<unsigned char>(uri[i + 2]))) {
+      decoded.push_back(char(std::stoi(uri.substr(i + 1, 2), nullptr, 16)));
+      i += 2;
+    } else {
+      decoded.push_back(uri[i]);
+    }
+  }
+  return decoded;
+}
+
+template <typename T>
+T read_value(const std::byte* data) {
+  T value;
+  std::memcpy(&value, data, sizeof(T));
+  return value;
+}
+
+float read_component(const std::byte* data, int component_type, bool normalized) {
+  switch (component_type) {
+    case TINYGLTF_COMPONENT_TYPE_BYTE: {
+      const float value = read_value<int8_t>(data);
+      return normalized ? std::max(value / 127.0f, -1.0f) : value;
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
+      const float value = read_value<uint8_t>(data);
+      return normalized ? value / 255.0f : value;
+    }
+    case TINYGLTF_COMPONENT_TYPE_SHORT: {
+      const float value = read_value<int16_t>(data);
+      return normalized ? std::max(value / 32767.0f, -1.0f) : value;
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+      const float value = read_value<uint16_t>(data);
+      return normalized ? value / 65535.0f : value;
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+      return float(read_value<uint32_t>(data));
+    default:
+      return read_value<float>(data);
+  }
+}
+
+bool is_index_type(int component_type) {
+  return component_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE ||
+         component_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT ||
+         component_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT;
+}
+
+glm::vec4 to_vec4(const std::vector<double>& values, const glm::vec4& fallback) {
+  glm::vec4 result = fallback;
+  for (size_t i = 0; i < std::min<size_t>(values.size(), 4); i++) {
+    result[int(i)] = float(values[i]);
+  }
+  return result;
+}
+}  // namespace
+
+glm::vec4 GltfImporter::AccessorView::read(uint32_t index, const glm::vec4& fallback) const {
+  if (data == nullptr) {
+    return fallback;
+  }
+  const std::byte* element = data + stride * index;
+  glm::vec4 value          = fallback;
+  if (component_type == TINYGLTF_COMPONENT_TYPE_FLOAT) {
+    std::memcpy(&value, element, components * sizeof(float));
+    return value;
+  }
+  const size_t component_size = tinygltf::GetComponentSizeInBytes(component_type);
+  for (int i = 0; i < components; i++) {
+    value[i] = read_component(element + i * component_size, component_type, normalized);
+  }
+  return value;
+}
+
+uint32_t GltfImporter::AccessorView::read_index(uint32_t index) const {
+  const std::byte* element = data + stride * index;
+  switch (component_type) {
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+      return read_value<uint8_t>(element);
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+      return read_value<uint16_t>(element);
+    default:
+      return read_value<uint32_t>(element);
+  }
+}
+
+GltfImporter::GltfImporter(util::ThreadPool* thread_pool) : m_thread_pool(thread_pool) {}
+
+GltfImporter::~GltfImporter() = default;
+
+void GltfImporter::clear() {
+  m_files.clear();
+  m_buffers.clear();
+  m_image_sources.clear();
+  m_meshes.clear();
+  m_primitives.clear();
+  m_mesh_ranges.clear();
+  m_materials.clear();
+  m_images.clear();
+  m_instances.clear();
+  m_vertex_data_size = 0;
+  m_index_data_size  = 0;
+  m_image_data_size  = 0;
+  m_source_size      = 0;
+}
+
+bool GltfImporter::open(const std::string& path) {
+  clear();
+  util::MappedFile file(path);
+  if (!file.is_open()) {
+    logger::error("Failed to map glTF file {}", path);
+    return false;
+  }
+  std::string_view json(reinterpret_cast<const char*>(file.data()), file.size());
+  std::span<const std::byte> glb_buffer;
+  if (file.size() >= GLB_HEADER_SIZE && read_u32(file.data()) == GLB_MAGIC) {
+    // the header is followed by the JSON chunk and an optional binary chunk
+    const std::byte* chunk  = file.data() + GLB_HEADER_SIZE;
+    const size_t json_start = GLB_HEADER_SIZE + GLB_CHUNK_HEADER;
+    const size_t json_end   = file.size() >= json_start ? json_start + read_u32(chunk) : 0;
+    if (json_end == 0 || json_end > file.size() || read_u32(chunk + 4) != GLB_CHUNK_JSON) {
+      logger::error("Invalid binary glTF file {}", path);
+      return false;
+    }
+    json = {reinterpret_cast<const char*>(chunk + GLB_CHUNK_HEADER), read_u32(chunk)};
+    if (json_end + GLB_CHUNK_HEADER <= file.size() &&
+        read_u32(file.data() + json_end + 4) == GLB_CHUNK_BIN) {
+      const size_t bin_size = std::min<size_t>(read_u32(file.data() + json_end),
+                                               file.size() - json_end - GLB_CHUNK_HEADER);
+      glb_buffer = {file.data() + json_end + GLB_CHUNK_HEADER, bin_size};
+    }
+  }
+  const std::string base_dir = std::filesystem::path(path).parent_path().string();
+  // the mapping, and with it json and glb_buffer, stays where it is
+  m_source_size += file.size();
+  m_files.push_back(std::move(file));
+
+  std::string stripped_json;
+  if (!map_sources(json, base_dir, glb_buffer, stripped_json)) {
+    clear();
+    return false;
+  }
+  tinygltf::TinyGLTF loader;
+  tinygltf::Model model;
+  std::string error;
+  std::string warning;
+  if (!loader.LoadASCIIFromString(&model, &error, &warning, stripped_json.data(),
+                                  static_cast<unsigned int>(stripped_json.size()), base_dir)) {
+    logger::error("Failed to parse glTF file {}: {}", path, error);
+    clear();
+    return false;
+  }
+  if (!warning.empty()) {
+    logger::warn("glTF file {}: {}", path, warning);
+  }
+  add_materials(model);
+  if (!add_meshes(model)) {
+    clear();
+    return false;
+  }
+  add_instances(model);
+  logger::info("Imported {}: {} meshes, {} instances, {} materials, {} images", path,
+               m_meshes.size(), m_instances.size(), m_materials.size(), m_images.size());
+  return true;
+}
+
+bool GltfImporter::map_sources(std::string_view json, const std::string& base_dir,
+                               std::span<const std::byte> glb_buffer,
+                               std::string& stripped_json) {
+  Json document = Json::parse(json.begin(), json.end(), nullptr, false);
+  if (document.is_discarded() || !document.is_object()) {
+    logger::error("The glTF document is no valid JSON object");
+    return false;
+  }
+  const auto map_file = [&](const std::string& uri) -> std::span<const std::byte> {
+    util::MappedFile file((std::filesystem::path(base_dir) / decode_uri(uri)).string());
+    if (!file.is_open()) {
+      return {};
+    }
+    const std::span<const std::byte> data(file.data(), file.size());
+    m_source_size += file.size();
+    m_files.push_back(std::move(file));
+    return data;
+  };
+  try {
+    for (const Json& buffer : document.value("buffers", Json::array())) {
+      const size_t byte_length = buffer.value("byteLength", size_t(0));
+      // only the buffer of a .glb has no uri
+      std::span<const std::byte> data = glb_buffer;
+      if (buffer.contains("uri")) {
+        const std::string uri = buffer["uri"].get<std::string>();
+        if (uri.starts_with("data:")) {
+          logger::error("glTF buffer {} is a data URI, which is not supported", m_buffers.size());
+          return false;
+        }
+        data = map_file(uri);
+      }
+      if (data.size() < byte_length) {
+        logger::error("glTF buffer {} is missing or smaller than {} bytes", m_buffers.size(),
+                      byte_length);
+        return false;
+      }
+      m_buffers.push_back(data.first(byte_length));
+    }
+    const Json buffer_views = document.value("bufferViews", Json::array());
+    for (const Json& image : document.value("images", Json::array())) {
+      std::span<const std::byte> data;
+      if (image.contains("bufferView")) {
+        const size_t index = image["bufferView"].get<size_t>();
+        if (index < buffer_views.size()) {
+          const Json& view    = buffer_views[index];
+          const size_t buffer = view.value("buffer", size_t(0));
+          const size_t offset = view.value("byteOffset", size_t(0));
+          const size_t length = view.value("byteLength", size_t(0));
+          if (buffer < m_buffers.size() && offset + length <= m_buffers[buffer].size()) {
+            data = m_buffers[buffer].subspan(offset, length);
+          }
+        }
+      } else if (image.contains("uri")) {
+        const std::string uri = image["uri"].get<std::string>();
+        if (!uri.starts_with("data:")) {
+          data = map_file(uri);
+        }
+      }
+      if (data.empty()) {
+        logger::warn("glTF image {} cannot be read, it is replaced by white",
+                     m_image_sources.size());
+      }
+      m_image_sources.push_back(data);
+    }
+  } catch (const Json::exception& e) {
+    logger::error("Invalid glTF buffer or image: {}", e.what());
+    return false;
+  }
+
+  // the decoded size is needed for the layout, only the headers are read here
+  for (const auto& source : m_image_sources) {
+    int width      = 1;
+    int height     = 1;
+    int components = 0;
+    if (!source.empty() &&
+        !stbi_info_from_memory(reinterpret_cast<const stbi_uc*>(source.data()),
+                               static_cast<int>(source.size()), &width, &height, &components)) {
+      logger::warn("glTF image {} has an unknown format, it is replaced by white",
+                   m_images.size());
+      width  = 1;
+      height = 1;
+    }
+    m_images.push_back({uint32_t(width), uint32_t(height), m_image_data_size});
+    m_image_data_size += size_t(width) * size_t(height) * 4;
+  }
+
+  // tinygltf would load copies of them
+  document.erase("buffers");
+  document.erase("images");
+  stripped_json = document.dump();
+  return true;
+}
+
+void GltfImporter::add_materials(const tinygltf::Model& model) {
+  const auto get_image = [&](int texture) -> int32_t {
+    if (texture < 0 || size_t(texture) >= model.textures.size()) {
+      return -1;
+    }
+    const int source = model.textures[texture].source;
+    return source >= 0 && size_t(source) < m_images.size() ? source : -1;
+  };
+  for (const auto& material : model.materials) {
+    const auto& pbr = material.pbrMetallicRoughness;
+    m_materials.push_back({
+        .base_color               = to_vec4(pbr.baseColorFactor, glm::vec4(1.0f)),
+        .metallic                 = float(pbr.metallicFactor),
+        .roughness                = float(pbr.roughnessFactor),
+        .emissive                 = to_vec4(material.emissiveFactor, glm::vec4(0.0f)),
+        .base_color_image         = get_image(pbr.baseColorTexture.index),
+        .metallic_roughness_image = get_image(pbr.metallicRoughnessTexture.index),
+        .normal_image             = get_image(material.normalTexture.index),
+        .emissive_image           = get_image(material.emissiveTexture.index),
+        .blended                  = material.alphaMode == "BLEND",
+        .double_sided             = material.doubleSided,
+    });
+  }
+}
+
+bool GltfImporter::add_meshes(const tinygltf::Model& model) {
+  const auto get_view = [&](int index, AccessorView& view) {
+    if (index < 0 || size_t(index) >= model.accessors.size()) {
+      return false;
+    }
+    const auto& accessor = model.accessors[index];
+    if (accessor.sparse.isSparse || accessor.bufferView < 0 ||
+        size_t(accessor.bufferView) >= model.bufferViews.size() ||
+        accessor.count > std::numeric_limits<uint32_t>::max()) {
+      return false;
+    }
+    const auto& buffer_view = model.bufferViews[accessor.bufferView];
+    const int stride        = accessor.ByteStride(buffer_view);
+    const int components    = tinygltf::GetNumComponentsInType(accessor.type);
+    if (buffer_view.buffer < 0 || size_t(buffer_view.buffer) >= m_buffers.size() ||
+        stride <= 0 || components <= 0 || components > 4 ||
+        (accessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT &&
+         accessor.componentType != TINYGLTF_COMPONENT_TYPE_BYTE &&
+         accessor.componentType != TINYGLTF_COMPONENT_TYPE_SHORT &&
+         !is_index_type(accessor.componentType))) {
+      return false;
+    }
+    // every element has to lie in the view, the view in the buffer
+    const auto buffer        = m_buffers[buffer_view.buffer];
+    const size_t view_end    = buffer_view.byteOffset + buffer_view.byteLength;
+    const size_t offset      = buffer_view.byteOffset + accessor.byteOffset;
+    const size_t element_end = size_t(components) *
+                               tinygltf::GetComponentSizeInBytes(accessor.componentType);
+    if (view_end > buffer.size() ||
+        (accessor.count > 0 && offset + size_t(stride) * (accessor.count - 1) + element_end >
+                                   view_end)) {
+      return false;
+    }
+    view = {
+        .data           = buffer.data() + offset,
+        .stride         = size_t(stride),
+        .count          = uint32_t(accessor.count),
+        .component_type = accessor.componentType,
+        .components     = components,
+        .normalized     = accessor.normalized,
+    };
+    return true;
+  };
+
+  uint32_t default_material = std::numeric_limits<uint32_t>::max();
+  size_t vertex_count       = 0;
+  size_t index_count        = 0;
+  for (size_t mesh = 0; mesh < model.meshes.size(); mesh++) {
+    const auto first_mesh = uint32_t(m_meshes.size());
+    for (const auto& primitive : model.meshes[mesh].primitives) {
+      Primitive source;
+      const auto position = primitive.attributes.find("POSITION");
+      if (primitive.mode != TINYGLTF_MODE_TRIANGLES || position == primitive.attributes.end() ||
+          !get_view(position->second, source.positions) ||
+          source.positions.component_type != TINYGLTF_COMPONENT_TYPE_FLOAT ||
+          source.positions.components != 3 || source.positions.count == 0) {
+        logger::warn("Skipping a primitive of glTF mesh {}, it is no triangle list with float "
+                     "positions",
+                     mesh);
+        continue;
+      }
+      // optional attributes with invalid accessors are left out
+      const auto add_attribute = [&](const char* name, AccessorView& view) {
+        const auto attribute = primitive.attributes.find(name);
+        if (attribute != primitive.attributes.end() &&
+            (!get_view(attribute->second, view) || view.count != source.positions.count)) {
+          logger::warn("Ignoring the {} attribute of glTF mesh {}", name, mesh);
+          view = {};
+        }
+      };
+      add_attribute("NORMAL", source.normals);
+      add_attribute("TEXCOORD_0", source.uvs);
+      add_attribute("COLOR_0", source.colors);
+      uint32_t primitive_indices = source.positions.count;
+      if (primitive.indices >= 0) {
+        if (!get_view(primitive.indices, source.indices) || source.indices.components != 1 ||
+            !is_index_type(source.indices.component_type)) {
+          logger::warn("Skipping a primitive of glTF mesh {}, its indices are invalid", mesh);
+          continue;
+        }
+        primitive_indices = source.indices.count;
+      }
+      // whole triangles only
+      primitive_indices -= primitive_indices % 3;
+      if (primitive_indices == 0) {
+        continue;
+      }
+
+      uint32_t material = uint32_t(primitive.material);
+      if (primitive.material < 0 || material >= model.materials.size()) {
+        if (default_material == std::numeric_limits<uint32_t>::max()) {
+          default_material = uint32_t(m_materials.size());
+          m_materials.emplace_back();
+        }
+        material = default_material;
+      }
+      m_meshes.push_back({
+          .material     = material,
+          .first_vertex = uint32_t(vertex_count),
+          .vertex_count = source.positions.count,
+          .first_index  = uint32_t(index_count),
+          .index_count  = primitive_indices,
+      });
+      m_primitives.push_back(source);
+      vertex_count += source.positions.count;
+      index_count += primitive_indices;
+      if (vertex_count > std::numeric_limits<int32_t>::max() ||
+          index_count > std::numeric_limits<uint32_t>::max()) {
+        logger::error("The glTF scene has more vertices or indices than a GpuScene can hold");
+        return false;
+      }
+    }
+    m_mesh_ranges.emplace_back(first_mesh, uint32_t(m_meshes.size()) - first_mesh);
+  }
+  m_vertex_data_size = vertex_count * sizeof(MeshVertex);
+  m_index_data_size  = index_count * sizeof(uint32_t);
+  return true;
+}
+
+void GltfImporter::add_instances(const tinygltf::Model& model) {
+  const auto add_node = [&](const auto& self, int index, const glm::mat4& parent,
+                            uint32_t depth) -> void {
+    if (index < 0 || size_t(index) >= model.nodes.size() || depth > MAX_NODE_DEPTH) {
+      return;
+    }
+    const auto& node = model.nodes[index];
+    glm::mat4 local(1.0f);
+    if (node.matrix.size() == 16) {
+      // column major like glm
+      for (int i = 0; i < 16; i++) {
+        glm::value_ptr(local)[i] = float(node.matrix[i]);
+      }
+    } else {
+      if (node.translation.size() == 3) {
+        local = glm::translate(local, glm::vec3(to_vec4(node.translation, glm::vec4(0.0f))));
+      }
+      if (node.rotation.size() == 4) {
+        const glm::vec4 xyzw = to_vec4(node.rotation, glm::vec4(0.0f));
+        local *= glm::mat4_cast(glm::quat(xyzw.w, xyzw.x, xyzw.y, xyzw.z));
+      }
+      if (node.scale.size() == 3) {
+        local = glm::scale(local, glm::vec3(to_vec4(node.scale, glm::vec4(1.0f))));
+      }
+    }
+    const glm::mat4 world = parent * local;
+    if (node.mesh >= 0 && size_t(node.mesh) < m_mesh_ranges.size()) {
+      const auto [first, count] = m_mesh_ranges[node.mesh];
+      for (uint32_t mesh = first; mesh < first + count; mesh++) {
+        m_instances.push_back({world, mesh});
+      }
+    }
+    for (int child : node.children) {
+      self(self, child, world, depth + 1);
+    }
+  };
+  if (model.scenes.empty()) {
+    // without scenes every mesh is shown once
+    for (uint32_t mesh = 0; mesh < m_meshes.size(); mesh++) {
+      m_instances.push_back({glm::mat4(1.0f), mesh});
+    }
+    return;
+  }
+  const size_t scene = model.defaultScene >= 0 && size_t(model.defaultScene) < model.scenes.size()
+                           ? size_t(model.defaultScene)
+                           : 0;
+  for (int node : model.scenes[scene].nodes) {
+    add_node(add_node, node, glm::mat4(1.0f), 0);
+  }
+}
+
+void GltfImporter::decode(std::byte* vertex_dst, std::byte* index_dst, std::byte* image_dst) {
+  // the images take longest and are started first
+  const auto image_count = image_dst != nullptr ? uint32_t(m_images.size()) : 0;
+  const auto task_count  = uint32_t(image_count + m_meshes.size());
+  const auto run         = [&](uint32_t task) {
+    if (task < image_count) {
+      decode_image(task, image_dst);
+    } else {
+      convert_primitive(task - image_count, vertex_dst, index_dst);
+    }
+  };
+  if (m_thread_pool == nullptr) {
+    for (uint32_t task = 0; task < task_count; task++) {
+      run(task);
+    }
+    return;
+  }
+  m_thread_pool->parallel_for(task_count, 1,
+                              [&](uint32_t begin, uint32_t end, uint32_t, uint32_t) {
+                                for (uint32_t task = begin; task < end; task++) {
+                                  run(task);
+                                }
+                              });
+}
+
+void GltfImporter::decode_image(uint32_t image, std::byte* dst) const {
+  const ImportedImage& info               = m_images[image];
+  const std::span<const std::byte> source = m_image_sources[image];
+  const size_t size                       = size_t(info.width) * info.height * 4;
+  int width                               = 0;
+  int height                              = 0;
+  int components                          = 0;
+  stbi_uc* pixels = source.empty() ? nullptr
+                                   : stbi_load_from_memory(
+                                         reinterpret_cast<const stbi_uc*>(source.data()),
+                                         static_cast<int>(source.size()), &width, &height,
+                                         &components, 4);
+  if (pixels != nullptr && uint32_t(width) == info.width && uint32_t(height) == info.height) {
+    std::memcpy(dst + info.offset, pixels, size);
+  } else {
+    if (!source.empty()) {
+      logger::warn("Failed to decode glTF image {}, it is replaced by white", image);
+    }
+    std::memset(dst + info.offset, 0xff, size);
+  }
+  stbi_image_free(pixels);
+}
+
+void GltfImporter::convert_primitive(uint32_t mesh, std::byte* vertex_dst, std::byte* index_dst) {
+  ImportedMesh& info      = m_meshes[mesh];
+  const Primitive& source = m_primitives[mesh];
+  const auto get_index     = [&](uint32_t i) {
+    return source.indices.data != nullptr ? source.indices.read_index(i) : i;
+  };
+
+  // Missing normals are accumulated from the area weighted triangle normals, the only case
+  // which needs memory of its own.
+  std::vector<glm::vec3> normals;
+  if (source.normals.data == nullptr) {
+    normals.resize(info.vertex_count, glm::vec3(0.0f));
+    for (uint32_t i = 0; i < info.index_count; i += 3) {
+      const uint32_t a = get_index(i);
+      const uint32_t b = get_index(i + 1);
+      const uint32_t c = get_index(i + 2);
+      if (a >= info.vertex_count || b >= info.vertex_count || c >= info.vertex_count) {
+        continue;
+      }
+      const glm::vec3 pa     = source.positions.read(a, glm::vec4(0.0f));
+      const glm::vec3 pb     = source.positions.read(b, glm::vec4(0.0f));
+      const glm::vec3 pc     = source.positions.read(c, glm::vec4(0.0f));
+      const glm::vec3 normal = glm::cross(pb - pa, pc - pa);
+      normals[a] += normal;
+      normals[b] += normal;
+      normals[c] += normal;
+    }
+    for (auto& normal : normals) {
+      const float length = glm::length(normal);
+      normal             = length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+  }
+
+  // The destinations may be write-combined, every vertex is stored once and nothing is read
+  // back. The bounding sphere is computed from the source positions like
+  // compute_bounding_sphere() does from the vertices.
+  const glm::vec3 base_color = m_materials[info.material].base_color;
+  MeshVertex* vertices       = reinterpret_cast<MeshVertex*>(vertex_dst) + info.first_vertex;
+  glm::vec3 min{std::numeric_limits<float>::max()};
+  glm::vec3 max{std::numeric_limits<float>::lowest()};
+  for (uint32_t i = 0; i < info.vertex_count; i++) {
+    const glm::vec3 position = source.positions.read(i, glm::vec4(0.0f));
+    const glm::vec4 color    = source.colors.read(i, glm::vec4(1.0f));
+    vertices[i]              = {
+        .position = position,
+        .normal   = normals.empty() ? glm::vec3(source.normals.read(i, glm::vec4(0.0f)))
+                                    : normals[i],
+        .color    = glm::vec3(color) * base_color,
+        .uv       = source.uvs.read(i, glm::vec4(0.0f)),
+    };
+    min = glm::min(min, position);
+    max = glm::max(max, position);
+  }
+  const glm::vec3 center = (min + max) * 0.5f;
+  float radius           = 0.0f;
+  for (uint32_t i = 0; i < info.vertex_count; i++) {
+    const glm::vec3 position = source.positions.read(i, glm::vec4(0.0f));
+    radius                   = std::max(radius, glm::length(position - center));
+  }
+  info.sphere = glm::vec4(center, radius);
+
+  uint32_t* indices = reinterpret_cast<uint32_t*>(index_dst) + info.first_index;
+  if (source.indices.data == nullptr) {
+    for (uint32_t i = 0; i < info.index_count; i++) {
+      indices[i] = i;
+    }
+    return;
+  }
+  // one loop per index type, out of range indices would read other meshes and become 0
+  const auto widen = [&]<typename T>() {
+    for (uint32_t i = 0; i < info.index_count; i++) {
+      const uint32_t index = read_value<T>(source.indices.data + source.indices.stride * i);
+      indices[i]           = index < info.vertex_count ? index : 0;
+    }
+  };
+  switch (source.indices.component_type) {
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+      widen.template operator()<uint8_t>();
+      break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+      widen.template operator()<uint16_t>();
+      break;
+    default:
+      widen.template operator()<uint32_t>();
+      break;
+  }
+}
+
+std::pair<std::unique_ptr<vkh::Buffer>, std::unique_ptr<vkh::Buffer>>
+GltfImporter::create_geometry_buffers(const vkh::Device& device, std::byte* image_dst) {
+  auto [vertex_buffer, index_buffer] =
+      GpuScene::create_geometry_buffers(device, "glTF", m_vertex_data_size, m_index_data_size);
+  decode(static_cast<std::byte*>(vertex_buffer->map()),
+         static_cast<std::byte*>(index_buffer->map()), image_dst);
+  vertex_buffer->unmap();
+  index_buffer->unmap();
+  return {std::move(vertex_buffer), std::move(index_buffer)};
+}
+
+void GltfImporter::add_to_scene(GpuScene& scene, uint32_t opaque_batch,
+                                uint32_t blended_batch) const {
+  std::vector<uint32_t> scene_meshes;
+  scene_meshes.reserve(m_meshes.size());
+  for (const auto& mesh : m_meshes) {
+    scene_meshes.push_back(scene.add_mesh_range(mesh.sphere, int32_t(mesh.first_vertex),
+                                                mesh.first_index, mesh.index_count));
+  }
+  for (const auto& instance : m_instances) {
+    const bool blended = m_materials[m_meshes[instance.mesh].material].blended;
+    scene.add_object(instance.transform, scene_meshes[instance.mesh],
+                     blended ? blended_batch : opaque_batch);
+  }
+}
+}  // namespace zen
@@ -0,0 +1,154 @@
+#ifndef ZENENGINE_GLTF_IMPORTER_HPP
+#define ZENENGINE_GLTF_IMPORTER_HPP
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+#include "renderer/gpu_scene.hpp"
+#include "utils/mapped_file.hpp"
+#include "utils/thread_pool.hpp"
+
+namespace tinygltf {
+class Model;
+}
+
+namespace zen {
+// metallic-roughness parameters of a glTF material
+struct MaterialData {
+  glm::vec4 base_color{1.0f};
+  float metallic{1.0f};
+  float roughness{1.0f};
+  glm::vec3 emissive{0.0f};
+  // indices into the images of the importer, -1 without a texture
+  int32_t base_color_image{-1};
+  int32_t metallic_roughness_image{-1};
+  int32_t normal_image{-1};
+  int32_t emissive_image{-1};
+  bool blended{false};
+  bool double_sided{false};
+};
+
+// One glTF primitive, its vertices and indices are ranges of the geometry buffers.
+struct ImportedMesh {
+  // center in xyz and radius in w like compute_bounding_sphere(), set by decode()
+  glm::vec4 sphere{0.0f};
+  uint32_t material{0};
+  uint32_t first_vertex{0};
+  uint32_t vertex_count{0};
+  // the indices are relative to first_vertex
+  uint32_t first_index{0};
+  uint32_t index_count{0};
+};
+
+// RGBA8 pixels at offset in the image data
+struct ImportedImage {
+  uint32_t width{0};
+  uint32_t height{0};
+  size_t offset{0};
+};
+
+struct ImportedInstance {
+  glm::mat4 transform{1.0f};
+  uint32_t mesh{0};
+};
+
+/// Imports glTF 2.0 scenes (.gltf with .bin files or .glb) into engine meshes and materials.
+///
+/// open() maps the file and its buffers and lets tinygltf parse the document without them, so
+/// the buffers are never copied into memory of their own. It checks every accessor and lays out
+/// the vertices of all meshes as MeshVertex, their indices widened to 32 bits and the images
+/// decoded to RGBA8. decode() then converts the geometry from the mapped files straight into
+/// its destinations, e.g. the mapped vertex and index buffers of create_geometry_buffers(), which
+/// it only writes. Images and meshes are decoded in parallel on the thread pool.
+///
+/// Only triangle lists are imported. Colors are the COLOR_0 attribute times the base color of
+/// the material, since the mesh shaders take their albedo from the vertex color. Missing
+/// normals are computed from the triangles. Sparse accessors and base64 data URIs are not
+/// supported.
+class GltfImporter {
+public:
+  ZEN_NO_COPY_MOVE(GltfImporter)
+  explicit GltfImporter(util::ThreadPool* thread_pool = nullptr);
+  ~GltfImporter();
+
+  // Returns false if the file cannot be read or is invalid, nothing is imported then.
+  bool open(const std::string& path);
+  // Writes the vertex, index and image data of the get_*_data_size() sizes, the images are
+  // skipped if image_dst is null. Also computes the bounding spheres of the meshes.
+  void decode(std::byte* vertex_dst, std::byte* index_dst, std::byte* image_dst);
+  // Decodes the geometry straight into new host visible vertex and index buffers for
+  // GpuScene::upload(), and the images into image_dst unless it is null.
+  std::pair<std::unique_ptr<vkh::Buffer>, std::unique_ptr<vkh::Buffer>> create_geometry_buffers(
+      const vkh::Device& device, std::byte* image_dst = nullptr);
+  // Adds the meshes and instances to scene after decode(), instances of blended materials go
+  // into blended_batch. The scene has to be uploaded with the buffers of
+  // create_geometry_buffers().
+  void add_to_scene(GpuScene& scene, uint32_t opaque_batch, uint32_t blended_batch) const;
+
+  size_t get_vertex_data_size() const { return m_vertex_data_size; }
+  size_t get_index_data_size() const { return m_index_data_size; }
+  size_t get_image_data_size() const { return m_image_data_size; }
+  // size of the mapped files decode() reads from
+  size_t get_source_size() const { return m_source_size; }
+  const std::vector<ImportedMesh>& get_meshes() const { return m_meshes; }
+  const std::vector<MaterialData>& get_materials() const { return m_materials; }
+  const std::vector<ImportedImage>& get_images() const { return m_images; }
+  const std::vector<ImportedInstance>& get_instances() const { return m_instances; }
+
+private:
+  // strided elements of an accessor in a mapped buffer
+  struct AccessorView {
+    const std::byte* data{nullptr};
+    size_t stride{0};
+    uint32_t count{0};
+    int component_type{0};
+    int components{0};
+    bool normalized{false};
+
+    glm::vec4 read(uint32_t index, const glm::vec4& fallback) const;
+    uint32_t read_index(uint32_t index) const;
+  };
+  // the sources of an ImportedMesh, accessors without data are missing
+  struct Primitive {
+    AccessorView positions;
+    AccessorView normals;
+    AccessorView uvs;
+    AccessorView colors;
+    AccessorView indices;
+  };
+
+  void clear();
+  // Maps the buffers and images of the document, stripped_json is the document without them
+  // for tinygltf.
+  bool map_sources(std::string_view json, const std::string& base_dir,
+                   std::span<const std::byte> glb_buffer, std::string& stripped_json);
+  bool add_meshes(const tinygltf::Model& model);
+  void add_materials(const tinygltf::Model& model);
+  void add_instances(const tinygltf::Model& model);
+  void decode_image(uint32_t image, std::byte* dst) const;
+  void convert_primitive(uint32_t mesh, std::byte* vertex_dst, std::byte* index_dst);
+
+  util::ThreadPool* m_thread_pool;
+  std::vector<util::MappedFile> m_files;
+  std::vector<std::span<const std::byte>> m_buffers;
+  // encoded images, empty if they cannot be read
+  std::vector<std::span<const std::byte>> m_image_sources;
+
+  std::vector<ImportedMesh> m_meshes;
+  std::vector<Primitive> m_primitives;
+  // first mesh and mesh count of every glTF mesh
+  std::vector<std::pair<uint32_t, uint32_t>> m_mesh_ranges;
+  std::vector<MaterialData> m_materials;
+  std::vector<ImportedImage> m_images;
+  std::vector<ImportedInstance> m_instances;
+  size_t m_vertex_data_size{0};
+  size_t m_index_data_size{0};
+  size_t m_image_data_size{0};
+  size_t m_source_size{0};
+};
+}  // namespace zen
+#endif  //ZENENGINE_GLTF_IMPORTER_HPP
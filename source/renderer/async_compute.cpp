@@ -0,0 +1,174 @@
+#include "async_compute.hpp"
+#include "logging.hpp"
+#include "vk_helper/command_buffer.hpp"
+#include "vk_helper/device.hpp"
+
+namespace zen {
+AsyncComputeScheduler::AsyncComputeScheduler(const vkh::Device& device,
+                                             uint32_t frames_in_flight)
+    : m_device(device),
+      m_async(device.has_async_compute_queue()),
+      m_graphics_family(device.graphics_queue_family_index()),
+      m_compute_family(device.compute_queue_family_index()),
+      m_cmd_allocator(device, device.compute_queue_family_index(), frames_in_flight, 1,
+                      "async compute"),
+      m_frame_timeline_values(m_cmd_allocator.frame_count(), 0) {
+  if (!m_async) {
+    logger::warn("No separate compute queue, async compute passes are recorded inline");
+  }
+}
+
+AsyncComputeScheduler::~AsyncComputeScheduler() {
+  // the command pools go away with us
+  for (auto value : m_frame_timeline_values) {
+    m_device.get_timeline(vkh::QUEUE_INDEX_COMPUTE).wait(value);
+  }
+}
+
+void AsyncComputeScheduler::begin_frame(uint32_t frame_index) {
+  m_frame_index = frame_index % m_cmd_allocator.frame_count();
+  // Graphics work waiting on the outputs already covers this, but passes without outputs are
+  // not tracked by the frame fence.
+  m_device.get_timeline(vkh::QUEUE_INDEX_COMPUTE).wait(m_frame_timeline_values[m_frame_index]);
+  m_cmd_allocator.begin_frame(m_frame_index);
+
+  m_graphics_waits.clear();
+  m_pending_acquires.clear();
+  m_last_async_pass_count = m_async_pass_count;
+  m_async_pass_count      = 0;
+}
+
+vkh::TimelinePoint AsyncComputeScheduler::add_pass(const ComputePass& pass,
+                                                   const vkh::CommandBuffer& graphics_cmd) {
+  if (!m_async || !pass.async) {
+    // same queue, plain execution and memory dependencies are enough
+    if (!pass.waits.empty()) {
+      // the waited for work was recorded or submitted earlier on this queue
+      VkPipelineStageFlags wait_stages = 0;
+      for (const auto& wait : pass.waits) {
+        wait_stages |= wait.stages;
+      }
+      graphics_cmd.memory_barrier(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_WRITE_BIT,
+                                  wait_stages,
+                                  VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT);
+    }
+    record_transfers(graphics_cmd.handle(), pass.inputs, VK_QUEUE_FAMILY_IGNORED,
+                     VK_QUEUE_FAMILY_IGNORED, TransferSide::Acquire);
+    pass.record(graphics_cmd);
+    record_transfers(graphics_cmd.handle(), pass.outputs, VK_QUEUE_FAMILY_IGNORED,
+                     VK_QUEUE_FAMILY_IGNORED, TransferSide::Release);
+    return {};
+  }
+
+  auto& cmd = m_cmd_allocator.request_command_buffer();
+  cmd.begin();
+  if (needs_ownership_transfer()) {
+    record_transfers(cmd.handle(), pass.inputs, m_graphics_family, m_compute_family,
+                     TransferSide::Acquire);
+  }
+  pass.record(cmd);
+  if (needs_ownership_transfer()) {
+    record_transfers(cmd.handle(), pass.outputs, m_compute_family, m_graphics_family,
+                     TransferSide::Release);
+  }
+  cmd.end();
+
+  vkh::SubmitBatch batch;
+  batch.cmd_buffers.push_back(cmd.handle());
+  batch.timeline_waits = pass.waits;
+  auto& submitter      = m_device.get_submitter(vkh::QUEUE_INDEX_COMPUTE);
+  const vkh::TimelinePoint point{&submitter.timeline(), submitter.enqueue(std::move(batch))};
+  m_frame_timeline_values[m_frame_index] = point.value;
+  m_async_pass_count++;
+
+  if (!pass.outputs.empty()) {
+    VkPipelineStageFlags consumer_stages = 0;
+    for (const auto& output : pass.outputs) {
+      consumer_stages |= output.dst_stages;
+      if (needs_ownership_transfer()) {
+        m_pending_acquires.push_back(output);
+      }
+    }
+    m_graphics_waits.push_back({point, consumer_stages});
+  }
+  return point;
+}
+
+void AsyncComputeScheduler::submit() {
+  if (m_async) {
+    m_device.get_submitter(vkh::QUEUE_INDEX_COMPUTE).flush();
+  }
+}
+
+void AsyncComputeScheduler::acquire_on_graphics(const vkh::CommandBuffer& graphics_cmd) const {
+  record_transfers(graphics_cmd.handle(), m_pending_acquires, m_compute_family,
+                   m_graphics_family, TransferSide::Acquire);
+}
+
+void AsyncComputeScheduler::release_to_compute(const vkh::CommandBuffer& graphics_cmd,
+                                               const std::vector<QueueTransfer>& transfers) const {
+  if (m_async && needs_ownership_transfer()) {
+    record_transfers(graphics_cmd.handle(), transfers, m_graphics_family, m_compute_family,
+                     TransferSide::Release);
+  }
+}
+
+void AsyncComputeScheduler::record_transfers(VkCommandBuffer cmd,
+                                             const std::vector<QueueTransfer>& transfers,
+                                             uint32_t src_family, uint32_t dst_family,
+                                             TransferSide side) const {
+  if (transfers.empty()) {
+    return;
+  }
+  const bool ownership_transfer = src_family != dst_family;
+  const bool release            = side == TransferSide::Release;
+
+  std::vector<VkBufferMemoryBarrier> buffer_barriers;
+  std::vector<VkImageMemoryBarrier> image_barriers;
+  VkPipelineStageFlags src_stages = 0;
+  VkPipelineStageFlags dst_stages = 0;
+  for (const auto& transfer : transfers) {
+    // The release only makes the writes available, the acquire makes them visible. Access
+    // masks of the other side are ignored for ownership transfers.
+    VkAccessFlags src_access = transfer.src_access;
+    VkAccessFlags dst_access = transfer.dst_access;
+    if (ownership_transfer) {
+      src_access = release ? transfer.src_access : 0;
+      dst_access = release ? 0 : transfer.dst_access;
+    }
+    // the acquire continues the semaphore wait, which waits in the consumer stages
+    src_stages |= (ownership_transfer && !release) ? transfer.dst_stages : transfer.src_stages;
+    dst_stages |= (ownership_transfer && release) ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT
+                                                  : transfer.dst_stages;
+
+    if (transfer.buffer != VK_NULL_HANDLE) {
+      buffer_barriers.push_back({
+          .sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+          .srcAccessMask       = src_access,
+          .dstAccessMask       = dst_access,
+          .srcQueueFamilyIndex = src_family,
+          .dstQueueFamilyIndex = dst_family,
+          .buffer              = transfer.buffer,
+          .offset              = transfer.offset,
+          .size                = transfer.size,
+      });
+    } else {
+      VK_ASSERT(transfer.image != VK_NULL_HANDLE);
+      image_barriers.push_back({
+          .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+          .srcAccessMask       = src_access,
+          .dstAccessMask       = dst_access,
+          .oldLayout           = transfer.old_layout,
+          .newLayout           = transfer.new_layout,
+          .srcQueueFamilyIndex = src_family,
+          .dstQueueFamilyIndex = dst_family,
+          .image               = transfer.image,
+          .subresourceRange    = transfer.subresource_range,
+      });
+    }
+  }
+  vkCmdPipelineBarrier(cmd, src_stages, dst_stages, 0, 0, nullptr,
+                       static_cast<uint32_t>(buffer_barriers.size()), buffer_barriers.data(),
+                       static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+}
+}  // namespace zen
@@ -0,0 +1,106 @@
+#ifndef ZENENGINE_ASYNC_COMPUTE_HPP
+#define ZENENGINE_ASYNC_COMPUTE_HPP
+#include <functional>
+#include <string>
+#include <vector>
+#include "vk_helper/base.hpp"
+#include "vk_helper/command_pool.hpp"
+#include "vk_helper/timeline.hpp"
+
+namespace zen {
+namespace vkh {
+class CommandBuffer;
+class Device;
+}  // namespace vkh
+
+/// A buffer or image handed between the graphics and the compute queue. Set either buffer or
+/// image. Stage/access masks describe the producer (src) and the consumer (dst) side.
+struct QueueTransfer {
+  VkBuffer buffer{VK_NULL_HANDLE};
+  VkDeviceSize offset{0};
+  VkDeviceSize size{VK_WHOLE_SIZE};
+
+  VkImage image{VK_NULL_HANDLE};
+  VkImageSubresourceRange subresource_range{VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS,
+                                            0, VK_REMAINING_ARRAY_LAYERS};
+  VkImageLayout old_layout{VK_IMAGE_LAYOUT_GENERAL};
+  VkImageLayout new_layout{VK_IMAGE_LAYOUT_GENERAL};
+
+  VkPipelineStageFlags src_stages{VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT};
+  VkAccessFlags src_access{VK_ACCESS_SHADER_WRITE_BIT};
+  VkPipelineStageFlags dst_stages{VK_PIPELINE_STAGE_VERTEX_SHADER_BIT};
+  VkAccessFlags dst_access{VK_ACCESS_SHADER_READ_BIT};
+};
+
+struct ComputePass {
+  std::string name;
+  // Async passes run on the compute queue and overlap with graphics work. Without a separate
+  // compute queue they are recorded inline into the graphics command buffer instead.
+  bool async{true};
+  // Resources written by graphics work which the pass reads. Their release barriers must have
+  // been recorded with AsyncComputeScheduler::release_to_compute() in a submission covered by
+  // waits.
+  std::vector<QueueTransfer> inputs;
+  // Resources the pass writes and graphics work of this frame reads.
+  std::vector<QueueTransfer> outputs;
+  // Cross-queue dependencies, usually the graphics timeline value which released the inputs.
+  // Inline passes are ordered after everything recorded before them instead.
+  std::vector<vkh::TimelineWait> waits;
+  std::function<void(const vkh::CommandBuffer&)> record;
+};
+
+/// Schedules compute passes on the dedicated compute queue. The scheduler records the
+/// queue family ownership transfers for pass inputs and outputs and collects the timeline
+/// waits the graphics submission needs before it may consume the outputs.
+///
+/// Per frame: begin_frame(), add_pass()..., submit(), then record the graphics work starting
+/// with acquire_on_graphics() and pass graphics_waits() to the graphics submission.
+class AsyncComputeScheduler {
+public:
+  ZEN_NO_COPY_MOVE(AsyncComputeScheduler)
+  AsyncComputeScheduler(const vkh::Device& device, uint32_t frames_in_flight);
+  ~AsyncComputeScheduler();
+
+  // Waits until the compute work the frame slot recorded last time finished and recycles its
+  // command buffers.
+  void begin_frame(uint32_t frame_index);
+  // Records the pass. Inline passes go into graphics_cmd, which must be outside a render pass.
+  // Returns the compute timeline point of async passes, an empty point for inline ones.
+  vkh::TimelinePoint add_pass(const ComputePass& pass, const vkh::CommandBuffer& graphics_cmd);
+  // Flushes the enqueued async passes to the compute queue so they start executing while the
+  // graphics work is still being recorded.
+  void submit();
+
+  // Records the acquire half of the ownership transfers for this frame's async outputs.
+  void acquire_on_graphics(const vkh::CommandBuffer& graphics_cmd) const;
+  // Records the release half of handing graphics written resources to the compute queue.
+  void release_to_compute(const vkh::CommandBuffer& graphics_cmd,
+                          const std::vector<QueueTransfer>& transfers) const;
+  // Waits the graphics submission of this frame needs for the async outputs it consumes.
+  const std::vector<vkh::TimelineWait>& graphics_waits() const { return m_graphics_waits; }
+
+  bool is_async() const { return m_async; }
+  uint32_t last_async_pass_count() const { return m_last_async_pass_count; }
+
+private:
+  enum class TransferSide { Release, Acquire };
+  void record_transfers(VkCommandBuffer cmd, const std::vector<QueueTransfer>& transfers,
+                        uint32_t src_family, uint32_t dst_family, TransferSide side) const;
+  // ownership transfers are only needed between different queue families
+  bool needs_ownership_transfer() const { return m_compute_family != m_graphics_family; }
+
+  const vkh::Device& m_device;
+  const bool m_async;
+  const uint32_t m_graphics_family;
+  const uint32_t m_compute_family;
+  vkh::FrameCommandAllocator m_cmd_allocator;
+  std::vector<uint64_t> m_frame_timeline_values;
+  uint32_t m_frame_index{0};
+
+  std::vector<vkh::TimelineWait> m_graphics_waits;
+  std::vector<QueueTransfer> m_pending_acquires;
+  uint32_t m_async_pass_count{0};
+  uint32_t m_last_async_pass_count{0};
+};
+}  // namespace zen
+#endif  //ZENENGINE_ASYNC_COMPUTE_HPP
@@ -0,0 +1,220 @@
+#include "clustered_lighting.hpp"
+#include <array>
+#include <cmath>
+#include <limits>
+#include "logging.hpp"
+#include "vk_helper/command_buffer.hpp"
+#include "vk_helper/device.hpp"
+#include "vk_helper/pipeline.hpp"
+
+namespace zen {
+namespace {
+constexpr glm::uvec3 CLUSTER_GRID = {16, 9, 24};
+constexpr uint32_t CLUSTER_COUNT  = CLUSTER_GRID.x * CLUSTER_GRID.y * CLUSTER_GRID.z;
+// on average, clusters near lights take more and the rest fewer
+constexpr uint32_t LIGHTS_PER_CLUSTER = 64;
+constexpr uint32_t MAX_LIGHT_INDICES  = CLUSTER_COUNT * LIGHTS_PER_CLUSTER;
+constexpr uint32_t BINNING_GROUP_SIZE = 64;
+constexpr glm::vec3 AMBIENT_LIGHT     = {0.03f, 0.03f, 0.04f};
+
+// distance of the near plane of slice, the last slice ends at z_far
+float get_slice_depth(uint32_t slice, float z_near, float z_far) {
+  return z_near * std::pow(z_far / z_near, float(slice) / float(CLUSTER_GRID.z));
+}
+}  // namespace
+
+ClusteredLighting::ClusteredLighting(const vkh::Device& device, uint32_t max_lights)
+    : m_device(device),
+      m_max_lights(max_lights),
+      m_binning_shader(device, "light binning"),
+      m_descriptor_layout_cache(device),
+      m_descriptor_allocator(device) {
+  m_binning_shader.add_stage("light_cluster.comp.spv", vkh::ShaderType::Compute).reflect_layout();
+
+  constexpr VmaAllocationCreateFlags host_write =
+      VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+  m_light_buffer  = std::make_unique<vkh::Buffer>(m_device, "lights",
+                                                  m_max_lights * sizeof(GpuLight),
+                                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host_write);
+  m_bounds_buffer = std::make_unique<vkh::Buffer>(m_device, "cluster bounds",
+                                                  CLUSTER_COUNT * sizeof(ClusterBounds),
+                                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host_write);
+  // written by the GPU only
+  m_cluster_buffer     = std::make_unique<vkh::Buffer>(m_device, "light clusters",
+                                                       CLUSTER_COUNT * sizeof(glm::uvec2),
+                                                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 0);
+  m_light_index_buffer = std::make_unique<vkh::Buffer>(m_device, "light indices",
+                                                       MAX_LIGHT_INDICES * sizeof(uint32_t),
+                                                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 0);
+  m_counter_buffer     = std::make_unique<vkh::Buffer>(
+      m_device, "light index counter", sizeof(uint32_t),
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 0);
+
+  std::array<VkDescriptorBufferInfo, 5> binning_infos = {{
+      {m_light_buffer->handle(), 0, VK_WHOLE_SIZE},
+      {m_bounds_buffer->handle(), 0, VK_WHOLE_SIZE},
+      {m_cluster_buffer->handle(), 0, VK_WHOLE_SIZE},
+      {m_light_index_buffer->handle(), 0, VK_WHOLE_SIZE},
+      {m_counter_buffer->handle(), 0, VK_WHOLE_SIZE},
+  }};
+  auto binning = vkh::DescriptorBuilder::begin(&m_descriptor_layout_cache, &m_descriptor_allocator);
+  for (uint32_t i = 0; i < binning_infos.size(); i++) {
+    binning.bind_buffer(i, &binning_infos[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                        VK_SHADER_STAGE_COMPUTE_BIT);
+  }
+  // the lights, the clusters and their light indices, as declared in clustered_lit.frag
+  std::array<VkDescriptorBufferInfo, 3> shading_infos = {
+      binning_infos[0], binning_infos[2], binning_infos[3]};
+  auto shading = vkh::DescriptorBuilder::begin(&m_descriptor_layout_cache, &m_descriptor_allocator);
+  for (uint32_t i = 0; i < shading_infos.size(); i++) {
+    shading.bind_buffer(i, &shading_infos[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                        VK_SHADER_STAGE_FRAGMENT_BIT);
+  }
+  if (!binning.build(m_binning_set) || !shading.build(m_shading_set)) {
+    logger::error("Failed to allocate the light descriptor sets");
+  }
+
+  std::vector<VkPipelineShaderStageCreateInfo> stages;
+  m_binning_shader.fill_stage_cis(stages);
+  m_binning_pipeline = vkh::create_compute_pipeline(
+      m_device, m_binning_shader.get_pipeline_layout(), stages.front(), "light binning");
+}
+
+ClusteredLighting::~ClusteredLighting() {
+  if (m_binning_pipeline != VK_NULL_HANDLE) {
+    m_device.destroy_pipeline(m_binning_pipeline);
+  }
+  m_device.destroy_pipeline_layout(m_binning_shader.get_pipeline_layout());
+}
+
+uint32_t ClusteredLighting::add_light(const Light& light) {
+  if (m_light_count == m_max_lights) {
+    logger::warn("Light limit of {} reached, dropping the light", m_max_lights);
+    return INVALID_LIGHT;
+  }
+  m_light_count++;
+  set_light(m_light_count - 1, light);
+  return m_light_count - 1;
+}
+
+void ClusteredLighting::set_light(uint32_t index, const Light& light) {
+  if (index >= m_light_count) {
+    logger::warn("Ignoring an update of light {}, there are {} lights", index, m_light_count);
+    return;
+  }
+  GpuLight gpu_light = {
+      .position_range      = glm::vec4(light.position, light.range),
+      .color_intensity     = glm::vec4(light.color, light.intensity),
+      .direction_cos_outer = glm::vec4(glm::normalize(light.direction), light.cos_outer),
+      .spot                = glm::vec4(light.cos_inner, 0.0f, 0.0f, 0.0f),
+  };
+  m_light_buffer->update(&gpu_light, sizeof(GpuLight), index * sizeof(GpuLight));
+}
+
+ComputePass ClusteredLighting::create_binning_pass(const ClusterView& view) {
+  const auto output = [](VkBuffer buffer) {
+    return QueueTransfer{
+        .buffer     = buffer,
+        .src_stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        .src_access = VK_ACCESS_SHADER_WRITE_BIT,
+        .dst_stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        .dst_access = VK_ACCESS_SHADER_READ_BIT,
+    };
+  };
+  // The shading of the frames submitted so far reads the clusters which are overwritten. Their
+  // contents are not kept, so no ownership transfer back to the compute queue is needed.
+  const vkh::TimelinePoint shading = {
+      &m_device.get_timeline(vkh::QUEUE_INDEX_GRAPHICS),
+      m_device.get_timeline(vkh::QUEUE_INDEX_GRAPHICS).last_submitted_value()};
+  return {
+      .name    = "light binning",
+      .outputs = {output(m_cluster_buffer->handle()), output(m_light_index_buffer->handle())},
+      .waits   = {{shading, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT}},
+      .record  = [this, view](const vkh::CommandBuffer& cmd) { record_binning(cmd, view); },
+  };
+}
+
+void ClusteredLighting::import_clusters(RenderGraph& graph) {
+  m_clusters      = graph.import_buffer("light clusters", m_cluster_buffer->handle());
+  m_light_indices = graph.import_buffer("light indices", m_light_index_buffer->handle());
+}
+
+void ClusteredLighting::declare_shading_inputs(RGPass& pass) const {
+  pass.add_buffer_input(m_clusters, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR,
+                        VK_ACCESS_2_SHADER_READ_BIT_KHR)
+      .add_buffer_input(m_light_indices, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR,
+                        VK_ACCESS_2_SHADER_READ_BIT_KHR);
+}
+
+void ClusteredLighting::bind_shading(const vkh::CommandBuffer& cmd, VkPipelineLayout layout,
+                                     uint32_t set, VkExtent2D extent) const {
+  // slice = log(depth) * scale + bias inverts get_slice_depth()
+  const float log_range            = std::log(m_bounds_far / m_bounds_near);
+  const ShadingConstants constants = {
+      .grid              = glm::uvec4(CLUSTER_GRID, 0),
+      .screen_to_cluster = {1.0f / float(extent.width), 1.0f / float(extent.height),
+                            float(CLUSTER_GRID.z) / log_range,
+                            -float(CLUSTER_GRID.z) * std::log(m_bounds_near) / log_range},
+      .ambient           = glm::vec4(AMBIENT_LIGHT, 0.0f),
+  };
+  cmd.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_GRAPHICS, layout, set, {m_shading_set});
+  cmd.push_constants(layout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(constants), &constants);
+}
+
+void ClusteredLighting::update_cluster_bounds(const ClusterView& view) {
+  if (view.proj == m_bounds_proj && view.z_near == m_bounds_near && view.z_far == m_bounds_far) {
+    return;
+  }
+  m_bounds_proj = view.proj;
+  m_bounds_near = view.z_near;
+  m_bounds_far  = view.z_far;
+
+  // Only changes with the projection, e.g. on resize. Frames in flight may then bin with a mix
+  // of old and new bounds for a frame.
+  const glm::mat4 inv_proj = glm::inverse(view.proj);
+  std::vector<ClusterBounds> bounds(CLUSTER_COUNT);
+  for (uint32_t z = 0; z < CLUSTER_GRID.z; z++) {
+    const float near_depth = get_slice_depth(z, view.z_near, view.z_far);
+    const float far_depth  = get_slice_depth(z + 1, view.z_near, view.z_far);
+    for (uint32_t y = 0; y < CLUSTER_GRID.y; y++) {
+      for (uint32_t x = 0; x < CLUSTER_GRID.x; x++) {
+        glm::vec3 min_point{std::numeric_limits<float>::max()};
+        glm::vec3 max_point{std::numeric_limits<float>::lowest()};
+        // the tile corners as view space rays, cut at both depths of the slice
+        for (uint32_t corner = 0; corner < 4; corner++) {
+          const glm::vec2 ndc   = {-1.0f + 2.0f * float(x + (corner & 1)) / float(CLUSTER_GRID.x),
+                                   -1.0f + 2.0f * float(y + (corner >> 1)) / float(CLUSTER_GRID.y)};
+          const glm::vec4 point = inv_proj * glm::vec4(ndc, 1.0f, 1.0f);
+          const glm::vec3 ray   = glm::vec3(point) / -point.z;
+          for (float depth : {near_depth, far_depth}) {
+            min_point = glm::min(min_point, ray * depth);
+            max_point = glm::max(max_point, ray * depth);
+          }
+        }
+        bounds[(z * CLUSTER_GRID.y + y) * CLUSTER_GRID.x + x] = {glm::vec4(min_point, 0.0f),
+                                                                 glm::vec4(max_point, 0.0f)};
+      }
+    }
+  }
+  m_bounds_buffer->update(bounds.data(), bounds.size() * sizeof(ClusterBounds));
+}
+
+void ClusteredLighting::record_binning(const vkh::CommandBuffer& cmd, const ClusterView& view) {
+  update_cluster_bounds(view);
+  cmd.fill_buffer(m_counter_buffer->handle(), 0);
+  cmd.memory_barrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                     VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+  const VkPipelineLayout layout    = m_binning_shader.get_pipeline_layout();
+  const BinningConstants constants = {
+      .view              = view.view,
+      .light_count       = m_light_count,
+      .cluster_count     = CLUSTER_COUNT,
+      .max_light_indices = MAX_LIGHT_INDICES,
+  };
+  cmd.bind_pipeline(VK_PIPELINE_BIND_POINT_COMPUTE, m_binning_pipeline);
+  cmd.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, {m_binning_set});
+  cmd.push_constants(layout, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(constants), &constants);
+  cmd.dispatch((CLUSTER_COUNT + BINNING_GROUP_SIZE - 1) / BINNING_GROUP_SIZE);
+}
+}  // namespace zen
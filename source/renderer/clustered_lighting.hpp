@@ -0,0 +1,119 @@
+#ifndef ZENENGINE_CLUSTERED_LIGHTING_HPP
+#define ZENENGINE_CLUSTERED_LIGHTING_HPP
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+#include "async_compute.hpp"
+#include "render_graph.hpp"
+#include "vk_helper/buffer.hpp"
+#include "vk_helper/descriptor.hpp"
+#include "vk_helper/shader.hpp"
+
+namespace zen {
+struct Light {
+  glm::vec3 position{0.0f};
+  float range{10.0f};
+  glm::vec3 color{1.0f};
+  float intensity{1.0f};
+  // spot lights only, a cos_outer of -1 makes a point light
+  glm::vec3 direction{0.0f, -1.0f, 0.0f};
+  float cos_outer{-1.0f};
+  float cos_inner{-1.0f};
+};
+
+struct ClusterView {
+  glm::mat4 view{1.0f};
+  glm::mat4 proj{1.0f};
+  float z_near{0.1f};
+  float z_far{100.0f};
+};
+
+/// Clustered forward lighting for many point and spot lights.
+///
+/// The view frustum is split into a 16x9x24 grid of clusters, uniform on screen and exponential
+/// in depth. Each frame a compute pass bins the lights into the clusters by testing their range
+/// against the view space AABB of every cluster and writes a compact list of light indices per
+/// cluster. The fragment shader (clustered_lit.frag) looks up its cluster and shades only the
+/// lights in it.
+///
+/// The binning only reads CPU written buffers, so it runs on the async compute queue and overlaps
+/// with the graphics work of the frame up to the shading pass.
+class ClusteredLighting {
+public:
+  ZEN_NO_COPY_MOVE(ClusteredLighting)
+  explicit ClusteredLighting(const vkh::Device& device, uint32_t max_lights = 4096);
+  ~ClusteredLighting();
+
+  // returned by add_light() when the light buffer is full
+  static constexpr uint32_t INVALID_LIGHT = ~0u;
+
+  uint32_t add_light(const Light& light);
+  // Frames in flight may see the new light early. Indices not returned by add_light() are
+  // rejected.
+  void set_light(uint32_t index, const Light& light);
+  uint32_t get_light_count() const { return m_light_count; }
+
+  // The binning for view, to be added to an AsyncComputeScheduler before the graphics work of
+  // the frame. The clusters are its outputs, handed to the fragment shaders of the graphics queue.
+  ComputePass create_binning_pass(const ClusterView& view);
+  // Imports the clusters into the graph of the shading pass, call before declare_shading_inputs().
+  void import_clusters(RenderGraph& graph);
+  // Declares the cluster reads of the fragment shader on the pass shading with the lights.
+  void declare_shading_inputs(RGPass& pass) const;
+  // binds the lights at set of the shading pipeline and pushes the cluster parameters
+  void bind_shading(const vkh::CommandBuffer& cmd, VkPipelineLayout layout, uint32_t set,
+                    VkExtent2D extent) const;
+
+private:
+  // matches Light in light_cluster.comp and clustered_lit.frag
+  struct GpuLight {
+    glm::vec4 position_range;
+    glm::vec4 color_intensity;
+    glm::vec4 direction_cos_outer;
+    glm::vec4 spot;
+  };
+  struct ClusterBounds {
+    glm::vec4 min_point;
+    glm::vec4 max_point;
+  };
+  struct BinningConstants {
+    glm::mat4 view;
+    uint32_t light_count;
+    uint32_t cluster_count;
+    uint32_t max_light_indices;
+  };
+  // matches ClusterParams in clustered_lit.frag
+  struct ShadingConstants {
+    glm::uvec4 grid;
+    glm::vec4 screen_to_cluster;
+    glm::vec4 ambient;
+  };
+
+  void update_cluster_bounds(const ClusterView& view);
+  void record_binning(const vkh::CommandBuffer& cmd, const ClusterView& view);
+
+  const vkh::Device& m_device;
+  uint32_t m_max_lights;
+  uint32_t m_light_count{0};
+  // the projection the cluster bounds were computed for
+  glm::mat4 m_bounds_proj{0.0f};
+  float m_bounds_near{0.0f};
+  float m_bounds_far{0.0f};
+
+  std::unique_ptr<vkh::Buffer> m_light_buffer;
+  std::unique_ptr<vkh::Buffer> m_bounds_buffer;
+  std::unique_ptr<vkh::Buffer> m_cluster_buffer;
+  std::unique_ptr<vkh::Buffer> m_light_index_buffer;
+  std::unique_ptr<vkh::Buffer> m_counter_buffer;
+  RGResourceHandle m_clusters;
+  RGResourceHandle m_light_indices;
+
+  vkh::ShaderProgram m_binning_shader;
+  VkPipeline m_binning_pipeline{VK_NULL_HANDLE};
+  vkh::DescriptorLayoutCache m_descriptor_layout_cache;
+  vkh::DescriptorAllocator m_descriptor_allocator;
+  VkDescriptorSet m_binning_set{VK_NULL_HANDLE};
+  VkDescriptorSet m_shading_set{VK_NULL_HANDLE};
+};
+}  // namespace zen
+#endif  //ZENENGINE_CLUSTERED_LIGHTING_HPP
@@ -0,0 +1,391 @@
+#include "deferred_renderer.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <tuple>
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+#include "gpu_scene.hpp"
+#include "logging.hpp"
+#include "vk_helper/command_buffer.hpp"
+#include "vk_helper/pipeline.hpp"
+
+namespace zen {
+namespace {
+constexpr uint32_t GRID_SIZE      = 16;
+constexpr float GRID_SPACING      = 1.5f;
+constexpr uint32_t MATERIAL_COUNT = 8;
+constexpr float Z_NEAR            = 0.1f;
+constexpr float Z_FAR             = 100.0f;
+// DrawList pass of the G-buffer draws
+constexpr uint8_t GBUFFER_PASS = 0;
+
+struct GBufferConstants {
+  glm::mat4 view_proj;
+};
+
+struct LightingConstants {
+  glm::mat4 inv_view_proj;
+  glm::vec4 params;
+};
+
+// cube from -1 to 1, four vertices per face
+MeshData make_cube() {
+  MeshData mesh;
+  const std::array<glm::vec3, 6> normals = {{
+      {1.0f, 0.0f, 0.0f},
+      {-1.0f, 0.0f, 0.0f},
+      {0.0f, 1.0f, 0.0f},
+      {0.0f, -1.0f, 0.0f},
+      {0.0f, 0.0f, 1.0f},
+      {0.0f, 0.0f, -1.0f},
+  }};
+  for (const glm::vec3& n : normals) {
+    const glm::vec3 u = std::abs(n.y) > 0.5f ? glm::vec3(1.0f, 0.0f, 0.0f)
+                                             : glm::vec3(0.0f, 1.0f, 0.0f);
+    const glm::vec3 v    = glm::cross(n, u);
+    const uint32_t first = static_cast<uint32_t>(mesh.vertices.size());
+    for (const glm::vec2& corner : {glm::vec2(-1.0f, -1.0f), glm::vec2(1.0f, -1.0f),
+                                    glm::vec2(1.0f, 1.0f), glm::vec2(-1.0f, 1.0f)}) {
+      mesh.vertices.push_back({n + corner.x * u + corner.y * v, n, glm::vec3(1.0f),
+                               corner * 0.5f + 0.5f});
+    }
+    for (uint32_t index : {0u, 1u, 2u, 0u, 2u, 3u}) {
+      mesh.indices.push_back(first + index);
+    }
+  }
+  return mesh;
+}
+}  // namespace
+
+DeferredRenderer::DeferredRenderer(const Ref<vkh::Context>& context,
+                                   const Ref<sys::Window>& window) {
+  m_context = context;
+  m_window  = window;
+}
+
+DeferredRenderer::~DeferredRenderer() {
+  if (!m_device) {
+    return;
+  }
+  // frames in flight must finish before pipelines and graph resources go away
+  m_frames.reset();
+  if (m_gbuffer_pipeline != VK_NULL_HANDLE) {
+    m_device->destroy_pipeline(m_gbuffer_pipeline);
+  }
+  if (m_lighting_pipeline != VK_NULL_HANDLE) {
+    m_device->destroy_pipeline(m_lighting_pipeline);
+  }
+  if (m_gbuffer_shader) {
+    m_device->destroy_pipeline_layout(m_gbuffer_shader->get_pipeline_layout());
+  }
+  if (m_lighting_shader) {
+    m_device->destroy_pipeline_layout(m_lighting_shader->get_pipeline_layout());
+  }
+  m_retired_allocators.clear();
+  m_render_graph.reset();
+}
+
+void DeferredRenderer::init() {
+  m_surface = CreateScope<vkh::Surface>(m_context->get_instance(), m_window->handle());
+  auto device_exts = vkh::Surface::get_device_exts();
+  if (!m_context->create_device(m_surface->handle(), device_exts.data(), device_exts.size(),
+                                nullptr)) {
+    logger::error("Failed to create device");
+    return;
+  }
+  m_device = CreateScope<vkh::Device>();
+  m_device->set_context(*m_context);
+  m_swapchain   = CreateScope<vkh::Swapchain>(*m_device, m_surface->handle(), m_window->get_width(),
+                                              m_window->get_height(), vkh::PresentPolicy::Vsync);
+  m_thread_pool = CreateScope<util::ThreadPool>();
+  m_recorder    = CreateScope<vkh::ParallelRecorder>(*m_thread_pool);
+  m_frames      = CreateScope<vkh::FrameContextRing>(*m_device, *m_swapchain, 2,
+                                                     m_thread_pool->size() + 1);
+  // one frame queued for presentation at most, input is sampled right before the deadline
+  m_frames->enable_frame_pacing({.max_queued_frames = 1});
+
+  m_gbuffer_shader = CreateScope<vkh::ShaderProgram>(*m_device, "gbuffer");
+  m_gbuffer_shader->add_stage("gbuffer.vert.spv", vkh::ShaderType::Vertex)
+      .add_stage("gbuffer.frag.spv", vkh::ShaderType::Fragment)
+      .reflect_layout();
+  m_lighting_shader = CreateScope<vkh::ShaderProgram>(*m_device, "deferred lighting");
+  m_lighting_shader->add_stage("fullscreen.vert.spv", vkh::ShaderType::Vertex)
+      .add_stage("deferred_lighting.frag.spv", vkh::ShaderType::Fragment)
+      .reflect_layout();
+  m_descriptor_layout_cache    = CreateScope<vkh::DescriptorLayoutCache>(*m_device);
+  m_descriptor_allocator       = CreateScope<vkh::DescriptorAllocator>(*m_device);
+  m_scene_descriptor_allocator = CreateScope<vkh::DescriptorAllocator>(*m_device);
+  build_scene();
+
+  m_render_graph = CreateScope<RenderGraph>(*m_device, m_frames->frames_in_flight(),
+                                            uint32_t(m_swapchain->get_image_count()));
+  build_render_graph();
+}
+
+void DeferredRenderer::build_scene() {
+  MeshData cube = make_cube();
+  const VkDeviceSize vertex_size = cube.vertices.size() * sizeof(MeshVertex);
+  const VkDeviceSize index_size  = cube.indices.size() * sizeof(uint32_t);
+  std::tie(m_vertex_buffer, m_index_buffer) =
+      GpuScene::create_geometry_buffers(*m_device, "cube", vertex_size, index_size);
+  m_vertex_buffer->update(cube.vertices.data(), vertex_size);
+  m_index_buffer->update(cube.indices.data(), index_size);
+  m_index_count = static_cast<uint32_t>(cube.indices.size());
+
+  for (uint32_t i = 0; i < MATERIAL_COUNT; i++) {
+    const float phase = glm::two_pi<float>() * float(i) / float(MATERIAL_COUNT);
+    glm::vec4 albedo  = {0.5f + 0.5f * glm::cos(glm::vec3(0.0f, 2.0f, 4.0f) + phase), 1.0f};
+    m_material_buffers.push_back(CreateScope<vkh::UniformBuffer>(
+        *m_device, "material " + std::to_string(i), sizeof(albedo)));
+    m_material_buffers.back()->update(&albedo, sizeof(albedo));
+    auto material_info  = VkDescriptorBufferInfo{m_material_buffers.back()->handle(), 0,
+                                                 VK_WHOLE_SIZE};
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    vkh::DescriptorBuilder::begin(m_descriptor_layout_cache.get(),
+                                  m_scene_descriptor_allocator.get())
+        .bind_buffer(0, &material_info, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                     VK_SHADER_STAGE_FRAGMENT_BIT)
+        .build(set);
+    m_materials.push_back(m_draw_list.add_material(set));
+  }
+
+  // the matrices are written every frame, the cubes change their height
+  m_models.resize(GRID_SIZE * GRID_SIZE, glm::mat4(1.0f));
+  for (uint32_t i = 0; i < m_frames->frames_in_flight(); i++) {
+    m_object_buffers.push_back(CreateScope<vkh::StorageBuffer>(
+        *m_device, "objects " + std::to_string(i), m_models.size() * sizeof(glm::mat4)));
+    auto object_info = VkDescriptorBufferInfo{m_object_buffers[i]->handle(), 0, VK_WHOLE_SIZE};
+    m_object_sets.emplace_back();
+    vkh::DescriptorBuilder::begin(m_descriptor_layout_cache.get(),
+                                  m_scene_descriptor_allocator.get())
+        .bind_buffer(0, &object_info, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                     VK_SHADER_STAGE_VERTEX_BIT)
+        .build(m_object_sets.back());
+  }
+}
+
+void DeferredRenderer::build_render_graph() {
+  m_render_graph->set_render_extent(m_swapchain->get_extent());
+  // passes without input attachments may still use dynamic rendering, the G-buffer and
+  // lighting passes are merged into one render pass either way
+  m_render_graph->set_dynamic_rendering(true);
+  m_backbuffer = m_render_graph->import_image(
+      "backbuffer",
+      {.format = m_swapchain->get_format(), .usage = m_swapchain->get_image_usage()},
+      VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR);
+  m_albedo = m_render_graph->create_image("gbuffer albedo", {.format = VK_FORMAT_R8G8B8A8_UNORM});
+  m_normal = m_render_graph->create_image("gbuffer normal",
+                                          {.format = VK_FORMAT_A2B10G10R10_UNORM_PACK32});
+  m_depth  = m_render_graph->create_image("depth", {.format = VK_FORMAT_D32_SFLOAT});
+
+  // shader output locations follow the order of the color outputs
+  m_render_graph->add_pass("gbuffer")
+      .add_color_output(m_albedo, VkClearColorValue{})
+      .add_color_output(m_normal, VkClearColorValue{})
+      .set_depth_output(m_depth, VkClearDepthStencilValue{1.0f, 0})
+      .set_secondary_command_buffers()
+      .set_execute([this](const RGPassContext& ctx) { record_gbuffer(ctx); });
+  // input attachment indices follow the order of the inputs
+  m_render_graph->add_pass("lighting")
+      .add_input_attachment(m_albedo)
+      .add_input_attachment(m_normal)
+      .add_input_attachment(m_depth)
+      .add_color_output(m_backbuffer, VkClearColorValue{{0.1f, 0.1f, 0.1f, 1.0f}})
+      .set_execute([this](const RGPassContext& ctx) { record_lighting(ctx); });
+  if (!m_render_graph->compile()) {
+    logger::error("Failed to compile render graph");
+    return;
+  }
+  update_lighting_descriptors();
+}
+
+bool DeferredRenderer::recreate_swapchain() {
+  if (!m_swapchain->recreate(m_window->get_width(), m_window->get_height())) {
+    return false;
+  }
+  m_window->resize();
+  m_frames->on_swapchain_recreated();
+  // the G-buffer follows the new extent, frames in flight keep the old one until they finished
+  m_render_graph->reset();
+  build_render_graph();
+  return true;
+}
+
+void DeferredRenderer::update_lighting_descriptors() {
+  // The set of the old G-buffer is freed with its allocator once the frames submitted so far
+  // finished, a fresh allocator holds the new one.
+  const auto& timeline = m_device->get_timeline(vkh::QUEUE_INDEX_GRAPHICS);
+  while (!m_retired_allocators.empty() &&
+         timeline.is_complete(m_retired_allocators.front().retire_value)) {
+    m_retired_allocators.pop_front();
+  }
+  if (m_lighting_set != VK_NULL_HANDLE) {
+    m_retired_allocators.push_back(
+        {std::move(m_descriptor_allocator), timeline.last_submitted_value()});
+    m_descriptor_allocator = CreateScope<vkh::DescriptorAllocator>(*m_device);
+    m_lighting_set         = VK_NULL_HANDLE;
+  }
+  std::array<VkDescriptorImageInfo, 3> image_infos = {{
+      {VK_NULL_HANDLE, m_render_graph->get_image_view(m_albedo),
+       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+      {VK_NULL_HANDLE, m_render_graph->get_image_view(m_normal),
+       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+      {VK_NULL_HANDLE, m_render_graph->get_image_view(m_depth),
+       VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL},
+  }};
+  auto builder =
+      vkh::DescriptorBuilder::begin(m_descriptor_layout_cache.get(), m_descriptor_allocator.get());
+  for (uint32_t i = 0; i < image_infos.size(); i++) {
+    builder.bind_image(i, &image_infos[i], VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
+                       VK_SHADER_STAGE_FRAGMENT_BIT);
+  }
+  if (!builder.build(m_lighting_set)) {
+    logger::error("Failed to allocate the lighting descriptor set");
+  }
+}
+
+void DeferredRenderer::record_gbuffer(const RGPassContext& ctx) {
+  const VkPipelineLayout layout = m_gbuffer_shader->get_pipeline_layout();
+  if (m_gbuffer_pipeline == VK_NULL_HANDLE) {
+    std::vector<VkPipelineShaderStageCreateInfo> stages;
+    m_gbuffer_shader->fill_stage_cis(stages);
+    vkh::PipelineBuilder builder(*m_device);
+    m_gbuffer_pipeline = builder.set_name("gbuffer")
+                             .set_shader_stages(stages)
+                             .set_vertex_specification(MeshVertex::get_input_description(),
+                                                       VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
+                             .set_view_port(ctx.extent)
+                             .set_rasterization(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE)
+                             .set_multisample(VK_SAMPLE_COUNT_1_BIT)
+                             .set_depth_stencil(true, true, VK_COMPARE_OP_LESS)
+                             .enable_blend(false, 2)
+                             .build(layout, ctx.render_pass, ctx.subpass);
+    m_gbuffer_draw_pipeline = m_draw_list.add_pipeline(m_gbuffer_pipeline, layout);
+  }
+  build_draw_list();
+  const GBufferConstants constants = {.view_proj = m_view_proj};
+  const VkDescriptorSet object_set = m_object_sets[m_frames->current_frame().index()];
+  // nothing is inherited from the primary command buffer, every chunk sets its state
+  m_recorder->record(m_frames->command_allocator(), ctx.cmd, ctx.inheritance,
+                     m_draw_list.get_draw_count(GBUFFER_PASS),
+                     [&](const vkh::CommandBuffer& cmd, uint32_t begin, uint32_t end) {
+                       cmd.set_viewport_scissor(ctx.extent);
+                       cmd.push_constants(layout, VK_SHADER_STAGE_VERTEX_BIT, sizeof(constants),
+                                          &constants);
+                       cmd.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0,
+                                                {object_set});
+                       // binds the pipeline and the materials
+                       m_draw_list.submit(cmd, GBUFFER_PASS, begin, end);
+                     });
+}
+
+void DeferredRenderer::build_draw_list() {
+  m_draw_list.clear();
+  const float half_size = 0.5f * float(GRID_SIZE - 1);
+  for (uint32_t i = 0; i < m_models.size(); i++) {
+    const glm::vec3 position = {float(i % GRID_SIZE) - half_size, 0.0f,
+                                float(i / GRID_SIZE) - half_size};
+    const float height       = 1.0f + 0.5f * std::sin(m_time + float(i));
+    m_models[i]              = glm::scale(glm::translate(glm::mat4(1.0f), position * GRID_SPACING),
+                                          glm::vec3(0.4f, 0.4f * height, 0.4f));
+    const float view_depth  = -(m_view * m_models[i][3]).z;
+    const uint16_t material = m_materials[i % MATERIAL_COUNT];
+    m_draw_list.push({
+        .key            = draw_key::opaque(GBUFFER_PASS, m_gbuffer_draw_pipeline, material,
+                                           draw_key::depth_bucket(view_depth, Z_NEAR, Z_FAR)),
+        .pipeline       = m_gbuffer_draw_pipeline,
+        .material       = material,
+        .vertex_buffer  = m_vertex_buffer->handle(),
+        .index_buffer   = m_index_buffer->handle(),
+        .index_count    = m_index_count,
+        .first_index    = 0,
+        .vertex_offset  = 0,
+        .first_instance = i,
+        .instance_count = 1,
+    });
+  }
+  // The cubes of a material become one instanced draw, nearest first. Their matrices are packed
+  // in draw order, the instances of a draw index them contiguously.
+  auto& object_buffer = *m_object_buffers[m_frames->current_frame().index()];
+  auto* objects       = static_cast<glm::mat4*>(object_buffer.map());
+  const auto capacity = static_cast<uint32_t>(m_models.size());
+  if (m_draw_list.build_instances(GBUFFER_PASS, m_models.data(), objects, 0, capacity) == 0) {
+    // the draws still index the objects in scene order
+    std::copy(m_models.begin(), m_models.end(), objects);
+  }
+  object_buffer.unmap();
+}
+
+void DeferredRenderer::record_lighting(const RGPassContext& ctx) {
+  const VkPipelineLayout layout = m_lighting_shader->get_pipeline_layout();
+  if (m_lighting_pipeline == VK_NULL_HANDLE) {
+    std::vector<VkPipelineShaderStageCreateInfo> stages;
+    m_lighting_shader->fill_stage_cis(stages);
+    vkh::PipelineBuilder builder(*m_device);
+    m_lighting_pipeline = builder.set_name("deferred lighting")
+                              .set_shader_stages(stages)
+                              .set_vertex_specification({}, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
+                              .set_view_port(ctx.extent)
+                              .set_rasterization(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE)
+                              .set_multisample(VK_SAMPLE_COUNT_1_BIT)
+                              .set_depth_stencil(false, false, VK_COMPARE_OP_ALWAYS)
+                              .enable_blend(false)
+                              .build(layout, ctx.render_pass, ctx.subpass);
+  }
+  const LightingConstants constants = {
+      .inv_view_proj = glm::inverse(m_view_proj),
+      .params        = {m_time, 0.0f, 0.0f, 0.0f},
+  };
+  ctx.cmd.bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, m_lighting_pipeline);
+  ctx.cmd.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, {m_lighting_set});
+  ctx.cmd.set_viewport_scissor(ctx.extent);
+  ctx.cmd.push_constants(layout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(constants), &constants);
+  ctx.cmd.draw(3);
+}
+
+void DeferredRenderer::wait_for_frame_start() {
+  if (m_frames) {
+    m_frames->wait_for_frame_start();
+  }
+}
+
+void DeferredRenderer::render() {
+  if (!m_frames) {
+    return;
+  }
+  if ((m_window->should_resize() || m_frames->swapchain_out_of_date()) && !recreate_swapchain()) {
+    return;
+  }
+  if (!m_frames->begin_frame()) {
+    return;
+  }
+  m_time              = m_timer.TimeStepSinceInitialisation();
+  const auto extent   = m_swapchain->get_extent();
+  const float aspect  = float(extent.width) / float(extent.height);
+  const glm::vec3 eye = {std::cos(m_time * 0.2f) * 14.0f, 9.0f, std::sin(m_time * 0.2f) * 14.0f};
+  glm::mat4 proj      = glm::perspectiveRH_ZO(glm::radians(60.0f), aspect, Z_NEAR, Z_FAR);
+  // Vulkan clip space has y pointing down
+  proj[1][1] *= -1.0f;
+  m_view      = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+  m_view_proj = proj * m_view;
+
+  auto& cmd_buffer = m_frames->request_command_buffer();
+  cmd_buffer.begin();
+  const uint32_t image_index = m_frames->swapchain_image_index();
+  m_render_graph->set_imported_image(m_backbuffer, m_swapchain->get_image(image_index),
+                                     m_swapchain->get_image_view(image_index));
+  m_render_graph->execute(cmd_buffer);
+  cmd_buffer.end();
+
+  m_frames->end_frame({cmd_buffer.handle()});
+
+  const auto& stats = m_frames->stats();
+  if (stats.frame_number % 600 == 0) {
+    logger::info("Input to present latency {:.2f} ms (avg {:.2f} ms), slept {:.2f} ms",
+                 stats.latency.input_to_present_ms, stats.latency.avg_input_to_present_ms,
+                 stats.latency.sleep_ms);
+  }
+}
+}  // namespace zen
@@ -0,0 +1,104 @@
+#ifndef ZENENGINE_DEFERRED_RENDERER_HPP
+#define ZENENGINE_DEFERRED_RENDERER_HPP
+#include <deque>
+#include <vector>
+#include <glm/glm.hpp>
+#include "draw_list.hpp"
+#include "render_graph.hpp"
+#include "systems/window_system.hpp"
+#include "utils/thread_pool.hpp"
+#include "utils/timer.hpp"
+#include "vk_helper/buffer.hpp"
+#include "vk_helper/context.hpp"
+#include "vk_helper/descriptor.hpp"
+#include "vk_helper/device.hpp"
+#include "vk_helper/frame_context.hpp"
+#include "vk_helper/parallel_recorder.hpp"
+#include "vk_helper/shader.hpp"
+#include "vk_helper/surface.hpp"
+#include "vk_helper/swapchain.hpp"
+#include "zen.hpp"
+
+namespace zen {
+/// Deferred shading in a single render pass: the G-buffer subpass writes albedo, normals and
+/// depth, the lighting subpass reads them back as input attachments at the same pixel. The
+/// G-buffer only lives inside the render pass, the render graph never stores it, so on tilers
+/// it stays in tile memory and elsewhere at least the store and reload bandwidth is saved.
+///
+/// The G-buffer pass is submitted from the CPU through a DrawList. The objects are sorted by
+/// material and depth, then the objects sharing material and mesh are merged into one instanced
+/// draw. The draws are recorded into secondary command buffers on worker threads.
+class DeferredRenderer {
+public:
+  DeferredRenderer(const Ref<vkh::Context>& context, const Ref<sys::Window>& window);
+  ~DeferredRenderer();
+  void init();
+  // Call before polling input, frame pacing delays the frame start as long as possible.
+  void wait_for_frame_start();
+  void render();
+
+private:
+  void build_scene();
+  void build_render_graph();
+  // Returns false while the window has no area, rendering is skipped then.
+  bool recreate_swapchain();
+  void update_lighting_descriptors();
+  // Pipelines are built the first time their subpass is recorded, the render pass comes from
+  // the render graph.
+  void record_gbuffer(const RGPassContext& ctx);
+  // Collects and instances the draws of the grid, writes their object matrices for the current
+  // frame.
+  void build_draw_list();
+  void record_lighting(const RGPassContext& ctx);
+
+  Ref<sys::Window> m_window;
+  Ref<vkh::Context> m_context;
+
+  Scope<vkh::Surface> m_surface;
+  Scope<vkh::Device> m_device;
+  Scope<vkh::Swapchain> m_swapchain;
+  // records the G-buffer draws, the frames have one command pool per worker and the main thread
+  Scope<util::ThreadPool> m_thread_pool;
+  Scope<vkh::ParallelRecorder> m_recorder;
+  Scope<vkh::FrameContextRing> m_frames;
+  Scope<RenderGraph> m_render_graph;
+  RGResourceHandle m_backbuffer;
+  RGResourceHandle m_albedo;
+  RGResourceHandle m_normal;
+  RGResourceHandle m_depth;
+
+  Scope<vkh::ShaderProgram> m_gbuffer_shader;
+  Scope<vkh::ShaderProgram> m_lighting_shader;
+  VkPipeline m_gbuffer_pipeline{VK_NULL_HANDLE};
+  VkPipeline m_lighting_pipeline{VK_NULL_HANDLE};
+  Scope<vkh::DescriptorLayoutCache> m_descriptor_layout_cache;
+  Scope<vkh::DescriptorAllocator> m_descriptor_allocator;
+  VkDescriptorSet m_lighting_set{VK_NULL_HANDLE};
+  // allocators of the sets of earlier G-buffers, frames in flight may still use them
+  struct RetiredAllocator {
+    Scope<vkh::DescriptorAllocator> allocator;
+    uint64_t retire_value;
+  };
+  std::deque<RetiredAllocator> m_retired_allocators;
+
+  // the grid: one cube mesh drawn with a few materials
+  Scope<vkh::Buffer> m_vertex_buffer;
+  Scope<vkh::Buffer> m_index_buffer;
+  uint32_t m_index_count{0};
+  std::vector<Scope<vkh::UniformBuffer>> m_material_buffers;
+  std::vector<uint16_t> m_materials;  // DrawList ids
+  uint16_t m_gbuffer_draw_pipeline{0};
+  std::vector<glm::mat4> m_models;
+  std::vector<Scope<vkh::StorageBuffer>> m_object_buffers;  // one per frame in flight
+  std::vector<VkDescriptorSet> m_object_sets;
+  // sets of the scene, they live as long as the renderer
+  Scope<vkh::DescriptorAllocator> m_scene_descriptor_allocator;
+  DrawList m_draw_list;
+
+  util::FrameTimer m_timer;
+  float m_time{0.0f};
+  glm::mat4 m_view{1.0f};
+  glm::mat4 m_view_proj{1.0f};
+};
+}  // namespace zen
+#endif  //ZENENGINE_DEFERRED_RENDERER_HPP
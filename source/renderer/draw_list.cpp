@@ -0,0 +1,248 @@
+#include "draw_list.hpp"
+#include <algorithm>
+#include <array>
+#include <tuple>
+#include "logging.hpp"
+#include "vk_helper/command_buffer.hpp"
+
+namespace zen {
+namespace draw_key {
+uint32_t depth_bucket(float view_depth, float z_near, float z_far) {
+  const float t = std::clamp((view_depth - z_near) / (z_far - z_near), 0.0f, 1.0f);
+  return static_cast<uint32_t>(t * float(MAX_DEPTH));
+}
+}  // namespace draw_key
+
+namespace {
+auto mesh_of(const DrawItem& item) {
+  return std::tie(item.vertex_buffer, item.index_buffer, item.first_index, item.index_count,
+                  item.vertex_offset);
+}
+}  // namespace
+
+uint16_t DrawList::add_pipeline(VkPipeline pipeline, VkPipelineLayout layout) {
+  m_pipelines.push_back({pipeline, layout});
+  return static_cast<uint16_t>(m_pipelines.size() - 1);
+}
+
+uint16_t DrawList::add_material(VkDescriptorSet set, uint32_t material_set) {
+  m_materials.push_back({set, material_set});
+  return static_cast<uint16_t>(m_materials.size() - 1);
+}
+
+void DrawList::clear() {
+  m_items.clear();
+  m_entries.clear();
+  m_sorted = true;
+}
+
+void DrawList::push(const DrawItem& item) {
+  m_entries.push_back({item.key, static_cast<uint32_t>(m_items.size())});
+  m_items.push_back(item);
+  m_sorted = false;
+}
+
+void DrawList::sort() {
+  constexpr uint32_t RADIX_BITS = 8;
+  constexpr uint32_t DIGITS     = 64 / RADIX_BITS;
+  constexpr uint32_t BUCKETS    = 1u << RADIX_BITS;
+  if (m_sorted) {
+    return;
+  }
+  const size_t count = m_entries.size();
+  // all digit histograms in one read of the keys
+  std::array<std::array<uint32_t, BUCKETS>, DIGITS> histograms{};
+  for (const auto& entry : m_entries) {
+    for (uint32_t d = 0; d < DIGITS; d++) {
+      histograms[d][(entry.key >> (d * RADIX_BITS)) & (BUCKETS - 1)]++;
+    }
+  }
+  m_scratch.resize(count);
+  SortEntry* src = m_entries.data();
+  SortEntry* dst = m_scratch.data();
+  for (uint32_t d = 0; d < DIGITS; d++) {
+    auto& histogram     = histograms[d];
+    const uint32_t bits = d * RADIX_BITS;
+    // a digit every key shares does not reorder anything
+    if (histogram[(src[0].key >> bits) & (BUCKETS - 1)] == count) {
+      continue;
+    }
+    uint32_t offset = 0;
+    for (auto& bucket : histogram) {
+      const uint32_t size = bucket;
+      bucket              = offset;
+      offset += size;
+    }
+    for (size_t i = 0; i < count; i++) {
+      dst[histogram[(src[i].key >> bits) & (BUCKETS - 1)]++] = src[i];
+    }
+    std::swap(src, dst);
+  }
+  if (src != m_entries.data()) {
+    m_entries.swap(m_scratch);
+  }
+  m_sorted = true;
+}
+
+uint32_t DrawList::build_instances(uint8_t pass, const glm::mat4* models, glm::mat4* objects,
+                                   uint32_t first_object, uint32_t object_capacity) {
+  sort();
+  const auto [begin, end] = get_pass_range(pass);
+  uint32_t object_count   = 0;
+  for (size_t i = begin; i < end; i++) {
+    object_count += m_items[m_entries[i].item].instance_count;
+  }
+  // the matrices are written from first_object on
+  if (uint64_t(first_object) + object_count > object_capacity) {
+    logger::error("Instancing needs {} objects after {}, only {} fit", object_count, first_object,
+                  object_capacity);
+    return 0;
+  }
+
+  struct Group {
+    uint64_t key;
+    size_t begin;
+    size_t end;
+  };
+  std::vector<Group> groups;
+  size_t run_begin = begin;
+  while (run_begin < end) {
+    // draws binding the same state, mostly one run per material
+    const DrawItem& first = m_items[m_entries[run_begin].item];
+    size_t run_end        = run_begin + 1;
+    while (run_end < end && m_items[m_entries[run_end].item].pipeline == first.pipeline &&
+           m_items[m_entries[run_end].item].material == first.material) {
+      run_end++;
+    }
+    // stable, the first draw of a mesh stays its nearest
+    std::stable_sort(m_entries.begin() + run_begin, m_entries.begin() + run_end,
+                     [&](const SortEntry& a, const SortEntry& b) {
+                       return mesh_of(m_items[a.item]) < mesh_of(m_items[b.item]);
+                     });
+    for (size_t i = run_begin; i < run_end;) {
+      const DrawItem& item = m_items[m_entries[i].item];
+      size_t group_end     = i + 1;
+      while (group_end < run_end &&
+             mesh_of(m_items[m_entries[group_end].item]) == mesh_of(item)) {
+        group_end++;
+      }
+      groups.push_back({m_entries[i].key, i, group_end});
+      i = group_end;
+    }
+    run_begin = run_end;
+  }
+  std::sort(groups.begin(), groups.end(),
+            [](const Group& a, const Group& b) { return a.key < b.key; });
+
+  std::vector<SortEntry> merged;
+  merged.reserve(groups.size());
+  uint32_t object = first_object;
+  for (const Group& group : groups) {
+    DrawItem instanced       = m_items[m_entries[group.begin].item];
+    instanced.first_instance = object;
+    for (size_t i = group.begin; i < group.end; i++) {
+      const DrawItem& item = m_items[m_entries[i].item];
+      std::copy_n(models + item.first_instance, item.instance_count, objects + object);
+      object += item.instance_count;
+    }
+    instanced.instance_count = object - instanced.first_instance;
+    merged.push_back({group.key, static_cast<uint32_t>(m_items.size())});
+    m_items.push_back(instanced);
+  }
+  std::copy(merged.begin(), merged.end(), m_entries.begin() + begin);
+  m_entries.erase(m_entries.begin() + begin + merged.size(), m_entries.begin() + end);
+  return object_count;
+}
+
+std::pair<size_t, size_t> DrawList::get_pass_range(uint8_t pass) const {
+  if (!m_sorted) {
+    return {0, m_entries.size()};
+  }
+  const auto pass_less = [](const SortEntry& entry, uint8_t value) {
+    return draw_key::get_pass(entry.key) < value;
+  };
+  const auto less_pass = [](uint8_t value, const SortEntry& entry) {
+    return value < draw_key::get_pass(entry.key);
+  };
+  const auto begin = std::lower_bound(m_entries.begin(), m_entries.end(), pass, pass_less);
+  const auto end   = std::upper_bound(begin, m_entries.end(), pass, less_pass);
+  return {size_t(begin - m_entries.begin()), size_t(end - m_entries.begin())};
+}
+
+template <typename Recorder>
+DrawListStats DrawList::walk(uint8_t pass, uint32_t first, uint32_t last,
+                             Recorder&& recorder) const {
+  const auto [pass_begin, pass_end] = get_pass_range(pass);
+  const size_t begin                = std::min(pass_begin + first, pass_end);
+  const size_t end                  = std::min(pass_begin + last, pass_end);
+
+  DrawListStats stats{};
+  const Pipeline* bound_pipeline = nullptr;
+  const Material* bound_material = nullptr;
+  VkPipelineLayout bound_layout  = VK_NULL_HANDLE;
+  VkBuffer bound_vertex_buffer   = VK_NULL_HANDLE;
+  VkBuffer bound_index_buffer    = VK_NULL_HANDLE;
+  for (size_t i = begin; i < end; i++) {
+    const DrawItem& item = m_items[m_entries[i].item];
+    if (draw_key::get_pass(item.key) != pass) {
+      continue;
+    }
+    const Pipeline* pipeline = &m_pipelines[item.pipeline];
+    const Material* material = &m_materials[item.material];
+    const bool new_pipeline  = pipeline != bound_pipeline;
+    // sets bound with another layout are not guaranteed to stay valid
+    const bool new_material  = material != bound_material || pipeline->layout != bound_layout;
+    const bool new_vertices  = item.vertex_buffer != bound_vertex_buffer;
+    const bool new_indices   = item.index_buffer != bound_index_buffer;
+    recorder(item, *pipeline, *material, new_pipeline, new_material, new_vertices, new_indices);
+
+    stats.pipeline_binds += new_pipeline;
+    stats.material_binds += new_material;
+    stats.buffer_binds += uint32_t(new_vertices) + uint32_t(new_indices);
+    stats.draws++;
+    bound_pipeline      = pipeline;
+    bound_material      = material;
+    bound_layout        = pipeline->layout;
+    bound_vertex_buffer = item.vertex_buffer;
+    bound_index_buffer  = item.index_buffer;
+  }
+  return stats;
+}
+
+uint32_t DrawList::get_draw_count(uint8_t pass) const {
+  const auto [begin, end] = get_pass_range(pass);
+  return static_cast<uint32_t>(end - begin);
+}
+
+DrawListStats DrawList::submit(const vkh::CommandBuffer& cmd, uint8_t pass) const {
+  return submit(cmd, pass, 0, get_draw_count(pass));
+}
+
+DrawListStats DrawList::submit(const vkh::CommandBuffer& cmd, uint8_t pass, uint32_t begin,
+                               uint32_t end) const {
+  return walk(pass, begin, end,
+              [&](const DrawItem& item, const Pipeline& pipeline, const Material& material,
+                  bool new_pipeline, bool new_material, bool new_vertices, bool new_indices) {
+                if (new_pipeline) {
+                  cmd.bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+                }
+                if (new_material) {
+                  cmd.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout,
+                                           material.set_index, {material.set});
+                }
+                if (new_vertices) {
+                  cmd.bind_vertex_buffer(0, item.vertex_buffer);
+                }
+                if (new_indices) {
+                  cmd.bind_index_buffer(item.index_buffer);
+                }
+                cmd.draw_indexed(item.index_count, item.instance_count, item.first_index,
+                                 item.vertex_offset, item.first_instance);
+              });
+}
+
+DrawListStats DrawList::count_binds(uint8_t pass) const {
+  return walk(pass, 0, get_draw_count(pass),
+              [](const DrawItem&, const Pipeline&, const Material&, bool, bool, bool, bool) {});
+}
+}  // namespace zen
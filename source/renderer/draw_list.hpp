@@ -0,0 +1,137 @@
+#ifndef ZENENGINE_DRAW_LIST_HPP
+#define ZENENGINE_DRAW_LIST_HPP
+#include <vector>
+#include <glm/glm.hpp>
+#include "vk_helper/base.hpp"
+
+namespace zen {
+namespace vkh {
+class CommandBuffer;
+}
+
+/// Packed 64-bit sort keys, most significant field first.
+///
+/// opaque:  pass:8 | pipeline:16 | material:16 | depth:24, front to back within a material
+/// blended: pass:8 | inverted depth:24 | pipeline:16 | material:16, back to front
+namespace draw_key {
+constexpr uint32_t DEPTH_BITS = 24;
+constexpr uint32_t MAX_DEPTH  = (1u << DEPTH_BITS) - 1;
+
+// Quantizes the view space depth between z_near and z_far to DEPTH_BITS.
+uint32_t depth_bucket(float view_depth, float z_near, float z_far);
+
+constexpr uint64_t opaque(uint8_t pass, uint16_t pipeline, uint16_t material, uint32_t depth) {
+  return uint64_t(pass) << 56 | uint64_t(pipeline) << 40 | uint64_t(material) << 24 |
+         (depth & MAX_DEPTH);
+}
+
+constexpr uint64_t blended(uint8_t pass, uint16_t pipeline, uint16_t material, uint32_t depth) {
+  return uint64_t(pass) << 56 | uint64_t(MAX_DEPTH - (depth & MAX_DEPTH)) << 32 |
+         uint64_t(pipeline) << 16 | material;
+}
+
+constexpr uint8_t get_pass(uint64_t key) { return uint8_t(key >> 56); }
+}  // namespace draw_key
+
+struct DrawItem {
+  // from draw_key::opaque() or draw_key::blended()
+  uint64_t key;
+  // ids from DrawList::add_pipeline() and DrawList::add_material(), also packed into the key
+  uint16_t pipeline;
+  uint16_t material;
+  VkBuffer vertex_buffer;
+  VkBuffer index_buffer;
+  uint32_t index_count;
+  uint32_t first_index;
+  int32_t vertex_offset;
+  // lets the shaders find per object data through gl_BaseInstance, the object of the first
+  // instance before build_instances()
+  uint32_t first_instance;
+  uint32_t instance_count;
+};
+
+struct DrawListStats {
+  uint32_t draws{0};
+  uint32_t pipeline_binds{0};
+  uint32_t material_binds{0};
+  uint32_t buffer_binds{0};
+};
+
+/// Draws collected in scene order each frame, sorted by key and submitted per pass.
+///
+/// sort() is an LSD radix sort on the keys, 8 bits per pass, skipping digits all keys share.
+/// Submission binds a pipeline, material or buffer only when it differs from the bound one, so
+/// for opaque keys state changes exactly where the key prefix changes.
+///
+/// It is meant for CPU-submitted passes like the G-buffer pass of the deferred renderer. The
+/// forward renderer draws through the GPU-driven GpuScene instead.
+///
+/// build_instances() runs after sort() and turns the draws of a pass sharing pipeline, material
+/// and mesh into a single instanced draw. The caller owns the object buffer the matrices go to,
+/// e.g. the per-frame object buffer of the deferred G-buffer pass. GpuScene keeps one indirect
+/// command per object and does not use it.
+class DrawList {
+public:
+  ZEN_NO_COPY(DrawList)
+  DrawList()  = default;
+  ~DrawList() = default;
+
+  // Pipelines and materials stay registered across frames, clear() only drops the items.
+  uint16_t add_pipeline(VkPipeline pipeline, VkPipelineLayout layout);
+  // The set is bound at material_set with the layout of the pipeline drawn with.
+  uint16_t add_material(VkDescriptorSet set, uint32_t material_set = 1);
+
+  void clear();
+  void push(const DrawItem& item);
+  void sort();
+  // Merges the draws of a sorted pass sharing pipeline, material and mesh into one instanced draw
+  // each and packs the model matrices of their objects contiguously into objects, starting at
+  // first_object, in draw order. Merged draws are ordered by their nearest member, so only for
+  // passes not blending within a material. object_capacity is the size of the whole objects
+  // array. Returns the number of matrices written, 0 if they do not fit behind first_object, the
+  // pass is left unchanged then.
+  uint32_t build_instances(uint8_t pass, const glm::mat4* models, glm::mat4* objects,
+                           uint32_t first_object, uint32_t object_capacity);
+
+  // Records the draws of pass, in key order once sorted, otherwise in scene order.
+  DrawListStats submit(const vkh::CommandBuffer& cmd, uint8_t pass) const;
+  // Records draws [begin, end) of the get_draw_count(pass) draws of pass, e.g. one chunk per
+  // secondary command buffer. Each call binds its state from scratch. Unsorted lists count the
+  // draws of all passes, those of other passes are skipped.
+  DrawListStats submit(const vkh::CommandBuffer& cmd, uint8_t pass, uint32_t begin,
+                       uint32_t end) const;
+  uint32_t get_draw_count(uint8_t pass) const;
+  // What submit() would bind, without recording.
+  DrawListStats count_binds(uint8_t pass) const;
+
+  size_t size() const { return m_entries.size(); }
+  bool is_sorted() const { return m_sorted; }
+
+private:
+  struct SortEntry {
+    uint64_t key;
+    uint32_t item;
+  };
+  struct Pipeline {
+    VkPipeline pipeline;
+    VkPipelineLayout layout;
+  };
+  struct Material {
+    VkDescriptorSet set;
+    uint32_t set_index;
+  };
+
+  std::pair<size_t, size_t> get_pass_range(uint8_t pass) const;
+  // walks draws [first, last) of the pass range
+  template <typename Recorder>
+  DrawListStats walk(uint8_t pass, uint32_t first, uint32_t last, Recorder&& recorder) const;
+
+  std::vector<Pipeline> m_pipelines;
+  std::vector<Material> m_materials;
+  std::vector<DrawItem> m_items;
+  std::vector<SortEntry> m_entries;
+  std::vector<SortEntry> m_scratch;
+  bool m_sorted{true};
+};
+}  // namespace zen
+#endif  //ZENENGINE_DRAW_LIST_HPP
@@ -0,0 +1,191 @@
+#include "dynamic_resolution.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include "logging.hpp"
+#include "vk_helper/command_buffer.hpp"
+#include "vk_helper/device.hpp"
+#include "vk_helper/pipeline.hpp"
+
+namespace zen {
+namespace {
+// weight of a new GPU time in the smoothed one
+constexpr float GPU_TIME_SMOOTHING = 0.3f;
+}  // namespace
+
+DynamicResolution::DynamicResolution(const vkh::Device& device, uint32_t frames_in_flight,
+                                     const DynamicResolutionSettings& settings)
+    : m_device(device),
+      m_settings(settings),
+      m_scale(settings.max_scale),
+      m_timestamp_period(device.get_timestamp_period()),
+      m_written(frames_in_flight, false),
+      m_shader(device, "upscale"),
+      m_descriptor_layout_cache(device),
+      m_descriptor_allocator(std::make_unique<vkh::DescriptorAllocator>(device)) {
+  VK_ASSERT(m_settings.min_scale > 0.0f && m_settings.min_scale <= m_settings.max_scale &&
+            m_settings.max_scale <= 1.0f);
+  if (m_timestamp_period > 0.0f) {
+    const VkQueryPoolCreateInfo query_pool_ci = {
+        .sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType  = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = 2 * frames_in_flight,
+    };
+    m_device.create_query_pool(query_pool_ci, &m_query_pool, "frame timestamps");
+  } else {
+    logger::warn("The graphics queue has no timestamps, the render scale stays at {}",
+                 m_settings.max_scale);
+  }
+  m_shader.add_stage("fullscreen.vert.spv", vkh::ShaderType::Vertex)
+      .add_stage("upscale.frag.spv", vkh::ShaderType::Fragment)
+      .reflect_layout();
+  // clamped to the edge on the top left, upscale.frag clamps the taps on the other sides
+  const VkSamplerCreateInfo sampler_ci = {
+      .sType        = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+      .magFilter    = VK_FILTER_LINEAR,
+      .minFilter    = VK_FILTER_LINEAR,
+      .mipmapMode   = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+      .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+  };
+  m_device.create_sampler(sampler_ci, &m_sampler, "upscale");
+}
+
+DynamicResolution::~DynamicResolution() {
+  if (m_pipeline != VK_NULL_HANDLE) {
+    m_device.destroy_pipeline(m_pipeline);
+  }
+  m_device.destroy_pipeline_layout(m_shader.get_pipeline_layout());
+  m_device.destroy_sampler(m_sampler);
+  if (m_query_pool != VK_NULL_HANDLE) {
+    m_device.destroy_query_pool(m_query_pool);
+  }
+}
+
+void DynamicResolution::begin_frame(const vkh::CommandBuffer& cmd, uint32_t frame_index,
+                                    VkExtent2D output_extent) {
+  VK_ASSERT(frame_index < m_written.size());
+  m_frame_index = frame_index;
+  if (m_query_pool != VK_NULL_HANDLE) {
+    // the frame context was waited for, its timestamps are available unless the GPU is lost
+    const uint32_t first_query = 2 * frame_index;
+    std::array<uint64_t, 2> ticks{};
+    if (m_written[frame_index] &&
+        m_device.get_query_results(m_query_pool, first_query, 2, ticks.data()) &&
+        ticks[1] > ticks[0]) {
+      update_scale(float(ticks[1] - ticks[0]) * m_timestamp_period * 1e-6f);
+    }
+    cmd.reset_query_pool(m_query_pool, first_query, 2);
+    cmd.write_timestamp(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_query_pool, first_query);
+  }
+  m_render_extent = {
+      std::max(uint32_t(std::round(float(output_extent.width) * m_scale)), 1u),
+      std::max(uint32_t(std::round(float(output_extent.height) * m_scale)), 1u),
+  };
+}
+
+void DynamicResolution::end_frame(const vkh::CommandBuffer& cmd) {
+  if (m_query_pool != VK_NULL_HANDLE) {
+    cmd.write_timestamp(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_query_pool,
+                        2 * m_frame_index + 1);
+    m_written[m_frame_index] = true;
+  }
+}
+
+void DynamicResolution::update_scale(float gpu_ms) {
+  // single frames spike with the work of other processes and the driver
+  m_gpu_ms = m_gpu_ms > 0.0f ? glm::mix(m_gpu_ms, gpu_ms, GPU_TIME_SMOOTHING) : gpu_ms;
+  // The GPU time follows the pixel count, the controller works on log2 of both: an error of
+  // -1 (twice the target) is corrected by an output one lower, which halves the pixels.
+  float error = std::log2(m_settings.target_ms / m_gpu_ms);
+  if (std::abs(error) < m_settings.dead_band) {
+    error = 0.0f;
+  }
+  const float integral   = m_integral + error;
+  const float derivative = error - m_last_error;
+  m_last_error           = error;
+  // log2 of the pixel count relative to the one at max_scale
+  const float output     =
+      m_settings.kp * error + m_settings.ki * integral + m_settings.kd * derivative;
+  const float min_output = 2.0f * std::log2(m_settings.min_scale / m_settings.max_scale);
+  const float clamped    = std::clamp(output, min_output, 0.0f);
+  // the integral stops while the scale is at a limit, it would wind up otherwise
+  if (clamped == output) {
+    m_integral = integral;
+  }
+  m_scale = m_settings.max_scale * std::exp2(0.5f * clamped);
+}
+
+void DynamicResolution::add_upscale_pass(RenderGraph& graph, RGResourceHandle source,
+                                         RGResourceHandle output) {
+  m_source = source;
+  // the image of the rebuilt graph needs a new descriptor
+  m_source_view = VK_NULL_HANDLE;
+  graph.add_pass("upscale")
+      .add_texture_input(source)
+      .add_color_output(output)
+      .set_execute([this](const RGPassContext& ctx) { record_upscale(ctx); });
+}
+
+void DynamicResolution::record_upscale(const RGPassContext& ctx) {
+  const VkPipelineLayout layout = m_shader.get_pipeline_layout();
+  if (m_pipeline == VK_NULL_HANDLE) {
+    std::vector<VkPipelineShaderStageCreateInfo> stages;
+    m_shader.fill_stage_cis(stages);
+    vkh::PipelineBuilder builder(m_device);
+    builder.set_name("upscale")
+        .set_shader_stages(stages)
+        .set_vertex_specification({}, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
+        .set_view_port(ctx.extent)
+        .set_rasterization(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE)
+        .set_multisample(VK_SAMPLE_COUNT_1_BIT)
+        .set_depth_stencil(false, false, VK_COMPARE_OP_ALWAYS)
+        .enable_blend(false);
+    m_pipeline = ctx.render_pass != VK_NULL_HANDLE
+                     ? builder.build(layout, ctx.render_pass, ctx.subpass)
+                     : builder.build(layout, *ctx.rendering_info);
+  }
+  const VkImageView source_view = ctx.graph.get_image_view(m_source);
+  if (source_view != m_source_view) {
+    // The set of the old source is freed with its allocator once the frames submitted so far
+    // finished, a fresh allocator holds the new one.
+    const auto& timeline = m_device.get_timeline(vkh::QUEUE_INDEX_GRAPHICS);
+    while (!m_retired_allocators.empty() &&
+           timeline.is_complete(m_retired_allocators.front().retire_value)) {
+      m_retired_allocators.pop_front();
+    }
+    if (m_source_set != VK_NULL_HANDLE) {
+      m_retired_allocators.push_back(
+          {std::move(m_descriptor_allocator), timeline.last_submitted_value()});
+      m_descriptor_allocator = std::make_unique<vkh::DescriptorAllocator>(m_device);
+      m_source_set           = VK_NULL_HANDLE;
+    }
+    m_source_view    = source_view;
+    auto source_info = VkDescriptorImageInfo{m_sampler, source_view,
+                                             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    const bool built =
+        vkh::DescriptorBuilder::begin(&m_descriptor_layout_cache, m_descriptor_allocator.get())
+            .bind_image(0, &source_info, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                        VK_SHADER_STAGE_FRAGMENT_BIT)
+            .build(m_source_set);
+    if (!built) {
+      logger::error("Failed to allocate the upscale descriptor set");
+    }
+  }
+  // the source has the size of the output, the scene fills its top left corner
+  const glm::vec2 source_size      = {float(ctx.extent.width), float(ctx.extent.height)};
+  const glm::vec2 render_size      = {float(m_render_extent.width), float(m_render_extent.height)};
+  const UpscaleConstants constants = {
+      .uv_scale   = render_size / source_size,
+      .texel_size = 1.0f / source_size,
+      .uv_max     = (render_size - 0.5f) / source_size,
+      .sharpness  = m_settings.sharpness,
+  };
+  ctx.cmd.bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+  ctx.cmd.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, {m_source_set});
+  ctx.cmd.set_viewport_scissor(ctx.extent);
+  ctx.cmd.push_constants(layout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(constants), &constants);
+  ctx.cmd.draw(3);
+}
+}  // namespace zen
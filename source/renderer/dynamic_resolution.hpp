@@ -0,0 +1,104 @@
+#ifndef ZENENGINE_DYNAMIC_RESOLUTION_HPP
+#define ZENENGINE_DYNAMIC_RESOLUTION_HPP
+#include <deque>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+#include "render_graph.hpp"
+#include "vk_helper/descriptor.hpp"
+#include "vk_helper/shader.hpp"
+
+namespace zen {
+struct DynamicResolutionSettings {
+  // GPU time of a frame the controller holds, in milliseconds
+  float target_ms{14.0f};
+  float min_scale{0.5f};
+  // at most 1, the scene targets have the size of the output
+  float max_scale{1.0f};
+  // gains of the controller, its error is log2 of target_ms over the GPU time
+  float kp{0.3f};
+  float ki{0.2f};
+  float kd{0.1f};
+  // errors below this are on target, keeps the resolution from jittering
+  float dead_band{0.05f};
+  // of the upscaler, 0: lightest, 1: strongest
+  float sharpness{0.5f};
+};
+
+/// Holds a GPU frame time by rendering the scene at a lower resolution while the GPU is busy.
+///
+/// Timestamps at the start and the end of every frame measure its GPU time. They are read when
+/// the frame context is used again, so nothing waits for them. A PID controller turns the error
+/// against DynamicResolutionSettings::target_ms into the render scale of the next frame, working
+/// on the pixel count since the GPU time is roughly proportional to it.
+///
+/// The scene targets keep the size of the output and the scene is drawn into their top left
+/// corner, a new scale only changes the viewport and the graph is not rebuilt. The upscale pass
+/// resamples that corner to the output with a sharpening filter (upscale.frag).
+class DynamicResolution {
+public:
+  ZEN_NO_COPY_MOVE(DynamicResolution)
+  DynamicResolution(const vkh::Device& device, uint32_t frames_in_flight,
+                    const DynamicResolutionSettings& settings = {});
+  ~DynamicResolution();
+
+  // Updates the scale from the last GPU time of frame_index and writes the start timestamp,
+  // first command of the frame.
+  void begin_frame(const vkh::CommandBuffer& cmd, uint32_t frame_index, VkExtent2D output_extent);
+  // last command of the frame
+  void end_frame(const vkh::CommandBuffer& cmd);
+
+  // Adds the pass upscaling the scene in the corner of source to output, passes drawing at the
+  // output resolution (UI, ...) follow it.
+  void add_upscale_pass(RenderGraph& graph, RGResourceHandle source, RGResourceHandle output);
+
+  // size of the scene this frame, in the top left corner of its targets
+  VkExtent2D get_render_extent() const { return m_render_extent; }
+  float get_scale() const { return m_scale; }
+  // smoothed GPU time of a frame in milliseconds, 0 until the first measurement
+  float get_gpu_time() const { return m_gpu_ms; }
+
+private:
+  // matches Constants in upscale.frag
+  struct UpscaleConstants {
+    glm::vec2 uv_scale;
+    glm::vec2 texel_size;
+    glm::vec2 uv_max;
+    float sharpness;
+  };
+
+  void update_scale(float gpu_ms);
+  void record_upscale(const RGPassContext& ctx);
+
+  const vkh::Device& m_device;
+  DynamicResolutionSettings m_settings;
+  float m_scale;
+  float m_gpu_ms{0.0f};
+  float m_integral{0.0f};
+  float m_last_error{0.0f};
+  VkExtent2D m_render_extent{};
+
+  // nanoseconds per tick, 0 without timestamps, the scale stays at its maximum then
+  float m_timestamp_period;
+  // two timestamps per frame in flight
+  VkQueryPool m_query_pool{VK_NULL_HANDLE};
+  std::vector<bool> m_written;
+  uint32_t m_frame_index{0};
+
+  RGResourceHandle m_source;
+  VkImageView m_source_view{VK_NULL_HANDLE};
+  VkSampler m_sampler{VK_NULL_HANDLE};
+  vkh::ShaderProgram m_shader;
+  VkPipeline m_pipeline{VK_NULL_HANDLE};
+  vkh::DescriptorLayoutCache m_descriptor_layout_cache;
+  std::unique_ptr<vkh::DescriptorAllocator> m_descriptor_allocator;
+  VkDescriptorSet m_source_set{VK_NULL_HANDLE};
+  // allocators of the sets of earlier sources, frames in flight may still use them
+  struct RetiredAllocator {
+    std::unique_ptr<vkh::DescriptorAllocator> allocator;
+    uint64_t retire_value;
+  };
+  std::deque<RetiredAllocator> m_retired_allocators;
+};
+}  // namespace zen
+#endif  //ZENENGINE_DYNAMIC_RESOLUTION_HPP
@@ -1,14 +1,130 @@
 #include "forward_renderer.hpp"
+#include <array>
+#include <cmath>
+#include <optional>
+#include <random>
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
 #include "logging.hpp"
-
+#include "vk_helper/command_buffer.hpp"
+#include "vk_helper/pipeline.hpp"
 
 using namespace zen::vkh;
 namespace zen {
+namespace {
+constexpr uint32_t SCENE_GRID_SIZE = 64;
+constexpr uint32_t LIGHT_COUNT     = 2048;
+constexpr float Z_NEAR             = 0.1f;
+constexpr float Z_FAR              = 200.0f;
+// does not write depth and is left out of the depth prepass
+constexpr uint32_t BLENDED_BATCH = 1;
+// direction the sunlight travels, the shadows of the grid fall onto the ground
+constexpr glm::vec3 SUN_DIRECTION = {-0.4f, -1.0f, -0.3f};
+constexpr glm::vec3 SUN_COLOR     = {1.0f, 0.95f, 0.85f};
+// sRGB like the swapchain, blending and the upscale filter work on linear colors
+constexpr VkFormat SCENE_COLOR_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+
+// matches CameraBuffer in tri_mesh_ssbo_textured.vert
+struct CameraData {
+  glm::mat4 view;
+  glm::mat4 proj;
+  glm::mat4 view_proj;
+};
+
+constexpr float SPHERE_RADIUS = 0.4f;
+
+// UV sphere, LODs halve the segments
+MeshData make_sphere(const glm::vec3& color, uint32_t segments) {
+  MeshData mesh;
+  const uint32_t rings = segments / 2;
+  for (uint32_t ring = 0; ring <= rings; ring++) {
+    const float theta = glm::pi<float>() * float(ring) / float(rings);
+    for (uint32_t segment = 0; segment <= segments; segment++) {
+      const float phi    = glm::two_pi<float>() * float(segment) / float(segments);
+      const glm::vec3 n  = {std::sin(theta) * std::cos(phi), std::cos(theta),
+                            std::sin(theta) * std::sin(phi)};
+      const glm::vec2 uv = {float(segment) / float(segments), float(ring) / float(rings)};
+      mesh.vertices.push_back({n * SPHERE_RADIUS, n, color * (0.6f + 0.4f * n.y), uv});
+    }
+  }
+  // counter-clockwise seen from outside
+  for (uint32_t ring = 0; ring < rings; ring++) {
+    for (uint32_t segment = 0; segment < segments; segment++) {
+      const uint32_t a = ring * (segments + 1) + segment;
+      const uint32_t b = a + segments + 1;
+      for (uint32_t index : {a, a + 1, b + 1, a, b + 1, b}) {
+        mesh.indices.push_back(index);
+      }
+    }
+  }
+  return mesh;
+}
+
+// largest distance between the sphere and its tessellation with the given segments
+float sphere_error(uint32_t segments) {
+  return SPHERE_RADIUS * (1.0f - std::cos(glm::pi<float>() / float(segments)));
+}
+
+// facing up, counter-clockwise seen from above
+MeshData make_ground(float half_size, const glm::vec3& color) {
+  MeshData mesh;
+  const glm::vec3 normal = {0.0f, 1.0f, 0.0f};
+  for (const glm::vec2& corner : {glm::vec2(-1.0f, -1.0f), glm::vec2(1.0f, -1.0f),
+                                  glm::vec2(1.0f, 1.0f), glm::vec2(-1.0f, 1.0f)}) {
+    const glm::vec3 position = {corner.x * half_size, 0.0f, corner.y * half_size};
+    mesh.vertices.push_back({position, normal, color, corner * 0.5f + 0.5f});
+  }
+  mesh.indices = {0, 3, 2, 0, 2, 1};
+  return mesh;
+}
+
+MeshData make_octahedron(const glm::vec3& color) {
+  MeshData mesh;
+  const std::array<glm::vec3, 6> tips = {{
+      {0.5f, 0.0f, 0.0f},
+      {-0.5f, 0.0f, 0.0f},
+      {0.0f, 0.5f, 0.0f},
+      {0.0f, -0.5f, 0.0f},
+      {0.0f, 0.0f, 0.5f},
+      {0.0f, 0.0f, -0.5f},
+  }};
+  for (const auto& tip : tips) {
+    mesh.vertices.push_back({tip, glm::normalize(tip), color * (0.7f + 0.6f * tip.y), {}});
+  }
+  const uint32_t indices[] = {0, 2, 4, 4, 2, 1, 1, 2, 5, 5, 2, 0,
+                              4, 3, 0, 1, 3, 4, 5, 3, 1, 0, 3, 5};
+  mesh.indices.assign(std::begin(indices), std::end(indices));
+  return mesh;
+}
+}  // namespace
+
 ForwardRenderer::ForwardRenderer(const Ref<Context>& context, const Ref<Window>& window) {
   m_context = context;
   m_window  = window;
 }
 
+ForwardRenderer::~ForwardRenderer() {
+  if (!m_device) {
+    return;
+  }
+  // frames in flight must finish before the graph resources go away
+  m_frames.reset();
+  m_async_compute.reset();
+  for (auto pipeline : m_pipelines) {
+    m_device->destroy_pipeline(pipeline);
+  }
+  if (m_prepass_pipeline != VK_NULL_HANDLE) {
+    m_device->destroy_pipeline(m_prepass_pipeline);
+  }
+  m_device->destroy_pipeline_layout(m_mesh_shader->get_pipeline_layout());
+  m_render_graph.reset();
+  m_resolution.reset();
+  m_shadows.reset();
+  m_scene.reset();
+  m_lighting.reset();
+}
+
 void ForwardRenderer::init() {
   m_surface = CreateScope<Surface>(m_context->get_instance(), m_window->handle());
   auto device_exts = vkh::Surface::get_device_exts();
@@ -19,6 +135,275 @@ void ForwardRenderer::init() {
   m_device = CreateScope<Device>();
   m_device->set_context(*m_context);
   m_swapchain = CreateScope<Swapchain>(*m_device, m_surface->handle(), m_window->get_width(),
-                                       m_window->get_height(), true);
+                                       m_window->get_height(), PresentPolicy::Vsync);
+  m_frames    = CreateScope<FrameContextRing>(*m_device, *m_swapchain, 2);
+
+  m_async_compute = CreateScope<AsyncComputeScheduler>(*m_device, m_frames->frames_in_flight());
+  m_resolution    = CreateScope<DynamicResolution>(*m_device, m_frames->frames_in_flight());
+
+  m_mesh_shader = CreateScope<ShaderProgram>(*m_device, "mesh");
+  m_mesh_shader->add_stage("mesh_lit.vert.spv", ShaderType::Vertex)
+      .add_stage("clustered_lit.frag.spv", ShaderType::Fragment)
+      .reflect_layout();
+  m_descriptor_layout_cache = CreateScope<DescriptorLayoutCache>(*m_device);
+  m_descriptor_allocator    = CreateScope<DescriptorAllocator>(*m_device);
+  build_scene();
+
+  m_render_graph = CreateScope<RenderGraph>(*m_device, m_frames->frames_in_flight(),
+                                            uint32_t(m_swapchain->get_image_count()));
+  build_render_graph();
+}
+
+void ForwardRenderer::build_scene() {
+  m_scene               = CreateScope<GpuScene>(*m_device);
+  const glm::vec3 color = {0.8f, 0.5f, 0.3f};
+  const uint32_t ball   = m_scene->add_mesh(make_sphere(color, 32));
+  const uint32_t gem    = m_scene->add_mesh(make_octahedron({0.3f, 0.6f, 0.9f}));
+  const uint32_t ground = m_scene->add_mesh(make_ground(1.5f * SCENE_GRID_SIZE, glm::vec3(0.5f)));
+  const float half_size = 0.5f * float(SCENE_GRID_SIZE - 1);
+  for (uint32_t segments : {16u, 8u, 4u}) {
+    m_scene->add_mesh_lod(ball, make_sphere(color, segments), sphere_error(segments));
+  }
+  for (uint32_t z = 0; z < SCENE_GRID_SIZE; z++) {
+    for (uint32_t x = 0; x < SCENE_GRID_SIZE; x++) {
+      const glm::vec3 position = {float(x) - half_size, 0.0f, float(z) - half_size};
+      const bool blended       = (x + z) % 4 == 0;
+      // batch 0 is opaque, batch 1 blended on top
+      m_scene->add_object(glm::translate(glm::mat4(1.0f), position * 1.5f), blended ? gem : ball,
+                          blended ? BLENDED_BATCH : 0);
+    }
+  }
+  // receives the shadows of the grid, below the largest objects
+  m_scene->add_object(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.5f, 0.0f)), ground, 0);
+  m_scene->upload();
+  m_scene_transform_version = m_scene->get_transform_version();
+
+  m_shadows = CreateScope<ShadowCascades>(*m_device, m_frames->frames_in_flight());
+  m_shadows->set_light(SUN_DIRECTION, SUN_COLOR);
+
+  // small colored lights floating over the grid, every eighth one a spot pointing down
+  m_lighting = CreateScope<ClusteredLighting>(*m_device, LIGHT_COUNT);
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  const float scene_size = 1.5f * float(SCENE_GRID_SIZE);
+  for (uint32_t i = 0; i < LIGHT_COUNT; i++) {
+    Light light{
+        .position  = {(unit(rng) - 0.5f) * scene_size, 0.5f + unit(rng),
+                      (unit(rng) - 0.5f) * scene_size},
+        .range     = 2.0f + 2.0f * unit(rng),
+        .color     = {unit(rng), unit(rng), unit(rng)},
+        .intensity = 4.0f,
+    };
+    if (i % 8 == 0) {
+      light.position.y += 2.0f;
+      light.range     = 6.0f;
+      light.cos_outer = std::cos(glm::radians(30.0f));
+      light.cos_inner = std::cos(glm::radians(20.0f));
+    }
+    m_lighting->add_light(light);
+  }
+
+  auto object_info = VkDescriptorBufferInfo{m_scene->get_object_buffer(), 0, VK_WHOLE_SIZE};
+  DescriptorBuilder::begin(m_descriptor_layout_cache.get(), m_descriptor_allocator.get())
+      .bind_buffer(0, &object_info, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+      .build(m_object_set);
+  for (uint32_t i = 0; i < m_frames->frames_in_flight(); i++) {
+    m_camera_buffers.push_back(CreateScope<UniformBuffer>(
+        *m_device, "camera " + std::to_string(i), sizeof(CameraData)));
+    auto camera_info = VkDescriptorBufferInfo{m_camera_buffers[i]->handle(), 0, VK_WHOLE_SIZE};
+    m_camera_sets.emplace_back();
+    DescriptorBuilder::begin(m_descriptor_layout_cache.get(), m_descriptor_allocator.get())
+        .bind_buffer(0, &camera_info, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+        .build(m_camera_sets.back());
+  }
+}
+
+void ForwardRenderer::build_render_graph() {
+  m_render_graph->set_render_extent(m_swapchain->get_extent());
+  m_render_graph->set_dynamic_rendering(true);
+  m_backbuffer = m_render_graph->import_image(
+      "backbuffer",
+      {.format = m_swapchain->get_format(), .usage = m_swapchain->get_image_usage()},
+      VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+      // matches the wait stage of the acquire semaphore
+      VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR);
+  // the scene is drawn into the top left m_render_extent of its targets
+  m_scene_color = m_render_graph->create_image("scene color", {.format = SCENE_COLOR_FORMAT});
+  m_depth       = m_render_graph->create_image("depth", {.format = VK_FORMAT_D32_SFLOAT});
+
+  std::optional<VkClearDepthStencilValue> depth_clear = VkClearDepthStencilValue{1.0f, 0};
+  m_scene->add_cull_passes(*m_render_graph, &m_view_proj, &m_lod_view, m_depth_prepass);
+  if (m_depth_prepass) {
+    auto& prepass = m_render_graph->add_pass("depth prepass")
+                        .set_depth_output(m_depth, depth_clear)
+                        .set_execute([this](const RGPassContext& ctx) { record_prepass(ctx); });
+    m_scene->declare_draw_inputs(prepass);
+    m_scene->add_occlusion_passes(*m_render_graph, m_depth, &m_view, &m_proj, &m_render_extent);
+    depth_clear.reset();
+  }
+  m_shadows->add_passes(*m_render_graph, *m_scene);
+  // binned on the async compute queue, see render()
+  m_lighting->import_clusters(*m_render_graph);
+  auto& forward_pass =
+      m_render_graph->add_pass("forward")
+          .add_color_output(m_scene_color, VkClearColorValue{{0.1f, 0.1f, 0.1f, 1.0f}})
+          .set_depth_output(m_depth, depth_clear)
+          .set_execute([this](const RGPassContext& ctx) { record_forward(ctx); });
+  m_scene->declare_draw_inputs(forward_pass);
+  m_lighting->declare_shading_inputs(forward_pass);
+  m_shadows->declare_shading_inputs(forward_pass);
+  m_resolution->add_upscale_pass(*m_render_graph, m_scene_color, m_backbuffer);
+  if (!m_render_graph->compile()) {
+    logger::error("Failed to compile render graph");
+  }
+}
+
+bool ForwardRenderer::recreate_swapchain() {
+  if (!m_swapchain->recreate(m_window->get_width(), m_window->get_height())) {
+    return false;
+  }
+  m_window->resize();
+  m_frames->on_swapchain_recreated();
+  m_render_graph->reset();
+  build_render_graph();
+  return true;
+}
+
+void ForwardRenderer::record_prepass(const RGPassContext& ctx) {
+  const VkPipelineLayout layout = m_mesh_shader->get_pipeline_layout();
+  if (m_prepass_pipeline == VK_NULL_HANDLE) {
+    std::vector<VkPipelineShaderStageCreateInfo> stages;
+    m_mesh_shader->fill_stage_cis(stages);
+    std::erase_if(stages, [](const auto& stage) {
+      return stage.stage != VK_SHADER_STAGE_VERTEX_BIT;
+    });
+    PipelineBuilder builder(*m_device);
+    builder.set_name("mesh depth prepass")
+        .set_shader_stages(stages)
+        .set_vertex_specification(MeshVertex::get_input_description(),
+                                  VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
+        .set_view_port(ctx.extent)
+        .set_rasterization(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_CLOCKWISE)
+        .set_multisample(VK_SAMPLE_COUNT_1_BIT)
+        .set_depth_stencil(true, true, VK_COMPARE_OP_LESS)
+        .enable_blend(false, 0);
+    m_prepass_pipeline = ctx.render_pass != VK_NULL_HANDLE
+                             ? builder.build(layout, ctx.render_pass, ctx.subpass)
+                             : builder.build(layout, *ctx.rendering_info);
+  }
+  const uint32_t frame_index = m_frames->current_frame().index();
+  ctx.cmd.set_viewport_scissor(m_render_extent);
+  ctx.cmd.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0,
+                               {m_camera_sets[frame_index], m_object_set});
+  ctx.cmd.bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, m_prepass_pipeline);
+  for (uint32_t batch = 0; batch < m_scene->get_batch_count(); batch++) {
+    if (batch != BLENDED_BATCH) {
+      m_scene->draw_batch(ctx.cmd, batch, DrawPhase::Early);
+    }
+  }
+}
+
+void ForwardRenderer::record_forward(const RGPassContext& ctx) {
+  const VkPipelineLayout layout = m_mesh_shader->get_pipeline_layout();
+  // The render pass of the graph is cached and dynamic rendering formats never change, so the
+  // pipelines stay valid across graph rebuilds.
+  if (m_pipelines.empty()) {
+    for (uint32_t batch = 0; batch < m_scene->get_batch_count(); batch++) {
+      const bool blended = batch == BLENDED_BATCH;
+      std::vector<VkPipelineShaderStageCreateInfo> stages;
+      m_mesh_shader->fill_stage_cis(stages);
+      PipelineBuilder builder(*m_device);
+      builder.set_name(blended ? "mesh blended" : "mesh opaque")
+          .set_shader_stages(stages)
+          .set_vertex_specification(MeshVertex::get_input_description(),
+                                    VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
+          .set_view_port(ctx.extent)
+          // the flipped y of the projection turns counter-clockwise into clockwise
+          .set_rasterization(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT,
+                             VK_FRONT_FACE_CLOCKWISE)
+          .set_multisample(VK_SAMPLE_COUNT_1_BIT)
+          // the depth prepass wrote the early objects with the same depth already
+          .set_depth_stencil(true, !blended,
+                             m_depth_prepass ? VK_COMPARE_OP_LESS_OR_EQUAL : VK_COMPARE_OP_LESS)
+          .enable_blend(blended);
+      m_pipelines.push_back(ctx.render_pass != VK_NULL_HANDLE
+                                ? builder.build(layout, ctx.render_pass, ctx.subpass)
+                                : builder.build(layout, *ctx.rendering_info));
+    }
+  }
+  const uint32_t frame_index = m_frames->current_frame().index();
+  ctx.cmd.set_viewport_scissor(m_render_extent);
+  ctx.cmd.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0,
+                               {m_camera_sets[frame_index], m_object_set});
+  m_lighting->bind_shading(ctx.cmd, layout, 2, m_render_extent);
+  m_shadows->bind_shading(ctx.cmd, layout, 3);
+  // one draw per pipeline and phase, the GPU decides how many objects it contains
+  for (uint32_t batch = 0; batch < m_pipelines.size(); batch++) {
+    ctx.cmd.bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelines[batch]);
+    m_scene->draw_batch(ctx.cmd, batch, DrawPhase::Early);
+    if (m_depth_prepass) {
+      m_scene->draw_batch(ctx.cmd, batch, DrawPhase::Late);
+    }
+  }
+}
+
+void ForwardRenderer::render() {
+  if (!m_frames) {
+    return;
+  }
+  if ((m_window->should_resize() || m_frames->swapchain_out_of_date()) && !recreate_swapchain()) {
+    return;
+  }
+  if (!m_frames->begin_frame()) {
+    return;
+  }
+  m_async_compute->begin_frame(m_frames->current_frame().index());
+  const float time    = m_timer.TimeStepSinceInitialisation();
+  const auto extent   = m_swapchain->get_extent();
+  const float aspect  = float(extent.width) / float(extent.height);
+  const glm::vec3 eye = {std::cos(time * 0.1f) * 30.0f, 12.0f, std::sin(time * 0.1f) * 30.0f};
+  CameraData camera   = {
+      .view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
+      .proj = glm::perspectiveRH_ZO(glm::radians(60.0f), aspect, Z_NEAR, Z_FAR),
+  };
+  // Vulkan clip space has y pointing down
+  camera.proj[1][1] *= -1.0f;
+  camera.view_proj = camera.proj * camera.view;
+  m_view           = camera.view;
+  m_proj           = camera.proj;
+  m_view_proj      = camera.view_proj;
+
+  m_lod_view.camera_position = eye;
+  m_cluster_view             = {camera.view, camera.proj, Z_NEAR, Z_FAR};
+
+  m_camera_buffers[m_frames->current_frame().index()]->update(&camera, sizeof(camera));
+
+  auto& cmd_buffer = m_frames->request_command_buffer();
+  cmd_buffer.begin();
+  // measures the GPU time of the whole frame and picks the resolution of the scene from it
+  m_resolution->begin_frame(cmd_buffer, m_frames->current_frame().index(), extent);
+  m_render_extent = m_resolution->get_render_extent();
+  // coarser LODs at lower resolutions
+  m_lod_view.projection_scale =
+      get_lod_projection_scale(camera.proj, float(m_render_extent.height));
+  // the lights are binned on the compute queue while the graphics work below is recorded and
+  // executed, only the forward pass waits for them
+  m_async_compute->add_pass(m_lighting->create_binning_pass(m_cluster_view), cmd_buffer);
+  m_async_compute->submit();
+  m_async_compute->acquire_on_graphics(cmd_buffer);
+
+  const uint32_t image_index = m_frames->swapchain_image_index();
+  m_render_graph->set_imported_image(m_backbuffer, m_swapchain->get_image(image_index),
+                                     m_swapchain->get_image_view(image_index));
+  if (m_scene->get_transform_version() != m_scene_transform_version) {
+    m_scene_transform_version = m_scene->get_transform_version();
+    m_shadows->invalidate_cache();
+  }
+  m_shadows->update(*m_render_graph, m_cluster_view, m_frames->current_frame().index());
+  m_render_graph->execute(cmd_buffer);
+  m_resolution->end_frame(cmd_buffer);
+  cmd_buffer.end();
+
+  m_frames->end_frame({cmd_buffer.handle()}, m_async_compute->graphics_waits());
 }
-}  // namespace zen
\ No newline at end of file
+}  // namespace zen
@@ -1,8 +1,21 @@
 #ifndef ZENENGINE_FORWARD_RENDERER_HPP
 #define ZENENGINE_FORWARD_RENDERER_HPP
+#include <vector>
+#include <glm/glm.hpp>
+#include "async_compute.hpp"
+#include "clustered_lighting.hpp"
+#include "dynamic_resolution.hpp"
+#include "gpu_scene.hpp"
+#include "render_graph.hpp"
+#include "shadow_cascades.hpp"
 #include "systems/window_system.hpp"
+#include "utils/timer.hpp"
+#include "vk_helper/buffer.hpp"
 #include "vk_helper/context.hpp"
+#include "vk_helper/descriptor.hpp"
 #include "vk_helper/device.hpp"
+#include "vk_helper/frame_context.hpp"
+#include "vk_helper/shader.hpp"
 #include "vk_helper/surface.hpp"
 #include "vk_helper/swapchain.hpp"
 #include "zen.hpp"
@@ -10,12 +23,33 @@ using namespace zen::vkh;
 using namespace zen::sys;
 
 namespace zen {
+/// Draws a GpuScene: objects are culled on the GPU and every pipeline issues one indirect draw,
+/// the CPU cost of a frame does not depend on the number of objects.
+///
+/// With the depth prepass the opaque objects visible in the last frame are drawn into depth
+/// first, which also drives the occlusion culling of the scene. The forward pass then shades
+/// every visible pixel once.
+///
+/// A sun lights the scene through cascaded shadow maps, the distant cascades are cached. The
+/// point and spot lights are binned on the async compute queue while the depth passes run.
+///
+/// The scene is rendered at a dynamic resolution which holds the GPU frame time, then upscaled
+/// to the swapchain.
 class ForwardRenderer {
 public:
   ForwardRenderer(const Ref<Context>& context, const Ref<Window>& window);
+  ~ForwardRenderer();
   void init();
+  void render();
 
 private:
+  void build_scene();
+  void build_render_graph();
+  void record_prepass(const RGPassContext& ctx);
+  void record_forward(const RGPassContext& ctx);
+  // Returns false while the window has no area, rendering is skipped then.
+  bool recreate_swapchain();
+
   // created by engine, shared by all renderers
   Ref<Window> m_window;
   Ref<Context> m_context;
@@ -23,6 +57,38 @@ private:
   Scope<Surface> m_surface;
   Scope<Device> m_device;
   Scope<Swapchain> m_swapchain;
+  Scope<FrameContextRing> m_frames;
+  Scope<AsyncComputeScheduler> m_async_compute;
+  Scope<RenderGraph> m_render_graph;
+  RGResourceHandle m_backbuffer;
+  RGResourceHandle m_scene_color;
+  RGResourceHandle m_depth;
+  Scope<DynamicResolution> m_resolution;
+  // part of the scene targets drawn to this frame
+  VkExtent2D m_render_extent{};
+
+  Scope<GpuScene> m_scene;
+  Scope<ClusteredLighting> m_lighting;
+  Scope<ShadowCascades> m_shadows;
+  // the cached shadows are rendered again when it changes
+  uint32_t m_scene_transform_version{0};
+  Scope<ShaderProgram> m_mesh_shader;
+  // one pipeline per scene batch: opaque, then blended
+  std::vector<VkPipeline> m_pipelines;
+  VkPipeline m_prepass_pipeline{VK_NULL_HANDLE};
+  bool m_depth_prepass{true};
+  Scope<DescriptorLayoutCache> m_descriptor_layout_cache;
+  Scope<DescriptorAllocator> m_descriptor_allocator;
+  std::vector<Scope<UniformBuffer>> m_camera_buffers;  // one per frame in flight
+  std::vector<VkDescriptorSet> m_camera_sets;
+  VkDescriptorSet m_object_set{VK_NULL_HANDLE};
+
+  util::FrameTimer m_timer;
+  glm::mat4 m_view{1.0f};
+  glm::mat4 m_proj{1.0f};
+  glm::mat4 m_view_proj{1.0f};
+  LodView m_lod_view{};
+  ClusterView m_cluster_view{};
 };
 }  // namespace zen
 #endif  //ZENENGINE_FORWARD_RENDERER_HPP
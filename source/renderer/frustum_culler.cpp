@@ -0,0 +1,354 @@
+#include "frustum_culler.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include "utils/thread_pool.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ZEN_CULL_SSE
+#include <emmintrin.h>
+#endif
+// AVX2 is enabled for the kernel function only, which runs after a CPUID check
+#if defined(ZEN_ENABLE_AVX2) && defined(ZEN_CULL_SSE)
+#define ZEN_CULL_AVX2
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define ZEN_TARGET_AVX2
+#else
+#define ZEN_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+namespace zen {
+namespace {
+// a multiple of every SIMD width, large enough to amortize the task overhead
+constexpr uint32_t CULL_CHUNK_SIZE = 16384;
+constexpr uint32_t NO_LOD_CHAIN    = ~0u;
+
+struct SoaBounds {
+  const float* center_x;
+  const float* center_y;
+  const float* center_z;
+  const float* radius;
+  const float* extent_x;
+  const float* extent_y;
+  const float* extent_z;
+};
+
+// An AABB is outside a plane when even its corner furthest along the normal is behind it, its
+// reach along the normal replaces the radius of a sphere.
+template <bool AABB>
+uint32_t cull_scalar(const SoaBounds& b, const FrustumPlanes& planes, uint32_t begin,
+                     uint32_t end, uint32_t* visible) {
+  uint32_t count = 0;
+  for (uint32_t i = begin; i < end; i++) {
+    bool inside = true;
+    for (const auto& plane : planes) {
+      const float distance =
+          plane.x * b.center_x[i] + plane.y * b.center_y[i] + plane.z * b.center_z[i] + plane.w;
+      const float reach = AABB ? std::abs(plane.x) * b.extent_x[i] +
+                                     std::abs(plane.y) * b.extent_y[i] +
+                                     std::abs(plane.z) * b.extent_z[i]
+                               : b.radius[i];
+      inside &= distance + reach >= 0.0f;
+    }
+    visible[count] = i;
+    count += inside;
+  }
+  return count;
+}
+
+#ifdef ZEN_CULL_SSE
+template <bool AABB>
+uint32_t cull_sse(const SoaBounds& b, const FrustumPlanes& planes, uint32_t begin,
+                  uint32_t end, uint32_t* visible) {
+  __m128 normal[6][3];
+  __m128 abs_normal[6][3];
+  __m128 offset[6];
+  for (uint32_t p = 0; p < 6; p++) {
+    for (uint32_t c = 0; c < 3; c++) {
+      normal[p][c]     = _mm_set1_ps(planes[p][c]);
+      abs_normal[p][c] = _mm_set1_ps(std::abs(planes[p][c]));
+    }
+    offset[p] = _mm_set1_ps(planes[p].w);
+  }
+  const __m128 zero = _mm_setzero_ps();
+
+  uint32_t count = 0;
+  uint32_t i     = begin;
+  for (; i + 4 <= end; i += 4) {
+    const __m128 cx = _mm_loadu_ps(b.center_x + i);
+    const __m128 cy = _mm_loadu_ps(b.center_y + i);
+    const __m128 cz = _mm_loadu_ps(b.center_z + i);
+    __m128 ex, ey, ez, radius;
+    if constexpr (AABB) {
+      ex = _mm_loadu_ps(b.extent_x + i);
+      ey = _mm_loadu_ps(b.extent_y + i);
+      ez = _mm_loadu_ps(b.extent_z + i);
+    } else {
+      radius = _mm_loadu_ps(b.radius + i);
+    }
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (uint32_t p = 0; p < 6; p++) {
+      __m128 distance = _mm_add_ps(_mm_mul_ps(normal[p][0], cx), offset[p]);
+      distance        = _mm_add_ps(_mm_mul_ps(normal[p][1], cy), distance);
+      distance        = _mm_add_ps(_mm_mul_ps(normal[p][2], cz), distance);
+      __m128 reach;
+      if constexpr (AABB) {
+        reach = _mm_mul_ps(abs_normal[p][0], ex);
+        reach = _mm_add_ps(_mm_mul_ps(abs_normal[p][1], ey), reach);
+        reach = _mm_add_ps(_mm_mul_ps(abs_normal[p][2], ez), reach);
+      } else {
+        reach = radius;
+      }
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), zero));
+    }
+    for (uint32_t mask = _mm_movemask_ps(inside); mask != 0; mask &= mask - 1) {
+      visible[count++] = i + std::countr_zero(mask);
+    }
+  }
+  return count + cull_scalar<AABB>(b, planes, i, end, visible + count);
+}
+#endif
+
+#ifdef ZEN_CULL_AVX2
+bool cpu_supports_avx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return false;
+  }
+  __cpuid(info, 1);
+  const bool fma     = info[2] & (1 << 12);
+  const bool osxsave = info[2] & (1 << 27);
+  // the OS saves the YMM registers
+  if (!fma || !osxsave || (_xgetbv(0) & 0x6) != 0x6) {
+    return false;
+  }
+  __cpuidex(info, 7, 0);
+  return info[1] & (1 << 5);
+#else
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+
+template <bool AABB>
+ZEN_TARGET_AVX2 uint32_t cull_avx2(const SoaBounds& b, const FrustumPlanes& planes,
+                                   uint32_t begin, uint32_t end, uint32_t* visible) {
+  __m256 normal[6][3];
+  __m256 abs_normal[6][3];
+  __m256 offset[6];
+  for (uint32_t p = 0; p < 6; p++) {
+    for (uint32_t c = 0; c < 3; c++) {
+      normal[p][c]     = _mm256_set1_ps(planes[p][c]);
+      abs_normal[p][c] = _mm256_set1_ps(std::abs(planes[p][c]));
+    }
+    offset[p] = _mm256_set1_ps(planes[p].w);
+  }
+  const __m256 zero = _mm256_setzero_ps();
+
+  uint32_t count = 0;
+  uint32_t i     = begin;
+  for (; i + 8 <= end; i += 8) {
+    const __m256 cx = _mm256_loadu_ps(b.center_x + i);
+    const __m256 cy = _mm256_loadu_ps(b.center_y + i);
+    const __m256 cz = _mm256_loadu_ps(b.center_z + i);
+    __m256 ex, ey, ez, radius;
+    if constexpr (AABB) {
+      ex = _mm256_loadu_ps(b.extent_x + i);
+      ey = _mm256_loadu_ps(b.extent_y + i);
+      ez = _mm256_loadu_ps(b.extent_z + i);
+    } else {
+      radius = _mm256_loadu_ps(b.radius + i);
+    }
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (uint32_t p = 0; p < 6; p++) {
+      __m256 distance = _mm256_fmadd_ps(normal[p][0], cx, offset[p]);
+      distance        = _mm256_fmadd_ps(normal[p][1], cy, distance);
+      distance        = _mm256_fmadd_ps(normal[p][2], cz, distance);
+      __m256 reach;
+      if constexpr (AABB) {
+        reach = _mm256_mul_ps(abs_normal[p][0], ex);
+        reach = _mm256_fmadd_ps(abs_normal[p][1], ey, reach);
+        reach = _mm256_fmadd_ps(abs_normal[p][2], ez, reach);
+      } else {
+        reach = radius;
+      }
+      inside = _mm256_and_ps(inside,
+                             _mm256_cmp_ps(_mm256_add_ps(distance, reach), zero, _CMP_GE_OQ));
+    }
+    for (uint32_t mask = _mm256_movemask_ps(inside); mask != 0; mask &= mask - 1) {
+      visible[count++] = i + std::countr_zero(mask);
+    }
+  }
+  return count + cull_scalar<AABB>(b, planes, i, end, visible + count);
+}
+#endif
+}  // namespace
+
+FrustumPlanes extract_frustum_planes(const glm::mat4& view_proj) {
+  const glm::mat4 m    = glm::transpose(view_proj);
+  FrustumPlanes planes = {m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[2], m[3] - m[2]};
+  for (auto& plane : planes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+  return planes;
+}
+
+FrustumCuller::FrustumCuller(util::ThreadPool* thread_pool) : m_thread_pool(thread_pool) {}
+
+CullKernel FrustumCuller::get_default_kernel() {
+#if defined(ZEN_CULL_AVX2)
+  static const bool avx2 = cpu_supports_avx2();
+  if (avx2) {
+    return CullKernel::Avx2;
+  }
+#endif
+#if defined(ZEN_CULL_SSE)
+  return CullKernel::Sse;
+#else
+  return CullKernel::Scalar;
+#endif
+}
+
+const char* FrustumCuller::get_kernel_name(CullKernel kernel) {
+  switch (kernel) {
+    case CullKernel::Scalar: return "scalar";
+    case CullKernel::Sse: return "SSE";
+    case CullKernel::Avx2: return "AVX2";
+  }
+  return "unknown";
+}
+
+uint32_t FrustumCuller::add_object(const glm::vec3& aabb_min, const glm::vec3& aabb_max) {
+  const uint32_t object = get_object_count();
+  for (auto* component : {&m_center_x, &m_center_y, &m_center_z, &m_radius, &m_extent_x,
+                          &m_extent_y, &m_extent_z}) {
+    component->push_back(0.0f);
+  }
+  m_object_lod_chains.push_back(NO_LOD_CHAIN);
+  m_lod_scales.push_back(1.0f);
+  m_lods.push_back(0);
+  set_bounds(object, aabb_min, aabb_max);
+  return object;
+}
+
+void FrustumCuller::set_bounds(uint32_t object, const glm::vec3& aabb_min,
+                               const glm::vec3& aabb_max) {
+  const glm::vec3 center = (aabb_min + aabb_max) * 0.5f;
+  const glm::vec3 extent = (aabb_max - aabb_min) * 0.5f;
+  m_center_x[object]     = center.x;
+  m_center_y[object]     = center.y;
+  m_center_z[object]     = center.z;
+  m_radius[object]       = glm::length(extent);
+  m_extent_x[object]     = extent.x;
+  m_extent_y[object]     = extent.y;
+  m_extent_z[object]     = extent.z;
+}
+
+uint32_t FrustumCuller::add_lod_chain(const LodChain& chain) {
+  m_lod_chains.push_back(chain);
+  return static_cast<uint32_t>(m_lod_chains.size() - 1);
+}
+
+void FrustumCuller::set_lod_chain(uint32_t object, uint32_t chain, float scale) {
+  m_object_lod_chains[object] = chain;
+  m_lod_scales[object]        = scale;
+  m_lods[object]              = 0;
+}
+
+void FrustumCuller::clear() {
+  for (auto* component : {&m_center_x, &m_center_y, &m_center_z, &m_radius, &m_extent_x,
+                          &m_extent_y, &m_extent_z, &m_lod_scales}) {
+    component->clear();
+  }
+  m_object_lod_chains.clear();
+  m_lods.clear();
+  m_visible.clear();
+}
+
+const std::vector<uint32_t>& FrustumCuller::cull(const FrustumPlanes& planes, CullVolume volume,
+                                                  CullKernel kernel) {
+  const uint32_t count = get_object_count();
+  m_visible.resize(count);
+  if (m_thread_pool == nullptr || count <= CULL_CHUNK_SIZE) {
+    m_visible.resize(cull_range(planes, volume, kernel, 0, count, m_visible.data()));
+    return m_visible;
+  }
+
+  // every chunk writes from its first object on, the results are moved together afterwards
+  m_chunk_counts.resize((count + CULL_CHUNK_SIZE - 1) / CULL_CHUNK_SIZE);
+  m_thread_pool->parallel_for(count, CULL_CHUNK_SIZE,
+                              [&](uint32_t begin, uint32_t end, uint32_t chunk, uint32_t) {
+                                m_chunk_counts[chunk] = cull_range(planes, volume, kernel, begin,
+                                                                   end, m_visible.data() + begin);
+                              });
+  uint32_t visible_count = m_chunk_counts[0];
+  for (uint32_t chunk = 1; chunk < m_chunk_counts.size(); chunk++) {
+    std::memmove(m_visible.data() + visible_count, m_visible.data() + chunk * CULL_CHUNK_SIZE,
+                 m_chunk_counts[chunk] * sizeof(uint32_t));
+    visible_count += m_chunk_counts[chunk];
+  }
+  m_visible.resize(visible_count);
+  return m_visible;
+}
+
+void FrustumCuller::select_lods(const LodView& view) {
+  const auto select = [&](uint32_t begin, uint32_t end, uint32_t, uint32_t) {
+    for (uint32_t i = begin; i < end; i++) {
+      const uint32_t object = m_visible[i];
+      const uint32_t chain  = m_object_lod_chains[object];
+      if (chain == NO_LOD_CHAIN) {
+        continue;
+      }
+      // distance to the nearest point of the bounding sphere, in units of the chain
+      const glm::vec3 offset =
+          glm::vec3(m_center_x[object], m_center_y[object], m_center_z[object]) -
+          view.camera_position;
+      const float distance = std::max(glm::length(offset) - m_radius[object], 0.0f);
+      m_lods[object] = static_cast<uint8_t>(
+          select_lod(m_lod_chains[chain], distance / m_lod_scales[object], m_lods[object], view));
+    }
+  };
+  const auto visible_count = static_cast<uint32_t>(m_visible.size());
+  if (m_thread_pool == nullptr || visible_count <= CULL_CHUNK_SIZE) {
+    select(0, visible_count, 0, 0);
+  } else {
+    m_thread_pool->parallel_for(visible_count, CULL_CHUNK_SIZE, select);
+  }
+}
+
+uint32_t FrustumCuller::cull_range(const FrustumPlanes& planes, CullVolume volume,
+                                   CullKernel kernel, uint32_t begin, uint32_t end,
+                                   uint32_t* visible) const {
+  const SoaBounds bounds{m_center_x.data(), m_center_y.data(), m_center_z.data(),
+                         m_radius.data(),   m_extent_x.data(), m_extent_y.data(),
+                         m_extent_z.data()};
+  const bool aabb = volume == CullVolume::Aabb;
+  switch (kernel) {
+#ifdef ZEN_CULL_AVX2
+    case CullKernel::Avx2:
+      if (get_default_kernel() != CullKernel::Avx2) {
+        // the CPU lacks AVX2 or FMA
+        return cull_range(planes, volume, get_default_kernel(), begin, end, visible);
+      }
+      return aabb ? cull_avx2<true>(bounds, planes, begin, end, visible)
+                  : cull_avx2<false>(bounds, planes, begin, end, visible);
+#endif
+#ifdef ZEN_CULL_SSE
+    case CullKernel::Sse:
+      return aabb ? cull_sse<true>(bounds, planes, begin, end, visible)
+                  : cull_sse<false>(bounds, planes, begin, end, visible);
+#endif
+    case CullKernel::Scalar:
+      return aabb ? cull_scalar<true>(bounds, planes, begin, end, visible)
+                  : cull_scalar<false>(bounds, planes, begin, end, visible);
+    default:
+      // not built in, e.g. AVX2 without ZEN_ENABLE_AVX2
+      return cull_range(planes, volume, get_default_kernel(), begin, end, visible);
+  }
+}
+}  // namespace zen
@@ -0,0 +1,88 @@
+#ifndef ZENENGINE_FRUSTUM_CULLER_HPP
+#define ZENENGINE_FRUSTUM_CULLER_HPP
+#include <array>
+#include <vector>
+#include <glm/glm.hpp>
+#include "lod.hpp"
+
+namespace zen {
+namespace util {
+class ThreadPool;
+}
+
+using FrustumPlanes = std::array<glm::vec4, 6>;
+
+// Gribb/Hartmann, planes point inside and are normalized, Vulkan depth range [0, 1]
+FrustumPlanes extract_frustum_planes(const glm::mat4& view_proj);
+
+enum class CullVolume {
+  Sphere,
+  Aabb
+};
+
+enum class CullKernel {
+  Scalar,
+  Sse,
+  // only with ZEN_ENABLE_AVX2, falls back to the default kernel on CPUs without AVX2 and FMA
+  Avx2
+};
+
+/// CPU frustum culling of world space bounding volumes.
+///
+/// Spheres and AABBs are stored as structure of arrays, one float array per component, so the
+/// SIMD kernels test 4 (SSE) or 8 (AVX2) objects against a plane at once. With a thread pool the
+/// objects are culled in chunks in parallel. The result is a compact list of visible object
+/// indices in ascending order.
+///
+/// Objects with a LOD chain get a LOD per frame from select_lods(), which only looks at the
+/// visible objects and keeps the LOD of the previous frame for hysteresis.
+class FrustumCuller {
+public:
+  explicit FrustumCuller(util::ThreadPool* thread_pool = nullptr);
+
+  // the best kernel this build and CPU support, checked once at runtime
+  static CullKernel get_default_kernel();
+  static const char* get_kernel_name(CullKernel kernel);
+
+  uint32_t add_object(const glm::vec3& aabb_min, const glm::vec3& aabb_max);
+  void set_bounds(uint32_t object, const glm::vec3& aabb_min, const glm::vec3& aabb_max);
+  // LOD chains stay registered when the objects are cleared.
+  uint32_t add_lod_chain(const LodChain& chain);
+  // scale converts the errors of the chain into world units, e.g. the scale of the model matrix
+  void set_lod_chain(uint32_t object, uint32_t chain, float scale = 1.0f);
+  void clear();
+
+  // Returns the indices of the objects intersecting the frustum, valid until the next cull().
+  const std::vector<uint32_t>& cull(const FrustumPlanes& planes,
+                                    CullVolume volume = CullVolume::Sphere,
+                                    CullKernel kernel = get_default_kernel());
+
+  // Selects the LODs of the objects visible after the last cull().
+  void select_lods(const LodView& view);
+  uint32_t get_lod(uint32_t object) const { return m_lods[object]; }
+
+  uint32_t get_object_count() const { return static_cast<uint32_t>(m_radius.size()); }
+  const std::vector<uint32_t>& get_visible() const { return m_visible; }
+
+private:
+  // per chunk so the results land in order without synchronization
+  uint32_t cull_range(const FrustumPlanes& planes, CullVolume volume, CullKernel kernel,
+                      uint32_t begin, uint32_t end, uint32_t* visible) const;
+
+  util::ThreadPool* m_thread_pool;
+  std::vector<float> m_center_x;
+  std::vector<float> m_center_y;
+  std::vector<float> m_center_z;
+  std::vector<float> m_radius;
+  std::vector<float> m_extent_x;
+  std::vector<float> m_extent_y;
+  std::vector<float> m_extent_z;
+  std::vector<LodChain> m_lod_chains;
+  std::vector<uint32_t> m_object_lod_chains;
+  std::vector<float> m_lod_scales;
+  std::vector<uint8_t> m_lods;
+  std::vector<uint32_t> m_visible;
+  std::vector<uint32_t> m_chunk_counts;
+};
+}  // namespace zen
+#endif  //ZENENGINE_FRUSTUM_CULLER_HPP
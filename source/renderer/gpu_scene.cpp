@@ -0,0 +1,579 @@
+#include "gpu_scene.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <string>
+#include "logging.hpp"
+#include "vk_helper/command_buffer.hpp"
+#include "vk_helper/device.hpp"
+
+namespace zen {
+namespace {
+constexpr uint32_t CULL_GROUP_SIZE = 64;
+constexpr uint32_t HIZ_GROUP_SIZE  = 8;
+
+// flags and visibility bits of cull.comp and occlusion_cull.comp
+constexpr uint32_t CULL_FLAG_COMPACT   = 1;
+constexpr uint32_t CULL_FLAG_OCCLUSION = 2;
+constexpr uint32_t CULL_FLAG_SHADOW    = 4;
+constexpr uint32_t VISIBILITY_VISIBLE  = 1;
+
+std::vector<VkPipelineShaderStageCreateInfo> get_stages(const vkh::ShaderProgram& shader) {
+  std::vector<VkPipelineShaderStageCreateInfo> stages;
+  shader.fill_stage_cis(stages);
+  return stages;
+}
+}  // namespace
+
+glm::vec4 compute_bounding_sphere(std::span<const MeshVertex> vertices) {
+  glm::vec3 min{std::numeric_limits<float>::max()};
+  glm::vec3 max{std::numeric_limits<float>::lowest()};
+  for (const auto& vertex : vertices) {
+    min = glm::min(min, vertex.position);
+    max = glm::max(max, vertex.position);
+  }
+  const glm::vec3 center = (min + max) * 0.5f;
+  float radius           = 0.0f;
+  for (const auto& vertex : vertices) {
+    radius = std::max(radius, glm::length(vertex.position - center));
+  }
+  return glm::vec4(center, radius);
+}
+
+vkh::VertexInputDescription MeshVertex::get_input_description() {
+  vkh::VertexInputDescription description;
+  description.bindings.push_back({0, sizeof(MeshVertex), VK_VERTEX_INPUT_RATE_VERTEX});
+  description.attributes = {
+      {0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(MeshVertex, position)},
+      {1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(MeshVertex, normal)},
+      {2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(MeshVertex, color)},
+      {3, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(MeshVertex, uv)},
+  };
+  return description;
+}
+
+GpuScene::GpuScene(const vkh::Device& device)
+    : m_device(device),
+      m_cull_shader(device, "cull"),
+      m_hiz_shader(device, "hiz build"),
+      m_occlusion_shader(device, "occlusion cull"),
+      m_descriptor_layout_cache(device),
+      m_descriptor_allocator(device) {
+  m_cull_shader.add_stage("cull.comp.spv", vkh::ShaderType::Compute).reflect_layout();
+  m_hiz_shader.add_stage("hiz_build.comp.spv", vkh::ShaderType::Compute).reflect_layout();
+  m_occlusion_shader.add_stage("occlusion_cull.comp.spv", vkh::ShaderType::Compute)
+      .reflect_layout();
+  // only read with texelFetch()
+  const VkSamplerCreateInfo sampler_ci = {
+      .sType        = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+      .magFilter    = VK_FILTER_NEAREST,
+      .minFilter    = VK_FILTER_NEAREST,
+      .mipmapMode   = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+      .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      .maxLod       = VK_LOD_CLAMP_NONE,
+  };
+  m_device.create_sampler(sampler_ci, &m_hiz_sampler, "hiz");
+}
+
+GpuScene::~GpuScene() {
+  for (VkPipeline pipeline : {m_cull_pipeline, m_hiz_pipeline, m_occlusion_pipeline}) {
+    if (pipeline != VK_NULL_HANDLE) {
+      m_device.destroy_pipeline(pipeline);
+    }
+  }
+  m_device.destroy_pipeline_layout(m_cull_shader.get_pipeline_layout());
+  m_device.destroy_pipeline_layout(m_hiz_shader.get_pipeline_layout());
+  m_device.destroy_pipeline_layout(m_occlusion_shader.get_pipeline_layout());
+  retire_hiz_views();
+  collect_retired_views(true);
+  m_device.destroy_sampler(m_hiz_sampler);
+}
+
+uint32_t GpuScene::add_mesh(const MeshData& mesh) {
+  return add_mesh(mesh.vertices, mesh.indices);
+}
+
+uint32_t GpuScene::add_mesh(std::span<const MeshVertex> vertices,
+                            std::span<const uint32_t> indices) {
+  VK_ASSERT(!m_vertex_buffer && !m_external_geometry);
+  m_meshes.push_back({
+      .sphere    = compute_bounding_sphere(vertices),
+      .lod_count = 1,
+      .lods      = {append_geometry(vertices, indices, 0.0f)},
+  });
+  return static_cast<uint32_t>(m_meshes.size() - 1);
+}
+
+uint32_t GpuScene::add_mesh_range(const glm::vec4& sphere, int32_t vertex_offset,
+                                  uint32_t first_index, uint32_t index_count) {
+  VK_ASSERT(!m_vertex_buffer && m_vertices.empty());
+  m_external_geometry = true;
+  m_meshes.push_back({
+      .sphere    = sphere,
+      .lod_count = 1,
+      .lods      = {{
+          .index_count   = index_count,
+          .first_index   = first_index,
+          .vertex_offset = vertex_offset,
+          .error         = 0.0f,
+      }},
+  });
+  return static_cast<uint32_t>(m_meshes.size() - 1);
+}
+
+void GpuScene::add_mesh_lod(uint32_t mesh, const MeshData& lod, float error) {
+  VK_ASSERT(!m_vertex_buffer && !m_external_geometry && mesh < m_meshes.size());
+  auto& range = m_meshes[mesh];
+  if (range.lod_count == MAX_LODS) {
+    logger::warn("Mesh {} already has {} LODs, dropping the new one", mesh, MAX_LODS);
+    return;
+  }
+  // the bounding sphere of LOD 0 is used for all of them
+  range.lods[range.lod_count++] = append_geometry(lod.vertices, lod.indices, error);
+}
+
+GpuScene::LodRange GpuScene::append_geometry(std::span<const MeshVertex> vertices,
+                                             std::span<const uint32_t> indices, float error) {
+  const LodRange range = {
+      .index_count   = static_cast<uint32_t>(indices.size()),
+      .first_index   = static_cast<uint32_t>(m_indices.size()),
+      .vertex_offset = static_cast<int32_t>(m_vertices.size()),
+      .error         = error,
+  };
+  m_vertices.insert(m_vertices.end(), vertices.begin(), vertices.end());
+  m_indices.insert(m_indices.end(), indices.begin(), indices.end());
+  return range;
+}
+
+uint32_t GpuScene::add_object(const glm::mat4& model, uint32_t mesh, uint32_t batch) {
+  VK_ASSERT(!m_vertex_buffer && mesh < m_meshes.size());
+  m_objects.push_back({mesh, batch});
+  m_models.push_back(model);
+  if (batch >= m_batch_sizes.size()) {
+    m_batch_sizes.resize(batch + 1, 0);
+  }
+  m_batch_sizes[batch]++;
+  return static_cast<uint32_t>(m_objects.size() - 1);
+}
+
+std::pair<std::unique_ptr<vkh::Buffer>, std::unique_ptr<vkh::Buffer>>
+GpuScene::create_geometry_buffers(const vkh::Device& device, const std::string& name,
+                                  VkDeviceSize vertex_size, VkDeviceSize index_size) {
+  // written once like the buffers of upload(), empty buffers are not allowed
+  const auto create_buffer = [&](const std::string& buffer_name, VkDeviceSize size,
+                                 VkBufferUsageFlags usage) {
+    return std::make_unique<vkh::Buffer>(device, buffer_name, std::max<VkDeviceSize>(size, 4),
+                                         usage,
+                                         VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+  };
+  return {create_buffer(name + " vertices", vertex_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT),
+          create_buffer(name + " indices", index_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT)};
+}
+
+void GpuScene::upload() {
+  VK_ASSERT(!m_external_geometry);
+  upload(nullptr, nullptr);
+}
+
+void GpuScene::upload(std::unique_ptr<vkh::Buffer> vertex_buffer,
+                      std::unique_ptr<vkh::Buffer> index_buffer) {
+  VK_ASSERT(!m_vertex_buffer && !m_objects.empty());
+  VK_ASSERT(m_external_geometry == (vertex_buffer && index_buffer));
+  // every batch reserves one command per object
+  m_batch_bases.resize(m_batch_sizes.size());
+  m_command_count = 0;
+  for (uint32_t batch = 0; batch < m_batch_sizes.size(); batch++) {
+    m_batch_bases[batch] = m_command_count;
+    m_command_count += m_batch_sizes[batch];
+  }
+  std::vector<CullObject> cull_objects;
+  std::vector<uint32_t> batch_fill(m_batch_sizes.size(), 0);
+  for (const auto& object : m_objects) {
+    cull_objects.push_back({
+        .sphere       = m_meshes[object.mesh].sphere,
+        .mesh         = object.mesh,
+        .batch        = object.batch,
+        .command_base = m_batch_bases[object.batch],
+        .command_slot = m_batch_bases[object.batch] + batch_fill[object.batch]++,
+    });
+  }
+  std::vector<GpuMeshLods> mesh_lods;
+  for (const auto& mesh : m_meshes) {
+    GpuMeshLods lods{.lod_count = mesh.lod_count};
+    for (uint32_t lod = 0; lod < mesh.lod_count; lod++) {
+      lods.index_counts[lod]   = mesh.lods[lod].index_count;
+      lods.first_indices[lod]  = mesh.lods[lod].first_index;
+      lods.vertex_offsets[lod] = mesh.lods[lod].vertex_offset;
+      lods.errors[lod]         = mesh.lods[lod].error;
+    }
+    mesh_lods.push_back(lods);
+  }
+  // every object starts at LOD 0 and visible, the first frame draws all of them early
+  const std::vector<uint32_t> object_lods(m_objects.size(), 0);
+  const std::vector<uint32_t> object_visibility(m_objects.size(), VISIBILITY_VISIBLE);
+
+  // Static data is written once through host visible memory, on discrete GPUs a staging copy
+  // to device local memory would be faster to read.
+  constexpr VmaAllocationCreateFlags host_write =
+      VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+  const auto create_buffer = [&](const char* name, VkDeviceSize size, VkBufferUsageFlags usage,
+                                 VmaAllocationCreateFlags flags, const void* data) {
+    auto buffer = std::make_unique<vkh::Buffer>(m_device, name, size, usage, flags);
+    if (data != nullptr) {
+      buffer->update(const_cast<void*>(data), size);
+    }
+    return buffer;
+  };
+  if (m_external_geometry) {
+    m_vertex_buffer = std::move(vertex_buffer);
+    m_index_buffer  = std::move(index_buffer);
+  } else {
+    m_vertex_buffer = create_buffer("scene vertices", m_vertices.size() * sizeof(MeshVertex),
+                                    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, host_write,
+                                    m_vertices.data());
+    m_index_buffer  = create_buffer("scene indices", m_indices.size() * sizeof(uint32_t),
+                                    VK_BUFFER_USAGE_INDEX_BUFFER_BIT, host_write, m_indices.data());
+  }
+  m_object_buffer = create_buffer("scene objects", m_models.size() * sizeof(glm::mat4),
+                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host_write, m_models.data());
+  m_cull_object_buffer =
+      create_buffer("scene cull objects", cull_objects.size() * sizeof(CullObject),
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host_write, cull_objects.data());
+  m_mesh_lod_buffer = create_buffer("scene mesh lods", mesh_lods.size() * sizeof(GpuMeshLods),
+                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host_write,
+                                    mesh_lods.data());
+  m_object_lod_buffer =
+      create_buffer("scene object lods", object_lods.size() * sizeof(uint32_t),
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host_write, object_lods.data());
+  m_object_visibility_buffer =
+      create_buffer("scene object visibility", object_visibility.size() * sizeof(uint32_t),
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host_write, object_visibility.data());
+  // written by the GPU only, the commands and counts of the early phase followed by the late one
+  m_command_buffer = create_buffer(
+      "scene draw commands", 2 * m_command_count * sizeof(VkDrawIndexedIndirectCommand),
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, 0, nullptr);
+  m_count_buffer = create_buffer(
+      "scene draw counts", 2 * m_batch_sizes.size() * sizeof(uint32_t),
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+          VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      0, nullptr);
+  // the shadow casters of one light, early phase only
+  m_shadow_command_buffer = create_buffer(
+      "scene shadow draw commands", m_command_count * sizeof(VkDrawIndexedIndirectCommand),
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, 0, nullptr);
+  m_shadow_count_buffer = create_buffer(
+      "scene shadow draw counts", m_batch_sizes.size() * sizeof(uint32_t),
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+          VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      0, nullptr);
+  m_vertices.clear();
+  m_indices.clear();
+
+  std::array<VkDescriptorBufferInfo, 7> buffer_infos = {{
+      {m_object_buffer->handle(), 0, VK_WHOLE_SIZE},
+      {m_cull_object_buffer->handle(), 0, VK_WHOLE_SIZE},
+      {m_command_buffer->handle(), 0, VK_WHOLE_SIZE},
+      {m_count_buffer->handle(), 0, VK_WHOLE_SIZE},
+      {m_mesh_lod_buffer->handle(), 0, VK_WHOLE_SIZE},
+      {m_object_lod_buffer->handle(), 0, VK_WHOLE_SIZE},
+      {m_object_visibility_buffer->handle(), 0, VK_WHOLE_SIZE},
+  }};
+  auto builder = vkh::DescriptorBuilder::begin(&m_descriptor_layout_cache, &m_descriptor_allocator);
+  for (uint32_t i = 0; i < buffer_infos.size(); i++) {
+    builder.bind_buffer(i, &buffer_infos[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                        VK_SHADER_STAGE_COMPUTE_BIT);
+  }
+  if (!builder.build(m_cull_set)) {
+    logger::error("Failed to allocate the cull descriptor set");
+  }
+  buffer_infos[2].buffer = m_shadow_command_buffer->handle();
+  buffer_infos[3].buffer = m_shadow_count_buffer->handle();
+  auto shadow_builder =
+      vkh::DescriptorBuilder::begin(&m_descriptor_layout_cache, &m_descriptor_allocator);
+  for (uint32_t i = 0; i < buffer_infos.size(); i++) {
+    shadow_builder.bind_buffer(i, &buffer_infos[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                               VK_SHADER_STAGE_COMPUTE_BIT);
+  }
+  if (!shadow_builder.build(m_shadow_cull_set)) {
+    logger::error("Failed to allocate the shadow cull descriptor set");
+  }
+  m_cull_pipeline = vkh::create_compute_pipeline(m_device, m_cull_shader.get_pipeline_layout(),
+                                                 get_stages(m_cull_shader).front(), "cull");
+  m_hiz_pipeline  = vkh::create_compute_pipeline(m_device, m_hiz_shader.get_pipeline_layout(),
+                                                 get_stages(m_hiz_shader).front(), "hiz build");
+  m_occlusion_pipeline =
+      vkh::create_compute_pipeline(m_device, m_occlusion_shader.get_pipeline_layout(),
+                                   get_stages(m_occlusion_shader).front(), "occlusion cull");
+  logger::info("GPU scene: {} objects, {} meshes, {} batches", m_objects.size(), m_meshes.size(),
+               m_batch_sizes.size());
+}
+
+void GpuScene::set_transform(uint32_t object, const glm::mat4& model) {
+  // Objects of frames in flight may see the new transform early, acceptable for a transform
+  // but not for anything changing the draw commands.
+  m_models[object] = model;
+  m_transform_version++;
+  m_object_buffer->update(&m_models[object], sizeof(glm::mat4), object * sizeof(glm::mat4));
+}
+
+void GpuScene::add_cull_passes(RenderGraph& graph, const glm::mat4* view_proj,
+                               const LodView* lod_view, bool occlusion_culling) {
+  VK_ASSERT(m_vertex_buffer);
+  m_commands = graph.import_buffer("draw commands", m_command_buffer->handle());
+  m_counts   = graph.import_buffer("draw counts", m_count_buffer->handle());
+  // the state read by the occlusion cull pass
+  m_object_lods = graph.import_buffer("object lods", m_object_lod_buffer->handle());
+  m_visibility  = graph.import_buffer("object visibility", m_object_visibility_buffer->handle());
+  graph.add_pass("reset draw counts", RGPassType::Compute)
+      .add_buffer_output(m_counts, VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR,
+                         VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR)
+      .set_execute([this](const RGPassContext& ctx) {
+        ctx.cmd.fill_buffer(m_count_buffer->handle(), 0);
+      });
+  graph.add_pass("frustum cull", RGPassType::Compute)
+      .add_buffer_output(m_commands, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+                         VK_ACCESS_2_SHADER_WRITE_BIT_KHR)
+      .add_buffer_output(m_counts, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+                         VK_ACCESS_2_SHADER_READ_BIT_KHR | VK_ACCESS_2_SHADER_WRITE_BIT_KHR)
+      .add_buffer_output(m_object_lods, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+                         VK_ACCESS_2_SHADER_READ_BIT_KHR | VK_ACCESS_2_SHADER_WRITE_BIT_KHR)
+      .add_buffer_output(m_visibility, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+                         VK_ACCESS_2_SHADER_READ_BIT_KHR | VK_ACCESS_2_SHADER_WRITE_BIT_KHR)
+      .set_execute([this, view_proj, lod_view, occlusion_culling](const RGPassContext& ctx) {
+        record_cull(ctx, *view_proj, *lod_view, occlusion_culling ? CULL_FLAG_OCCLUSION : 0,
+                    m_cull_set);
+      });
+}
+
+void GpuScene::add_shadow_cull_passes(RenderGraph& graph, const glm::mat4* view_proj) {
+  VK_ASSERT(m_vertex_buffer);
+  m_shadow_commands = graph.import_buffer("shadow draw commands",
+                                          m_shadow_command_buffer->handle());
+  m_shadow_counts   = graph.import_buffer("shadow draw counts", m_shadow_count_buffer->handle());
+  graph.add_pass("reset shadow draw counts", RGPassType::Compute)
+      .add_buffer_output(m_shadow_counts, VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR,
+                         VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR)
+      .set_execute([this](const RGPassContext& ctx) {
+        ctx.cmd.fill_buffer(m_shadow_count_buffer->handle(), 0);
+      });
+  graph.add_pass("shadow cull", RGPassType::Compute)
+      .add_buffer_input(m_object_lods, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+                        VK_ACCESS_2_SHADER_READ_BIT_KHR)
+      .add_buffer_output(m_shadow_commands, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+                         VK_ACCESS_2_SHADER_WRITE_BIT_KHR)
+      .add_buffer_output(m_shadow_counts, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+                         VK_ACCESS_2_SHADER_READ_BIT_KHR | VK_ACCESS_2_SHADER_WRITE_BIT_KHR)
+      .set_execute([this, view_proj](const RGPassContext& ctx) {
+        record_cull(ctx, *view_proj, LodView{}, CULL_FLAG_SHADOW, m_shadow_cull_set);
+      });
+}
+
+void GpuScene::add_occlusion_passes(RenderGraph& graph, RGResourceHandle depth,
+                                    const glm::mat4* view, const glm::mat4* proj,
+                                    const VkExtent2D* viewport) {
+  VK_ASSERT(m_vertex_buffer);
+  // Level 0 has half the resolution of the depth buffer, rounded up to a power of two so every
+  // texel of a level covers exactly 2x2 texels of the level below.
+  m_depth        = depth;
+  m_depth_extent = graph.get_render_extent();
+  m_viewport     = viewport;
+  m_hiz_extent   = {std::bit_ceil((m_depth_extent.width + 1) / 2),
+                    std::bit_ceil((m_depth_extent.height + 1) / 2)};
+  m_hiz_levels   = std::bit_width(std::max(m_hiz_extent.width, m_hiz_extent.height));
+  m_hiz          = graph.create_image("hiz", {.format     = VK_FORMAT_R32G32_SFLOAT,
+                                              .extent     = m_hiz_extent,
+                                              .mip_levels = m_hiz_levels});
+  // the image of the rebuilt graph needs new views
+  retire_hiz_views();
+  graph.add_pass("hiz build", RGPassType::Compute)
+      .add_texture_input(depth, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR)
+      .add_storage_image_output(m_hiz)
+      .set_execute([this](const RGPassContext& ctx) { record_hiz_build(ctx); });
+  graph.add_pass("occlusion cull", RGPassType::Compute)
+      .add_texture_input(m_hiz, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR)
+      .add_buffer_input(m_object_lods, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+                        VK_ACCESS_2_SHADER_READ_BIT_KHR)
+      .add_buffer_output(m_visibility, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+                         VK_ACCESS_2_SHADER_READ_BIT_KHR | VK_ACCESS_2_SHADER_WRITE_BIT_KHR)
+      .add_buffer_output(m_commands, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+                         VK_ACCESS_2_SHADER_WRITE_BIT_KHR)
+      .add_buffer_output(m_counts, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+                         VK_ACCESS_2_SHADER_READ_BIT_KHR | VK_ACCESS_2_SHADER_WRITE_BIT_KHR)
+      .set_execute([this, view, proj](const RGPassContext& ctx) {
+        record_occlusion_cull(ctx, *view, *proj);
+      });
+}
+
+void GpuScene::record_cull(const RGPassContext& ctx, const glm::mat4& view_proj,
+                           const LodView& lod_view, uint32_t flags, VkDescriptorSet set) {
+  if (m_device.get_features().supports_draw_indirect_count) {
+    flags |= CULL_FLAG_COMPACT;
+  }
+  const VkPipelineLayout layout = m_cull_shader.get_pipeline_layout();
+  const CullConstants constants = {
+      .planes         = extract_frustum_planes(view_proj),
+      .camera         = glm::vec4(lod_view.camera_position, lod_view.projection_scale),
+      .object_count   = get_object_count(),
+      .flags          = flags,
+      .lod_threshold  = lod_view.settings.error_threshold,
+      .lod_hysteresis = lod_view.settings.hysteresis,
+  };
+  ctx.cmd.bind_pipeline(VK_PIPELINE_BIND_POINT_COMPUTE, m_cull_pipeline);
+  ctx.cmd.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, {set});
+  ctx.cmd.push_constants(layout, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(constants), &constants);
+  ctx.cmd.dispatch((constants.object_count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE);
+}
+
+void GpuScene::record_hiz_build(const RGPassContext& ctx) {
+  collect_retired_views(false);
+  if (m_hiz_views.empty()) {
+    create_hiz_descriptors(ctx.graph);
+  }
+  const VkPipelineLayout layout = m_hiz_shader.get_pipeline_layout();
+  ctx.cmd.bind_pipeline(VK_PIPELINE_BIND_POINT_COMPUTE, m_hiz_pipeline);
+  // the pyramid keeps its size, the texels past the viewport are neutral
+  const VkExtent2D viewport = get_viewport_extent();
+  glm::uvec2 source_size    = {viewport.width, viewport.height};
+  for (uint32_t level = 0; level < m_hiz_levels; level++) {
+    if (level > 0) {
+      // the previous level is complete before it is reduced
+      ctx.cmd.memory_barrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    }
+    const glm::uvec2 size = {std::max(m_hiz_extent.width >> level, 1u),
+                             std::max(m_hiz_extent.height >> level, 1u)};
+    ctx.cmd.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, {m_hiz_sets[level]});
+    const HizConstants constants = {source_size, level};
+    ctx.cmd.push_constants(layout, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(constants), &constants);
+    ctx.cmd.dispatch((size.x + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE,
+                     (size.y + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE);
+    source_size = size;
+  }
+}
+
+void GpuScene::record_occlusion_cull(const RGPassContext& ctx, const glm::mat4& view,
+                                     const glm::mat4& proj) {
+  const VkPipelineLayout layout      = m_occlusion_shader.get_pipeline_layout();
+  const VkExtent2D viewport          = get_viewport_extent();
+  const OcclusionConstants constants = {
+      .view          = view,
+      .projection    = {proj[0][0], std::abs(proj[1][1]), proj[2][2], proj[3][2]},
+      .hiz_scale     = glm::vec2(viewport.width, viewport.height) * 0.5f,
+      .object_count  = get_object_count(),
+      .flags         = m_device.get_features().supports_draw_indirect_count ? CULL_FLAG_COMPACT : 0,
+      .late_commands = m_command_count,
+      .late_counts   = get_batch_count(),
+  };
+  ctx.cmd.bind_pipeline(VK_PIPELINE_BIND_POINT_COMPUTE, m_occlusion_pipeline);
+  ctx.cmd.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0,
+                               {m_cull_set, m_occlusion_set});
+  ctx.cmd.push_constants(layout, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(constants), &constants);
+  ctx.cmd.dispatch((constants.object_count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE);
+}
+
+void GpuScene::create_hiz_descriptors(const RenderGraph& graph) {
+  const VkImage image = graph.get_image(m_hiz);
+  for (uint32_t level = 0; level < m_hiz_levels; level++) {
+    const VkImageViewCreateInfo view_ci = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image            = image,
+        .viewType         = VK_IMAGE_VIEW_TYPE_2D,
+        .format           = VK_FORMAT_R32G32_SFLOAT,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1},
+    };
+    m_device.create_image_view(view_ci, &m_hiz_views.emplace_back(),
+                               "hiz level " + std::to_string(level));
+  }
+  // a fresh allocator, the one of the previous image was retired with its views
+  m_hiz_allocator = std::make_unique<vkh::DescriptorAllocator>(m_device);
+
+  VkDescriptorImageInfo depth_info = {m_hiz_sampler, graph.get_image_view(m_depth),
+                                      VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+  VkDescriptorImageInfo pyramid_info = {m_hiz_sampler, graph.get_image_view(m_hiz),
+                                        VK_IMAGE_LAYOUT_GENERAL};
+  m_hiz_sets.resize(m_hiz_levels);
+  for (uint32_t level = 0; level < m_hiz_levels; level++) {
+    VkDescriptorImageInfo level_info = {VK_NULL_HANDLE, m_hiz_views[level],
+                                        VK_IMAGE_LAYOUT_GENERAL};
+    const bool built =
+        vkh::DescriptorBuilder::begin(&m_descriptor_layout_cache, m_hiz_allocator.get())
+            .bind_image(0, &depth_info, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                        VK_SHADER_STAGE_COMPUTE_BIT)
+            .bind_image(1, &pyramid_info, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                        VK_SHADER_STAGE_COMPUTE_BIT)
+            .bind_image(2, &level_info, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                        VK_SHADER_STAGE_COMPUTE_BIT)
+            .build(m_hiz_sets[level]);
+    if (!built) {
+      logger::error("Failed to allocate the hiz descriptor set of level {}", level);
+    }
+  }
+  pyramid_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  if (!vkh::DescriptorBuilder::begin(&m_descriptor_layout_cache, m_hiz_allocator.get())
+           .bind_image(0, &pyramid_info, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+           .build(m_occlusion_set)) {
+    logger::error("Failed to allocate the occlusion descriptor set");
+  }
+}
+
+void GpuScene::retire_hiz_views() {
+  if (m_hiz_views.empty()) {
+    return;
+  }
+  // retired together with the image, frames submitted so far may still use the views and sets
+  const auto& timeline = m_device.get_timeline(vkh::QUEUE_INDEX_GRAPHICS);
+  m_retired_views.push_back(
+      {std::move(m_hiz_views), std::move(m_hiz_allocator), timeline.last_submitted_value()});
+  m_hiz_views.clear();
+  m_hiz_sets.clear();
+  m_occlusion_set = VK_NULL_HANDLE;
+}
+
+void GpuScene::collect_retired_views(bool wait) {
+  const auto& timeline = m_device.get_timeline(vkh::QUEUE_INDEX_GRAPHICS);
+  while (!m_retired_views.empty()) {
+    auto& retired = m_retired_views.front();
+    if (wait) {
+      timeline.wait(retired.retire_value);
+    } else if (!timeline.is_complete(retired.retire_value)) {
+      break;
+    }
+    for (VkImageView view : retired.views) {
+      m_device.destroy_image_view(view);
+    }
+    m_retired_views.pop_front();
+  }
+}
+
+void GpuScene::declare_draw_inputs(RGPass& pass, DrawPhase phase) const {
+  const bool shadow = phase == DrawPhase::Shadow;
+  pass.add_buffer_input(shadow ? m_shadow_commands : m_commands,
+                        VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT_KHR,
+                        VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT_KHR)
+      .add_buffer_input(shadow ? m_shadow_counts : m_counts,
+                        VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT_KHR,
+                        VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT_KHR);
+}
+
+void GpuScene::draw_batch(const vkh::CommandBuffer& cmd, uint32_t batch, DrawPhase phase) const {
+  if (batch >= m_batch_sizes.size() || m_batch_sizes[batch] == 0) {
+    return;
+  }
+  const bool late             = phase == DrawPhase::Late;
+  const bool shadow           = phase == DrawPhase::Shadow;
+  const uint32_t first        = m_batch_bases[batch] + (late ? m_command_count : 0);
+  const uint32_t count_offset = batch + (late ? get_batch_count() : 0);
+  cmd.bind_vertex_buffer(0, m_vertex_buffer->handle());
+  cmd.bind_index_buffer(m_index_buffer->handle());
+  cmd.draw_indexed_indirect_count(
+      (shadow ? m_shadow_command_buffer : m_command_buffer)->handle(),
+      first * sizeof(VkDrawIndexedIndirectCommand),
+      (shadow ? m_shadow_count_buffer : m_count_buffer)->handle(),
+      count_offset * sizeof(uint32_t), m_batch_sizes[batch]);
+}
+}  // namespace zen
@@ -0,0 +1,257 @@
+#ifndef ZENENGINE_GPU_SCENE_HPP
+#define ZENENGINE_GPU_SCENE_HPP
+#include <array>
+#include <deque>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+#include "frustum_culler.hpp"
+#include "render_graph.hpp"
+#include "vk_helper/buffer.hpp"
+#include "vk_helper/descriptor.hpp"
+#include "vk_helper/pipeline.hpp"
+#include "vk_helper/shader.hpp"
+
+namespace zen {
+// matches the vertex input of tri_mesh_ssbo_textured.vert
+struct MeshVertex {
+  glm::vec3 position;
+  glm::vec3 normal;
+  glm::vec3 color;
+  glm::vec2 uv;
+
+  static vkh::VertexInputDescription get_input_description();
+};
+
+// With occlusion culling the objects visible in the last frame are drawn in the early phase, the
+// objects they no longer occlude in the late phase. Shadow draws the casters of the light.
+enum class DrawPhase {
+  Early,
+  Late,
+  Shadow
+};
+
+struct MeshData {
+  std::vector<MeshVertex> vertices;
+  std::vector<uint32_t> indices;
+};
+
+// center in xyz and radius in w, centered on the bounding box
+glm::vec4 compute_bounding_sphere(std::span<const MeshVertex> vertices);
+
+/// Meshes and object instances living on the GPU, drawn without per-object CPU work.
+///
+/// All meshes share one vertex and one index buffer. Every object has a model matrix, a mesh and
+/// a batch, one batch per pipeline. Each frame a compute pass culls the objects against the
+/// view frustum and writes a VkDrawIndexedIndirectCommand per visible object into the region
+/// of its batch, then draw_batch() issues a single indirect draw per batch. Objects are found in
+/// the vertex shader through gl_BaseInstance.
+///
+/// A mesh may have coarser LODs, the cull pass picks one per visible object from its projected
+/// error, with the LOD of the previous frame kept on the GPU for hysteresis.
+///
+/// Occlusion culling works in two phases. The cull pass only keeps the objects which were visible
+/// in the last frame, their depth is drawn and reduced to a hierarchical-Z pyramid of min/max
+/// depth, then a second pass tests the objects in the frustum against the pyramid. Objects it
+/// finds visible are drawn in the late phase unless the early phase had them already, and the
+/// result is the visible set of the next frame.
+///
+/// Shadow casters are culled by a separate pass against the frustum of a light into their own
+/// commands, using the LODs the camera selected.
+///
+/// Meshes and objects are added before upload(), transforms may change afterwards.
+class GpuScene {
+public:
+  ZEN_NO_COPY_MOVE(GpuScene)
+  explicit GpuScene(const vkh::Device& device);
+  ~GpuScene();
+
+  uint32_t add_mesh(const MeshData& mesh);
+  // for geometry which is not in a MeshData, e.g. imported into one large block
+  uint32_t add_mesh(std::span<const MeshVertex> vertices, std::span<const uint32_t> indices);
+  // Adds a mesh whose geometry is already in the vertex and index buffers passed to upload(),
+  // e.g. loaded from a cooked file. Cannot be mixed with the other add_mesh() overloads.
+  uint32_t add_mesh_range(const glm::vec4& sphere, int32_t vertex_offset, uint32_t first_index,
+                          uint32_t index_count);
+  // Adds the next coarser LOD of mesh, error is its geometric error in model space.
+  void add_mesh_lod(uint32_t mesh, const MeshData& lod, float error);
+  uint32_t add_object(const glm::mat4& model, uint32_t mesh, uint32_t batch);
+  // Creates the GPU buffers, the CPU copies of the meshes are dropped.
+  void upload();
+  // Creates the GPU buffers with the given geometry buffers, for meshes of add_mesh_range().
+  void upload(std::unique_ptr<vkh::Buffer> vertex_buffer,
+              std::unique_ptr<vkh::Buffer> index_buffer);
+  // Creates vertex and index buffers for upload(), host visible for the caller to map and fill.
+  static std::pair<std::unique_ptr<vkh::Buffer>, std::unique_ptr<vkh::Buffer>>
+  create_geometry_buffers(const vkh::Device& device, const std::string& name,
+                          VkDeviceSize vertex_size, VkDeviceSize index_size);
+  void set_transform(uint32_t object, const glm::mat4& model);
+  // changes whenever a transform does, e.g. to invalidate cached shadows
+  uint32_t get_transform_version() const { return m_transform_version; }
+
+  // Adds the passes resetting the draw counts and culling against the frustum of view_proj.
+  // view_proj and lod_view are read when the passes execute, so they may change every frame.
+  // With occlusion_culling the passes write the early phase, add_occlusion_passes() has to
+  // follow once its depth is drawn.
+  void add_cull_passes(RenderGraph& graph, const glm::mat4* view_proj, const LodView* lod_view,
+                       bool occlusion_culling = false);
+  // Adds the passes building the depth pyramid of depth and writing the late phase, view and
+  // proj are read when the passes execute and have to match the ones of add_cull_passes().
+  // viewport, also read then, is the top left part of depth drawn to, all of it if null.
+  void add_occlusion_passes(RenderGraph& graph, RGResourceHandle depth, const glm::mat4* view,
+                            const glm::mat4* proj, const VkExtent2D* viewport = nullptr);
+  // Adds the passes culling the shadow casters against the frustum of view_proj, read when the
+  // passes execute. Follows add_cull_passes(), whose LODs the casters use.
+  void add_shadow_cull_passes(RenderGraph& graph, const glm::mat4* view_proj);
+  // Declares the indirect reads of draw_batch() on the pass drawing the batches.
+  void declare_draw_inputs(RGPass& pass, DrawPhase phase = DrawPhase::Early) const;
+  void draw_batch(const vkh::CommandBuffer& cmd, uint32_t batch,
+                  DrawPhase phase = DrawPhase::Early) const;
+
+  uint32_t get_batch_count() const { return static_cast<uint32_t>(m_batch_sizes.size()); }
+  uint32_t get_object_count() const { return static_cast<uint32_t>(m_models.size()); }
+  // model matrices indexed by object, bound as the object buffer of the vertex shader
+  VkBuffer get_object_buffer() const { return m_object_buffer->handle(); }
+
+private:
+  // matches CullObject in cull.comp
+  struct CullObject {
+    glm::vec4 sphere;
+    uint32_t mesh;
+    uint32_t batch;
+    uint32_t command_base;
+    uint32_t command_slot;
+  };
+  // matches MeshLods in cull.comp
+  struct GpuMeshLods {
+    glm::uvec4 index_counts;
+    glm::uvec4 first_indices;
+    glm::ivec4 vertex_offsets;
+    glm::vec4 errors;
+    uint32_t lod_count;
+    uint32_t pad[3];
+  };
+  struct CullConstants {
+    FrustumPlanes planes;
+    // xyz: camera position, w: LodView::projection_scale
+    glm::vec4 camera;
+    uint32_t object_count;
+    uint32_t flags;
+    float lod_threshold;
+    float lod_hysteresis;
+  };
+  // matches Constants in hiz_build.comp
+  struct HizConstants {
+    glm::uvec2 source_size;
+    uint32_t level;
+  };
+  // matches Constants in occlusion_cull.comp
+  struct OcclusionConstants {
+    glm::mat4 view;
+    glm::vec4 projection;
+    glm::vec2 hiz_scale;
+    uint32_t object_count;
+    uint32_t flags;
+    uint32_t late_commands;
+    uint32_t late_counts;
+  };
+  // views and descriptor sets of a depth pyramid which may still be used by frames in flight
+  struct RetiredViews {
+    std::vector<VkImageView> views;
+    std::unique_ptr<vkh::DescriptorAllocator> allocator;
+    uint64_t retire_value;
+  };
+  struct LodRange {
+    uint32_t index_count;
+    uint32_t first_index;
+    int32_t vertex_offset;
+    float error;
+  };
+  struct MeshRange {
+    glm::vec4 sphere;
+    uint32_t lod_count;
+    std::array<LodRange, MAX_LODS> lods;
+  };
+  struct Object {
+    uint32_t mesh;
+    uint32_t batch;
+  };
+
+  LodRange append_geometry(std::span<const MeshVertex> vertices,
+                           std::span<const uint32_t> indices, float error);
+  void record_cull(const RGPassContext& ctx, const glm::mat4& view_proj, const LodView& lod_view,
+                   uint32_t flags, VkDescriptorSet set);
+  void record_hiz_build(const RGPassContext& ctx);
+  void record_occlusion_cull(const RGPassContext& ctx, const glm::mat4& view,
+                             const glm::mat4& proj);
+  VkExtent2D get_viewport_extent() const { return m_viewport ? *m_viewport : m_depth_extent; }
+  // Per level views and descriptor sets of the pyramid, created once the graph has the image.
+  void create_hiz_descriptors(const RenderGraph& graph);
+  void retire_hiz_views();
+  void collect_retired_views(bool wait);
+
+  const vkh::Device& m_device;
+  std::vector<MeshVertex> m_vertices;
+  std::vector<uint32_t> m_indices;
+  std::vector<MeshRange> m_meshes;
+  std::vector<Object> m_objects;
+  std::vector<glm::mat4> m_models;
+  std::vector<uint32_t> m_batch_sizes;
+  std::vector<uint32_t> m_batch_bases;
+  // commands of the early phase, the late phase follows them
+  uint32_t m_command_count{0};
+  uint32_t m_transform_version{0};
+  // meshes of add_mesh_range(), upload() takes their buffers
+  bool m_external_geometry{false};
+
+  std::unique_ptr<vkh::Buffer> m_vertex_buffer;
+  std::unique_ptr<vkh::Buffer> m_index_buffer;
+  std::unique_ptr<vkh::Buffer> m_object_buffer;
+  std::unique_ptr<vkh::Buffer> m_cull_object_buffer;
+  std::unique_ptr<vkh::Buffer> m_mesh_lod_buffer;
+  // LOD of every object in the last frame, only accessed by the GPU
+  std::unique_ptr<vkh::Buffer> m_object_lod_buffer;
+  // occlusion culling state of every object, only accessed by the GPU
+  std::unique_ptr<vkh::Buffer> m_object_visibility_buffer;
+  std::unique_ptr<vkh::Buffer> m_command_buffer;
+  std::unique_ptr<vkh::Buffer> m_count_buffer;
+  std::unique_ptr<vkh::Buffer> m_shadow_command_buffer;
+  std::unique_ptr<vkh::Buffer> m_shadow_count_buffer;
+  RGResourceHandle m_commands;
+  RGResourceHandle m_counts;
+  RGResourceHandle m_shadow_commands;
+  RGResourceHandle m_shadow_counts;
+  RGResourceHandle m_object_lods;
+  RGResourceHandle m_visibility;
+  RGResourceHandle m_depth;
+  RGResourceHandle m_hiz;
+  VkExtent2D m_depth_extent{};
+  const VkExtent2D* m_viewport{nullptr};
+  VkExtent2D m_hiz_extent{};
+  uint32_t m_hiz_levels{0};
+  std::vector<VkImageView> m_hiz_views;
+  std::deque<RetiredViews> m_retired_views;
+
+  vkh::ShaderProgram m_cull_shader;
+  vkh::ShaderProgram m_hiz_shader;
+  vkh::ShaderProgram m_occlusion_shader;
+  VkPipeline m_cull_pipeline{VK_NULL_HANDLE};
+  VkPipeline m_hiz_pipeline{VK_NULL_HANDLE};
+  VkPipeline m_occlusion_pipeline{VK_NULL_HANDLE};
+  VkSampler m_hiz_sampler{VK_NULL_HANDLE};
+  vkh::DescriptorLayoutCache m_descriptor_layout_cache;
+  vkh::DescriptorAllocator m_descriptor_allocator;
+  VkDescriptorSet m_cull_set{VK_NULL_HANDLE};
+  // the cull set writing the shadow commands and counts
+  VkDescriptorSet m_shadow_cull_set{VK_NULL_HANDLE};
+  // the sets of the pyramid, retired with its views
+  std::unique_ptr<vkh::DescriptorAllocator> m_hiz_allocator;
+  // one per level of the pyramid
+  std::vector<VkDescriptorSet> m_hiz_sets;
+  VkDescriptorSet m_occlusion_set{VK_NULL_HANDLE};
+};
+}  // namespace zen
+#endif  //ZENENGINE_GPU_SCENE_HPP
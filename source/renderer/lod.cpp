@@ -0,0 +1,22 @@
+#include "lod.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace zen {
+float get_lod_projection_scale(const glm::mat4& proj, float viewport_height) {
+  return std::abs(proj[1][1]) * viewport_height * 0.5f;
+}
+
+uint32_t select_lod(const LodChain& chain, float distance, uint32_t current, const LodView& view) {
+  const float pixels_per_unit = view.projection_scale / std::max(distance, 1e-3f);
+  const float threshold       = view.settings.error_threshold;
+  for (uint32_t lod = chain.count - 1; lod > 0; lod--) {
+    // switching to a coarser LOD needs the margin, keeping the current one does not
+    const float limit = lod > current ? threshold * (1.0f - view.settings.hysteresis) : threshold;
+    if (chain.errors[lod] * pixels_per_unit <= limit) {
+      return lod;
+    }
+  }
+  return 0;
+}
+}  // namespace zen
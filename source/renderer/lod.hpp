@@ -0,0 +1,38 @@
+#ifndef ZENENGINE_LOD_HPP
+#define ZENENGINE_LOD_HPP
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace zen {
+constexpr uint32_t MAX_LODS = 4;
+
+struct LodSettings {
+  // largest screen space error in pixels a LOD may show
+  float error_threshold{1.0f};
+  // A coarser LOD must undercut the threshold by this fraction before it is selected, so objects
+  // near the switching distance do not pop back and forth.
+  float hysteresis{0.25f};
+};
+
+struct LodView {
+  glm::vec3 camera_position{0.0f};
+  // pixels per world unit at distance 1
+  float projection_scale{1.0f};
+  LodSettings settings{};
+};
+
+// projection_scale of LodView for a perspective projection, proj[1][1] is cot(fov_y / 2).
+float get_lod_projection_scale(const glm::mat4& proj, float viewport_height);
+
+/// Geometric errors of the LODs of a mesh in world units, LOD 0 is the finest, errors ascend.
+struct LodChain {
+  uint32_t count{1};
+  std::array<float, MAX_LODS> errors{};
+};
+
+// Picks the coarsest LOD whose error projected at distance stays below the threshold, current is
+// the LOD of the previous frame. Mirrors select_lod() in cull.comp.
+uint32_t select_lod(const LodChain& chain, float distance, uint32_t current, const LodView& view);
+}  // namespace zen
+#endif  //ZENENGINE_LOD_HPP
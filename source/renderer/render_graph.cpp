@@ -0,0 +1,1126 @@
+#include "render_graph.hpp"
+#include <algorithm>
+#include "logging.hpp"
+#include "vk_helper/command_buffer.hpp"
+#include "vk_helper/device.hpp"
+
+namespace zen {
+namespace {
+bool is_depth_format(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool has_stencil(VkFormat format) {
+  return format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT ||
+         format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+// Bytes per texel including stencil, good enough to estimate attachment traffic.
+uint32_t texel_size(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_R8_UNORM:
+      return 1;
+    case VK_FORMAT_R8G8_UNORM:
+    case VK_FORMAT_R16_SFLOAT:
+    case VK_FORMAT_D16_UNORM:
+      return 2;
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+      return 3;
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+    case VK_FORMAT_R32G32_SFLOAT:
+      return 8;
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+      return 5;
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+      return 16;
+    default:
+      // 8 bit RGBA/BGRA, 10 bit packed, R32, D24S8, D32
+      return 4;
+  }
+}
+
+constexpr VkPipelineStageFlags2KHR DEPTH_STAGES =
+    VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT_KHR |
+    VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR;
+}  // namespace
+
+RGPass::RGPass(RenderGraph& graph, std::string name, RGPassType type, uint32_t index)
+    : m_graph(graph), m_name(std::move(name)), m_type(type), m_index(index) {}
+
+RGPass& RGPass::add_access(const Access& access) {
+  VK_ASSERT(access.resource.valid() && access.resource.index < m_graph.m_resources.size());
+  auto& resource = m_graph.m_resources[access.resource.index];
+  if (resource.is_image) {
+    switch (access.kind) {
+      case AccessKind::Color:
+        resource.image_usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        break;
+      case AccessKind::Depth:
+      case AccessKind::DepthRead:
+        resource.image_usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        break;
+      case AccessKind::Input:
+        resource.image_usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+        break;
+      case AccessKind::Texture:
+        resource.image_usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+        break;
+      case AccessKind::Storage:
+        resource.image_usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+        break;
+      default:
+        break;
+    }
+  }
+  m_accesses.push_back(access);
+  return *this;
+}
+
+RGPass& RGPass::add_color_output(RGResourceHandle image, std::optional<VkClearColorValue> clear) {
+  VK_ASSERT(m_type == RGPassType::Graphics);
+  std::optional<VkClearValue> clear_value;
+  VkAccessFlags2KHR access = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR;
+  if (clear) {
+    clear_value = VkClearValue{.color = *clear};
+  } else {
+    access |= VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT_KHR;
+  }
+  return add_access({image, AccessKind::Color, true,
+                     VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, access,
+                     VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, clear_value});
+}
+
+RGPass& RGPass::set_depth_output(RGResourceHandle image,
+                                 std::optional<VkClearDepthStencilValue> clear) {
+  VK_ASSERT(m_type == RGPassType::Graphics);
+  std::optional<VkClearValue> clear_value;
+  if (clear) {
+    clear_value = VkClearValue{.depthStencil = *clear};
+  }
+  return add_access({image, AccessKind::Depth, true, DEPTH_STAGES,
+                     VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT_KHR |
+                         VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR,
+                     VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, clear_value});
+}
+
+RGPass& RGPass::set_depth_input(RGResourceHandle image) {
+  VK_ASSERT(m_type == RGPassType::Graphics);
+  return add_access({image, AccessKind::DepthRead, false, DEPTH_STAGES,
+                     VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT_KHR,
+                     VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, std::nullopt});
+}
+
+RGPass& RGPass::add_input_attachment(RGResourceHandle image) {
+  VK_ASSERT(m_type == RGPassType::Graphics);
+  VK_ASSERT(image.valid() && image.index < m_graph.m_resources.size());
+  const bool depth = is_depth_format(m_graph.m_resources[image.index].image_desc.format);
+  return add_access({image, AccessKind::Input, false, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR,
+                     VK_ACCESS_2_INPUT_ATTACHMENT_READ_BIT_KHR,
+                     depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                           : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                     std::nullopt});
+}
+
+RGPass& RGPass::add_texture_input(RGResourceHandle image, VkPipelineStageFlags2KHR stages) {
+  VK_ASSERT(image.valid() && image.index < m_graph.m_resources.size());
+  const bool depth = is_depth_format(m_graph.m_resources[image.index].image_desc.format);
+  return add_access({image, AccessKind::Texture, false, stages,
+                     VK_ACCESS_2_SHADER_SAMPLED_READ_BIT_KHR,
+                     depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                           : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                     std::nullopt});
+}
+
+RGPass& RGPass::add_storage_image_input(RGResourceHandle image, VkPipelineStageFlags2KHR stages) {
+  return add_access({image, AccessKind::Storage, false, stages,
+                     VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR, VK_IMAGE_LAYOUT_GENERAL,
+                     std::nullopt});
+}
+
+RGPass& RGPass::add_storage_image_output(RGResourceHandle image,
+                                         VkPipelineStageFlags2KHR stages) {
+  return add_access({image, AccessKind::Storage, true, stages,
+                     VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR, VK_IMAGE_LAYOUT_GENERAL,
+                     std::nullopt});
+}
+
+RGPass& RGPass::add_buffer_input(RGResourceHandle buffer, VkPipelineStageFlags2KHR stages,
+                                 VkAccessFlags2KHR access) {
+  return add_access({buffer, AccessKind::Buffer, false, stages, access,
+                     VK_IMAGE_LAYOUT_UNDEFINED, std::nullopt});
+}
+
+RGPass& RGPass::add_buffer_output(RGResourceHandle buffer, VkPipelineStageFlags2KHR stages,
+                                  VkAccessFlags2KHR access) {
+  return add_access({buffer, AccessKind::Buffer, true, stages, access,
+                     VK_IMAGE_LAYOUT_UNDEFINED, std::nullopt});
+}
+
+RGPass& RGPass::set_view_mask(uint32_t view_mask) {
+  VK_ASSERT(m_type == RGPassType::Graphics);
+  VK_ASSERT(m_graph.m_device.get_features().supports_multiview || view_mask == 0);
+  m_view_mask = view_mask;
+  return *this;
+}
+
+RGPass& RGPass::set_side_effects() {
+  m_side_effects = true;
+  return *this;
+}
+
+RGPass& RGPass::set_secondary_command_buffers() {
+  VK_ASSERT(m_type == RGPassType::Graphics);
+  m_secondary_contents = true;
+  return *this;
+}
+
+RGPass& RGPass::set_execute(ExecuteFunc func) {
+  m_execute = std::move(func);
+  return *this;
+}
+
+RenderGraph::RenderGraph(const vkh::Device& device, uint32_t frames_in_flight,
+                         uint32_t swapchain_image_count)
+    : m_device(device),
+      m_tracker(device),
+      m_render_pass_cache(device),
+      m_framebuffer_cache(device, frames_in_flight + swapchain_image_count) {}
+
+RenderGraph::~RenderGraph() {
+  reset();
+  collect_retired(true);
+}
+
+void RenderGraph::set_dynamic_rendering(bool enable) {
+  VK_ASSERT(!m_compiled);
+  m_use_dynamic_rendering = enable && m_device.get_features().supports_dynamic_rendering;
+  if (enable && !m_use_dynamic_rendering) {
+    logger::warn("Dynamic rendering is not supported, using render passes");
+  }
+}
+
+RGResourceHandle RenderGraph::create_image(const std::string& name, const RGImageDesc& desc) {
+  VK_ASSERT(!m_compiled);
+  Resource resource{};
+  resource.name       = name;
+  resource.image_desc = desc;
+  resource.aspect     = VK_IMAGE_ASPECT_COLOR_BIT;
+  if (is_depth_format(desc.format)) {
+    resource.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (has_stencil(desc.format)) {
+      resource.aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+  }
+  m_resources.push_back(std::move(resource));
+  return {static_cast<uint32_t>(m_resources.size() - 1)};
+}
+
+RGResourceHandle RenderGraph::create_buffer(const std::string& name, const RGBufferDesc& desc) {
+  VK_ASSERT(!m_compiled);
+  Resource resource{};
+  resource.name        = name;
+  resource.is_image    = false;
+  resource.buffer_desc = desc;
+  m_resources.push_back(std::move(resource));
+  return {static_cast<uint32_t>(m_resources.size() - 1)};
+}
+
+RGResourceHandle RenderGraph::import_image(const std::string& name, const RGImageDesc& desc,
+                                           VkImageLayout final_layout,
+                                           VkPipelineStageFlags2KHR ready_stages) {
+  auto handle           = create_image(name, desc);
+  auto& resource        = m_resources[handle.index];
+  resource.imported     = true;
+  resource.final_layout = final_layout;
+  resource.ready_stages = ready_stages;
+  return handle;
+}
+
+RGResourceHandle RenderGraph::import_buffer(const std::string& name, VkBuffer buffer) {
+  auto handle       = create_buffer(name, {});
+  auto& resource    = m_resources[handle.index];
+  resource.imported = true;
+  resource.buffer   = buffer;
+  return handle;
+}
+
+void RenderGraph::set_imported_image(RGResourceHandle handle, VkImage image, VkImageView view,
+                                     VkImageLayout current_layout) {
+  auto& resource = m_resources[handle.index];
+  VK_ASSERT(resource.imported && resource.is_image);
+  resource.image = image;
+  resource.view  = view;
+  if (std::find(resource.imported_views.begin(), resource.imported_views.end(), view) ==
+      resource.imported_views.end()) {
+    resource.imported_views.push_back(view);
+  }
+  // the tracker cannot know what happened to the image outside of the graph
+  m_tracker.register_image(image, resource.aspect, resource.image_desc.mip_levels,
+                           resource.image_desc.layer_count, current_layout);
+  m_tracker.assume_image_access(image, full_range(resource), current_layout,
+                                resource.ready_stages, VK_ACCESS_2_NONE_KHR);
+}
+
+void RenderGraph::mark_output(RGResourceHandle handle) {
+  m_resources[handle.index].output = true;
+}
+
+RGPass& RenderGraph::add_pass(const std::string& name, RGPassType type) {
+  VK_ASSERT(!m_compiled);
+  const auto index = static_cast<uint32_t>(m_passes.size());
+  m_passes.emplace_back(new RGPass(*this, name, type, index));
+  return *m_passes.back();
+}
+
+bool RenderGraph::compile() {
+  if (m_render_extent.width == 0 || m_render_extent.height == 0) {
+    logger::error("Render graph has no render extent");
+    return false;
+  }
+  collect_retired(false);
+  m_stats                 = {};
+  m_stats.declared_passes = static_cast<uint32_t>(m_passes.size());
+
+  // every read needs an earlier writer or an imported resource
+  std::vector<bool> written(m_resources.size(), false);
+  for (const auto& pass : m_passes) {
+    for (const auto& access : pass->m_accesses) {
+      const auto& resource = m_resources[access.resource.index];
+      if (!access.write && !resource.imported && !written[access.resource.index]) {
+        logger::error("Pass {} reads {} before it is written", pass->m_name, resource.name);
+        return false;
+      }
+    }
+    for (const auto& access : pass->m_accesses) {
+      written[access.resource.index] = written[access.resource.index] || access.write;
+    }
+  }
+
+  cull_passes();
+  build_steps();
+  create_transient_resources();
+  for (auto& step : m_steps) {
+    if (!step.is_render_pass) {
+      continue;
+    }
+    const auto& pass     = *m_passes[step.passes.front()];
+    const bool has_input = std::any_of(
+        pass.m_accesses.begin(), pass.m_accesses.end(),
+        [](const RGPass::Access& a) { return a.kind == RGPass::AccessKind::Input; });
+    if (m_use_dynamic_rendering && step.passes.size() == 1 && !has_input) {
+      setup_dynamic_rendering(step);
+    } else {
+      create_render_pass(step);
+    }
+  }
+  m_compiled = true;
+  logger::info("Render graph: {} passes, {} culled, {} render passes, {} dynamic rendering "
+               "passes, {} transient images ({} tile local) using {} KiB ({} KiB without "
+               "aliasing), attachments load {} KiB and store {} KiB per frame",
+               m_stats.declared_passes, m_stats.culled_passes, m_stats.render_passes,
+               m_stats.dynamic_rendering_passes, m_stats.transient_images,
+               m_stats.tile_local_images, m_stats.transient_memory / 1024,
+               m_stats.unaliased_memory / 1024, m_stats.attachment_load_bytes / 1024,
+               m_stats.attachment_store_bytes / 1024);
+  return true;
+}
+
+void RenderGraph::cull_passes() {
+  std::vector<bool> needed(m_resources.size(), false);
+  for (uint32_t i = 0; i < m_resources.size(); i++) {
+    needed[i] = m_resources[i].imported || m_resources[i].output;
+  }
+  m_pass_alive.assign(m_passes.size(), false);
+  for (auto it = m_passes.rbegin(); it != m_passes.rend(); ++it) {
+    const auto& pass = **it;
+    bool alive       = pass.m_side_effects;
+    for (const auto& access : pass.m_accesses) {
+      alive = alive || (access.write && needed[access.resource.index]);
+    }
+    if (!alive) {
+      m_stats.culled_passes++;
+      continue;
+    }
+    m_pass_alive[pass.m_index] = true;
+    for (const auto& access : pass.m_accesses) {
+      // attachments which are not cleared load the previous contents
+      const bool loads = !access.write || (pass.is_attachment(access) && !access.clear);
+      if (loads) {
+        needed[access.resource.index] = true;
+      }
+    }
+  }
+}
+
+bool RenderGraph::can_merge(const Step& step, const RGPass& pass) const {
+  const auto& first_pass = *m_passes[step.passes.front()];
+  const auto extent_of   = [&](const RGPass& p) -> std::optional<VkExtent2D> {
+    for (const auto& access : p.m_accesses) {
+      if (p.is_attachment(access)) {
+        const auto& desc = m_resources[access.resource.index].image_desc;
+        return desc.extent.width == 0 ? m_render_extent : desc.extent;
+      }
+    }
+    return std::nullopt;
+  };
+  const auto samples_of = [&](const RGPass& p) {
+    for (const auto& access : p.m_accesses) {
+      if (p.is_attachment(access) && access.kind != RGPass::AccessKind::Input) {
+        return m_resources[access.resource.index].image_desc.samples;
+      }
+    }
+    return VK_SAMPLE_COUNT_1_BIT;
+  };
+  const auto depth_of = [&](const RGPass& p) -> uint32_t {
+    for (const auto& access : p.m_accesses) {
+      if (access.kind == RGPass::AccessKind::Depth ||
+          access.kind == RGPass::AccessKind::DepthRead) {
+        return access.resource.index;
+      }
+    }
+    return ~0u;
+  };
+
+  const bool reads_input_attachments =
+      std::any_of(pass.m_accesses.begin(), pass.m_accesses.end(), [](const RGPass::Access& a) {
+        return a.kind == RGPass::AccessKind::Input;
+      });
+  // without subpass inputs a separate dynamic rendering instance is as good as a subpass
+  if (m_use_dynamic_rendering && !reads_input_attachments) {
+    return false;
+  }
+  const auto a = extent_of(first_pass);
+  const auto b = extent_of(pass);
+  if (!a || !b || a->width != b->width || a->height != b->height ||
+      samples_of(first_pass) != samples_of(pass) || first_pass.m_view_mask != pass.m_view_mask) {
+    return false;
+  }
+  const uint32_t depth = depth_of(pass);
+  for (uint32_t index : step.passes) {
+    const auto& other = *m_passes[index];
+    const uint32_t other_depth = depth_of(other);
+    if (depth != ~0u && other_depth != ~0u && depth != other_depth) {
+      return false;
+    }
+    // Only attachment to attachment dependencies can be expressed with subpass dependencies,
+    // everything else needs a barrier outside of the render pass.
+    for (const auto& access : pass.m_accesses) {
+      for (const auto& other_access : other.m_accesses) {
+        if (access.resource.index != other_access.resource.index) {
+          continue;
+        }
+        const bool both_attachments =
+            pass.is_attachment(access) && other.is_attachment(other_access);
+        if (!both_attachments && (access.write || other_access.write)) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+void RenderGraph::build_steps() {
+  m_steps.clear();
+  for (uint32_t i = 0; i < m_passes.size(); i++) {
+    if (!m_pass_alive[i]) {
+      continue;
+    }
+    const auto& pass = *m_passes[i];
+    const bool has_attachments =
+        std::any_of(pass.m_accesses.begin(), pass.m_accesses.end(),
+                    [&](const RGPass::Access& access) { return pass.is_attachment(access); });
+    const bool is_render_pass = pass.m_type == RGPassType::Graphics && has_attachments;
+    if (is_render_pass && !m_steps.empty() && m_steps.back().is_render_pass &&
+        can_merge(m_steps.back(), pass)) {
+      m_steps.back().passes.push_back(i);
+      continue;
+    }
+    Step step{};
+    step.passes         = {i};
+    step.is_render_pass = is_render_pass;
+    step.view_mask      = pass.m_view_mask;
+    m_steps.push_back(std::move(step));
+  }
+
+  for (uint32_t s = 0; s < m_steps.size(); s++) {
+    for (uint32_t index : m_steps[s].passes) {
+      for (const auto& access : m_passes[index]->m_accesses) {
+        auto& resource      = m_resources[access.resource.index];
+        resource.first_step = std::min(resource.first_step, s);
+        resource.last_step  = std::max(resource.last_step, s);
+      }
+    }
+  }
+}
+
+void RenderGraph::create_render_pass(Step& step) {
+  struct AttachmentUse {
+    uint32_t subpass;
+    const RGPass::Access* access;
+  };
+  std::vector<std::vector<AttachmentUse>> uses;
+  for (uint32_t subpass = 0; subpass < step.passes.size(); subpass++) {
+    const auto& pass = *m_passes[step.passes[subpass]];
+    for (const auto& access : pass.m_accesses) {
+      if (!pass.is_attachment(access)) {
+        continue;
+      }
+      auto it = std::find(step.attachments.begin(), step.attachments.end(),
+                          access.resource.index);
+      if (it == step.attachments.end()) {
+        step.attachments.push_back(access.resource.index);
+        uses.emplace_back();
+        it = step.attachments.end() - 1;
+      }
+      uses[it - step.attachments.begin()].push_back({subpass, &access});
+    }
+  }
+
+  const auto step_index = static_cast<uint32_t>(&step - m_steps.data());
+  std::vector<VkAttachmentDescription> attachments;
+  for (uint32_t a = 0; a < step.attachments.size(); a++) {
+    const auto& resource = m_resources[step.attachments[a]];
+    const auto& first    = *uses[a].front().access;
+    const auto& last     = *uses[a].back().access;
+    const auto usage     = get_attachment_usage(resource, step_index, first);
+    const auto load_op   = vkh::infer_load_op(usage);
+    const auto store_op  = vkh::infer_store_op(usage);
+    const bool stencil   = has_stencil(resource.image_desc.format);
+    attachments.push_back({
+        .format         = resource.image_desc.format,
+        .samples        = resource.image_desc.samples,
+        .loadOp         = load_op,
+        .storeOp        = store_op,
+        .stencilLoadOp  = stencil ? load_op : VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .stencilStoreOp = stencil ? store_op : VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        // the tracker transitions to the first layout before the render pass begins
+        .initialLayout = first.layout,
+        .finalLayout   = last.layout,
+    });
+    step.clear_values.push_back(first.clear.value_or(VkClearValue{}));
+    step.load_ops.push_back(load_op);
+    step.store_ops.push_back(store_op);
+    step.final_layouts.push_back(last.layout);
+    step.final_stages.push_back(last.stages);
+    step.final_access.push_back(last.access);
+  }
+
+  const auto subpass_count = static_cast<uint32_t>(step.passes.size());
+  std::vector<std::vector<VkAttachmentReference>> color_refs(subpass_count);
+  std::vector<std::vector<VkAttachmentReference>> input_refs(subpass_count);
+  std::vector<VkAttachmentReference> depth_refs(subpass_count,
+                                                {VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED});
+  std::vector<std::vector<uint32_t>> preserve_refs(subpass_count);
+  // references keep the declaration order of the pass, it maps to the fragment shader output
+  // locations and input attachment indices
+  for (uint32_t subpass = 0; subpass < subpass_count; subpass++) {
+    const auto& pass = *m_passes[step.passes[subpass]];
+    for (const auto& access : pass.m_accesses) {
+      if (!pass.is_attachment(access)) {
+        continue;
+      }
+      const auto a = static_cast<uint32_t>(
+          std::find(step.attachments.begin(), step.attachments.end(), access.resource.index) -
+          step.attachments.begin());
+      const VkAttachmentReference ref{a, access.layout};
+      switch (access.kind) {
+        case RGPass::AccessKind::Color:
+          color_refs[subpass].push_back(ref);
+          break;
+        case RGPass::AccessKind::Depth:
+        case RGPass::AccessKind::DepthRead:
+          depth_refs[subpass] = ref;
+          break;
+        default:
+          input_refs[subpass].push_back(ref);
+          break;
+      }
+    }
+  }
+  for (uint32_t a = 0; a < step.attachments.size(); a++) {
+    // contents used by a later subpass have to survive the ones in between
+    const uint32_t first_subpass = uses[a].front().subpass;
+    const uint32_t last_subpass  = uses[a].back().subpass;
+    for (uint32_t subpass = first_subpass + 1; subpass < last_subpass; subpass++) {
+      const bool used = std::any_of(uses[a].begin(), uses[a].end(),
+                                    [&](const AttachmentUse& u) { return u.subpass == subpass; });
+      if (!used) {
+        preserve_refs[subpass].push_back(a);
+      }
+    }
+  }
+
+  std::vector<VkSubpassDescription> subpasses(subpass_count);
+  for (uint32_t i = 0; i < subpass_count; i++) {
+    subpasses[i] = {
+        .pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .inputAttachmentCount    = static_cast<uint32_t>(input_refs[i].size()),
+        .pInputAttachments       = input_refs[i].data(),
+        .colorAttachmentCount    = static_cast<uint32_t>(color_refs[i].size()),
+        .pColorAttachments       = color_refs[i].data(),
+        .pDepthStencilAttachment = depth_refs[i].attachment == VK_ATTACHMENT_UNUSED
+                                       ? nullptr
+                                       : &depth_refs[i],
+        .preserveAttachmentCount = static_cast<uint32_t>(preserve_refs[i].size()),
+        .pPreserveAttachments    = preserve_refs[i].data(),
+    };
+  }
+
+  // Attachment dependencies between subpasses are per pixel, BY_REGION lets tilers keep the
+  // data on chip.
+  std::vector<VkSubpassDependency> dependencies;
+  for (uint32_t a = 0; a < step.attachments.size(); a++) {
+    for (size_t j = 1; j < uses[a].size(); j++) {
+      const auto& src = uses[a][j - 1];
+      const auto& dst = uses[a][j];
+      if (src.subpass == dst.subpass || (!src.access->write && !dst.access->write)) {
+        continue;
+      }
+      dependencies.push_back({
+          .srcSubpass      = src.subpass,
+          .dstSubpass      = dst.subpass,
+          .srcStageMask    = static_cast<VkPipelineStageFlags>(src.access->stages),
+          .dstStageMask    = static_cast<VkPipelineStageFlags>(dst.access->stages),
+          .srcAccessMask   = static_cast<VkAccessFlags>(src.access->access),
+          .dstAccessMask   = static_cast<VkAccessFlags>(dst.access->access),
+          .dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT,
+      });
+    }
+  }
+
+  // merged passes share the view mask
+  const std::vector<uint32_t> view_masks(subpass_count, step.view_mask);
+  const VkRenderPassMultiviewCreateInfo multiview_ci = {
+      .sType        = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO,
+      .subpassCount = subpass_count,
+      .pViewMasks   = view_masks.data(),
+  };
+  const VkRenderPassCreateInfo render_pass_ci = {
+      .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+      .pNext           = step.view_mask != 0 ? &multiview_ci : nullptr,
+      .attachmentCount = static_cast<uint32_t>(attachments.size()),
+      .pAttachments    = attachments.data(),
+      .subpassCount    = subpass_count,
+      .pSubpasses      = subpasses.data(),
+      .dependencyCount = static_cast<uint32_t>(dependencies.size()),
+      .pDependencies   = dependencies.data(),
+  };
+  std::string name;
+  for (uint32_t index : step.passes) {
+    name += (name.empty() ? "" : "+") + m_passes[index]->m_name;
+  }
+  step.render_pass = m_render_pass_cache.get_or_create(render_pass_ci, name);
+
+  const auto& desc = m_resources[step.attachments.front()].image_desc;
+  step.extent      = desc.extent.width == 0 ? m_render_extent : desc.extent;
+  count_attachment_traffic(step);
+  m_stats.render_passes++;
+}
+
+void RenderGraph::setup_dynamic_rendering(Step& step) {
+  step.dynamic_rendering      = true;
+  const auto step_index       = static_cast<uint32_t>(&step - m_steps.data());
+  const auto& pass            = *m_passes[step.passes.front()];
+  const RGPass::Access* depth = nullptr;
+  VkFormat depth_format       = VK_FORMAT_UNDEFINED;
+  const auto add_attachment   = [&](const RGPass::Access& access) {
+    const auto& resource = m_resources[access.resource.index];
+    const auto usage     = get_attachment_usage(resource, step_index, access);
+    step.attachments.push_back(access.resource.index);
+    step.clear_values.push_back(access.clear.value_or(VkClearValue{}));
+    step.load_ops.push_back(vkh::infer_load_op(usage));
+    step.store_ops.push_back(vkh::infer_store_op(usage));
+  };
+  for (const auto& access : pass.m_accesses) {
+    const auto& resource = m_resources[access.resource.index];
+    if (access.kind == RGPass::AccessKind::Color) {
+      add_attachment(access);
+      step.color_formats.push_back(resource.image_desc.format);
+    } else if (access.kind == RGPass::AccessKind::Depth ||
+               access.kind == RGPass::AccessKind::DepthRead) {
+      depth        = &access;
+      depth_format = resource.image_desc.format;
+    }
+  }
+  // the depth attachment always goes last
+  if (depth != nullptr) {
+    add_attachment(*depth);
+  }
+  step.rendering_info = {
+      .sType                   = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR,
+      .viewMask                = step.view_mask,
+      .colorAttachmentCount    = static_cast<uint32_t>(step.color_formats.size()),
+      .pColorAttachmentFormats = step.color_formats.data(),
+      .depthAttachmentFormat   = depth_format,
+      .stencilAttachmentFormat = has_stencil(depth_format) ? depth_format : VK_FORMAT_UNDEFINED,
+  };
+  const auto& desc = m_resources[step.attachments.front()].image_desc;
+  // the secondary contents flag of the rendering info is not repeated here
+  step.inheritance_rendering = {
+      .sType                   = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR,
+      .viewMask                = step.view_mask,
+      .colorAttachmentCount    = step.rendering_info.colorAttachmentCount,
+      .pColorAttachmentFormats = step.color_formats.data(),
+      .depthAttachmentFormat   = step.rendering_info.depthAttachmentFormat,
+      .stencilAttachmentFormat = step.rendering_info.stencilAttachmentFormat,
+      .rasterizationSamples    = desc.samples,
+  };
+  step.extent = desc.extent.width == 0 ? m_render_extent : desc.extent;
+  count_attachment_traffic(step);
+  m_stats.dynamic_rendering_passes++;
+}
+
+vkh::AttachmentUsage RenderGraph::get_attachment_usage(const Resource& resource,
+                                                       uint32_t step_index,
+                                                       const RGPass::Access& first_access) const {
+  return {
+      // imported images hold what was rendered outside of the graph, transient ones are
+      // undefined until their first step
+      .reads_previous_contents = resource.imported || resource.first_step < step_index,
+      .full_overwrite          = first_access.clear.has_value(),
+      .read_later = resource.imported || resource.output || resource.last_step > step_index,
+  };
+}
+
+void RenderGraph::count_attachment_traffic(const Step& step) {
+  for (uint32_t a = 0; a < step.attachments.size(); a++) {
+    const auto& desc         = m_resources[step.attachments[a]].image_desc;
+    const VkExtent2D extent  = desc.extent.width == 0 ? m_render_extent : desc.extent;
+    const VkDeviceSize bytes = VkDeviceSize(extent.width) * extent.height * desc.layer_count *
+                               desc.samples * texel_size(desc.format);
+    if (step.load_ops[a] == VK_ATTACHMENT_LOAD_OP_LOAD) {
+      m_stats.attachment_load_bytes += bytes;
+    }
+    if (step.store_ops[a] == VK_ATTACHMENT_STORE_OP_STORE) {
+      m_stats.attachment_store_bytes += bytes;
+    }
+  }
+}
+
+void RenderGraph::begin_dynamic_rendering(const vkh::CommandBuffer& cmd, const Step& step) const {
+  const auto& pass = *m_passes[step.passes.front()];
+  std::vector<VkRenderingAttachmentInfoKHR> color_attachments;
+  VkRenderingAttachmentInfoKHR depth_attachment{VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR};
+  bool has_depth              = false;
+  bool has_stencil_attachment = false;
+  for (const auto& access : pass.m_accesses) {
+    if (access.kind != RGPass::AccessKind::Color && access.kind != RGPass::AccessKind::Depth &&
+        access.kind != RGPass::AccessKind::DepthRead) {
+      continue;
+    }
+    const auto& resource = m_resources[access.resource.index];
+    const auto a         = static_cast<uint32_t>(
+        std::find(step.attachments.begin(), step.attachments.end(), access.resource.index) -
+        step.attachments.begin());
+    const VkRenderingAttachmentInfoKHR attachment = {
+        .sType       = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+        .imageView   = resource.view,
+        .imageLayout = access.layout,
+        .loadOp      = step.load_ops[a],
+        .storeOp     = step.store_ops[a],
+        .clearValue  = access.clear.value_or(VkClearValue{}),
+    };
+    if (access.kind == RGPass::AccessKind::Color) {
+      color_attachments.push_back(attachment);
+    } else {
+      depth_attachment       = attachment;
+      has_depth              = true;
+      has_stencil_attachment = has_stencil(resource.image_desc.format);
+    }
+  }
+  // with multiview the layers come from the view mask
+  const uint32_t layer_count =
+      step.view_mask != 0 ? 1 : m_resources[step.attachments.front()].image_desc.layer_count;
+  const VkRenderingFlagsKHR flags =
+      pass.m_secondary_contents ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR : 0;
+  const VkRenderingInfoKHR rendering_info = {
+      .sType                = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
+      .flags                = flags,
+      .renderArea           = {.offset = {0, 0}, .extent = step.extent},
+      .layerCount           = layer_count,
+      .viewMask             = step.view_mask,
+      .colorAttachmentCount = static_cast<uint32_t>(color_attachments.size()),
+      .pColorAttachments    = color_attachments.data(),
+      .pDepthAttachment     = has_depth ? &depth_attachment : nullptr,
+      .pStencilAttachment   = has_stencil_attachment ? &depth_attachment : nullptr,
+  };
+  cmd.begin_rendering(rendering_info);
+}
+
+void RenderGraph::create_transient_resources() {
+  struct MemoryBlock {
+    VkMemoryRequirements requirements;
+    bool lazy;
+    std::vector<uint32_t> resources;
+  };
+  std::vector<MemoryBlock> blocks;
+  std::vector<std::pair<uint32_t, VkMemoryRequirements>> images;
+
+  for (uint32_t i = 0; i < m_resources.size(); i++) {
+    auto& resource = m_resources[i];
+    if (resource.imported || resource.first_step == ~0u) {
+      continue;
+    }
+    if (!resource.is_image) {
+      resource.owned_buffer = std::make_unique<vkh::Buffer>(
+          m_device, resource.name, resource.buffer_desc.size, resource.buffer_desc.usage, 0);
+      resource.buffer = resource.owned_buffer->handle();
+      continue;
+    }
+    resource.tile_local = is_tile_local(resource);
+    if (resource.tile_local) {
+      resource.image_usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+      m_stats.tile_local_images++;
+    }
+    const auto& desc        = resource.image_desc;
+    const VkExtent2D extent = desc.extent.width == 0 ? m_render_extent : desc.extent;
+    const VkImageCreateInfo image_ci = {
+        .sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType     = VK_IMAGE_TYPE_2D,
+        .format        = desc.format,
+        .extent        = {extent.width, extent.height, 1},
+        .mipLevels     = desc.mip_levels,
+        .arrayLayers   = desc.layer_count,
+        .samples       = desc.samples,
+        .tiling        = VK_IMAGE_TILING_OPTIMAL,
+        .usage         = resource.image_usage,
+        .sharingMode   = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    m_device.create_image(image_ci, &resource.image, resource.name);
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(m_device.handle(), resource.image, &requirements);
+    images.emplace_back(i, requirements);
+    m_stats.transient_images++;
+    m_stats.unaliased_memory += requirements.size;
+  }
+
+  // Greedy first fit, largest images first: an image may share a block with the images whose
+  // step ranges do not overlap its own.
+  std::sort(images.begin(), images.end(),
+            [](const auto& a, const auto& b) { return a.second.size > b.second.size; });
+  for (const auto& [index, requirements] : images) {
+    const auto& resource = m_resources[index];
+    MemoryBlock* target  = nullptr;
+    for (auto& block : blocks) {
+      if ((block.requirements.memoryTypeBits & requirements.memoryTypeBits) == 0 ||
+          block.lazy != resource.tile_local) {
+        continue;
+      }
+      const bool overlaps =
+          std::any_of(block.resources.begin(), block.resources.end(), [&](uint32_t other) {
+            const auto& o = m_resources[other];
+            return resource.first_step <= o.last_step && o.first_step <= resource.last_step;
+          });
+      if (!overlaps) {
+        target = &block;
+        break;
+      }
+    }
+    if (target == nullptr) {
+      blocks.push_back({requirements, resource.tile_local, {}});
+      target = &blocks.back();
+    }
+    target->requirements.size = std::max(target->requirements.size, requirements.size);
+    target->requirements.alignment =
+        std::max(target->requirements.alignment, requirements.alignment);
+    target->requirements.memoryTypeBits &= requirements.memoryTypeBits;
+    target->resources.push_back(index);
+  }
+
+  for (auto& block : blocks) {
+    VmaAllocationCreateInfo alloc_ci{};
+    alloc_ci.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    if (block.lazy) {
+      // tilers back lazily allocated memory only if the attachment ever leaves tile memory
+      alloc_ci.preferredFlags = VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+    }
+    VmaAllocation allocation{VK_NULL_HANDLE};
+    VK_CHECK(vmaAllocateMemory(m_device.get_allocator(), &block.requirements, &alloc_ci,
+                               &allocation, nullptr),
+             "vmaAllocateMemory");
+    m_image_memory.push_back(allocation);
+    m_stats.transient_memory += block.requirements.size;
+
+    // the image used right before in the same memory has to be done before the next starts
+    std::sort(block.resources.begin(), block.resources.end(), [&](uint32_t a, uint32_t b) {
+      return m_resources[a].first_step < m_resources[b].first_step;
+    });
+    for (size_t i = 0; i < block.resources.size(); i++) {
+      auto& resource = m_resources[block.resources[i]];
+      vmaBindImageMemory(m_device.get_allocator(), allocation, resource.image);
+      // the first image follows the last one of the previous frame
+      if (block.resources.size() > 1) {
+        resource.alias_predecessor = block.resources[(i + block.resources.size() - 1) %
+                                                     block.resources.size()];
+      }
+      const VkImageViewCreateInfo view_ci = {
+          .sType            = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+          .image            = resource.image,
+          .viewType         = resource.image_desc.layer_count == 1 ? VK_IMAGE_VIEW_TYPE_2D
+                                                                   : VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+          .format           = resource.image_desc.format,
+          .subresourceRange = full_range(resource),
+      };
+      m_device.create_image_view(view_ci, &resource.view, resource.name);
+      m_tracker.register_image(resource.image, resource.aspect, resource.image_desc.mip_levels,
+                               resource.image_desc.layer_count, VK_IMAGE_LAYOUT_UNDEFINED);
+    }
+  }
+}
+
+bool RenderGraph::is_tile_local(const Resource& resource) const {
+  constexpr VkImageUsageFlags attachment_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                                 VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                                                 VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+  return resource.is_image && !resource.imported && !resource.output &&
+         resource.first_step == resource.last_step && m_steps[resource.first_step].is_render_pass &&
+         (resource.image_usage & ~attachment_usage) == 0;
+}
+
+VkImageSubresourceRange RenderGraph::full_range(const Resource& resource) const {
+  return {resource.aspect, 0, resource.image_desc.mip_levels, 0,
+          resource.image_desc.layer_count};
+}
+
+VkFramebuffer RenderGraph::get_framebuffer(const Step& step) {
+  std::vector<vkh::FramebufferAttachment> attachments;
+  attachments.reserve(step.attachments.size());
+  for (uint32_t index : step.attachments) {
+    const auto& resource = m_resources[index];
+    const auto& desc     = resource.image_desc;
+    attachments.push_back({
+        .view        = resource.view,
+        .format      = desc.format,
+        .usage       = resource.imported && desc.usage != 0 ? desc.usage : resource.image_usage,
+        .extent      = desc.extent.width == 0 ? m_render_extent : desc.extent,
+        .layer_count = desc.layer_count,
+    });
+  }
+  // multiview render passes need framebuffers with a single layer
+  const auto& desc = m_resources[step.attachments.front()].image_desc;
+  return m_framebuffer_cache.get_or_create(step.render_pass, attachments, step.extent,
+                                           step.view_mask != 0 ? 1 : desc.layer_count);
+}
+
+void RenderGraph::request_step_accesses(const Step& step) {
+  const auto step_index = static_cast<uint32_t>(&step - m_steps.data());
+  std::vector<bool> requested(m_resources.size(), false);
+  std::vector<bool> aliased(m_resources.size(), false);
+  for (uint32_t index : step.passes) {
+    const auto& pass = *m_passes[index];
+    for (const auto& access : pass.m_accesses) {
+      auto& resource = m_resources[access.resource.index];
+      // inside a render pass only the state at its begin matters, the subpasses and their
+      // dependencies take care of the rest
+      if (step.is_render_pass && pass.is_attachment(access)) {
+        if (requested[access.resource.index]) {
+          continue;
+        }
+        requested[access.resource.index] = true;
+      }
+      if (!resource.is_image) {
+        m_tracker.request_buffer_access(resource.buffer, access.stages, access.access);
+        continue;
+      }
+      const bool first_use = resource.first_step == step_index;
+      if (first_use && resource.alias_predecessor != ~0u && !aliased[access.resource.index]) {
+        // The memory still belongs to the previous image until its last users finished, the
+        // discarding transition below waits on them. A separate barrier would not order the
+        // transition after them.
+        aliased[access.resource.index] = true;
+        m_tracker.alias_image(resource.image, m_resources[resource.alias_predecessor].image);
+      }
+      // transient contents never survive a frame and cleared ones are overwritten anyway
+      const bool discard = first_use && access.write && (!resource.imported || access.clear);
+      m_tracker.request_image_access(resource.image, full_range(resource), access.layout,
+                                     access.stages, access.access, discard);
+    }
+  }
+}
+
+void RenderGraph::execute(const vkh::CommandBuffer& cmd) {
+  VK_ASSERT(m_compiled);
+  if (!m_retired.empty()) {
+    collect_retired(false);
+  }
+  for (const auto& step : m_steps) {
+    request_step_accesses(step);
+    m_tracker.flush(cmd);
+
+    if (!step.is_render_pass) {
+      const auto& pass = *m_passes[step.passes.front()];
+      if (pass.m_execute) {
+        pass.m_execute({cmd, *this, VK_NULL_HANDLE, 0, nullptr, m_render_extent});
+      }
+      continue;
+    }
+
+    if (step.dynamic_rendering) {
+      // attachments stay in the layouts the tracker transitioned them to
+      const auto& pass = *m_passes[step.passes.front()];
+      begin_dynamic_rendering(cmd, step);
+      if (pass.m_execute) {
+        vkh::SecondaryInheritance inheritance{};
+        if (pass.m_secondary_contents) {
+          inheritance.rendering = &step.inheritance_rendering;
+        }
+        pass.m_execute(
+            {cmd, *this, VK_NULL_HANDLE, 0, &step.rendering_info, step.extent, inheritance});
+      }
+      cmd.end_rendering();
+      continue;
+    }
+
+    // imageless framebuffers get the views when the render pass begins
+    std::vector<VkImageView> views;
+    for (uint32_t index : step.attachments) {
+      views.push_back(m_resources[index].view);
+    }
+    const VkRenderPassAttachmentBeginInfoKHR attachment_begin_info = {
+        .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_ATTACHMENT_BEGIN_INFO_KHR,
+        .attachmentCount = static_cast<uint32_t>(views.size()),
+        .pAttachments    = views.data(),
+    };
+    const VkFramebuffer framebuffer        = get_framebuffer(step);
+    const VkRenderPassBeginInfo begin_info = {
+        .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .pNext           = m_framebuffer_cache.is_imageless() ? &attachment_begin_info : nullptr,
+        .renderPass      = step.render_pass,
+        .framebuffer     = framebuffer,
+        .renderArea      = {.offset = {0, 0}, .extent = step.extent},
+        .clearValueCount = static_cast<uint32_t>(step.clear_values.size()),
+        .pClearValues    = step.clear_values.data(),
+    };
+    // the contents are chosen per subpass
+    for (uint32_t subpass = 0; subpass < step.passes.size(); subpass++) {
+      const auto& pass                 = *m_passes[step.passes[subpass]];
+      const VkSubpassContents contents = pass.m_secondary_contents
+                                             ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                                             : VK_SUBPASS_CONTENTS_INLINE;
+      if (subpass == 0) {
+        cmd.begin_render_pass(begin_info, contents);
+      } else {
+        cmd.next_subpass(contents);
+      }
+      if (pass.m_execute) {
+        vkh::SecondaryInheritance inheritance{};
+        if (pass.m_secondary_contents) {
+          inheritance = {step.render_pass, subpass, framebuffer};
+        }
+        pass.m_execute({cmd, *this, step.render_pass, subpass, nullptr, step.extent, inheritance});
+      }
+    }
+    cmd.end_render_pass();
+
+    for (uint32_t a = 0; a < step.attachments.size(); a++) {
+      const auto& resource = m_resources[step.attachments[a]];
+      m_tracker.assume_image_access(resource.image, full_range(resource), step.final_layouts[a],
+                                    step.final_stages[a], step.final_access[a]);
+    }
+  }
+
+  // hand imported images back in the layout their next user expects, e.g. for present
+  for (const auto& resource : m_resources) {
+    if (resource.imported && resource.is_image &&
+        resource.final_layout != VK_IMAGE_LAYOUT_UNDEFINED) {
+      m_tracker.request_image_access(resource.image, full_range(resource), resource.final_layout,
+                                     VK_PIPELINE_STAGE_2_NONE_KHR, VK_ACCESS_2_NONE_KHR);
+    }
+  }
+  m_tracker.flush(cmd);
+  m_framebuffer_cache.next_frame();
+}
+
+void RenderGraph::reset() {
+  m_steps.clear();
+  // everything submitted so far may still use the resources
+  RetiredResources retired{};
+  retired.retire_value = m_device.get_timeline(vkh::QUEUE_INDEX_GRAPHICS).last_submitted_value();
+  for (auto& resource : m_resources) {
+    if (resource.is_image) {
+      m_tracker.forget(resource.image);
+    } else {
+      m_tracker.forget(resource.buffer);
+    }
+    if (resource.imported) {
+      retired.framebuffer_views.insert(retired.framebuffer_views.end(),
+                                       resource.imported_views.begin(),
+                                       resource.imported_views.end());
+      continue;
+    }
+    if (resource.view != VK_NULL_HANDLE) {
+      retired.views.push_back(resource.view);
+      retired.framebuffer_views.push_back(resource.view);
+    }
+    if (resource.image != VK_NULL_HANDLE) {
+      retired.images.push_back(resource.image);
+    }
+    if (resource.owned_buffer) {
+      retired.buffers.push_back(std::move(resource.owned_buffer));
+    }
+  }
+  retired.memory = std::move(m_image_memory);
+  m_image_memory.clear();
+  m_retired.push_back(std::move(retired));
+  m_resources.clear();
+  m_passes.clear();
+  m_pass_alive.clear();
+  m_compiled = false;
+}
+
+void RenderGraph::release(RetiredResources& retired) {
+  // Framebuffers keyed by views must go before a new view may reuse a handle. Frames using them
+  // finished, framebuffers of imported views may outlive the views they reference.
+  for (auto view : retired.framebuffer_views) {
+    m_framebuffer_cache.forget(view);
+  }
+  for (auto view : retired.views) {
+    m_device.destroy_image_view(view);
+  }
+  for (auto image : retired.images) {
+    m_device.destroy_image(image);
+  }
+  for (auto allocation : retired.memory) {
+    vmaFreeMemory(m_device.get_allocator(), allocation);
+  }
+  retired.buffers.clear();
+}
+
+void RenderGraph::collect_retired(bool wait) {
+  const auto& timeline = m_device.get_timeline(vkh::QUEUE_INDEX_GRAPHICS);
+  while (!m_retired.empty()) {
+    auto& retired = m_retired.front();
+    if (wait) {
+      timeline.wait(retired.retire_value);
+    } else if (!timeline.is_complete(retired.retire_value)) {
+      break;
+    }
+    release(retired);
+    m_retired.pop_front();
+  }
+}
+
+VkImage RenderGraph::get_image(RGResourceHandle handle) const {
+  return m_resources[handle.index].image;
+}
+
+VkImageView RenderGraph::get_image_view(RGResourceHandle handle) const {
+  return m_resources[handle.index].view;
+}
+
+VkBuffer RenderGraph::get_buffer(RGResourceHandle handle) const {
+  return m_resources[handle.index].buffer;
+}
+}  // namespace zen
@@ -0,0 +1,311 @@
+#ifndef ZENENGINE_RENDER_GRAPH_HPP
+#define ZENENGINE_RENDER_GRAPH_HPP
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include "vk_helper/base.hpp"
+#include "vk_helper/buffer.hpp"
+#include "vk_helper/framebuffer.hpp"
+#include "vk_helper/parallel_recorder.hpp"
+#include "vk_helper/render_pass.hpp"
+#include "vk_helper/resource_state_tracker.hpp"
+
+namespace zen {
+namespace vkh {
+class CommandBuffer;
+class Device;
+}  // namespace vkh
+class RenderGraph;
+
+struct RGResourceHandle {
+  uint32_t index{~0u};
+  bool valid() const { return index != ~0u; }
+};
+
+struct RGImageDesc {
+  VkFormat format{VK_FORMAT_UNDEFINED};
+  // 0 means the render extent of the graph
+  VkExtent2D extent{0, 0};
+  uint32_t layer_count{1};
+  uint32_t mip_levels{1};
+  VkSampleCountFlagBits samples{VK_SAMPLE_COUNT_1_BIT};
+  // usage an imported image was created with, transient images derive it from their accesses
+  VkImageUsageFlags usage{0};
+};
+
+struct RGBufferDesc {
+  VkDeviceSize size{0};
+  VkBufferUsageFlags usage{0};
+};
+
+enum class RGPassType { Graphics, Compute };
+
+struct RGPassContext {
+  const vkh::CommandBuffer& cmd;
+  const RenderGraph& graph;
+  // the render pass and subpass the pass is recorded in, VK_NULL_HANDLE for compute passes
+  // and passes recorded with dynamic rendering
+  VkRenderPass render_pass;
+  uint32_t subpass;
+  // attachment formats of passes recorded with dynamic rendering, pipelines are built for them
+  const VkPipelineRenderingCreateInfoKHR* rendering_info;
+  VkExtent2D extent;
+  // inherited by the secondary command buffers of passes with set_secondary_command_buffers()
+  vkh::SecondaryInheritance inheritance{};
+};
+
+/// Declares what a pass reads and writes. Passes are created by RenderGraph::add_pass().
+class RGPass {
+public:
+  using ExecuteFunc = std::function<void(const RGPassContext&)>;
+
+  RGPass& add_color_output(RGResourceHandle image,
+                           std::optional<VkClearColorValue> clear = std::nullopt);
+  RGPass& set_depth_output(RGResourceHandle image,
+                           std::optional<VkClearDepthStencilValue> clear = std::nullopt);
+  // read-only depth test
+  RGPass& set_depth_input(RGResourceHandle image);
+  RGPass& add_input_attachment(RGResourceHandle image);
+  RGPass& add_texture_input(
+      RGResourceHandle image,
+      VkPipelineStageFlags2KHR stages = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR);
+  RGPass& add_storage_image_input(
+      RGResourceHandle image,
+      VkPipelineStageFlags2KHR stages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR);
+  RGPass& add_storage_image_output(
+      RGResourceHandle image,
+      VkPipelineStageFlags2KHR stages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR);
+  RGPass& add_buffer_input(RGResourceHandle buffer, VkPipelineStageFlags2KHR stages,
+                           VkAccessFlags2KHR access);
+  RGPass& add_buffer_output(RGResourceHandle buffer, VkPipelineStageFlags2KHR stages,
+                            VkAccessFlags2KHR access);
+  // Renders every layer set in view_mask with multiview, the shaders select their layer with
+  // gl_ViewIndex. All attachments need a layer per view.
+  RGPass& set_view_mask(uint32_t view_mask);
+  // Keeps the pass even if nothing reads its outputs, e.g. for readbacks.
+  RGPass& set_side_effects();
+  // The pass only executes secondary command buffers, e.g. recorded by a vkh::ParallelRecorder
+  // with RGPassContext::inheritance. Its subpass or dynamic rendering instance is begun with
+  // secondary contents, nothing may be recorded inline into RGPassContext::cmd.
+  RGPass& set_secondary_command_buffers();
+  RGPass& set_execute(ExecuteFunc func);
+
+  const std::string& get_name() const { return m_name; }
+  RGPassType get_type() const { return m_type; }
+
+private:
+  friend class RenderGraph;
+
+  enum class AccessKind { Color, Depth, DepthRead, Input, Texture, Storage, Buffer };
+  struct Access {
+    RGResourceHandle resource;
+    AccessKind kind;
+    bool write;
+    VkPipelineStageFlags2KHR stages;
+    VkAccessFlags2KHR access;
+    VkImageLayout layout;
+    std::optional<VkClearValue> clear;
+  };
+
+  RGPass(RenderGraph& graph, std::string name, RGPassType type, uint32_t index);
+  RGPass& add_access(const Access& access);
+  bool is_attachment(const Access& access) const {
+    return access.kind == AccessKind::Color || access.kind == AccessKind::Depth ||
+           access.kind == AccessKind::DepthRead || access.kind == AccessKind::Input;
+  }
+
+  RenderGraph& m_graph;
+  std::string m_name;
+  RGPassType m_type;
+  uint32_t m_index;
+  std::vector<Access> m_accesses;
+  uint32_t m_view_mask{0};
+  bool m_side_effects{false};
+  bool m_secondary_contents{false};
+  ExecuteFunc m_execute;
+};
+
+struct RenderGraphStats {
+  uint32_t declared_passes{0};
+  uint32_t culled_passes{0};
+  uint32_t render_passes{0};  // VkRenderPasses after merging passes into subpasses
+  uint32_t dynamic_rendering_passes{0};
+  uint32_t transient_images{0};
+  // transient images only used as attachments of one render pass, never stored to memory
+  uint32_t tile_local_images{0};
+  VkDeviceSize transient_memory{0};  // memory of transient images after aliasing
+  VkDeviceSize unaliased_memory{0};  // what the transient images would need without aliasing
+  // attachment memory traffic of one execute() caused by load and store ops
+  VkDeviceSize attachment_load_bytes{0};
+  VkDeviceSize attachment_store_bytes{0};
+};
+
+/// Frame graph of passes and the resources they use.
+///
+/// Resources are either transient, created and owned by the graph, or imported. After all
+/// passes are declared, compile():
+/// - culls passes whose outputs are never read, imported and output resources count as read,
+/// - keeps the declaration order of the remaining passes, which has to be a valid execution
+///   order (readers after writers),
+/// - merges consecutive graphics passes with matching attachments into subpasses of one render
+///   pass if the later ones only read earlier results as input attachments,
+/// - creates transient resources, images with disjoint lifetimes share memory. Attachments
+///   which only live within one render pass (e.g. a G-buffer read as input attachments) are
+///   not stored and use lazily allocated memory, so they stay in tile memory on tilers.
+/// execute() then records the passes with the barriers computed by a ResourceStateTracker.
+///
+/// Render passes and framebuffers are cached across reset(), so rebuilding the graph for a new
+/// extent or different imported images mostly hits the caches.
+class RenderGraph {
+public:
+  ZEN_NO_COPY_MOVE(RenderGraph)
+  // Imported swapchain images come back every swapchain_image_count frames, their framebuffers
+  // are kept that long on top of the frames in flight.
+  RenderGraph(const vkh::Device& device, uint32_t frames_in_flight,
+              uint32_t swapchain_image_count);
+  ~RenderGraph();
+
+  void set_render_extent(VkExtent2D extent) { m_render_extent = extent; }
+  // Records passes with VK_KHR_dynamic_rendering if the device supports it. Passes reading
+  // input attachments still need subpasses and keep using render passes. Set before compile().
+  void set_dynamic_rendering(bool enable);
+  bool uses_dynamic_rendering() const { return m_use_dynamic_rendering; }
+  VkExtent2D get_render_extent() const { return m_render_extent; }
+
+  RGResourceHandle create_image(const std::string& name, const RGImageDesc& desc);
+  RGResourceHandle create_buffer(const std::string& name, const RGBufferDesc& desc);
+  // Imported images are bound every frame with set_imported_image(). ready_stages are the
+  // stages a semaphore wait on the image is done by, e.g. the swapchain acquire.
+  RGResourceHandle import_image(
+      const std::string& name, const RGImageDesc& desc, VkImageLayout final_layout,
+      VkPipelineStageFlags2KHR ready_stages = VK_PIPELINE_STAGE_2_NONE_KHR);
+  RGResourceHandle import_buffer(const std::string& name, VkBuffer buffer);
+  void set_imported_image(RGResourceHandle handle, VkImage image, VkImageView view,
+                          VkImageLayout current_layout = VK_IMAGE_LAYOUT_UNDEFINED);
+  // Keeps the passes writing the resource alive.
+  void mark_output(RGResourceHandle handle);
+
+  RGPass& add_pass(const std::string& name, RGPassType type = RGPassType::Graphics);
+
+  bool compile();
+  void execute(const vkh::CommandBuffer& cmd);
+  // Drops passes, resources and compiled state without waiting for the GPU. Transient resources
+  // and framebuffers of imported views are destroyed once the frames using them finished, so the
+  // graph can be rebuilt while frames are in flight, e.g. after a resize. Cached render passes
+  // are kept.
+  void reset();
+
+  VkImage get_image(RGResourceHandle handle) const;
+  VkImageView get_image_view(RGResourceHandle handle) const;
+  VkBuffer get_buffer(RGResourceHandle handle) const;
+  const RenderGraphStats& get_stats() const { return m_stats; }
+  const vkh::BarrierStats& get_barrier_stats() const { return m_tracker.stats(); }
+  const vkh::RenderPassCache& get_render_pass_cache() const { return m_render_pass_cache; }
+  const vkh::FramebufferCache& get_framebuffer_cache() const { return m_framebuffer_cache; }
+
+private:
+  friend class RGPass;
+
+  struct Resource {
+    std::string name;
+    bool is_image{true};
+    bool imported{false};
+    bool output{false};
+    RGImageDesc image_desc{};
+    RGBufferDesc buffer_desc{};
+    VkImageUsageFlags image_usage{0};
+    VkImageLayout final_layout{VK_IMAGE_LAYOUT_UNDEFINED};
+    VkPipelineStageFlags2KHR ready_stages{VK_PIPELINE_STAGE_2_NONE_KHR};
+
+    // physical resources
+    VkImage image{VK_NULL_HANDLE};
+    VkImageView view{VK_NULL_HANDLE};
+    VkImageAspectFlags aspect{VK_IMAGE_ASPECT_COLOR_BIT};
+    VkBuffer buffer{VK_NULL_HANDLE};
+    std::unique_ptr<vkh::Buffer> owned_buffer;
+    // every view bound to an imported image, e.g. one per swapchain image
+    std::vector<VkImageView> imported_views;
+    bool tile_local{false};
+    // The previous image living in the same memory, its users have to finish first. The first
+    // image of a block follows the last one, which used the memory in the previous frame.
+    uint32_t alias_predecessor{~0u};
+
+    // lifetime in steps
+    uint32_t first_step{~0u};
+    uint32_t last_step{0};
+  };
+  // A render pass with one subpass per graphics pass, a single graphics pass recorded with
+  // dynamic rendering, or a single compute pass.
+  struct Step {
+    std::vector<uint32_t> passes;
+    bool is_render_pass{false};
+    bool dynamic_rendering{false};
+    VkRenderPass render_pass{VK_NULL_HANDLE};
+    std::vector<VkFormat> color_formats;
+    VkPipelineRenderingCreateInfoKHR rendering_info{};
+    // the same formats for secondary command buffers
+    VkCommandBufferInheritanceRenderingInfoKHR inheritance_rendering{};
+    VkExtent2D extent{};
+    // multiview mask of the passes, 0 without multiview
+    uint32_t view_mask{0};
+    std::vector<uint32_t> attachments;  // resource indices
+    std::vector<VkClearValue> clear_values;
+    // inferred from the accesses before and after the step
+    std::vector<VkAttachmentLoadOp> load_ops;
+    std::vector<VkAttachmentStoreOp> store_ops;
+    // layout and access of each attachment after the render pass
+    std::vector<VkImageLayout> final_layouts;
+    std::vector<VkPipelineStageFlags2KHR> final_stages;
+    std::vector<VkAccessFlags2KHR> final_access;
+  };
+
+  // Resources of a reset graph, released once the graphics timeline reached retire_value.
+  struct RetiredResources {
+    uint64_t retire_value;
+    std::vector<VkImage> images;
+    std::vector<VkImageView> views;
+    std::vector<VmaAllocation> memory;
+    std::vector<std::unique_ptr<vkh::Buffer>> buffers;
+    // views cached framebuffers may reference, including the ones of imported images
+    std::vector<VkImageView> framebuffer_views;
+  };
+
+  void release(RetiredResources& retired);
+  // Releases retired resources the GPU finished with, all of them if wait is set.
+  void collect_retired(bool wait);
+  void cull_passes();
+  void build_steps();
+  bool can_merge(const Step& step, const RGPass& pass) const;
+  void create_render_pass(Step& step);
+  void setup_dynamic_rendering(Step& step);
+  void begin_dynamic_rendering(const vkh::CommandBuffer& cmd, const Step& step) const;
+  void create_transient_resources();
+  bool is_tile_local(const Resource& resource) const;
+  vkh::AttachmentUsage get_attachment_usage(const Resource& resource, uint32_t step_index,
+                                            const RGPass::Access& first_access) const;
+  void count_attachment_traffic(const Step& step);
+  VkFramebuffer get_framebuffer(const Step& step);
+  void request_step_accesses(const Step& step);
+  VkImageSubresourceRange full_range(const Resource& resource) const;
+
+  const vkh::Device& m_device;
+  vkh::ResourceStateTracker m_tracker;
+  vkh::RenderPassCache m_render_pass_cache;
+  vkh::FramebufferCache m_framebuffer_cache;
+  VkExtent2D m_render_extent{0, 0};
+  bool m_use_dynamic_rendering{false};
+
+  std::vector<Resource> m_resources;
+  std::vector<std::unique_ptr<RGPass>> m_passes;
+  std::vector<bool> m_pass_alive;
+  std::vector<Step> m_steps;
+  std::vector<VmaAllocation> m_image_memory;
+  std::deque<RetiredResources> m_retired;
+  bool m_compiled{false};
+  RenderGraphStats m_stats{};
+};
+}  // namespace zen
+#endif  //ZENENGINE_RENDER_GRAPH_HPP
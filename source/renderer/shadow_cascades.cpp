@@ -0,0 +1,290 @@
+#include "shadow_cascades.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include "logging.hpp"
+#include "vk_helper/command_buffer.hpp"
+#include "vk_helper/device.hpp"
+#include "vk_helper/pipeline.hpp"
+
+namespace zen {
+namespace {
+constexpr VkFormat SHADOW_MAP_FORMAT = VK_FORMAT_D32_SFLOAT;
+constexpr VkImageUsageFlags SHADOW_MAP_USAGE =
+    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+constexpr uint32_t ALL_CASCADES = (1u << SHADOW_CASCADE_COUNT) - 1;
+
+glm::mat4 get_light_proj(const glm::vec3& min, const glm::vec3& max) {
+  // light space looks down -z, the caster side of the box has the larger z
+  return glm::orthoRH_ZO(min.x, max.x, min.y, max.y, -max.z, -min.z);
+}
+}  // namespace
+
+ShadowCascades::ShadowCascades(const vkh::Device& device, uint32_t frames_in_flight,
+                               const ShadowSettings& settings)
+    : m_device(device),
+      m_settings(settings),
+      m_caster_shader(device, "shadow casters"),
+      m_clear_shader(device, "shadow clear"),
+      m_descriptor_layout_cache(device),
+      m_descriptor_allocator(device) {
+  VK_ASSERT(m_settings.cached_cascades < SHADOW_CASCADE_COUNT);
+  if (!m_device.get_features().supports_multiview) {
+    // required by Vulkan 1.1, there is no fallback rendering one pass per cascade
+    logger::error("Multiview is not supported, the shadow cascades cannot be rendered");
+  }
+  m_caster_shader.add_stage("shadow.vert.spv", vkh::ShaderType::Vertex).reflect_layout();
+  m_clear_shader.add_stage("shadow_clear.vert.spv", vkh::ShaderType::Vertex).reflect_layout();
+  m_shadow_map = std::make_unique<vkh::Image>(
+      m_device, vkh::ImageInfo{.format       = SHADOW_MAP_FORMAT,
+                               .image_usage  = SHADOW_MAP_USAGE,
+                               .layer_count  = SHADOW_CASCADE_COUNT,
+                               .image_extent = {m_settings.resolution, m_settings.resolution},
+                               .name         = "shadow cascades"});
+  // hardware 2x2 PCF, everything outside of the cascades is lit
+  const VkSamplerCreateInfo sampler_ci = {
+      .sType         = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+      .magFilter     = VK_FILTER_LINEAR,
+      .minFilter     = VK_FILTER_LINEAR,
+      .mipmapMode    = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+      .addressModeU  = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
+      .addressModeV  = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
+      .addressModeW  = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
+      .compareEnable = VK_TRUE,
+      .compareOp     = VK_COMPARE_OP_LESS_OR_EQUAL,
+      .borderColor   = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE,
+  };
+  m_device.create_sampler(sampler_ci, &m_sampler, "shadow cascades");
+
+  VkDescriptorImageInfo shadow_map_info = {m_sampler, m_shadow_map->get_view(),
+                                           VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+  for (uint32_t i = 0; i < frames_in_flight; i++) {
+    m_uniform_buffers.push_back(std::make_unique<vkh::UniformBuffer>(
+        m_device, "shadow cascades " + std::to_string(i), sizeof(ShadowData)));
+    auto buffer_info = VkDescriptorBufferInfo{m_uniform_buffers[i]->handle(), 0, VK_WHOLE_SIZE};
+    m_render_sets.emplace_back();
+    m_shading_sets.emplace_back();
+    const bool built =
+        vkh::DescriptorBuilder::begin(&m_descriptor_layout_cache, &m_descriptor_allocator)
+            .bind_buffer(0, &buffer_info, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                         VK_SHADER_STAGE_VERTEX_BIT)
+            .build(m_render_sets.back()) &&
+        vkh::DescriptorBuilder::begin(&m_descriptor_layout_cache, &m_descriptor_allocator)
+            .bind_buffer(0, &buffer_info, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                         VK_SHADER_STAGE_FRAGMENT_BIT)
+            .bind_image(1, &shadow_map_info, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                        VK_SHADER_STAGE_FRAGMENT_BIT)
+            .build(m_shading_sets.back());
+    if (!built) {
+      logger::error("Failed to allocate the shadow descriptor sets of frame {}", i);
+    }
+  }
+}
+
+ShadowCascades::~ShadowCascades() {
+  for (VkPipeline pipeline : {m_caster_pipeline, m_clear_pipeline}) {
+    if (pipeline != VK_NULL_HANDLE) {
+      m_device.destroy_pipeline(pipeline);
+    }
+  }
+  m_device.destroy_pipeline_layout(m_caster_shader.get_pipeline_layout());
+  m_device.destroy_pipeline_layout(m_clear_shader.get_pipeline_layout());
+  m_device.destroy_sampler(m_sampler);
+}
+
+void ShadowCascades::set_light(const glm::vec3& direction, const glm::vec3& color) {
+  const glm::vec3 normalized = glm::normalize(direction);
+  m_light_color              = color;
+  if (normalized == m_light_direction && m_cache_valid) {
+    return;
+  }
+  m_light_direction  = normalized;
+  const glm::vec3 up = std::abs(normalized.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f)
+                                                      : glm::vec3(0.0f, 1.0f, 0.0f);
+  m_light_view       = glm::lookAt(glm::vec3(0.0f), normalized, up);
+  m_cache_valid      = false;
+}
+
+void ShadowCascades::invalidate_cache() {
+  m_cache_valid = false;
+}
+
+void ShadowCascades::add_passes(RenderGraph& graph, GpuScene& scene) {
+  m_shadow_map_handle = graph.import_image(
+      "shadow cascades",
+      {.format      = SHADOW_MAP_FORMAT,
+       .extent      = {m_settings.resolution, m_settings.resolution},
+       .layer_count = SHADOW_CASCADE_COUNT,
+       .usage       = SHADOW_MAP_USAGE},
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+      // the shading of the previous frame is the last access
+      VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR);
+  if (m_object_set == VK_NULL_HANDLE) {
+    auto object_info = VkDescriptorBufferInfo{scene.get_object_buffer(), 0, VK_WHOLE_SIZE};
+    vkh::DescriptorBuilder::begin(&m_descriptor_layout_cache, &m_descriptor_allocator)
+        .bind_buffer(0, &object_info, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                     VK_SHADER_STAGE_VERTEX_BIT)
+        .build(m_object_set);
+  }
+  scene.add_shadow_cull_passes(graph, &m_cull_view_proj);
+  // Loads the cascades, the cached ones keep their contents and the others are cleared by
+  // record().
+  auto& pass = graph.add_pass("shadow cascades")
+                   .set_view_mask(ALL_CASCADES)
+                   .set_depth_output(m_shadow_map_handle)
+                   .set_execute([this, &scene](const RGPassContext& ctx) { record(ctx, scene); });
+  scene.declare_draw_inputs(pass, DrawPhase::Shadow);
+}
+
+void ShadowCascades::update(RenderGraph& graph, const ClusterView& view, uint32_t frame_index) {
+  m_frame_index = frame_index;
+  // Every split gets the smallest sphere around its frustum slice, which only depends on the
+  // projection and not the orientation of the camera.
+  const glm::mat4 inv_view    = glm::inverse(view.view);
+  const float tan_squared     = 1.0f / (view.proj[0][0] * view.proj[0][0]) +
+                                1.0f / (view.proj[1][1] * view.proj[1][1]);
+  const float z_near          = view.z_near;
+  const float z_far           = std::min(m_settings.max_distance, view.z_far);
+  const uint32_t first_cached = SHADOW_CASCADE_COUNT - m_settings.cached_cascades;
+  glm::vec3 cull_min{std::numeric_limits<float>::max()};
+  glm::vec3 cull_max{std::numeric_limits<float>::lowest()};
+  float split_near = z_near;
+  m_refresh_mask   = 0;
+  for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+    // practical split scheme
+    const float t         = float(i + 1) / float(SHADOW_CASCADE_COUNT);
+    const float uniform   = z_near + (z_far - z_near) * t;
+    const float log       = z_near * std::pow(z_far / z_near, t);
+    const float split_far = uniform + (log - uniform) * m_settings.split_lambda;
+    // the center along the view direction with equal distance to the near and far corners
+    const float center_depth =
+        std::min(0.5f * (split_near + split_far) * (1.0f + tan_squared), split_far);
+    const glm::vec3 center   = inv_view * glm::vec4(0.0f, 0.0f, -center_depth, 1.0f);
+    float radius             = std::sqrt(split_far * split_far * tan_squared +
+                                         (split_far - center_depth) * (split_far - center_depth));
+    auto& cascade            = m_cascades[i];
+    cascade.split            = split_far;
+    split_near               = split_far;
+    if (i >= first_cached) {
+      const bool covered =
+          m_cache_valid &&
+          glm::distance(center, glm::vec3(cascade.sphere)) + radius <= cascade.sphere.w;
+      if (covered) {
+        continue;
+      }
+      radius *= 1.0f + m_settings.cache_margin;
+    }
+    // a stable radius keeps the texel grid stable
+    radius = std::ceil(radius * 16.0f) / 16.0f;
+    fit_cascade(cascade, glm::vec4(center, radius));
+    m_refresh_mask |= 1u << i;
+    cull_min = glm::min(cull_min, cascade.min);
+    cull_max = glm::max(cull_max, cascade.max);
+  }
+  m_cache_valid = true;
+  if (m_refresh_mask != 0) {
+    m_cull_view_proj = get_light_proj(cull_min, cull_max) * m_light_view;
+  }
+
+  ShadowData data = {
+      .light_direction = glm::vec4(m_light_direction, m_settings.depth_bias),
+      .light_color     = glm::vec4(m_light_color, 0.0f),
+      .refresh_mask    = m_refresh_mask,
+  };
+  for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+    const auto& cascade = m_cascades[i];
+    data.cascades[i]    = get_light_proj(cascade.min, cascade.max) * m_light_view;
+    data.splits[i]      = cascade.split;
+    data.texel_sizes[i] = (cascade.max.x - cascade.min.x) / float(m_settings.resolution);
+  }
+  m_uniform_buffers[frame_index]->update(&data, sizeof(data));
+  // the cached cascades are only valid after the first frame
+  graph.set_imported_image(m_shadow_map_handle, m_shadow_map->handle(), m_shadow_map->get_view(),
+                           m_shadow_map_layout);
+  m_shadow_map_layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+}
+
+void ShadowCascades::fit_cascade(Cascade& cascade, const glm::vec4& sphere) const {
+  // Grown so the sphere stays covered after the center moved by up to one texel, then the
+  // center is snapped to the texel grid.
+  const float resolution = float(m_settings.resolution);
+  const float half_size  = sphere.w * resolution / (resolution - 2.0f);
+  const float texel_size = 2.0f * half_size / resolution;
+  glm::vec3 center       = m_light_view * glm::vec4(glm::vec3(sphere), 1.0f);
+  center.x               = std::floor(center.x / texel_size) * texel_size;
+  center.y               = std::floor(center.y / texel_size) * texel_size;
+  cascade.sphere         = sphere;
+  cascade.min            = center - half_size;
+  cascade.max = center + glm::vec3(half_size, half_size, half_size + m_settings.caster_distance);
+}
+
+void ShadowCascades::declare_shading_inputs(RGPass& pass) const {
+  pass.add_texture_input(m_shadow_map_handle);
+}
+
+void ShadowCascades::bind_shading(const vkh::CommandBuffer& cmd, VkPipelineLayout layout,
+                                  uint32_t set) const {
+  cmd.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_GRAPHICS, layout, set,
+                           {m_shading_sets[m_frame_index]});
+}
+
+void ShadowCascades::create_pipelines(const RGPassContext& ctx) {
+  const auto build = [&](vkh::PipelineBuilder& builder, VkPipelineLayout layout) {
+    return ctx.render_pass != VK_NULL_HANDLE ? builder.build(layout, ctx.render_pass, ctx.subpass)
+                                             : builder.build(layout, *ctx.rendering_info);
+  };
+  std::vector<VkPipelineShaderStageCreateInfo> stages;
+  m_caster_shader.fill_stage_cis(stages);
+  vkh::PipelineBuilder caster_builder(m_device);
+  caster_builder.set_name("shadow casters")
+      .set_shader_stages(stages)
+      .set_vertex_specification(MeshVertex::get_input_description(),
+                                VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
+      .set_view_port(ctx.extent)
+      // the normal offset of the shading handles acne, both sides cast
+      .set_rasterization(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE)
+      .set_multisample(VK_SAMPLE_COUNT_1_BIT)
+      .set_depth_stencil(true, true, VK_COMPARE_OP_LESS)
+      .enable_blend(false, 0);
+  m_caster_pipeline = build(caster_builder, m_caster_shader.get_pipeline_layout());
+
+  stages.clear();
+  m_clear_shader.fill_stage_cis(stages);
+  vkh::PipelineBuilder clear_builder(m_device);
+  clear_builder.set_name("shadow clear")
+      .set_shader_stages(stages)
+      .set_vertex_specification({}, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
+      .set_view_port(ctx.extent)
+      .set_rasterization(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE)
+      .set_multisample(VK_SAMPLE_COUNT_1_BIT)
+      .set_depth_stencil(true, true, VK_COMPARE_OP_ALWAYS)
+      .enable_blend(false, 0);
+  m_clear_pipeline = build(clear_builder, m_clear_shader.get_pipeline_layout());
+}
+
+void ShadowCascades::record(const RGPassContext& ctx, const GpuScene& scene) {
+  if (m_caster_pipeline == VK_NULL_HANDLE) {
+    create_pipelines(ctx);
+  }
+  if (m_refresh_mask == 0) {
+    return;
+  }
+  const VkDescriptorSet render_set = m_render_sets[m_frame_index];
+  ctx.cmd.set_viewport_scissor(ctx.extent);
+  ctx.cmd.bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, m_clear_pipeline);
+  ctx.cmd.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_GRAPHICS,
+                               m_clear_shader.get_pipeline_layout(), 0, {render_set});
+  ctx.cmd.draw(3);
+  // every batch casts, the shadow cull pass left out the casters of unrendered cascades
+  ctx.cmd.bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, m_caster_pipeline);
+  ctx.cmd.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_GRAPHICS,
+                               m_caster_shader.get_pipeline_layout(), 0,
+                               {render_set, m_object_set});
+  for (uint32_t batch = 0; batch < scene.get_batch_count(); batch++) {
+    scene.draw_batch(ctx.cmd, batch, DrawPhase::Shadow);
+  }
+}
+}  // namespace zen
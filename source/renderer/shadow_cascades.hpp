@@ -0,0 +1,125 @@
+#ifndef ZENENGINE_SHADOW_CASCADES_HPP
+#define ZENENGINE_SHADOW_CASCADES_HPP
+#include <array>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+#include "clustered_lighting.hpp"
+#include "gpu_scene.hpp"
+#include "render_graph.hpp"
+#include "vk_helper/buffer.hpp"
+#include "vk_helper/descriptor.hpp"
+#include "vk_helper/image.hpp"
+#include "vk_helper/shader.hpp"
+
+namespace zen {
+constexpr uint32_t SHADOW_CASCADE_COUNT = 4;
+
+struct ShadowSettings {
+  uint32_t resolution{2048};
+  // shadows end here or at the far plane of the camera
+  float max_distance{80.0f};
+  // blends uniform (0) and logarithmic (1) cascade splits
+  float split_lambda{0.75f};
+  // the farthest cascades, only rendered again when their content or the light changes
+  uint32_t cached_cascades{2};
+  // cached cascades cover this much more than their split so the camera can move in them
+  float cache_margin{0.25f};
+  // casters this far in front of a cascade towards the light still cast into it
+  float caster_distance{40.0f};
+  // light space depth subtracted before the comparison
+  float depth_bias{0.0005f};
+};
+
+/// Cascaded shadow maps of one directional light.
+///
+/// The view frustum up to ShadowSettings::max_distance is split into SHADOW_CASCADE_COUNT
+/// cascades, each fitted into an orthographic light frustum snapped to whole texels so the
+/// shadows do not shimmer when the camera moves. The cascades are layers of one depth array
+/// rendered by a single multiview pass, the vertex shader (shadow.vert) picks the cascade with
+/// gl_ViewIndex.
+///
+/// The nearest cascades are rendered every frame. The farthest ones cover their split with a
+/// margin and keep their contents until the light changes, invalidate_cache() is called or the
+/// camera leaves the margin, then only those cascades are cleared and rendered again. Casters
+/// are culled on the GPU against the union of the cascades rendered in the frame.
+class ShadowCascades {
+public:
+  ZEN_NO_COPY_MOVE(ShadowCascades)
+  ShadowCascades(const vkh::Device& device, uint32_t frames_in_flight,
+                 const ShadowSettings& settings = {});
+  ~ShadowCascades();
+
+  // direction is the one the light travels in
+  void set_light(const glm::vec3& direction, const glm::vec3& color);
+  // Renders the cached cascades again, e.g. after shadow casters moved.
+  void invalidate_cache();
+
+  // Adds the passes culling the casters of scene and rendering the cascades.
+  void add_passes(RenderGraph& graph, GpuScene& scene);
+  // Fits the cascades to the camera of the frame, before the graph executes.
+  void update(RenderGraph& graph, const ClusterView& view, uint32_t frame_index);
+  // Declares the shadow map read of the fragment shader on the pass shading with the light.
+  void declare_shading_inputs(RGPass& pass) const;
+  // binds the light and the shadow map at set of the shading pipeline
+  void bind_shading(const vkh::CommandBuffer& cmd, VkPipelineLayout layout, uint32_t set) const;
+
+  // cascades rendered by the last update(), one bit per cascade
+  uint32_t get_refresh_mask() const { return m_refresh_mask; }
+
+private:
+  // matches ShadowBuffer in shadow.vert, shadow_clear.vert and clustered_lit.frag
+  struct ShadowData {
+    std::array<glm::mat4, SHADOW_CASCADE_COUNT> cascades;
+    glm::vec4 splits;
+    glm::vec4 texel_sizes;
+    // xyz: direction the light travels, w: depth bias
+    glm::vec4 light_direction;
+    glm::vec4 light_color;
+    uint32_t refresh_mask;
+    uint32_t pad[3];
+  };
+  struct Cascade {
+    // world space sphere the light frustum is fitted to, xyz: center, w: radius
+    glm::vec4 sphere{0.0f};
+    // light space bounds of the light frustum
+    glm::vec3 min{0.0f};
+    glm::vec3 max{0.0f};
+    float split{0.0f};
+  };
+
+  void fit_cascade(Cascade& cascade, const glm::vec4& sphere) const;
+  void create_pipelines(const RGPassContext& ctx);
+  void record(const RGPassContext& ctx, const GpuScene& scene);
+
+  const vkh::Device& m_device;
+  ShadowSettings m_settings;
+  glm::vec3 m_light_direction{0.0f, -1.0f, 0.0f};
+  glm::vec3 m_light_color{0.0f};
+  // rotation into light space, shared by all cascades
+  glm::mat4 m_light_view{1.0f};
+  bool m_cache_valid{false};
+  std::array<Cascade, SHADOW_CASCADE_COUNT> m_cascades;
+  uint32_t m_refresh_mask{0};
+  uint32_t m_frame_index{0};
+  // union of the cascades rendered in the frame, the casters are culled against it
+  glm::mat4 m_cull_view_proj{1.0f};
+
+  std::unique_ptr<vkh::Image> m_shadow_map;
+  VkImageLayout m_shadow_map_layout{VK_IMAGE_LAYOUT_UNDEFINED};
+  RGResourceHandle m_shadow_map_handle;
+  VkSampler m_sampler{VK_NULL_HANDLE};
+  std::vector<std::unique_ptr<vkh::UniformBuffer>> m_uniform_buffers;  // one per frame in flight
+
+  vkh::ShaderProgram m_caster_shader;
+  vkh::ShaderProgram m_clear_shader;
+  VkPipeline m_caster_pipeline{VK_NULL_HANDLE};
+  VkPipeline m_clear_pipeline{VK_NULL_HANDLE};
+  vkh::DescriptorLayoutCache m_descriptor_layout_cache;
+  vkh::DescriptorAllocator m_descriptor_allocator;
+  std::vector<VkDescriptorSet> m_render_sets;
+  std::vector<VkDescriptorSet> m_shading_sets;
+  VkDescriptorSet m_object_set{VK_NULL_HANDLE};
+};
+}  // namespace zen
+#endif  //ZENENGINE_SHADOW_CASCADES_HPP
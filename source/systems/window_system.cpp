@@ -27,7 +27,8 @@ void Window::set_glfw_callbacks() {
     window_data->should_resize = true;
     logger::trace("Window resized to {} x {}", width, height);
   };
-  glfwSetWindowSizeCallback(m_window, resize_callback);
+  // the swapchain extent is in pixels, not screen coordinates
+  glfwSetFramebufferSizeCallback(m_window, resize_callback);
 
   const auto key_callback = [](GLFWwindow* w, auto key, auto scancode, auto action, auto mode) {
     if (key < 0 || key > GLFW_KEY_LAST) {
@@ -0,0 +1,84 @@
+#include "mapped_file.hpp"
+#include <utility>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace zen::util {
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path) {
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return;
+  }
+  LARGE_INTEGER size{};
+  if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+    // the view keeps the mapping alive, both handles can be closed right away
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping != nullptr) {
+      m_data = static_cast<const std::byte*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+      m_size = m_data != nullptr ? size_t(size.QuadPart) : 0;
+      CloseHandle(mapping);
+    }
+  }
+  CloseHandle(file);
+}
+
+void MappedFile::close() {
+  if (m_data != nullptr) {
+    UnmapViewOfFile(m_data);
+  }
+}
+#else
+MappedFile::MappedFile(const std::string& path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  struct stat info {};
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    void* data = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      // all of an asset is needed soon, start reading it in the background
+      madvise(data, size_t(info.st_size), MADV_WILLNEED);
+      m_data = static_cast<const std::byte*>(data);
+      m_size = size_t(info.st_size);
+    }
+  }
+  // the mapping stays valid without the descriptor
+  ::close(fd);
+}
+
+void MappedFile::close() {
+  if (m_data != nullptr) {
+    munmap(const_cast<std::byte*>(m_data), m_size);
+  }
+}
+#endif
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this != &other) {
+    close();
+    m_data = std::exchange(other.m_data, nullptr);
+    m_size = std::exchange(other.m_size, 0);
+  }
+  return *this;
+}
+}  // namespace zen::util
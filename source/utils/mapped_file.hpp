@@ -0,0 +1,31 @@
+#ifndef ZENENGINE_MAPPED_FILE_HPP
+#define ZENENGINE_MAPPED_FILE_HPP
+#include <cstddef>
+#include <string>
+
+namespace zen::util {
+/// Read-only memory mapping of a whole file. Pages are read on first access, large assets are
+/// copied from the page cache straight to their destination instead of through a read buffer.
+class MappedFile {
+public:
+  MappedFile() = default;
+  // is_open() tells whether it worked, empty files are not mapped
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+  MappedFile(const MappedFile&)            = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool is_open() const { return m_data != nullptr; }
+  const std::byte* data() const { return m_data; }
+  size_t size() const { return m_size; }
+
+private:
+  void close();
+
+  const std::byte* m_data{nullptr};
+  size_t m_size{0};
+};
+}  // namespace zen::util
+#endif  //ZENENGINE_MAPPED_FILE_HPP
@@ -0,0 +1,93 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+
+namespace zen::util {
+ThreadPool::ThreadPool(uint32_t thread_count) {
+  thread_count = std::max(thread_count, 1u);
+  m_workers.reserve(thread_count);
+  for (uint32_t i = 0; i < thread_count; i++) {
+    m_workers.emplace_back(&ThreadPool::worker_loop, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_task_cv.notify_all();
+  for (auto& worker : m_workers) {
+    worker.join();
+  }
+}
+
+uint32_t ThreadPool::default_thread_count() {
+  // leave one core for the thread that submits work
+  const uint32_t hw_threads = std::thread::hardware_concurrency();
+  return hw_threads > 1 ? hw_threads - 1 : 1;
+}
+
+void ThreadPool::enqueue(Task task) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tasks.push(std::move(task));
+  }
+  m_task_cv.notify_one();
+}
+
+void ThreadPool::wait_idle() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_idle_cv.wait(lock, [this] { return m_tasks.empty() && m_active_tasks == 0; });
+}
+
+uint32_t ThreadPool::parallel_for(uint32_t count, uint32_t chunk_size, const RangeTask& task) {
+  if (count == 0) {
+    return 0;
+  }
+  chunk_size                = std::max(chunk_size, 1u);
+  const uint32_t num_chunks = (count + chunk_size - 1) / chunk_size;
+
+  uint32_t remaining = num_chunks;
+  std::mutex done_mutex;
+  std::condition_variable done_cv;
+  for (uint32_t chunk = 0; chunk < num_chunks; chunk++) {
+    const uint32_t begin = chunk * chunk_size;
+    const uint32_t end   = std::min(begin + chunk_size, count);
+    enqueue([&, begin, end, chunk](uint32_t worker_index) {
+      task(begin, end, chunk, worker_index);
+      // decrement under the lock so the waiter cannot return while we still touch its state
+      std::lock_guard<std::mutex> lock(done_mutex);
+      if (--remaining == 0) {
+        done_cv.notify_one();
+      }
+    });
+  }
+  std::unique_lock<std::mutex> lock(done_mutex);
+  done_cv.wait(lock, [&] { return remaining == 0; });
+  return num_chunks;
+}
+
+void ThreadPool::worker_loop(uint32_t worker_index) {
+  while (true) {
+    Task task;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_task_cv.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+      if (m_stop && m_tasks.empty()) {
+        return;
+      }
+      task = std::move(m_tasks.front());
+      m_tasks.pop();
+      m_active_tasks++;
+    }
+    task(worker_index);
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_active_tasks--;
+      if (m_tasks.empty() && m_active_tasks == 0) {
+        m_idle_cv.notify_all();
+      }
+    }
+  }
+}
+}  // namespace zen::util
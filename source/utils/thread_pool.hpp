@@ -0,0 +1,49 @@
+#ifndef ZENENGINE_THREAD_POOL_HPP
+#define ZENENGINE_THREAD_POOL_HPP
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace zen::util {
+/// Fixed size pool of worker threads. Every worker has a stable index in [0, size()) which is
+/// passed to its tasks, so per-thread resources (e.g. command pools) can be indexed by it.
+class ThreadPool {
+public:
+  using Task      = std::function<void(uint32_t worker_index)>;
+  using RangeTask = std::function<void(uint32_t begin, uint32_t end, uint32_t chunk_index,
+                                       uint32_t worker_index)>;
+
+  explicit ThreadPool(uint32_t thread_count = default_thread_count());
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&)            = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  static uint32_t default_thread_count();
+
+  uint32_t size() const { return static_cast<uint32_t>(m_workers.size()); }
+
+  void enqueue(Task task);
+  // Blocks until every enqueued task has finished.
+  void wait_idle();
+
+  // Splits [0, count) into chunks of chunk_size and blocks until all of them are processed.
+  // Returns the number of chunks, chunk_index is in [0, chunk count).
+  uint32_t parallel_for(uint32_t count, uint32_t chunk_size, const RangeTask& task);
+
+private:
+  void worker_loop(uint32_t worker_index);
+
+  std::vector<std::thread> m_workers;
+  std::queue<Task> m_tasks;
+  std::mutex m_mutex;
+  std::condition_variable m_task_cv;
+  std::condition_variable m_idle_cv;
+  uint32_t m_active_tasks{0};
+  bool m_stop{false};
+};
+}  // namespace zen::util
+#endif  //ZENENGINE_THREAD_POOL_HPP
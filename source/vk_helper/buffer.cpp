@@ -6,7 +6,7 @@
 namespace zen::vkh {
 Buffer::Buffer(const Device& device, std::string name, VkDeviceSize size,
                VkBufferUsageFlags buffer_usage, VmaAllocationCreateFlags vma_flags)
-    : m_device(device), m_name(std::move(name)) {
+    : m_device(device), m_name(std::move(name)), m_size(size) {
   VkBufferCreateInfo buffer_ci{};
   buffer_ci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   buffer_ci.size  = size;
@@ -34,9 +34,22 @@ void Buffer::update(void* src_data, size_t data_size, uint32_t offset) {
   vmaUnmapMemory(m_device.get_allocator(), m_allocation);
 }
 
+void* Buffer::map() {
+  void* data = nullptr;
+  VK_CHECK(vmaMapMemory(m_device.get_allocator(), m_allocation, &data), "vmaMapMemory");
+  return data;
+}
+
+void Buffer::unmap() {
+  // no-op on host coherent memory
+  vmaFlushAllocation(m_device.get_allocator(), m_allocation, 0, VK_WHOLE_SIZE);
+  vmaUnmapMemory(m_device.get_allocator(), m_allocation);
+}
+
 Buffer::Buffer(Buffer&& other) noexcept : m_device(other.m_device) {
   m_name       = std::move(other.m_name);
   m_buffer     = std::exchange(other.m_buffer, nullptr);
+  m_size       = other.m_size;
   m_allocation = std::exchange(other.m_allocation, nullptr);
   m_alloc_info = other.m_alloc_info;
 }
@@ -16,8 +16,12 @@ public:
   virtual ~Buffer();
 
   void update(void* src_data, size_t data_size, uint32_t offset = 0);
+  // For writing large data in place, unmap() flushes it.
+  void* map();
+  void unmap();
 
   VkBuffer handle() const { return m_buffer; }
+  VkDeviceSize get_size() const { return m_size; }
   VmaAllocationInfo allocation_info() const { return m_alloc_info; }
 
 protected:
@@ -42,6 +46,7 @@ public:
 };
 
 class StagingBuffer : public Buffer {
+public:
   StagingBuffer(const Device& device, const std::string& name, const VkDeviceSize& buffer_size);
   StagingBuffer(StagingBuffer&& other) noexcept;
 };
@@ -1,10 +1,11 @@
 #include "command_buffer.hpp"
 #include "device.hpp"
+#include "logging.hpp"
 
 namespace zen::vkh {
 CommandBuffer::CommandBuffer(const Device& device, VkCommandPool cmd_pool,
                              VkCommandBufferLevel level, std::string name)
-    : m_device(device), m_name(std::move(name)) {
+    : m_device(device), m_level(level), m_name(std::move(name)) {
   VkCommandBufferAllocateInfo info = {
       .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
       .commandPool        = cmd_pool,
@@ -12,27 +13,182 @@ CommandBuffer::CommandBuffer(const Device& device, VkCommandPool cmd_pool,
       .commandBufferCount = 1,
   };
   m_device.allocate_command_buffer(info, &m_cmd_buffer, m_name);
-  m_wait_fence = std::make_unique<Fence>(m_device, m_name, false);
 }
 
 CommandBuffer::CommandBuffer(CommandBuffer&& other) noexcept : m_device(other.m_device) {
   m_cmd_buffer = std::exchange(other.m_cmd_buffer, VK_NULL_HANDLE);
+  m_level      = other.m_level;
   m_name       = std::move(other.m_name);
-  m_wait_fence = std::exchange(other.m_wait_fence, nullptr);
 }
 
 void CommandBuffer::begin(const VkCommandBufferUsageFlags flags) const {
   // primary command buffer
   VkCommandBufferBeginInfo info = {.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
                                    .flags = flags};
-  vkBeginCommandBuffer(m_cmd_buffer, &info);
+  VK_CHECK(vkBeginCommandBuffer(m_cmd_buffer, &info), "vkBeginCommandBuffer");
 }
 
-VkResult CommandBuffer::fence_status() const {
-  return m_wait_fence->status();
+void CommandBuffer::begin_secondary(VkRenderPass render_pass, uint32_t subpass,
+                                    VkFramebuffer framebuffer) const {
+  VK_ASSERT(m_level == VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+  VkCommandBufferInheritanceInfo inheritance = {
+      .sType       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+      .renderPass  = render_pass,
+      .subpass     = subpass,
+      .framebuffer = framebuffer,
+  };
+  VkCommandBufferBeginInfo info = {
+      .sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags            = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                          VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+      .pInheritanceInfo = &inheritance,
+  };
+  VK_CHECK(vkBeginCommandBuffer(m_cmd_buffer, &info), "vkBeginCommandBuffer");
+}
+
+void CommandBuffer::begin_secondary(
+    const VkCommandBufferInheritanceRenderingInfoKHR& rendering_info) const {
+  VK_ASSERT(m_level == VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+  VkCommandBufferInheritanceInfo inheritance = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+      .pNext = &rendering_info,
+  };
+  VkCommandBufferBeginInfo info = {
+      .sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags            = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                          VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+      .pInheritanceInfo = &inheritance,
+  };
+  VK_CHECK(vkBeginCommandBuffer(m_cmd_buffer, &info), "vkBeginCommandBuffer");
+}
+
+void CommandBuffer::end() const {
+  VK_CHECK(vkEndCommandBuffer(m_cmd_buffer), "vkEndCommandBuffer");
+}
+
+void CommandBuffer::begin_render_pass(const VkRenderPassBeginInfo& info,
+                                      VkSubpassContents contents) const {
+  vkCmdBeginRenderPass(m_cmd_buffer, &info, contents);
+}
+
+void CommandBuffer::next_subpass(VkSubpassContents contents) const {
+  vkCmdNextSubpass(m_cmd_buffer, contents);
+}
+
+void CommandBuffer::end_render_pass() const {
+  vkCmdEndRenderPass(m_cmd_buffer);
+}
+
+void CommandBuffer::begin_rendering(const VkRenderingInfoKHR& info) const {
+  vkCmdBeginRenderingKHR(m_cmd_buffer, &info);
+}
+
+void CommandBuffer::end_rendering() const {
+  vkCmdEndRenderingKHR(m_cmd_buffer);
+}
+
+void CommandBuffer::execute_commands(
+    const std::vector<VkCommandBuffer>& secondary_cmd_buffers) const {
+  VK_ASSERT(m_level == VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+  if (secondary_cmd_buffers.empty()) {
+    return;
+  }
+  vkCmdExecuteCommands(m_cmd_buffer, static_cast<uint32_t>(secondary_cmd_buffers.size()),
+                       secondary_cmd_buffers.data());
+}
+
+void CommandBuffer::bind_pipeline(VkPipelineBindPoint bind_point, VkPipeline pipeline) const {
+  vkCmdBindPipeline(m_cmd_buffer, bind_point, pipeline);
+}
+
+void CommandBuffer::bind_descriptor_sets(VkPipelineBindPoint bind_point, VkPipelineLayout layout,
+                                         uint32_t first_set,
+                                         const std::vector<VkDescriptorSet>& sets) const {
+  vkCmdBindDescriptorSets(m_cmd_buffer, bind_point, layout, first_set,
+                          static_cast<uint32_t>(sets.size()), sets.data(), 0, nullptr);
 }
 
-void CommandBuffer::reset_fence() const {
-  m_wait_fence->reset();
+void CommandBuffer::push_constants(VkPipelineLayout layout, VkShaderStageFlags stages,
+                                   uint32_t size, const void* data, uint32_t offset) const {
+  vkCmdPushConstants(m_cmd_buffer, layout, stages, offset, size, data);
+}
+
+void CommandBuffer::set_viewport_scissor(VkExtent2D extent) const {
+  const VkViewport viewport = {
+      .x        = 0.0f,
+      .y        = 0.0f,
+      .width    = static_cast<float>(extent.width),
+      .height   = static_cast<float>(extent.height),
+      .minDepth = 0.0f,
+      .maxDepth = 1.0f,
+  };
+  const VkRect2D scissor = {.offset = {0, 0}, .extent = extent};
+  vkCmdSetViewport(m_cmd_buffer, 0, 1, &viewport);
+  vkCmdSetScissor(m_cmd_buffer, 0, 1, &scissor);
+}
+
+void CommandBuffer::draw(uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex,
+                         uint32_t first_instance) const {
+  vkCmdDraw(m_cmd_buffer, vertex_count, instance_count, first_vertex, first_instance);
+}
+
+void CommandBuffer::bind_vertex_buffer(uint32_t binding, VkBuffer buffer,
+                                       VkDeviceSize offset) const {
+  vkCmdBindVertexBuffers(m_cmd_buffer, binding, 1, &buffer, &offset);
+}
+
+void CommandBuffer::bind_index_buffer(VkBuffer buffer, VkDeviceSize offset,
+                                      VkIndexType index_type) const {
+  vkCmdBindIndexBuffer(m_cmd_buffer, buffer, offset, index_type);
+}
+
+void CommandBuffer::draw_indexed(uint32_t index_count, uint32_t instance_count,
+                                 uint32_t first_index, int32_t vertex_offset,
+                                 uint32_t first_instance) const {
+  vkCmdDrawIndexed(m_cmd_buffer, index_count, instance_count, first_index, vertex_offset,
+                   first_instance);
+}
+
+void CommandBuffer::draw_indexed_indirect_count(VkBuffer buffer, VkDeviceSize offset,
+                                                VkBuffer count_buffer, VkDeviceSize count_offset,
+                                                uint32_t max_draw_count, uint32_t stride) const {
+  if (m_device.get_features().supports_draw_indirect_count) {
+    vkCmdDrawIndexedIndirectCountKHR(m_cmd_buffer, buffer, offset, count_buffer, count_offset,
+                                     max_draw_count, stride);
+  } else {
+    vkCmdDrawIndexedIndirect(m_cmd_buffer, buffer, offset, max_draw_count, stride);
+  }
+}
+
+void CommandBuffer::dispatch(uint32_t group_count_x, uint32_t group_count_y,
+                             uint32_t group_count_z) const {
+  vkCmdDispatch(m_cmd_buffer, group_count_x, group_count_y, group_count_z);
+}
+
+void CommandBuffer::fill_buffer(VkBuffer buffer, uint32_t data, VkDeviceSize offset,
+                                VkDeviceSize size) const {
+  vkCmdFillBuffer(m_cmd_buffer, buffer, offset, size, data);
+}
+
+void CommandBuffer::reset_query_pool(VkQueryPool query_pool, uint32_t first_query,
+                                     uint32_t count) const {
+  vkCmdResetQueryPool(m_cmd_buffer, query_pool, first_query, count);
+}
+
+void CommandBuffer::write_timestamp(VkPipelineStageFlagBits stage, VkQueryPool query_pool,
+                                    uint32_t query) const {
+  vkCmdWriteTimestamp(m_cmd_buffer, stage, query_pool, query);
+}
+
+void CommandBuffer::memory_barrier(VkPipelineStageFlags src_stages, VkAccessFlags src_access,
+                                   VkPipelineStageFlags dst_stages,
+                                   VkAccessFlags dst_access) const {
+  const VkMemoryBarrier barrier = {
+      .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = src_access,
+      .dstAccessMask = dst_access,
+  };
+  vkCmdPipelineBarrier(m_cmd_buffer, src_stages, dst_stages, 0, 1, &barrier, 0, nullptr, 0,
+                       nullptr);
 }
-}  // namespace zen::vkh
\ No newline at end of file
+}  // namespace zen::vkh
@@ -1,9 +1,8 @@
 #ifndef ZENENGINE_COMMAND_BUFFER_HPP
 #define ZENENGINE_COMMAND_BUFFER_HPP
-#include <memory>
 #include <string>
+#include <vector>
 #include "base.hpp"
-#include "fence.hpp"
 
 namespace zen::vkh {
 class Device;
@@ -22,15 +21,64 @@ public:
   ~CommandBuffer() = default;
 
   void begin(VkCommandBufferUsageFlags flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT) const;
+  // Begins a secondary command buffer which continues the given subpass of a render pass.
+  void begin_secondary(VkRenderPass render_pass, uint32_t subpass,
+                       VkFramebuffer framebuffer = VK_NULL_HANDLE) const;
+  // Begins a secondary command buffer which continues a dynamic rendering instance.
+  void begin_secondary(const VkCommandBufferInheritanceRenderingInfoKHR& rendering_info) const;
+  void end() const;
 
-  VkResult fence_status() const;
-  void reset_fence() const;
+  void begin_render_pass(const VkRenderPassBeginInfo& info, VkSubpassContents contents) const;
+  void next_subpass(VkSubpassContents contents) const;
+  void end_render_pass() const;
+
+  // VK_KHR_dynamic_rendering, attachments are given at record time instead of a render pass
+  // and framebuffer object.
+  void begin_rendering(const VkRenderingInfoKHR& info) const;
+  void end_rendering() const;
+
+  void execute_commands(const std::vector<VkCommandBuffer>& secondary_cmd_buffers) const;
+
+  void bind_pipeline(VkPipelineBindPoint bind_point, VkPipeline pipeline) const;
+  void bind_descriptor_sets(VkPipelineBindPoint bind_point, VkPipelineLayout layout,
+                            uint32_t first_set, const std::vector<VkDescriptorSet>& sets) const;
+  void push_constants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t size,
+                      const void* data, uint32_t offset = 0) const;
+  // Sets viewport and scissor to cover the extent.
+  void set_viewport_scissor(VkExtent2D extent) const;
+  void draw(uint32_t vertex_count, uint32_t instance_count = 1, uint32_t first_vertex = 0,
+            uint32_t first_instance = 0) const;
+  void bind_vertex_buffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset = 0) const;
+  void bind_index_buffer(VkBuffer buffer, VkDeviceSize offset = 0,
+                         VkIndexType index_type = VK_INDEX_TYPE_UINT32) const;
+  void draw_indexed(uint32_t index_count, uint32_t instance_count = 1, uint32_t first_index = 0,
+                    int32_t vertex_offset = 0, uint32_t first_instance = 0) const;
+  // Draws the VkDrawIndexedIndirectCommands at offset, the GPU reads their count from
+  // count_buffer. Without VK_KHR_draw_indirect_count all max_draw_count commands are drawn, the
+  // unused ones then need an instance count of 0.
+  void draw_indexed_indirect_count(VkBuffer buffer, VkDeviceSize offset, VkBuffer count_buffer,
+                                   VkDeviceSize count_offset, uint32_t max_draw_count,
+                                   uint32_t stride = sizeof(VkDrawIndexedIndirectCommand)) const;
+  void dispatch(uint32_t group_count_x, uint32_t group_count_y = 1,
+                uint32_t group_count_z = 1) const;
+  void fill_buffer(VkBuffer buffer, uint32_t data, VkDeviceSize offset = 0,
+                   VkDeviceSize size = VK_WHOLE_SIZE) const;
+  void reset_query_pool(VkQueryPool query_pool, uint32_t first_query, uint32_t count) const;
+  void write_timestamp(VkPipelineStageFlagBits stage, VkQueryPool query_pool,
+                       uint32_t query) const;
+  // Global memory barrier for dependencies within a render graph pass, e.g. between dispatches
+  // writing and reading different mips of one image.
+  void memory_barrier(VkPipelineStageFlags src_stages, VkAccessFlags src_access,
+                      VkPipelineStageFlags dst_stages, VkAccessFlags dst_access) const;
+
+  VkCommandBuffer handle() const { return m_cmd_buffer; }
+  VkCommandBufferLevel level() const { return m_level; }
 
 private:
   const Device& m_device;
   VkCommandBuffer m_cmd_buffer{nullptr};
+  VkCommandBufferLevel m_level{VK_COMMAND_BUFFER_LEVEL_PRIMARY};
   std::string m_name;
-  std::unique_ptr<Fence> m_wait_fence;
 };
 }  // namespace zen::vkh
 #endif  //ZENENGINE_COMMAND_BUFFER_HPP
@@ -6,39 +6,81 @@
 #include "logging.hpp"
 
 namespace zen::vkh {
-CommandPool::CommandPool(const Device& device, std::string name)
-    : m_device(device), m_name(std::move(name)) {
+CommandPool::CommandPool(const Device& device, uint32_t queue_family_index, std::string name)
+    : m_device(device), m_name(std::move(name)), m_queue_family_index(queue_family_index) {
+  // No RESET_COMMAND_BUFFER_BIT: buffers are never reset individually, the whole pool is.
   VkCommandPoolCreateInfo cmd_pool_ci = {.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-                                         .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT |
-                                                  VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
-                                         .queueFamilyIndex = device.graphics_queue_family_index()};
+                                         .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+                                         .queueFamilyIndex = m_queue_family_index};
   m_device.create_command_pool(cmd_pool_ci, &m_cmd_pool, m_name);
 }
 
 CommandPool::~CommandPool() {
+  // command buffers are freed together with the pool
+  m_primary_cmd_buffers.buffers.clear();
+  m_secondary_cmd_buffers.buffers.clear();
   m_device.destroy_command_pool(m_cmd_pool);
 }
 
-const CommandBuffer& CommandPool::request_primary_command_buffer(const std::string& name) {
-  // Try to find a command buffer which is currently not used
-  for (const auto& cmd_buf : m_primary_cmd_buffers) {
-    if (cmd_buf->fence_status() == VK_SUCCESS) {
-      // Reset the command buffer's fence to make it usable again
-      cmd_buf->reset_fence();
-      cmd_buf->begin();
-      return *cmd_buf;
-    }
+CommandBuffer& CommandPool::request_command_buffer(VkCommandBufferLevel level) {
+  const bool primary = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  auto& list         = primary ? m_primary_cmd_buffers : m_secondary_cmd_buffers;
+  if (list.active_count < list.buffers.size()) {
+    return *list.buffers[list.active_count++];
   }
 
-  // We need to create a new command buffer because no free one was found
-  // Note that there is currently no method for shrinking m_cmd_bufs, but this should not be a problem
-  m_primary_cmd_buffers.emplace_back(std::make_unique<CommandBuffer>(
-      m_device, m_cmd_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, "command buffer"));
+  auto name =
+      m_name + (primary ? " primary #" : " secondary #") + std::to_string(list.active_count);
+  list.buffers.emplace_back(std::make_unique<CommandBuffer>(m_device, m_cmd_pool, level, name));
+  list.active_count++;
+  logger::trace("Creating new command buffer {}", name);
+
+  return *list.buffers.back();
+}
+
+CommandBuffer& CommandPool::request_primary_command_buffer() {
+  auto& cmd_buf = request_command_buffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+  cmd_buf.begin();
+  return cmd_buf;
+}
+
+void CommandPool::reset() {
+  m_device.reset_command_pool(m_cmd_pool);
+  m_primary_cmd_buffers.active_count   = 0;
+  m_secondary_cmd_buffers.active_count = 0;
+}
+
+FrameCommandAllocator::FrameCommandAllocator(const Device& device, uint32_t queue_family_index,
+                                             uint32_t frame_count, uint32_t thread_count,
+                                             const std::string& name)
+    : m_thread_count(thread_count) {
+  VK_ASSERT(frame_count > 0 && thread_count > 0);
+  m_pools.resize(frame_count);
+  for (uint32_t frame = 0; frame < frame_count; frame++) {
+    for (uint32_t thread = 0; thread < thread_count; thread++) {
+      auto pool_name =
+          name + " frame " + std::to_string(frame) + " thread " + std::to_string(thread);
+      m_pools[frame].emplace_back(
+          std::make_unique<CommandPool>(device, queue_family_index, pool_name));
+    }
+  }
+}
 
-  spdlog::trace("Creating new command buffer #{}", m_primary_cmd_buffers.size());
+void FrameCommandAllocator::begin_frame(uint32_t frame_index) {
+  VK_ASSERT(frame_index < m_pools.size());
+  m_frame_index = frame_index;
+  for (auto& pool : m_pools[m_frame_index]) {
+    pool->reset();
+  }
+}
 
-  m_primary_cmd_buffers.back()->begin();
-  return *m_primary_cmd_buffers.back();
+CommandPool& FrameCommandAllocator::get_pool(uint32_t thread_index) {
+  VK_ASSERT(thread_index < m_thread_count);
+  return *m_pools[m_frame_index][thread_index];
 }
 
-}  // namespace zen::vkh
\ No newline at end of file
+CommandBuffer& FrameCommandAllocator::request_command_buffer(uint32_t thread_index,
+                                                             VkCommandBufferLevel level) {
+  return get_pool(thread_index).request_command_buffer(level);
+}
+}  // namespace zen::vkh
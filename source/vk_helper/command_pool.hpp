@@ -9,20 +9,64 @@ namespace zen::vkh {
 class Device;
 class CommandBuffer;
 
+/// Transient command pool. Command buffers are handed out by bump index and are all
+/// recycled together by reset(), so the pool must only be reset once the GPU is done with it.
 class CommandPool {
 public:
   ZEN_NO_COPY_MOVE(CommandPool)
-  CommandPool(const Device& device, std::string name);
+  CommandPool(const Device& device, uint32_t queue_family_index, std::string name);
   ~CommandPool();
 
   VkCommandPool handle() { return m_cmd_pool; }
-  const CommandBuffer& request_primary_command_buffer(const std::string& name);
+  uint32_t queue_family_index() const { return m_queue_family_index; }
+
+  CommandBuffer& request_command_buffer(
+      VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+  // Returns a primary command buffer which is already in the recording state.
+  CommandBuffer& request_primary_command_buffer();
+
+  void reset();
 
 private:
+  struct CommandBufferList {
+    std::vector<std::unique_ptr<CommandBuffer>> buffers;
+    uint32_t active_count{0};
+  };
+
   const Device& m_device;
   std::string m_name;
+  uint32_t m_queue_family_index{0};
   VkCommandPool m_cmd_pool{nullptr};
-  std::vector<std::unique_ptr<CommandBuffer>> m_primary_cmd_buffers;
+  CommandBufferList m_primary_cmd_buffers;
+  CommandBufferList m_secondary_cmd_buffers;
+};
+
+/// Ring of command pools, one per frame in flight and per recording thread.
+/// Each thread only touches its own pool, so requesting command buffers needs no locking.
+class FrameCommandAllocator {
+public:
+  ZEN_NO_COPY_MOVE(FrameCommandAllocator)
+  FrameCommandAllocator(const Device& device, uint32_t queue_family_index, uint32_t frame_count,
+                        uint32_t thread_count, const std::string& name);
+  ~FrameCommandAllocator() = default;
+
+  // Makes frame_index the active frame and resets all of its pools. The caller must have
+  // waited for the GPU work previously recorded for this frame (e.g. on the frame's fence).
+  void begin_frame(uint32_t frame_index);
+
+  CommandPool& get_pool(uint32_t thread_index = 0);
+  CommandBuffer& request_command_buffer(
+      uint32_t thread_index      = 0,
+      VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+  uint32_t frame_count() const { return static_cast<uint32_t>(m_pools.size()); }
+  uint32_t thread_count() const { return m_thread_count; }
+  uint32_t frame_index() const { return m_frame_index; }
+
+private:
+  std::vector<std::vector<std::unique_ptr<CommandPool>>> m_pools;
+  uint32_t m_thread_count{1};
+  uint32_t m_frame_index{0};
 };
 }  // namespace zen::vkh
 #endif  //ZENENGINE_COMMAND_POOL_HPP
@@ -256,8 +256,180 @@ bool Context::create_device(VkSurfaceKHR surface, const char** required_device_e
     }
     enabled_extensions.push_back(required_device_extensions[i]);
   }
+  // Query optional features, every supported extension appends its feature struct to the chain.
+  VkPhysicalDeviceFeatures2 features2{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+  void** ppNext = &features2.pNext;
+
+  m_feature.timeline_semaphore_features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+  if (has_extension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+    enabled_extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+    *ppNext = &m_feature.timeline_semaphore_features;
+    ppNext  = &m_feature.timeline_semaphore_features.pNext;
+  }
+
+  m_feature.sync2_features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+  if (has_extension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME)) {
+    enabled_extensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+    *ppNext = &m_feature.sync2_features;
+    ppNext  = &m_feature.sync2_features.pNext;
+  }
+
+  m_feature.dynamic_rendering_features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+  if (has_extension(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) &&
+      has_extension(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME) &&
+      has_extension(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME)) {
+    // dependencies of dynamic rendering on Vulkan 1.1
+    enabled_extensions.push_back(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+    enabled_extensions.push_back(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME);
+    enabled_extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+    *ppNext = &m_feature.dynamic_rendering_features;
+    ppNext  = &m_feature.dynamic_rendering_features.pNext;
+  }
+
+  m_feature.imageless_framebuffer_features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGELESS_FRAMEBUFFER_FEATURES_KHR;
+  if (has_extension(VK_KHR_IMAGELESS_FRAMEBUFFER_EXTENSION_NAME) &&
+      has_extension(VK_KHR_IMAGE_FORMAT_LIST_EXTENSION_NAME)) {
+    // maintenance2 is core in Vulkan 1.1
+    enabled_extensions.push_back(VK_KHR_IMAGE_FORMAT_LIST_EXTENSION_NAME);
+    enabled_extensions.push_back(VK_KHR_IMAGELESS_FRAMEBUFFER_EXTENSION_NAME);
+    *ppNext = &m_feature.imageless_framebuffer_features;
+    ppNext  = &m_feature.imageless_framebuffer_features.pNext;
+    m_feature.supports_image_format_list = true;
+  }
+
+  // core in Vulkan 1.1, gl_BaseInstance/gl_DrawID need it
+  m_feature.shader_draw_parameters_features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_DRAW_PARAMETERS_FEATURES;
+  *ppNext = &m_feature.shader_draw_parameters_features;
+  ppNext  = &m_feature.shader_draw_parameters_features.pNext;
+
+  // core in Vulkan 1.1, renders the shadow cascades in one pass
+  m_feature.multiview_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES;
+  *ppNext                            = &m_feature.multiview_features;
+  ppNext                             = &m_feature.multiview_features.pNext;
+
+  // core in Vulkan 1.2, no feature struct
+  if (has_extension(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+    enabled_extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    m_feature.supports_draw_indirect_count = true;
+  }
+
+  m_feature.present_id_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+  m_feature.present_wait_features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+  if (has_extension(VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+      has_extension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+    // present wait waits on present ids, only useful together
+    enabled_extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+    enabled_extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+    *ppNext = &m_feature.present_id_features;
+    ppNext  = &m_feature.present_id_features.pNext;
+    *ppNext = &m_feature.present_wait_features;
+    ppNext  = &m_feature.present_wait_features.pNext;
+  }
+
+  vkGetPhysicalDeviceFeatures2(m_gpu, &features2);
+  const VkPhysicalDeviceFeatures& supported = features2.features;
+
+  if (!m_feature.timeline_semaphore_features.timelineSemaphore) {
+    logger::error("Timeline semaphores are not supported!");
+    return false;
+  }
+  m_feature.supports_sync2 = m_feature.sync2_features.synchronization2 == VK_TRUE;
+  m_feature.supports_dynamic_rendering =
+      m_feature.dynamic_rendering_features.dynamicRendering == VK_TRUE;
+  m_feature.supports_imageless_framebuffer =
+      m_feature.imageless_framebuffer_features.imagelessFramebuffer == VK_TRUE;
+  m_feature.supports_present_id   = m_feature.present_id_features.presentId == VK_TRUE;
+  m_feature.supports_present_wait =
+      m_feature.supports_present_id && m_feature.present_wait_features.presentWait == VK_TRUE;
+  m_feature.supports_multiview    = m_feature.multiview_features.multiview == VK_TRUE;
+
+  // Only the required features and the ones the engine uses are enabled, the queried chain
+  // would turn on everything supported, including costly features like robustBufferAccess.
+  VkPhysicalDeviceFeatures enabled =
+      required_features != nullptr ? *required_features : VkPhysicalDeviceFeatures{};
+  // every member is a VkBool32
+  const auto* required_flags  = reinterpret_cast<const VkBool32*>(&enabled);
+  const auto* supported_flags = reinterpret_cast<const VkBool32*>(&supported);
+  for (size_t i = 0; i < sizeof(VkPhysicalDeviceFeatures) / sizeof(VkBool32); i++) {
+    if (required_flags[i] && !supported_flags[i]) {
+      logger::error("Required device feature {} of VkPhysicalDeviceFeatures is not supported", i);
+      return false;
+    }
+  }
+  // one indirect command per object, with the object as its first instance
+  enabled.multiDrawIndirect         = supported.multiDrawIndirect;
+  enabled.drawIndirectFirstInstance = supported.drawIndirectFirstInstance;
+  // the RG32F depth pyramid is written as a storage image
+  enabled.shaderStorageImageExtendedFormats = supported.shaderStorageImageExtendedFormats;
+  m_feature.enabled_features                = enabled;
+
+  VkPhysicalDeviceFeatures2 enabled2{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+  enabled2.features   = enabled;
+  void** enabled_next = &enabled2.pNext;
+  const auto enable   = [&](auto& feature) {
+    *enabled_next = &feature;
+    enabled_next  = &feature.pNext;
+  };
+  VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_semaphore = {
+      .sType             = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR,
+      .timelineSemaphore = VK_TRUE,
+  };
+  enable(timeline_semaphore);
+  VkPhysicalDeviceSynchronization2FeaturesKHR sync2 = {
+      .sType            = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR,
+      .synchronization2 = VK_TRUE,
+  };
+  if (m_feature.supports_sync2) {
+    enable(sync2);
+  }
+  VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamic_rendering = {
+      .sType            = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR,
+      .dynamicRendering = VK_TRUE,
+  };
+  if (m_feature.supports_dynamic_rendering) {
+    enable(dynamic_rendering);
+  }
+  VkPhysicalDeviceImagelessFramebufferFeaturesKHR imageless_framebuffer = {
+      .sType                = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGELESS_FRAMEBUFFER_FEATURES_KHR,
+      .imagelessFramebuffer = VK_TRUE,
+  };
+  if (m_feature.supports_imageless_framebuffer) {
+    enable(imageless_framebuffer);
+  }
+  VkPhysicalDeviceShaderDrawParametersFeatures shader_draw_parameters = {
+      .sType                = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_DRAW_PARAMETERS_FEATURES,
+      .shaderDrawParameters = m_feature.shader_draw_parameters_features.shaderDrawParameters,
+  };
+  enable(shader_draw_parameters);
+  // only vertex and fragment shaders use gl_ViewIndex
+  VkPhysicalDeviceMultiviewFeatures multiview = {
+      .sType     = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES,
+      .multiview = m_feature.multiview_features.multiview,
+  };
+  enable(multiview);
+  VkPhysicalDevicePresentIdFeaturesKHR present_id = {
+      .sType     = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+      .presentId = VK_TRUE,
+  };
+  VkPhysicalDevicePresentWaitFeaturesKHR present_wait = {
+      .sType       = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+      .presentWait = VK_TRUE,
+  };
+  if (m_feature.supports_present_id) {
+    enable(present_id);
+  }
+  if (m_feature.supports_present_wait) {
+    enable(present_wait);
+  }
   // Create logical device
   VkDeviceCreateInfo device_ci = {VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO};
+  device_ci.pNext              = &enabled2;
   std::vector<VkDeviceQueueCreateInfo> queue_cis;
   populate_queue_ci(queue_cis);
   device_ci.pQueueCreateInfos     = queue_cis.data();
@@ -280,6 +452,7 @@ bool Context::create_device(VkSurfaceKHR surface, const char** required_device_e
     }
   }
   DebugUtil::get().set_obj_name(m_device, "device");
+  return true;
 }
 
 bool Context::find_proper_queue(uint32_t& family, uint32_t& index, VkQueueFlags required,
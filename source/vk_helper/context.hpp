@@ -20,6 +20,10 @@ struct DeviceFeatures {
   bool supports_memory_budget                    = false;
   bool supports_astc_decode_mode                 = false;
   bool supports_sync2                            = false;
+  bool supports_dynamic_rendering                = false;
+  bool supports_imageless_framebuffer            = false;
+  bool supports_present_id                       = false;
+  bool supports_present_wait                     = false;
   bool supports_video_queue                      = false;
   bool supports_video_decode_queue               = false;
   bool supports_video_decode_h264                = false;
@@ -31,6 +35,7 @@ struct DeviceFeatures {
   bool supports_tooling_info                     = false;
   bool supports_hdr_metadata                     = false;
   bool supports_swapchain_colorspace             = false;
+  bool supports_multiview                        = false;
 
   // Vulkan 1.1 core
   VkPhysicalDeviceFeatures enabled_features                                        = {};
@@ -41,17 +46,19 @@ struct DeviceFeatures {
   VkPhysicalDeviceSubgroupProperties subgroup_properties                           = {};
 
   // KHR
-  VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_semaphore_features = {};
-  VkPhysicalDevicePerformanceQueryFeaturesKHR performance_query_features   = {};
-  VkPhysicalDeviceDriverPropertiesKHR driver_properties                    = {};
-  VkPhysicalDeviceSynchronization2FeaturesKHR sync2_features               = {};
-  VkPhysicalDevicePresentIdFeaturesKHR present_id_features                 = {};
-  VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features             = {};
-  VkPhysicalDevice8BitStorageFeaturesKHR storage_8bit_features             = {};
-  VkPhysicalDevice16BitStorageFeaturesKHR storage_16bit_features           = {};
-  VkPhysicalDeviceFloat16Int8FeaturesKHR float16_int8_features             = {};
-  VkPhysicalDeviceFloatControlsPropertiesKHR float_control_properties      = {};
-  VkPhysicalDeviceIDProperties id_properties                               = {};
+  VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_semaphore_features       = {};
+  VkPhysicalDevicePerformanceQueryFeaturesKHR performance_query_features         = {};
+  VkPhysicalDeviceDriverPropertiesKHR driver_properties                          = {};
+  VkPhysicalDeviceSynchronization2FeaturesKHR sync2_features                     = {};
+  VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamic_rendering_features         = {};
+  VkPhysicalDeviceImagelessFramebufferFeaturesKHR imageless_framebuffer_features = {};
+  VkPhysicalDevicePresentIdFeaturesKHR present_id_features                       = {};
+  VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features                   = {};
+  VkPhysicalDevice8BitStorageFeaturesKHR storage_8bit_features                   = {};
+  VkPhysicalDevice16BitStorageFeaturesKHR storage_16bit_features                 = {};
+  VkPhysicalDeviceFloat16Int8FeaturesKHR float16_int8_features                   = {};
+  VkPhysicalDeviceFloatControlsPropertiesKHR float_control_properties            = {};
+  VkPhysicalDeviceIDProperties id_properties                                     = {};
 
   // EXT
   VkPhysicalDeviceExternalMemoryHostPropertiesEXT host_memory_properties            = {};
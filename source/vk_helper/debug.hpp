@@ -54,9 +54,15 @@ public:
   void set_obj_name(const VkQueue& object, const char* name) const {
     set_obj_name(object, name, VK_OBJECT_TYPE_QUEUE);
   }
+  void set_obj_name(const VkQueryPool& object, const char* name) const {
+    set_obj_name(object, name, VK_OBJECT_TYPE_QUERY_POOL);
+  }
   void set_obj_name(const VkRenderPass& object, const char* name) const {
     set_obj_name(object, name, VK_OBJECT_TYPE_RENDER_PASS);
   }
+  void set_obj_name(const VkSampler& object, const char* name) const {
+    set_obj_name(object, name, VK_OBJECT_TYPE_SAMPLER);
+  }
   void set_obj_name(const VkSemaphore& object, const char* name) const {
     set_obj_name(object, name, VK_OBJECT_TYPE_SEMAPHORE);
   }
@@ -1,4 +1,5 @@
 #include "device.hpp"
+#include <algorithm>
 #include "debug.hpp"
 #include "logging.hpp"
 
@@ -11,6 +12,7 @@ Device::~Device() {
   if (m_device != VK_NULL_HANDLE) {
     vkDeviceWaitIdle(m_device);
   }
+  m_queue_states.clear();
   if (m_device != VK_NULL_HANDLE) {
     vkDestroyDevice(m_device, nullptr);
   }
@@ -26,9 +28,77 @@ void Device::set_context(Context& ctx) {
   m_mem_props  = ctx.m_mem_props;
 
   init_vma();
+  init_queue_states();
   display_info();
 }
 
+void Device::init_queue_states() {
+  for (int i = 0; i < QUEUE_INDEX_COUNT; i++) {
+    VkQueue queue = m_queue_info.queues[i];
+    if (queue == VK_NULL_HANDLE) {
+      continue;
+    }
+    auto it = std::find_if(m_queue_states.begin(), m_queue_states.end(),
+                           [queue](const auto& state) { return state->queue == queue; });
+    if (it != m_queue_states.end()) {
+      m_queue_state_by_index[i] = it->get();
+      continue;
+    }
+    auto state      = std::make_unique<QueueState>();
+    state->queue    = queue;
+    state->timeline = std::make_unique<Timeline>(*this, std::string(QUEUE_NAMES[i]) + " timeline");
+    state->submitter =
+        std::make_unique<QueueSubmitter>(queue, *state->timeline, state->submit_mutex);
+    m_queue_state_by_index[i] = state.get();
+    m_queue_states.emplace_back(std::move(state));
+  }
+}
+
+Timeline& Device::get_timeline(QueueIndices queue_index) const {
+  VK_ASSERT(m_queue_state_by_index[queue_index] != nullptr);
+  return *m_queue_state_by_index[queue_index]->timeline;
+}
+
+QueueSubmitter& Device::get_submitter(QueueIndices queue_index) const {
+  VK_ASSERT(m_queue_state_by_index[queue_index] != nullptr);
+  return *m_queue_state_by_index[queue_index]->submitter;
+}
+
+uint64_t Device::submit(QueueIndices queue_index, const SubmitBatch& batch, VkFence fence) const {
+  auto& submitter             = get_submitter(queue_index);
+  const uint64_t signal_value = submitter.enqueue(batch);
+  submitter.flush(fence);
+  return signal_value;
+}
+
+void Device::next_frame() const {
+  for (const auto& state : m_queue_states) {
+    state->submitter->next_frame();
+  }
+}
+
+VkResult Device::present(const VkPresentInfoKHR& present_info) const {
+  auto* state = m_queue_state_by_index[QUEUE_INDEX_GRAPHICS];
+  std::lock_guard<std::mutex> lock(state->submit_mutex);
+  return vkQueuePresentKHR(state->queue, &present_info);
+}
+
+void Device::wait_queue_idle(QueueIndices queue_index) const {
+  // values of batches which are still pending would never be signaled otherwise
+  get_submitter(queue_index).flush();
+  get_timeline(queue_index).wait_idle();
+}
+
+void Device::create_image(const VkImageCreateInfo& image_ci, VkImage* image,
+                          const std::string& name) const {
+  VK_CHECK(vkCreateImage(m_device, &image_ci, nullptr, image), "vkCreateImage");
+  DebugUtil::get().set_obj_name(*image, name.data());
+}
+
+void Device::destroy_image(VkImage image) const {
+  vkDestroyImage(m_device, image, nullptr);
+}
+
 void Device::create_image_view(const VkImageViewCreateInfo& image_view_ci, VkImageView* image_view,
                                const std::string& name) const {
   VK_CHECK(vkCreateImageView(m_device, &image_view_ci, nullptr, image_view), "vkCreateImageView");
@@ -39,6 +109,42 @@ void Device::destroy_image_view(VkImageView image_view) const {
   vkDestroyImageView(m_device, image_view, nullptr);
 }
 
+void Device::create_sampler(const VkSamplerCreateInfo& sampler_ci, VkSampler* sampler,
+                            const std::string& name) const {
+  VK_CHECK(vkCreateSampler(m_device, &sampler_ci, nullptr, sampler), "vkCreateSampler");
+  DebugUtil::get().set_obj_name(*sampler, name.data());
+}
+
+void Device::destroy_sampler(VkSampler sampler) const {
+  vkDestroySampler(m_device, sampler, nullptr);
+}
+
+void Device::create_query_pool(const VkQueryPoolCreateInfo& query_pool_ci, VkQueryPool* query_pool,
+                               const std::string& name) const {
+  VK_CHECK(vkCreateQueryPool(m_device, &query_pool_ci, nullptr, query_pool), "vkCreateQueryPool");
+  DebugUtil::get().set_obj_name(*query_pool, name.data());
+}
+
+void Device::destroy_query_pool(VkQueryPool query_pool) const {
+  vkDestroyQueryPool(m_device, query_pool, nullptr);
+}
+
+bool Device::get_query_results(VkQueryPool query_pool, uint32_t first_query, uint32_t count,
+                               uint64_t* results) const {
+  const VkResult result =
+      vkGetQueryPoolResults(m_device, query_pool, first_query, count, count * sizeof(uint64_t),
+                            results, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+  if (result == VK_NOT_READY) {
+    return false;
+  }
+  VK_CHECK(result, "vkGetQueryPoolResults");
+  return true;
+}
+
+float Device::get_timestamp_period() const {
+  return m_queue_info.timestamp_valid_bits > 0 ? m_gpu_props.limits.timestampPeriod : 0.0f;
+}
+
 VkDevice Device::handle() const {
   return m_device;
 }
@@ -120,6 +226,14 @@ void Device::destroy_shader_module(VkShaderModule shader_module) const {
   vkDestroyShaderModule(m_device, shader_module, nullptr);
 }
 
+void Device::destroy_pipeline(VkPipeline pipeline) const {
+  vkDestroyPipeline(m_device, pipeline, nullptr);
+}
+
+void Device::destroy_pipeline_layout(VkPipelineLayout pipeline_layout) const {
+  vkDestroyPipelineLayout(m_device, pipeline_layout, nullptr);
+}
+
 void Device::create_semaphore(const VkSemaphoreCreateInfo& semaphore_ci, VkSemaphore* semaphore,
                               const std::string& name) const {
   VK_CHECK(vkCreateSemaphore(m_device, &semaphore_ci, nullptr, semaphore), "vkCreateSemaphore");
@@ -150,6 +264,10 @@ void Device::destroy_command_pool(VkCommandPool cmd_pool) const {
   vkDestroyCommandPool(m_device, cmd_pool, nullptr);
 }
 
+void Device::reset_command_pool(VkCommandPool cmd_pool) const {
+  VK_CHECK(vkResetCommandPool(m_device, cmd_pool, 0), "vkResetCommandPool");
+}
+
 void Device::allocate_command_buffer(const VkCommandBufferAllocateInfo& info,
                                      VkCommandBuffer* cmd_buffer, const std::string& name) const {
   VK_CHECK(vkAllocateCommandBuffers(m_device, &info, cmd_buffer), "vkAllocateCommandBuffers");
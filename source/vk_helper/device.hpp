@@ -1,7 +1,11 @@
 #ifndef ZENENGINE_DEVICE_HPP
 #define ZENENGINE_DEVICE_HPP
+#include <memory>
+#include <mutex>
 #include <string>
 #include "context.hpp"
+#include "queue_submitter.hpp"
+#include "timeline.hpp"
 
 namespace zen::vkh {
 class Device {
@@ -13,11 +17,34 @@ public:
   uint32_t graphics_queue_family_index() const {
     return m_queue_info.family_indices[QUEUE_INDEX_GRAPHICS];
   }
+  uint32_t compute_queue_family_index() const {
+    return m_queue_info.family_indices[QUEUE_INDEX_COMPUTE];
+  }
+  uint32_t transfer_queue_family_index() const {
+    return m_queue_info.family_indices[QUEUE_INDEX_TRANSFER];
+  }
+  // true if compute work can run concurrently with graphics work on its own queue
+  bool has_async_compute_queue() const { return compute_queue() != graphics_queue(); }
   VkQueue graphics_queue() const { return m_queue_info.queues[QUEUE_INDEX_GRAPHICS]; }
   VkQueue compute_queue() const { return m_queue_info.queues[QUEUE_INDEX_COMPUTE]; }
   VkQueue transfer_queue() const { return m_queue_info.queues[QUEUE_INDEX_TRANSFER]; }
   VkQueue present_queue() const { return m_queue_info.queues[QUEUE_INDEX_GRAPHICS]; }
 
+  // Queue indices sharing a VkQueue (e.g. compute falling back to graphics) share a timeline
+  // and a submitter.
+  Timeline& get_timeline(QueueIndices queue_index) const;
+  QueueSubmitter& get_submitter(QueueIndices queue_index) const;
+  // Enqueues the batch and flushes the queue right away, returns the signaled timeline value.
+  // Prefer get_submitter().enqueue() and one flush per frame for work from several systems.
+  uint64_t submit(QueueIndices queue_index, const SubmitBatch& batch,
+                  VkFence fence = VK_NULL_HANDLE) const;
+  // Rolls the per-frame submit counters of all queues.
+  void next_frame() const;
+  // Presents on the graphics queue, serialized with submissions to it.
+  VkResult present(const VkPresentInfoKHR& present_info) const;
+  // Waits on the CPU until everything submitted to the queue so far has finished.
+  void wait_queue_idle(QueueIndices queue_index) const;
+
   void create_render_pass(const VkRenderPassCreateInfo& info, VkRenderPass* render_pass, const std::string& name) const;
   void destroy_render_pass(VkRenderPass render_pass) const;
 
@@ -27,6 +54,9 @@ public:
   void create_shader_module(const VkShaderModuleCreateInfo& info, VkShaderModule* shader_module, const std::string& name) const;
   void destroy_shader_module(VkShaderModule shader_module) const;
 
+  void destroy_pipeline(VkPipeline pipeline) const;
+  void destroy_pipeline_layout(VkPipelineLayout pipeline_layout) const;
+
   void create_semaphore(const VkSemaphoreCreateInfo& semaphore_ci, VkSemaphore* semaphore,
                         const std::string& name) const;
   void destroy_semaphore(VkSemaphore semaphore) const;
@@ -36,16 +66,32 @@ public:
 
   void create_command_pool(const VkCommandPoolCreateInfo& info, VkCommandPool* cmd_pool, const std::string& name) const;
   void destroy_command_pool(VkCommandPool cmd_pool) const;
+  void reset_command_pool(VkCommandPool cmd_pool) const;
 
   void allocate_command_buffer(const VkCommandBufferAllocateInfo& info, VkCommandBuffer* cmd_buffer, const std::string& name) const;
 
   void create_swapchain(const VkSwapchainCreateInfoKHR& info, VkSwapchainKHR* swapchain, const std::string& name) const;
   void destroy_swapchain(VkSwapchainKHR swapchain) const;
 
+  void create_image(const VkImageCreateInfo& image_ci, VkImage* image,
+                    const std::string& name) const;
+  void destroy_image(VkImage image) const;
+
   void create_image_view(const VkImageViewCreateInfo& image_view_ci, VkImageView* image_view,
                          const std::string& name) const;
   void destroy_image_view(VkImageView image_view) const;
 
+  void create_sampler(const VkSamplerCreateInfo& sampler_ci, VkSampler* sampler,
+                      const std::string& name) const;
+  void destroy_sampler(VkSampler sampler) const;
+
+  void create_query_pool(const VkQueryPoolCreateInfo& query_pool_ci, VkQueryPool* query_pool,
+                         const std::string& name) const;
+  void destroy_query_pool(VkQueryPool query_pool) const;
+  // Copies count 64 bit results without waiting, false if any of them is not available yet.
+  bool get_query_results(VkQueryPool query_pool, uint32_t first_query, uint32_t count,
+                         uint64_t* results) const;
+
   std::vector<VkSurfaceFormatKHR> get_surface_formats(VkSurfaceKHR surface) const;
   std::vector<VkPresentModeKHR> get_surface_present_modes(VkSurfaceKHR surface) const;
   VkSurfaceCapabilitiesKHR get_surface_capabilities(VkSurfaceKHR surface) const;
@@ -53,9 +99,21 @@ public:
   VkDevice handle() const;
   VmaAllocator get_allocator() const;
   VkPhysicalDevice get_gpu() const;
+  const DeviceFeatures& get_features() const { return m_features; }
+  // nanoseconds per timestamp tick, 0 if the graphics queue does not write timestamps
+  float get_timestamp_period() const;
 
 private:
+  struct QueueState {
+    VkQueue queue{VK_NULL_HANDLE};
+    std::unique_ptr<Timeline> timeline;
+    std::unique_ptr<QueueSubmitter> submitter;
+    // vkQueueSubmit and vkQueuePresentKHR require external synchronization of the queue
+    std::mutex submit_mutex;
+  };
+
   void init_vma();
+  void init_queue_states();
   void display_info();
 
   VkInstance m_instance{nullptr};
@@ -66,6 +124,8 @@ private:
   VkPhysicalDeviceProperties m_gpu_props{};
   DeviceFeatures m_features;
   VmaAllocator m_allocator{VK_NULL_HANDLE};
+  std::vector<std::unique_ptr<QueueState>> m_queue_states;
+  QueueState* m_queue_state_by_index[QUEUE_INDEX_COUNT]{};
 };
 }  // namespace zen::vkh
 #endif  //EASYGRAPHICS_DEVICE_HPP
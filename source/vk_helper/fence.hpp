@@ -1,5 +1,6 @@
 #ifndef ZENENGINE_FENCE_HPP
 #define ZENENGINE_FENCE_HPP
+#include <limits>
 #include <string>
 #include "base.hpp"
 
@@ -19,6 +20,8 @@ public:
 
   VkResult status() const;
 
+  VkFence handle() const { return m_fence; }
+
 private:
   const Device& m_device;
   VkFence m_fence{nullptr};
@@ -0,0 +1,163 @@
+#include "frame_context.hpp"
+#include <algorithm>
+#include <chrono>
+#include "command_buffer.hpp"
+#include "device.hpp"
+#include "logging.hpp"
+#include "swapchain.hpp"
+
+namespace zen::vkh {
+FrameContext::FrameContext(const Device& device, uint32_t index)
+    : m_index(index),
+      m_fence(device, "frame fence " + std::to_string(index), true),
+      m_acquire_semaphore(device, "acquire semaphore " + std::to_string(index)),
+      m_descriptor_allocator(device) {}
+
+FrameContextRing::FrameContextRing(const Device& device, Swapchain& swapchain,
+                                   uint32_t frames_in_flight, uint32_t recording_threads)
+    : m_device(device),
+      m_swapchain(swapchain),
+      m_cmd_allocator(device, device.graphics_queue_family_index(),
+                      std::clamp(frames_in_flight, 2u, 3u), recording_threads, "frame") {
+  frames_in_flight = m_cmd_allocator.frame_count();
+  for (uint32_t i = 0; i < frames_in_flight; i++) {
+    m_frames.emplace_back(std::make_unique<FrameContext>(device, i));
+  }
+  create_render_finished_semaphores();
+  logger::info("Using {} frames in flight", frames_in_flight);
+}
+
+FrameContextRing::~FrameContextRing() {
+  wait_idle();
+}
+
+void FrameContextRing::create_render_finished_semaphores() {
+  m_render_finished_semaphores.clear();
+  for (uint32_t i = 0; i < m_swapchain.get_image_count(); i++) {
+    m_render_finished_semaphores.emplace_back(
+        std::make_unique<Semaphore>(m_device, "render finished semaphore " + std::to_string(i)));
+  }
+}
+
+void FrameContextRing::collect_retired_semaphores() {
+  const auto& timeline = m_device.get_timeline(QUEUE_INDEX_GRAPHICS);
+
+  // retired in submission order like the swapchains
+  const auto it = std::find_if(m_retired_semaphores.begin(), m_retired_semaphores.end(),
+                               [&](const auto& retired) {
+                                 return !timeline.is_complete(retired.retire_value);
+                               });
+  m_retired_semaphores.erase(m_retired_semaphores.begin(), it);
+}
+
+void FrameContextRing::enable_frame_pacing(const FramePacingConfig& config) {
+  m_pacer = std::make_unique<FramePacer>(m_device, m_swapchain, config);
+}
+
+void FrameContextRing::wait_for_frame_start() {
+  if (m_pacer) {
+    m_pacer->wait_for_frame_start();
+    m_stats.latency = m_pacer->stats();
+  }
+}
+
+bool FrameContextRing::begin_frame() {
+  VK_ASSERT(!m_frame_active);
+  auto& frame = current_frame();
+
+  const auto wait_begin = std::chrono::high_resolution_clock::now();
+  frame.fence().block();
+  const auto wait_end = std::chrono::high_resolution_clock::now();
+  m_stats.fence_wait_ms =
+      std::chrono::duration<float, std::chrono::milliseconds::period>(wait_end - wait_begin)
+          .count();
+  // exponential moving average, smooths out single frame spikes
+  m_stats.avg_fence_wait_ms = m_stats.avg_fence_wait_ms * 0.95f + m_stats.fence_wait_ms * 0.05f;
+
+  // the GPU is done with everything this context recorded last time
+  m_cmd_allocator.begin_frame(frame.index());
+  frame.descriptor_allocator().reset_pools();
+  m_swapchain.collect_retired();
+  collect_retired_semaphores();
+
+  const VkResult result =
+      m_swapchain.acquire_next_image(frame.acquire_semaphore().semaphore(), m_image_index);
+  if (result == VK_SUBOPTIMAL_KHR || result == VK_ERROR_OUT_OF_DATE_KHR) {
+    m_swapchain_out_of_date = true;
+  }
+  // a suboptimal image was acquired and can still be presented
+  if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+    if (result != VK_ERROR_OUT_OF_DATE_KHR) {
+      logger::warn("Failed to acquire swapchain image, skipping frame");
+    }
+    return false;
+  }
+  m_frame_active = true;
+  return true;
+}
+
+void FrameContextRing::end_frame(const std::vector<VkCommandBuffer>& cmd_buffers,
+                                 const std::vector<TimelineWait>& timeline_waits) {
+  VK_ASSERT(m_frame_active);
+  auto& frame = current_frame();
+
+  SubmitBatch batch;
+  batch.cmd_buffers    = cmd_buffers;
+  batch.timeline_waits = timeline_waits;
+  batch.binary_waits.push_back(
+      {frame.acquire_semaphore().semaphore(), VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT});
+  batch.binary_signals.push_back(render_finished_semaphore().semaphore());
+
+  // Work other systems enqueued on the graphics queue during the frame goes out with the same
+  // vkQueueSubmit call.
+  auto& submitter        = m_device.get_submitter(QUEUE_INDEX_GRAPHICS);
+  frame.m_timeline_value = submitter.enqueue(std::move(batch));
+  // only reset right before the submit which signals it again, otherwise a skipped frame
+  // would leave the fence unsignaled forever
+  frame.fence().reset();
+  submitter.flush(frame.fence().handle());
+
+  const uint64_t present_id = m_pacer ? m_pacer->on_frame_submitted(frame.m_timeline_value) : 0;
+  const VkResult result =
+      m_swapchain.present(m_image_index, render_finished_semaphore().semaphore(), present_id);
+  if (result == VK_SUBOPTIMAL_KHR || result == VK_ERROR_OUT_OF_DATE_KHR) {
+    m_swapchain_out_of_date = true;
+  } else if (result != VK_SUCCESS) {
+    logger::warn("Failed to present swapchain image");
+  }
+  // a suboptimal image is still presented
+  if (m_pacer && result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+    m_pacer->on_present_failed();
+  }
+
+  m_device.next_frame();
+  m_stats.graphics_submits = submitter.last_frame_stats();
+
+  m_frame_active = false;
+  m_frame_index  = (m_frame_index + 1) % frames_in_flight();
+  m_stats.frame_number++;
+}
+
+void FrameContextRing::on_swapchain_recreated() {
+  m_swapchain_out_of_date = false;
+  // retired with the same value as the old swapchain, see Swapchain::recreate()
+  const auto& timeline = m_device.get_timeline(QUEUE_INDEX_GRAPHICS);
+  m_retired_semaphores.push_back(
+      {std::move(m_render_finished_semaphores), timeline.last_submitted_value() + 1});
+  create_render_finished_semaphores();
+  if (m_pacer) {
+    m_pacer->reset();
+  }
+}
+
+CommandBuffer& FrameContextRing::request_command_buffer(uint32_t thread_index,
+                                                        VkCommandBufferLevel level) {
+  return m_cmd_allocator.request_command_buffer(thread_index, level);
+}
+
+void FrameContextRing::wait_idle() {
+  for (auto& frame : m_frames) {
+    frame->fence().block();
+  }
+}
+}  // namespace zen::vkh
@@ -0,0 +1,122 @@
+#ifndef ZENENGINE_FRAME_CONTEXT_HPP
+#define ZENENGINE_FRAME_CONTEXT_HPP
+#include <memory>
+#include <vector>
+#include "base.hpp"
+#include "command_pool.hpp"
+#include "descriptor.hpp"
+#include "fence.hpp"
+#include "frame_pacer.hpp"
+#include "queue_submitter.hpp"
+#include "semaphore.hpp"
+
+namespace zen::vkh {
+class CommandBuffer;
+class Device;
+class Swapchain;
+
+/// Resources owned by one frame in flight. They are only recycled once the frame's fence
+/// signalled, i.e. once the GPU finished the work recorded the last time this slot was used.
+class FrameContext {
+public:
+  ZEN_NO_COPY_MOVE(FrameContext)
+  FrameContext(const Device& device, uint32_t index);
+  ~FrameContext() = default;
+
+  uint32_t index() const { return m_index; }
+  Fence& fence() { return m_fence; }
+  Semaphore& acquire_semaphore() { return m_acquire_semaphore; }
+  DescriptorAllocator& descriptor_allocator() { return m_descriptor_allocator; }
+  // graphics timeline value signaled by this frame's submission
+  uint64_t timeline_value() const { return m_timeline_value; }
+
+private:
+  friend class FrameContextRing;
+
+  uint32_t m_index;
+  Fence m_fence;
+  Semaphore m_acquire_semaphore;
+  DescriptorAllocator m_descriptor_allocator;
+  uint64_t m_timeline_value{0};
+};
+
+struct FrameStats {
+  uint64_t frame_number{0};
+  // CPU time spent blocked on the frame fence. Consistently high values mean we are GPU-bound.
+  float fence_wait_ms{0.0f};
+  float avg_fence_wait_ms{0.0f};
+  SubmitStats graphics_submits{};
+  // only updated with frame pacing enabled
+  LatencyStats latency{};
+};
+
+/// Ring of 2-3 frame contexts driving the acquire/submit/present loop. While the GPU executes
+/// frame N the CPU can already record frame N + 1 into the next context.
+class FrameContextRing {
+public:
+  ZEN_NO_COPY_MOVE(FrameContextRing)
+  FrameContextRing(const Device& device, Swapchain& swapchain, uint32_t frames_in_flight = 2,
+                   uint32_t recording_threads = 1);
+  ~FrameContextRing();
+
+  // Frame pacing bounds the frames queued for presentation, see FramePacer.
+  void enable_frame_pacing(const FramePacingConfig& config);
+  // Call before sampling input, blocks until the next frame should start. No-op without pacing.
+  void wait_for_frame_start();
+  // Waits for the next frame context to become free, recycles its resources and acquires a
+  // swapchain image. Returns false if no image could be acquired, the frame must then be skipped.
+  // Retired swapchains whose frames finished are destroyed here.
+  bool begin_frame();
+  // Submits the recorded command buffers and presents the acquired image. The submission
+  // additionally waits on timeline_waits, e.g. async compute work the frame consumes.
+  void end_frame(const std::vector<VkCommandBuffer>& cmd_buffers,
+                 const std::vector<TimelineWait>& timeline_waits = {});
+
+  FrameContext& current_frame() { return *m_frames[m_frame_index]; }
+  FrameCommandAllocator& command_allocator() { return m_cmd_allocator; }
+  CommandBuffer& request_command_buffer(
+      uint32_t thread_index      = 0,
+      VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+  uint32_t frames_in_flight() const { return static_cast<uint32_t>(m_frames.size()); }
+  uint32_t swapchain_image_index() const { return m_image_index; }
+  // Set when acquire or present reported the swapchain as out of date or suboptimal, it should
+  // be recreated before the next frame.
+  bool swapchain_out_of_date() const { return m_swapchain_out_of_date; }
+  // Call after Swapchain::recreate(), frames in flight are not waited for. The present
+  // semaphores of the old images are retired like the old swapchain.
+  void on_swapchain_recreated();
+  // waited on by the present of the acquired image
+  Semaphore& render_finished_semaphore() { return *m_render_finished_semaphores[m_image_index]; }
+  const FrameStats& stats() const { return m_stats; }
+
+  // Blocks until every frame in flight has finished on the GPU.
+  void wait_idle();
+
+private:
+  // semaphores of an old swapchain whose presents may still wait on them
+  struct RetiredSemaphores {
+    std::vector<std::unique_ptr<Semaphore>> semaphores;
+    uint64_t retire_value;
+  };
+
+  void create_render_finished_semaphores();
+  void collect_retired_semaphores();
+
+  const Device& m_device;
+  Swapchain& m_swapchain;
+  std::vector<std::unique_ptr<FrameContext>> m_frames;
+  // One per swapchain image rather than per frame: the frame fence does not cover the present,
+  // only acquiring the same image again guarantees its last present consumed the signal.
+  std::vector<std::unique_ptr<Semaphore>> m_render_finished_semaphores;
+  std::vector<RetiredSemaphores> m_retired_semaphores;
+  FrameCommandAllocator m_cmd_allocator;
+  std::unique_ptr<FramePacer> m_pacer;
+  uint32_t m_frame_index{0};
+  uint32_t m_image_index{0};
+  bool m_frame_active{false};
+  bool m_swapchain_out_of_date{false};
+  FrameStats m_stats{};
+};
+}  // namespace zen::vkh
+#endif  //ZENENGINE_FRAME_CONTEXT_HPP
@@ -0,0 +1,95 @@
+#include "frame_pacer.hpp"
+#include <algorithm>
+#include <thread>
+#include "device.hpp"
+#include "logging.hpp"
+#include "swapchain.hpp"
+
+namespace zen::vkh {
+namespace {
+using Milliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>;
+// a present wait should never take this long, e.g. the window is minimized
+constexpr uint64_t PRESENT_WAIT_TIMEOUT = 100'000'000;
+}  // namespace
+
+FramePacer::FramePacer(const Device& device, const Swapchain& swapchain,
+                       const FramePacingConfig& config)
+    : m_swapchain(swapchain),
+      m_timeline(device.get_timeline(QUEUE_INDEX_GRAPHICS)),
+      m_config(config) {
+  m_config.max_queued_frames = std::max(m_config.max_queued_frames, 1u);
+  m_use_present_id           = device.get_features().supports_present_wait;
+  m_stats.present_wait       = m_use_present_id;
+  logger::info("Frame pacing with at most {} queued frames on {}", m_config.max_queued_frames,
+               m_use_present_id ? "present wait" : "GPU completion");
+}
+
+void FramePacer::wait_for_frame_start() {
+  while (m_queued_frames.size() >= m_config.max_queued_frames) {
+    retire_oldest_frame();
+  }
+
+  m_stats.sleep_ms = 0.0f;
+  if (m_config.late_input_sampling && m_stats.present_interval_ms > 0.0f) {
+    // the next frame is shown one present interval after every frame still queued
+    const float until_deadline_ms =
+        m_stats.present_interval_ms * float(m_queued_frames.size() + 1) -
+        Milliseconds(Clock::now() - m_last_present_time).count();
+    const float sleep_ms = until_deadline_ms - m_stats.frame_time_ms - m_config.safety_margin_ms;
+    if (sleep_ms > 0.0f) {
+      std::this_thread::sleep_for(Milliseconds(sleep_ms));
+      m_stats.sleep_ms = sleep_ms;
+    }
+  }
+  m_input_time = Clock::now();
+}
+
+uint64_t FramePacer::on_frame_submitted(uint64_t timeline_value) {
+  const uint64_t present_id = m_use_present_id ? m_next_present_id++ : 0;
+  m_queued_frames.push_back({present_id, timeline_value, m_input_time});
+  return present_id;
+}
+
+void FramePacer::on_present_failed() {
+  if (!m_queued_frames.empty()) {
+    m_queued_frames.back().present_id = 0;
+  }
+}
+
+void FramePacer::reset() {
+  m_queued_frames.clear();
+  m_next_present_id           = 1;
+  m_last_present_time         = {};
+  m_stats.present_interval_ms = 0.0f;
+}
+
+void FramePacer::retire_oldest_frame() {
+  const QueuedFrame frame = m_queued_frames.front();
+  m_queued_frames.pop_front();
+
+  // With one queued frame this runs right after the submission, the wait returns when the GPU
+  // finished and the frame time is exact.
+  m_timeline.wait(frame.timeline_value);
+  const auto gpu_done_time  = Clock::now();
+  const float frame_time_ms = Milliseconds(gpu_done_time - frame.input_time).count();
+  // rise fast and decay slowly, underestimating misses the deadline
+  m_stats.frame_time_ms = std::max(frame_time_ms, m_stats.frame_time_ms * 0.95f);
+
+  bool presented = false;
+  if (frame.present_id != 0) {
+    presented = m_swapchain.wait_for_present(frame.present_id, PRESENT_WAIT_TIMEOUT);
+  }
+  const auto present_time = presented ? Clock::now() : gpu_done_time;
+  if (m_last_present_time != Clock::time_point{}) {
+    const float interval_ms = Milliseconds(present_time - m_last_present_time).count();
+    m_stats.present_interval_ms = m_stats.present_interval_ms == 0.0f
+                                      ? interval_ms
+                                      : m_stats.present_interval_ms * 0.9f + interval_ms * 0.1f;
+  }
+  m_last_present_time = present_time;
+
+  m_stats.input_to_present_ms = Milliseconds(present_time - frame.input_time).count();
+  m_stats.avg_input_to_present_ms =
+      m_stats.avg_input_to_present_ms * 0.95f + m_stats.input_to_present_ms * 0.05f;
+}
+}  // namespace zen::vkh
@@ -0,0 +1,81 @@
+#ifndef ZENENGINE_FRAME_PACER_HPP
+#define ZENENGINE_FRAME_PACER_HPP
+#include <chrono>
+#include <deque>
+#include "base.hpp"
+
+namespace zen::vkh {
+class Device;
+class Swapchain;
+class Timeline;
+
+struct FramePacingConfig {
+  // Frames submitted but not yet presented. 1 gives the lowest latency, more frames keep the GPU
+  // busy when CPU frame times vary.
+  uint32_t max_queued_frames{1};
+  // Sleeps before input sampling so the frame finishes right before its present deadline.
+  bool late_input_sampling{true};
+  // headroom on top of the predicted frame time, a missed deadline costs a whole refresh
+  float safety_margin_ms{1.5f};
+};
+
+struct LatencyStats {
+  // pacing on VK_KHR_present_wait, otherwise on GPU completion of the frame
+  bool present_wait{false};
+  float sleep_ms{0.0f};
+  float present_interval_ms{0.0f};
+  // predicted time from input sampling until the GPU finished the frame
+  float frame_time_ms{0.0f};
+  // from input sampling until the frame was presented, or finished on the GPU without present
+  // wait
+  float input_to_present_ms{0.0f};
+  float avg_input_to_present_ms{0.0f};
+};
+
+/// Bounds the number of frames queued for presentation and delays the start of the next frame,
+/// so input is sampled as late as possible while the frame still makes the next vblank.
+///
+/// With VK_KHR_present_wait every present gets an id and the pacer waits until the frame
+/// max_queued_frames back is on screen. Without it the graphics timeline bounds the queue
+/// instead, present timing is then only approximated by GPU completion.
+class FramePacer {
+public:
+  ZEN_NO_COPY_MOVE(FramePacer)
+  FramePacer(const Device& device, const Swapchain& swapchain, const FramePacingConfig& config);
+  ~FramePacer() = default;
+
+  // Call right before sampling input for the next frame.
+  void wait_for_frame_start();
+  // Returns the id to present the frame with, 0 without VK_KHR_present_id. timeline_value is the
+  // graphics timeline value the frame's submission signals.
+  uint64_t on_frame_submitted(uint64_t timeline_value);
+  // The present of the last submitted frame failed, its id will never complete and is not
+  // waited for. The id stays used, present ids only grow.
+  void on_present_failed();
+  // Present ids start over for a new swapchain, frames queued on the old one are dropped.
+  void reset();
+
+  const LatencyStats& stats() const { return m_stats; }
+
+private:
+  using Clock = std::chrono::steady_clock;
+  struct QueuedFrame {
+    uint64_t present_id;
+    uint64_t timeline_value;
+    Clock::time_point input_time;
+  };
+
+  void retire_oldest_frame();
+
+  const Swapchain& m_swapchain;
+  const Timeline& m_timeline;
+  FramePacingConfig m_config;
+  bool m_use_present_id{false};
+  uint64_t m_next_present_id{1};
+  std::deque<QueuedFrame> m_queued_frames;
+  Clock::time_point m_input_time{};
+  Clock::time_point m_last_present_time{};
+  LatencyStats m_stats{};
+};
+}  // namespace zen::vkh
+#endif  //ZENENGINE_FRAME_PACER_HPP
@@ -27,4 +27,120 @@ uint32_t Framebuffer::get_max_layers(const std::vector<ImageInfo>& image_infos)
 
   return max_element->layer_count;
 }
+
+/** FramebufferCache **/
+FramebufferCache::FramebufferCache(const Device& device, uint32_t max_unused_frames)
+    : m_device(device),
+      m_imageless(device.get_features().supports_imageless_framebuffer),
+      m_max_unused_frames(max_unused_frames) {}
+
+FramebufferCache::~FramebufferCache() {
+  cleanup();
+}
+
+void FramebufferCache::cleanup() {
+  for (const auto& p : m_framebuffer_cache) {
+    m_device.destroy_framebuffer(p.second.framebuffer);
+  }
+  m_framebuffer_cache.clear();
+}
+
+VkFramebuffer FramebufferCache::get_or_create(VkRenderPass render_pass,
+                                              const std::vector<FramebufferAttachment>& attachments,
+                                              VkExtent2D extent, uint32_t layer_count) {
+  FramebufferKey key{.render_pass = render_pass};
+  key.words.push_back(uint64_t(extent.width) << 32 | extent.height);
+  key.words.push_back(layer_count);
+  for (const auto& att : attachments) {
+    if (m_imageless) {
+      key.words.push_back(uint64_t(att.format) << 32 | att.usage);
+      key.words.push_back(uint64_t(att.extent.width) << 32 | att.extent.height);
+      key.words.push_back(att.layer_count);
+    } else {
+      key.words.push_back(reinterpret_cast<uint64_t>(att.view));
+    }
+  }
+
+  auto it = m_framebuffer_cache.find(key);
+  if (it != m_framebuffer_cache.end()) {
+    m_hits++;
+    it->second.last_used_frame = m_frame;
+    return it->second.framebuffer;
+  }
+  m_misses++;
+
+  std::vector<VkImageView> views;
+  std::vector<VkFramebufferAttachmentImageInfoKHR> image_infos;
+  for (const auto& att : attachments) {
+    views.push_back(att.view);
+    image_infos.push_back({
+        .sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENT_IMAGE_INFO_KHR,
+        .usage           = att.usage,
+        .width           = att.extent.width,
+        .height          = att.extent.height,
+        .layerCount      = att.layer_count,
+        .viewFormatCount = 1,
+        .pViewFormats    = &att.format,
+    });
+  }
+  const VkFramebufferAttachmentsCreateInfoKHR attachments_ci = {
+      .sType                    = VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENTS_CREATE_INFO_KHR,
+      .attachmentImageInfoCount = static_cast<uint32_t>(image_infos.size()),
+      .pAttachmentImageInfos    = image_infos.data(),
+  };
+  const VkFramebufferCreateInfo framebuffer_ci = {
+      .sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+      .pNext           = m_imageless ? &attachments_ci : nullptr,
+      .flags           = m_imageless ? VK_FRAMEBUFFER_CREATE_IMAGELESS_BIT_KHR : 0u,
+      .renderPass      = render_pass,
+      .attachmentCount = static_cast<uint32_t>(attachments.size()),
+      .pAttachments    = m_imageless ? nullptr : views.data(),
+      .width           = extent.width,
+      .height          = extent.height,
+      .layers          = layer_count,
+  };
+  VkFramebuffer framebuffer{VK_NULL_HANDLE};
+  m_device.create_framebuffer(framebuffer_ci, &framebuffer,
+                              m_imageless ? "imageless framebuffer" : "framebuffer");
+  if (m_imageless) {
+    views.clear();
+  }
+  m_framebuffer_cache.emplace(std::move(key), Entry{framebuffer, std::move(views), m_frame});
+  return framebuffer;
+}
+
+void FramebufferCache::next_frame() {
+  m_frame++;
+  for (auto it = m_framebuffer_cache.begin(); it != m_framebuffer_cache.end();) {
+    if (m_frame - it->second.last_used_frame > m_max_unused_frames) {
+      m_device.destroy_framebuffer(it->second.framebuffer);
+      it = m_framebuffer_cache.erase(it);
+      m_evictions++;
+    } else {
+      ++it;
+    }
+  }
+}
+
+void FramebufferCache::forget(VkImageView view) {
+  for (auto it = m_framebuffer_cache.begin(); it != m_framebuffer_cache.end();) {
+    const auto& views = it->second.views;
+    if (std::find(views.begin(), views.end(), view) != views.end()) {
+      m_device.destroy_framebuffer(it->second.framebuffer);
+      it = m_framebuffer_cache.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+size_t FramebufferCache::FramebufferKey::hash() const {
+  // FNV-1a over the render pass and the attachment words
+  uint64_t result = 14695981039346656037ull;
+  result          = (result ^ reinterpret_cast<uint64_t>(render_pass)) * 1099511628211ull;
+  for (uint64_t word : words) {
+    result = (result ^ word) * 1099511628211ull;
+  }
+  return static_cast<size_t>(result);
+}
 }  // namespace zen::vkh
\ No newline at end of file
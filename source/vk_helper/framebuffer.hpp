@@ -1,5 +1,7 @@
 #ifndef ZENENGINE_FRAMEBUFFER_HPP
 #define ZENENGINE_FRAMEBUFFER_HPP
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include "base.hpp"
 #include "image.hpp"
@@ -20,9 +22,79 @@ public:
   Framebuffer(const Device& device, const FramebufferInfo& info);
   ~Framebuffer();
 
+  VkFramebuffer handle() const { return m_framebuffer; }
+
 private:
   const Device& m_device;
   VkFramebuffer m_framebuffer{nullptr};
 };
-}
+
+/// An attachment as seen by a framebuffer. Imageless framebuffers only depend on the format,
+/// usage and size of the image, the view is passed when the render pass begins.
+struct FramebufferAttachment {
+  VkImageView view{VK_NULL_HANDLE};
+  VkFormat format{VK_FORMAT_UNDEFINED};
+  // must equal the usage the image was created with
+  VkImageUsageFlags usage{0};
+  VkExtent2D extent{};
+  uint32_t layer_count{1};
+};
+
+/// Framebuffers keyed by render pass and attachments. With VK_KHR_imageless_framebuffer the key
+/// holds attachment formats and extents only, so switching between swapchain images or
+/// per-frame targets of the same size reuses one framebuffer. Without it the views are keyed.
+///
+/// Framebuffers not requested for max_unused_frames calls of next_frame() are destroyed, which
+/// must cover the frames in flight that may still use them. Framebuffers keyed by swapchain views
+/// are only requested every swapchain image count frames, which has to be added on top.
+class FramebufferCache {
+public:
+  ZEN_NO_COPY_MOVE(FramebufferCache)
+  FramebufferCache(const Device& device, uint32_t max_unused_frames);
+  ~FramebufferCache();
+
+  VkFramebuffer get_or_create(VkRenderPass render_pass,
+                              const std::vector<FramebufferAttachment>& attachments,
+                              VkExtent2D extent, uint32_t layer_count = 1);
+  // If true, begin render passes with a VkRenderPassAttachmentBeginInfoKHR holding the views.
+  bool is_imageless() const { return m_imageless; }
+  void next_frame();
+  // Destroys the framebuffers referencing the view, its handle may be reused. The GPU must not
+  // use them anymore.
+  void forget(VkImageView view);
+  void cleanup();
+
+  uint32_t get_hit_count() const { return m_hits; }
+  uint32_t get_miss_count() const { return m_misses; }
+  uint32_t get_eviction_count() const { return m_evictions; }
+
+  struct FramebufferKey {
+    VkRenderPass render_pass{VK_NULL_HANDLE};
+    std::vector<uint64_t> words;
+    bool operator==(const FramebufferKey& other) const {
+      return render_pass == other.render_pass && words == other.words;
+    }
+    size_t hash() const;
+  };
+
+private:
+  struct Entry {
+    VkFramebuffer framebuffer;
+    std::vector<VkImageView> views;  // only for framebuffers with views
+    uint64_t last_used_frame;
+  };
+  struct FramebufferHash {
+    size_t operator()(const FramebufferKey& k) const { return k.hash(); }
+  };
+
+  const Device& m_device;
+  const bool m_imageless;
+  const uint32_t m_max_unused_frames;
+  uint64_t m_frame{0};
+  std::unordered_map<FramebufferKey, Entry, FramebufferHash> m_framebuffer_cache;
+  uint32_t m_hits{0};
+  uint32_t m_misses{0};
+  uint32_t m_evictions{0};
+};
+}  // namespace zen::vkh
 #endif  //ZENENGINE_FRAMEBUFFER_HPP
@@ -5,14 +5,15 @@
 
 namespace zen::vkh {
 Image::Image(const Device& device, ImageInfo info) : m_device(device), m_info(std::move(info)) {
-  VkImageAspectFlags aspect_mask;
-  if (m_info.image_usage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT) {
-    aspect_mask = VK_IMAGE_ASPECT_COLOR_BIT;
-  } else if (m_info.image_usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT) {
-    aspect_mask = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+  if (m_info.image_usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+    m_aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (m_info.format == VK_FORMAT_D16_UNORM_S8_UINT ||
+        m_info.format == VK_FORMAT_D24_UNORM_S8_UINT ||
+        m_info.format == VK_FORMAT_D32_SFLOAT_S8_UINT) {
+      m_aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
   } else {
-    spdlog::error("Image usage not supported!");
-    VK_ASSERT(false);
+    m_aspect = VK_IMAGE_ASPECT_COLOR_BIT;
   }
 
   const VkImageCreateInfo image_ci = {
@@ -24,7 +25,7 @@ Image::Image(const Device& device, ImageInfo info) : m_device(device), m_info(st
           .height = m_info.image_extent.height,
           .depth  = 1,
       },
-      .mipLevels     = 1,
+      .mipLevels     = m_info.mip_levels,
       .arrayLayers   = m_info.layer_count,
       .samples       = m_info.sample_count,
       .tiling        = VK_IMAGE_TILING_OPTIMAL,
@@ -48,9 +49,9 @@ Image::Image(const Device& device, ImageInfo info) : m_device(device), m_info(st
       .viewType = (m_info.layer_count == 1) ? VK_IMAGE_VIEW_TYPE_2D : VK_IMAGE_VIEW_TYPE_2D_ARRAY,
       .format   = m_info.format,
       .subresourceRange{
-          .aspectMask     = aspect_mask,
+          .aspectMask     = m_aspect,
           .baseMipLevel   = 0,
-          .levelCount     = 1,
+          .levelCount     = m_info.mip_levels,
           .baseArrayLayer = 0,
           .layerCount     = m_info.layer_count,
       },
@@ -59,13 +60,17 @@ Image::Image(const Device& device, ImageInfo info) : m_device(device), m_info(st
 }
 
 Image::Image(Image&& other) noexcept : m_device(other.m_device) {
-  m_allocation = other.m_allocation;
-  m_image      = other.m_image;
+  m_allocation = std::exchange(other.m_allocation, VK_NULL_HANDLE);
+  m_image      = std::exchange(other.m_image, VK_NULL_HANDLE);
   m_info       = std::move(other.m_info);
-  m_image_view = other.m_image_view;
+  m_aspect     = other.m_aspect;
+  m_image_view = std::exchange(other.m_image_view, VK_NULL_HANDLE);
 }
 
 Image::~Image() {
+  if (m_image == VK_NULL_HANDLE) {
+    return;
+  }
   m_device.destroy_image_view(m_image_view);
   vmaDestroyImage(m_device.get_allocator(), m_image, m_allocation);
 }
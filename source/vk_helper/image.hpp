@@ -8,6 +8,7 @@ struct ImageInfo {
   VkFormat format;  //The color format.
   VkImageUsageFlags image_usage;  //The image usage flags.
   uint32_t layer_count{1};  // The image layer count
+  uint32_t mip_levels{1};  // The number of mip levels
   VkSampleCountFlagBits sample_count{VK_SAMPLE_COUNT_1_BIT};  // The sample count.
   VkExtent2D image_extent;  // The width and height of the image.
   std::string name; // The name of the VkImage used for DebugUtil.
@@ -23,11 +24,18 @@ public:
   Image& operator=(Image&&)      = delete;
   Image(const Image&)            = delete;
 
+  VkImage handle() const { return m_image; }
   VkImageView get_view() const { return m_image_view; }
+  VkFormat get_format() const { return m_info.format; }
+  VkExtent2D get_extent() const { return m_info.image_extent; }
+  VkImageAspectFlags get_aspect() const { return m_aspect; }
+  uint32_t get_layer_count() const { return m_info.layer_count; }
+  uint32_t get_mip_levels() const { return m_info.mip_levels; }
 
 private:
   const Device& m_device;
   ImageInfo m_info;
+  VkImageAspectFlags m_aspect{VK_IMAGE_ASPECT_COLOR_BIT};
   VmaAllocation m_allocation{VK_NULL_HANDLE};
   VkImage m_image{VK_NULL_HANDLE};
   VkImageView m_image_view{VK_NULL_HANDLE};
@@ -0,0 +1,50 @@
+#include "parallel_recorder.hpp"
+#include <algorithm>
+#include "command_buffer.hpp"
+#include "command_pool.hpp"
+#include "logging.hpp"
+#include "utils/thread_pool.hpp"
+
+namespace zen::vkh {
+ParallelRecorder::ParallelRecorder(util::ThreadPool& thread_pool, uint32_t min_draws_per_chunk)
+    : m_thread_pool(thread_pool), m_min_draws_per_chunk(std::max(min_draws_per_chunk, 1u)) {}
+
+uint32_t ParallelRecorder::chunk_size(uint32_t draw_count) const {
+  // A few chunks per worker keeps them busy when draw costs are uneven, while the minimum size
+  // keeps the per-secondary overhead negligible.
+  const uint32_t target_chunks = m_thread_pool.size() * 4;
+  const uint32_t balanced      = (draw_count + target_chunks - 1) / target_chunks;
+  return std::max(balanced, m_min_draws_per_chunk);
+}
+
+void ParallelRecorder::record(FrameCommandAllocator& cmd_allocator, const CommandBuffer& primary,
+                              const SecondaryInheritance& inheritance, uint32_t draw_count,
+                              const RecordFunc& record_func) {
+  VK_ASSERT(cmd_allocator.thread_count() > m_thread_pool.size());
+  m_secondaries.clear();
+  if (draw_count == 0) {
+    return;
+  }
+  const uint32_t draws_per_chunk = chunk_size(draw_count);
+  m_secondaries.resize((draw_count + draws_per_chunk - 1) / draws_per_chunk, VK_NULL_HANDLE);
+
+  m_thread_pool.parallel_for(
+      draw_count, draws_per_chunk,
+      [&](uint32_t begin, uint32_t end, uint32_t chunk_index, uint32_t worker_index) {
+        auto& cmd_buffer = cmd_allocator.request_command_buffer(worker_index + 1,
+                                                                VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+        if (inheritance.rendering != nullptr) {
+          cmd_buffer.begin_secondary(*inheritance.rendering);
+        } else {
+          cmd_buffer.begin_secondary(inheritance.render_pass, inheritance.subpass,
+                                     inheritance.framebuffer);
+        }
+        record_func(cmd_buffer, begin, end);
+        cmd_buffer.end();
+        // each chunk owns its slot, no synchronization needed
+        m_secondaries[chunk_index] = cmd_buffer.handle();
+      });
+
+  primary.execute_commands(m_secondaries);
+}
+}  // namespace zen::vkh
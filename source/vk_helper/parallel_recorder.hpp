@@ -0,0 +1,57 @@
+#ifndef ZENENGINE_PARALLEL_RECORDER_HPP
+#define ZENENGINE_PARALLEL_RECORDER_HPP
+#include <functional>
+#include <vector>
+#include "base.hpp"
+
+namespace zen::util {
+class ThreadPool;
+}
+
+namespace zen::vkh {
+class CommandBuffer;
+class FrameCommandAllocator;
+
+struct SecondaryInheritance {
+  VkRenderPass render_pass{VK_NULL_HANDLE};
+  uint32_t subpass{0};
+  VkFramebuffer framebuffer{VK_NULL_HANDLE};
+  // set instead of render_pass inside dynamic rendering begun with
+  // VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR
+  const VkCommandBufferInheritanceRenderingInfoKHR* rendering{nullptr};
+};
+
+/// Splits a draw list into chunks which are recorded into secondary command buffers on worker
+/// threads and then executed from the primary command buffer in chunk order, so the result does
+/// not depend on thread scheduling.
+///
+/// Worker i records with pool (i + 1) of the FrameCommandAllocator, pool 0 is reserved for the
+/// thread recording the primary command buffer. The allocator therefore needs at least
+/// thread_pool.size() + 1 threads.
+class ParallelRecorder {
+public:
+  // Records draws [begin, end) into cmd_buffer. Viewport/scissor and bound state are not
+  // inherited by secondary command buffers and must be set again in every chunk.
+  using RecordFunc =
+      std::function<void(const CommandBuffer& cmd_buffer, uint32_t begin, uint32_t end)>;
+
+  explicit ParallelRecorder(util::ThreadPool& thread_pool, uint32_t min_draws_per_chunk = 256);
+
+  // The primary command buffer must be inside the inherited subpass, begun with
+  // VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, or the inherited dynamic rendering. Render
+  // graph passes get both from RGPass::set_secondary_command_buffers().
+  void record(FrameCommandAllocator& cmd_allocator, const CommandBuffer& primary,
+              const SecondaryInheritance& inheritance, uint32_t draw_count,
+              const RecordFunc& record_func);
+
+  uint32_t last_chunk_count() const { return static_cast<uint32_t>(m_secondaries.size()); }
+
+private:
+  uint32_t chunk_size(uint32_t draw_count) const;
+
+  util::ThreadPool& m_thread_pool;
+  uint32_t m_min_draws_per_chunk;
+  std::vector<VkCommandBuffer> m_secondaries;
+};
+}  // namespace zen::vkh
+#endif  //ZENENGINE_PARALLEL_RECORDER_HPP
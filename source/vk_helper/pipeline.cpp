@@ -24,7 +24,7 @@ PipelineBuilder& PipelineBuilder::reset() {
 
   m_depth_stencil_state = {};
 
-  m_color_blend_att   = {};
+  m_color_blend_atts.clear();
   m_color_blend_state = {};
 
   m_dynamic_state_enables.clear();
@@ -96,20 +96,31 @@ PipelineBuilder& PipelineBuilder::set_depth_stencil(bool enable_depth_test, bool
   return *this;
 }
 
-PipelineBuilder& PipelineBuilder::enable_blend(bool flag) {
-  m_color_blend_att   = color_blend_att(flag);
-  m_color_blend_state = color_blend_state_ci(1, &m_color_blend_att);
+PipelineBuilder& PipelineBuilder::enable_blend(bool flag, uint32_t color_att_count) {
+  m_color_blend_atts.assign(color_att_count, color_blend_att(flag));
+  m_color_blend_state = color_blend_state_ci(color_att_count, m_color_blend_atts.data());
   return *this;
 }
 
 VkPipeline PipelineBuilder::build(VkPipelineLayout layout, VkRenderPass render_pass,
                                   uint32_t subpass_index) {
+  return build(layout, render_pass, subpass_index, nullptr);
+}
+
+VkPipeline PipelineBuilder::build(VkPipelineLayout layout,
+                                  const VkPipelineRenderingCreateInfoKHR& rendering_info) {
+  return build(layout, VK_NULL_HANDLE, 0, &rendering_info);
+}
+
+VkPipeline PipelineBuilder::build(VkPipelineLayout layout, VkRenderPass render_pass,
+                                  uint32_t subpass_index, const void* p_next) {
   m_dynamic_state_enables = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
   m_dynamic_state         = dynamic_state_ci(m_dynamic_state_enables);
 
   VkGraphicsPipelineCreateInfo pipeline_ci{};
   // basic infos
   pipeline_ci.sType              = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipeline_ci.pNext              = p_next;
   pipeline_ci.layout             = layout;
   pipeline_ci.renderPass         = render_pass;
   pipeline_ci.flags              = 0;
@@ -135,4 +146,21 @@ VkPipeline PipelineBuilder::build(VkPipelineLayout layout, VkRenderPass render_p
   DebugUtil::get().set_obj_name(pipeline, m_name.data());
   return pipeline;
 }
+
+VkPipeline create_compute_pipeline(const Device& device, VkPipelineLayout layout,
+                                   const VkPipelineShaderStageCreateInfo& stage,
+                                   const std::string& name) {
+  VK_ASSERT(stage.stage == VK_SHADER_STAGE_COMPUTE_BIT);
+  const VkComputePipelineCreateInfo pipeline_ci = {
+      .sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+      .stage  = stage,
+      .layout = layout,
+  };
+  VkPipeline pipeline;
+  VK_CHECK(
+      vkCreateComputePipelines(device.handle(), nullptr, 1, &pipeline_ci, nullptr, &pipeline),
+      "vkCreateComputePipelines");
+  DebugUtil::get().set_obj_name(pipeline, name.data());
+  return pipeline;
+}
 }  // namespace zen::vkh
\ No newline at end of file
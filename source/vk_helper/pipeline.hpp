@@ -29,11 +29,17 @@ public:
   PipelineBuilder& set_multisample(VkSampleCountFlagBits samples);
   PipelineBuilder& set_depth_stencil(bool enable_depth_test, bool enable_depth_write,
                                      VkCompareOp depth_compare_op);
-  PipelineBuilder& enable_blend(bool flag);
+  // One blend state per color attachment of the subpass.
+  PipelineBuilder& enable_blend(bool flag, uint32_t color_att_count = 1);
 
   VkPipeline build(VkPipelineLayout layout, VkRenderPass render_pass, uint32_t subpass_index);
+  // For VK_KHR_dynamic_rendering, the attachment formats replace the render pass.
+  VkPipeline build(VkPipelineLayout layout, const VkPipelineRenderingCreateInfoKHR& rendering_info);
 
 private:
+  VkPipeline build(VkPipelineLayout layout, VkRenderPass render_pass, uint32_t subpass_index,
+                   const void* p_next);
+
   const Device& m_device;
   std::string m_name;
   std::vector<VkPipelineShaderStageCreateInfo> m_shader_stages;
@@ -55,11 +61,16 @@ private:
 
   VkPipelineDepthStencilStateCreateInfo m_depth_stencil_state{};
 
-  VkPipelineColorBlendAttachmentState m_color_blend_att{};
+  std::vector<VkPipelineColorBlendAttachmentState> m_color_blend_atts;
   VkPipelineColorBlendStateCreateInfo m_color_blend_state{};
 
   std::vector<VkDynamicState> m_dynamic_state_enables;
   VkPipelineDynamicStateCreateInfo m_dynamic_state{};
 };
+
+// Compute pipelines only consist of the shader stage and the layout.
+VkPipeline create_compute_pipeline(const Device& device, VkPipelineLayout layout,
+                                   const VkPipelineShaderStageCreateInfo& stage,
+                                   const std::string& name);
 }  // namespace zen::vkh
 #endif  //ZENENGINE_PIPELINE_HPP
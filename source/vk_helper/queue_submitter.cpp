@@ -0,0 +1,125 @@
+#include "queue_submitter.hpp"
+#include "logging.hpp"
+
+namespace zen::vkh {
+QueueSubmitter::QueueSubmitter(VkQueue queue, Timeline& timeline, std::mutex& queue_mutex)
+    : m_queue(queue), m_timeline(timeline), m_queue_mutex(queue_mutex) {}
+
+uint64_t QueueSubmitter::enqueue(SubmitBatch batch) {
+  std::lock_guard<std::mutex> lock(m_pending_mutex);
+  // reserved under the pending lock, so values increase in submission order
+  const uint64_t signal_value = m_timeline.next_value();
+  m_pending.push_back({std::move(batch), signal_value});
+  m_current_stats.batches++;
+  return signal_value;
+}
+
+namespace {
+struct SubmitGroup {
+  std::vector<VkSemaphore> wait_semaphores;
+  std::vector<uint64_t> wait_values;
+  std::vector<VkPipelineStageFlags> wait_stages;
+  std::vector<VkCommandBuffer> cmd_buffers;
+  std::vector<VkSemaphore> signal_semaphores;
+  std::vector<uint64_t> signal_values;
+  uint64_t timeline_value{0};
+};
+}  // namespace
+
+void QueueSubmitter::flush(VkFence fence) {
+  // Holding the queue lock for the whole flush keeps a concurrent flush from submitting later
+  // timeline values before ours.
+  std::lock_guard<std::mutex> queue_lock(m_queue_mutex);
+  std::vector<PendingBatch> pending;
+  {
+    std::lock_guard<std::mutex> lock(m_pending_mutex);
+    pending.swap(m_pending);
+  }
+  if (pending.empty()) {
+    if (fence != VK_NULL_HANDLE) {
+      VK_CHECK(vkQueueSubmit(m_queue, 0, nullptr, fence), "vkQueueSubmit");
+    }
+    return;
+  }
+
+  std::vector<SubmitGroup> groups;
+  groups.reserve(pending.size());
+  for (auto& [batch, signal_value] : pending) {
+    bool has_waits = !batch.binary_waits.empty();
+    for (const auto& wait : batch.timeline_waits) {
+      // waiting on our own queue's earlier work is implicit in submission order
+      has_waits |= wait.point.timeline != &m_timeline;
+    }
+    if (groups.empty() || has_waits || !groups.back().signal_semaphores.empty()) {
+      groups.emplace_back();
+    }
+    auto& group = groups.back();
+    for (const auto& wait : batch.binary_waits) {
+      group.wait_semaphores.push_back(wait.semaphore);
+      group.wait_values.push_back(0);  // ignored for binary semaphores
+      group.wait_stages.push_back(wait.stages);
+    }
+    for (const auto& wait : batch.timeline_waits) {
+      if (wait.point.timeline == &m_timeline) {
+        continue;
+      }
+      group.wait_semaphores.push_back(wait.point.timeline->handle());
+      group.wait_values.push_back(wait.point.value);
+      group.wait_stages.push_back(wait.stages);
+    }
+    group.cmd_buffers.insert(group.cmd_buffers.end(), batch.cmd_buffers.begin(),
+                             batch.cmd_buffers.end());
+    for (auto semaphore : batch.binary_signals) {
+      group.signal_semaphores.push_back(semaphore);
+      group.signal_values.push_back(0);
+    }
+    // signaling the later value implies all earlier ones of the merged batches
+    group.timeline_value = signal_value;
+  }
+
+  std::vector<VkTimelineSemaphoreSubmitInfoKHR> timeline_infos(groups.size());
+  std::vector<VkSubmitInfo> submit_infos(groups.size());
+  for (size_t i = 0; i < groups.size(); i++) {
+    auto& group = groups[i];
+    group.signal_semaphores.push_back(m_timeline.handle());
+    group.signal_values.push_back(group.timeline_value);
+
+    timeline_infos[i] = {
+        .sType                     = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,
+        .waitSemaphoreValueCount   = static_cast<uint32_t>(group.wait_values.size()),
+        .pWaitSemaphoreValues      = group.wait_values.data(),
+        .signalSemaphoreValueCount = static_cast<uint32_t>(group.signal_values.size()),
+        .pSignalSemaphoreValues    = group.signal_values.data(),
+    };
+    submit_infos[i] = {
+        .sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext                = &timeline_infos[i],
+        .waitSemaphoreCount   = static_cast<uint32_t>(group.wait_semaphores.size()),
+        .pWaitSemaphores      = group.wait_semaphores.data(),
+        .pWaitDstStageMask    = group.wait_stages.data(),
+        .commandBufferCount   = static_cast<uint32_t>(group.cmd_buffers.size()),
+        .pCommandBuffers      = group.cmd_buffers.data(),
+        .signalSemaphoreCount = static_cast<uint32_t>(group.signal_semaphores.size()),
+        .pSignalSemaphores    = group.signal_semaphores.data(),
+    };
+  }
+  VK_CHECK(vkQueueSubmit(m_queue, static_cast<uint32_t>(submit_infos.size()), submit_infos.data(),
+                         fence),
+           "vkQueueSubmit");
+
+  std::lock_guard<std::mutex> lock(m_pending_mutex);
+  m_current_stats.submit_calls++;
+  m_current_stats.submit_infos += static_cast<uint32_t>(submit_infos.size());
+}
+
+void QueueSubmitter::next_frame() {
+  std::lock_guard<std::mutex> lock(m_pending_mutex);
+  m_last_frame_stats = m_current_stats;
+  m_current_stats    = {};
+}
+
+SubmitStats QueueSubmitter::last_frame_stats() const {
+  std::lock_guard<std::mutex> lock(m_pending_mutex);
+  return m_last_frame_stats;
+}
+}  // namespace zen::vkh
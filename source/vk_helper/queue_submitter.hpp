@@ -0,0 +1,55 @@
+#ifndef ZENENGINE_QUEUE_SUBMITTER_HPP
+#define ZENENGINE_QUEUE_SUBMITTER_HPP
+#include <mutex>
+#include <vector>
+#include "base.hpp"
+#include "timeline.hpp"
+
+namespace zen::vkh {
+struct SubmitStats {
+  uint32_t submit_calls{0};  // vkQueueSubmit calls
+  uint32_t submit_infos{0};  // VkSubmitInfos after coalescing
+  uint32_t batches{0};       // enqueued batches
+};
+
+/// Collects submissions for one queue from any thread and flushes them with a single
+/// vkQueueSubmit. Consecutive batches without waits are merged into one VkSubmitInfo, a batch
+/// with waits starts a new one so the earlier work is not held back by them.
+///
+/// Every batch gets its timeline value at enqueue time. GPU work on other queues may wait on it
+/// right away, CPU waits on it only return after the next flush().
+class QueueSubmitter {
+public:
+  ZEN_NO_COPY_MOVE(QueueSubmitter)
+  // queue_mutex guards every use of the VkQueue, including present.
+  QueueSubmitter(VkQueue queue, Timeline& timeline, std::mutex& queue_mutex);
+  ~QueueSubmitter() = default;
+
+  // Thread-safe. Returns the timeline value signaled once the batch has executed.
+  uint64_t enqueue(SubmitBatch batch);
+  // Submits all pending batches, fence is signaled once all of them completed.
+  void flush(VkFence fence = VK_NULL_HANDLE);
+
+  // Starts a new stats frame, last_frame_stats() then reports the frame that just ended.
+  void next_frame();
+  SubmitStats last_frame_stats() const;
+  VkQueue queue() const { return m_queue; }
+  Timeline& timeline() const { return m_timeline; }
+
+private:
+  struct PendingBatch {
+    SubmitBatch batch;
+    uint64_t signal_value;
+  };
+
+  VkQueue m_queue;
+  Timeline& m_timeline;
+  std::mutex& m_queue_mutex;
+
+  mutable std::mutex m_pending_mutex;
+  std::vector<PendingBatch> m_pending;
+  SubmitStats m_current_stats{};
+  SubmitStats m_last_frame_stats{};
+};
+}  // namespace zen::vkh
+#endif  //ZENENGINE_QUEUE_SUBMITTER_HPP
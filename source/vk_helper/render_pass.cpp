@@ -10,50 +10,76 @@ SubpassInfo::SubpassInfo(const std::vector<uint32_t>& colors, const std::vector<
     color_refs.emplace_back(color_att_ref(color));
   }
   for (const auto input : inputs) {
-    color_refs.emplace_back(input_att_ref(input));
+    input_refs.emplace_back(input_att_ref(input));
   }
-  depth_stencil_ref = depth_stencil_att_ref(depth_stencil);
+  if (depth_stencil != VK_ATTACHMENT_UNUSED) {
+    depth_stencil_ref = depth_stencil_att_ref(depth_stencil);
+  } else {
+    depth_stencil_ref = {VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED};
+  }
+}
+
+VkAttachmentLoadOp infer_load_op(const AttachmentUsage& usage) {
+  if (usage.full_overwrite) {
+    return VK_ATTACHMENT_LOAD_OP_CLEAR;
+  }
+  return usage.reads_previous_contents ? VK_ATTACHMENT_LOAD_OP_LOAD
+                                       : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 }
 
-RenderPassBuilder& RenderPassBuilder::add_present_att(VkFormat format) {
+VkAttachmentStoreOp infer_store_op(const AttachmentUsage& usage) {
+  return usage.read_later ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+}
+
+RenderPassBuilder& RenderPassBuilder::add_present_att(VkFormat format,
+                                                      const AttachmentUsage& usage) {
   VkAttachmentDescription att = {
       .format         = format,
       .samples        = VK_SAMPLE_COUNT_1_BIT,
-      .loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR,
-      .storeOp        = VK_ATTACHMENT_STORE_OP_STORE,
+      .loadOp         = infer_load_op(usage),
+      .storeOp        = infer_store_op(usage),
       .stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
       .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-      .initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED,
+      .initialLayout  = usage.reads_previous_contents ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+                                                      : VK_IMAGE_LAYOUT_UNDEFINED,
       .finalLayout    = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR  // present layout
   };
   m_attachments.emplace_back(att);
   return *this;
 }
 
-RenderPassBuilder& RenderPassBuilder::add_color_att(VkFormat format, bool clear) {
+RenderPassBuilder& RenderPassBuilder::add_color_att(VkFormat format,
+                                                    const AttachmentUsage& usage) {
   VkAttachmentDescription att = {
       .format         = format,
       .samples        = VK_SAMPLE_COUNT_1_BIT,
-      .loadOp         = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-      .storeOp        = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+      .loadOp         = infer_load_op(usage),
+      .storeOp        = infer_store_op(usage),
       .stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
       .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-      .initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED,
+      .initialLayout  = usage.reads_previous_contents ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+                                                      : VK_IMAGE_LAYOUT_UNDEFINED,
       .finalLayout    = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL  // color attachment layout
   };
   m_attachments.emplace_back(att);
   return *this;
 }
 
-RenderPassBuilder& RenderPassBuilder::add_depth_stencil_att(VkFormat format) {
+RenderPassBuilder& RenderPassBuilder::add_depth_stencil_att(VkFormat format,
+                                                            const AttachmentUsage& usage) {
+  const bool stencil = format == VK_FORMAT_D16_UNORM_S8_UINT ||
+                       format == VK_FORMAT_D24_UNORM_S8_UINT ||
+                       format == VK_FORMAT_D32_SFLOAT_S8_UINT;
   VkAttachmentDescription att = {
       .format         = format,
       .samples        = VK_SAMPLE_COUNT_1_BIT,
-      .loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR,
-      .storeOp        = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-      .stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-      .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-      .initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED,
+      .loadOp         = infer_load_op(usage),
+      .storeOp        = infer_store_op(usage),
+      .stencilLoadOp  = stencil ? infer_load_op(usage) : VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+      .stencilStoreOp = stencil ? infer_store_op(usage) : VK_ATTACHMENT_STORE_OP_DONT_CARE,
+      .initialLayout  = usage.reads_previous_contents
+                            ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+                            : VK_IMAGE_LAYOUT_UNDEFINED,
       .finalLayout    = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL  // depth stencil layout
   };
   m_attachments.emplace_back(att);
@@ -156,7 +182,7 @@ RenderPassBuilder& RenderPassBuilder::set_subpass_deps(const SubpassDepInfo& inf
   return *this;
 }
 
-VkRenderPass RenderPassBuilder::build() {
+VkRenderPass RenderPassBuilder::build(const std::string& name) {
   std::vector<VkSubpassDescription> subpass_descriptions;
   for (const auto& subpass_info : m_subpass_infos) {
     VkSubpassDescription subpass{
@@ -167,7 +193,9 @@ VkRenderPass RenderPassBuilder::build() {
         .colorAttachmentCount = static_cast<uint32_t>(subpass_info.color_refs.size()),
         .pColorAttachments =
             subpass_info.color_refs.empty() ? nullptr : subpass_info.color_refs.data(),
-        .pDepthStencilAttachment = &subpass_info.depth_stencil_ref  //
+        .pDepthStencilAttachment = subpass_info.depth_stencil_ref.attachment != VK_ATTACHMENT_UNUSED
+                                       ? &subpass_info.depth_stencil_ref
+                                       : nullptr  //
     };
     subpass_descriptions.emplace_back(subpass);
   }
@@ -178,9 +206,106 @@ VkRenderPass RenderPassBuilder::build() {
   render_pass_ci.pSubpasses      = subpass_descriptions.data();
   render_pass_ci.dependencyCount = static_cast<uint32_t>(m_subpass_deps.size());
   render_pass_ci.pDependencies   = m_subpass_deps.data();
+  if (m_cache != nullptr) {
+    return m_cache->get_or_create(render_pass_ci, name);
+  }
   VkRenderPass render_pass;
-  m_device.create_render_pass(render_pass_ci, &render_pass, "render pass");
+  m_device.create_render_pass(render_pass_ci, &render_pass, name);
 
   return render_pass;
 }
+
+/** RenderPassCache **/
+namespace {
+void append_refs(std::vector<uint32_t>& words, uint32_t count,
+                 const VkAttachmentReference* refs) {
+  words.push_back(count);
+  for (uint32_t i = 0; i < count; i++) {
+    words.push_back(refs[i].attachment);
+    words.push_back(refs[i].layout);
+  }
+}
+}  // namespace
+
+RenderPassCache::~RenderPassCache() {
+  cleanup();
+}
+
+void RenderPassCache::cleanup() {
+  for (const auto& p : m_render_pass_cache) {
+    m_device.destroy_render_pass(p.second);
+  }
+  m_render_pass_cache.clear();
+}
+
+VkRenderPass RenderPassCache::get_or_create(const VkRenderPassCreateInfo& info,
+                                            const std::string& name) {
+  // multiview is the only extension struct which is part of the key
+  const auto* multiview = static_cast<const VkRenderPassMultiviewCreateInfo*>(info.pNext);
+  VK_ASSERT(multiview == nullptr ||
+            (multiview->sType == VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO &&
+             multiview->pNext == nullptr));
+  RenderPassDesc desc;
+  auto& words = desc.words;
+  words.push_back(info.flags);
+  words.push_back(info.attachmentCount);
+  for (uint32_t i = 0; i < info.attachmentCount; i++) {
+    const auto& att = info.pAttachments[i];
+    words.insert(words.end(), {att.flags, att.format, att.samples, att.loadOp, att.storeOp,
+                               att.stencilLoadOp, att.stencilStoreOp, att.initialLayout,
+                               att.finalLayout});
+  }
+  words.push_back(info.subpassCount);
+  for (uint32_t i = 0; i < info.subpassCount; i++) {
+    const auto& subpass = info.pSubpasses[i];
+    words.push_back(subpass.flags);
+    words.push_back(subpass.pipelineBindPoint);
+    append_refs(words, subpass.inputAttachmentCount, subpass.pInputAttachments);
+    append_refs(words, subpass.colorAttachmentCount, subpass.pColorAttachments);
+    append_refs(words, subpass.pResolveAttachments ? subpass.colorAttachmentCount : 0,
+                subpass.pResolveAttachments);
+    append_refs(words, subpass.pDepthStencilAttachment ? 1 : 0, subpass.pDepthStencilAttachment);
+    words.push_back(subpass.preserveAttachmentCount);
+    words.insert(words.end(), subpass.pPreserveAttachments,
+                 subpass.pPreserveAttachments + subpass.preserveAttachmentCount);
+  }
+  words.push_back(info.dependencyCount);
+  for (uint32_t i = 0; i < info.dependencyCount; i++) {
+    const auto& dep = info.pDependencies[i];
+    words.insert(words.end(), {dep.srcSubpass, dep.dstSubpass, dep.srcStageMask,
+                               dep.dstStageMask, dep.srcAccessMask, dep.dstAccessMask,
+                               dep.dependencyFlags});
+  }
+  if (multiview != nullptr) {
+    words.push_back(multiview->subpassCount);
+    words.insert(words.end(), multiview->pViewMasks,
+                 multiview->pViewMasks + multiview->subpassCount);
+    words.push_back(multiview->dependencyCount);
+    words.insert(words.end(), multiview->pViewOffsets,
+                 multiview->pViewOffsets + multiview->dependencyCount);
+    words.push_back(multiview->correlationMaskCount);
+    words.insert(words.end(), multiview->pCorrelationMasks,
+                 multiview->pCorrelationMasks + multiview->correlationMaskCount);
+  }
+
+  auto it = m_render_pass_cache.find(desc);
+  if (it != m_render_pass_cache.end()) {
+    m_hits++;
+    return it->second;
+  }
+  m_misses++;
+  VkRenderPass render_pass{VK_NULL_HANDLE};
+  m_device.create_render_pass(info, &render_pass, name);
+  m_render_pass_cache.emplace(std::move(desc), render_pass);
+  return render_pass;
+}
+
+size_t RenderPassCache::RenderPassDesc::hash() const {
+  // FNV-1a over the flattened description
+  uint64_t result = 14695981039346656037ull;
+  for (uint32_t word : words) {
+    result = (result ^ word) * 1099511628211ull;
+  }
+  return static_cast<size_t>(result);
+}
 }  // namespace zen::vkh
\ No newline at end of file
@@ -1,5 +1,7 @@
 #ifndef ZENENGINE_RENDER_PASS_HPP
 #define ZENENGINE_RENDER_PASS_HPP
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include "base.hpp"
 
@@ -14,6 +16,21 @@ struct SubpassDepInfo {
   bool extern_color_dep{true};
 };
 
+/// How a frame uses an attachment outside of a render pass. Previous contents are only loaded if
+/// they are read, results only stored if something reads them later, which saves the memory
+/// traffic of the attachment on tilers and bandwidth everywhere else.
+struct AttachmentUsage {
+  // the render pass reads what earlier passes left in the attachment
+  bool reads_previous_contents{false};
+  // the first access writes every pixel, a clear is cheaper than a load
+  bool full_overwrite{false};
+  // a later pass or the presentation engine reads the result
+  bool read_later{false};
+};
+
+VkAttachmentLoadOp infer_load_op(const AttachmentUsage& usage);
+VkAttachmentStoreOp infer_store_op(const AttachmentUsage& usage);
+
 struct SubpassInfo {
   SubpassInfo(const std::vector<uint32_t>& colors, const std::vector<uint32_t>& inputs,
               uint32_t depth_stencil);
@@ -22,24 +39,64 @@ struct SubpassInfo {
   VkAttachmentReference depth_stencil_ref{};
 };
 
+/// Render passes by their description. Render passes with equal attachments, subpasses and
+/// dependencies are compatible and interchangeable, so a description is only created once and
+/// rebuilding a frame (e.g. after a swapchain resize) reuses it. The cache owns the render passes.
+class RenderPassCache {
+public:
+  ZEN_NO_COPY_MOVE(RenderPassCache)
+  explicit RenderPassCache(const Device& device) : m_device(device) {}
+  ~RenderPassCache();
+
+  // The name is only used when the render pass is created.
+  VkRenderPass get_or_create(const VkRenderPassCreateInfo& info, const std::string& name);
+  void cleanup();
+
+  uint32_t get_hit_count() const { return m_hits; }
+  uint32_t get_miss_count() const { return m_misses; }
+
+  struct RenderPassDesc {
+    // every member of the create info that matters, flattened
+    std::vector<uint32_t> words;
+    bool operator==(const RenderPassDesc& other) const { return words == other.words; }
+    size_t hash() const;
+  };
+
+private:
+  const Device& m_device;
+  struct RenderPassHash {
+    size_t operator()(const RenderPassDesc& k) const { return k.hash(); }
+  };
+  std::unordered_map<RenderPassDesc, VkRenderPass, RenderPassHash> m_render_pass_cache;
+  uint32_t m_hits{0};
+  uint32_t m_misses{0};
+};
+
 class RenderPassBuilder {
 public:
-  explicit RenderPassBuilder(const Device& device) : m_device(device) {}
+  // With a cache, build() returns cached render passes which the cache owns.
+  explicit RenderPassBuilder(const Device& device, RenderPassCache* cache = nullptr)
+      : m_device(device), m_cache(cache) {}
   ~RenderPassBuilder() = default;
 
-  RenderPassBuilder& add_present_att(VkFormat format);
-  RenderPassBuilder& add_color_att(VkFormat format, bool clear);
-  RenderPassBuilder& add_depth_stencil_att(VkFormat format);
+  RenderPassBuilder& add_present_att(VkFormat format,
+                                     const AttachmentUsage& usage = {.full_overwrite = true,
+                                                                     .read_later     = true});
+  RenderPassBuilder& add_color_att(VkFormat format, const AttachmentUsage& usage);
+  RenderPassBuilder& add_depth_stencil_att(VkFormat format,
+                                           const AttachmentUsage& usage = {.full_overwrite =
+                                                                               true});
 
   RenderPassBuilder& add_subpass(const std::vector<uint32_t>& color_refs,
                                  const std::vector<uint32_t>& input_refs,
-                                 uint32_t depth_stencil_ref);
+                                 uint32_t depth_stencil_ref = VK_ATTACHMENT_UNUSED);
 
   RenderPassBuilder& set_subpass_deps(const SubpassDepInfo& info);
 
-  VkRenderPass build();
+  VkRenderPass build(const std::string& name = "render pass");
 private:
   const Device& m_device;
+  RenderPassCache* m_cache;
   std::vector<VkAttachmentDescription> m_attachments;
   std::vector<SubpassInfo> m_subpass_infos;
   std::vector<VkAttachmentReference> m_attachment_refs;
@@ -0,0 +1,380 @@
+#include "resource_state_tracker.hpp"
+#include "buffer.hpp"
+#include "command_buffer.hpp"
+#include "device.hpp"
+#include "image.hpp"
+#include "logging.hpp"
+
+namespace zen::vkh {
+namespace {
+constexpr VkAccessFlags2KHR WRITE_ACCESS_MASK =
+    VK_ACCESS_2_SHADER_WRITE_BIT_KHR | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR |
+    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR | VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR |
+    VK_ACCESS_2_HOST_WRITE_BIT_KHR | VK_ACCESS_2_MEMORY_WRITE_BIT_KHR |
+    VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR;
+
+// The legacy flags share their bit values with the lower 32 bits of the sync2 ones, the stages
+// only sync2 has are widened to the legacy stages containing them.
+VkPipelineStageFlags to_legacy_stages(VkPipelineStageFlags2KHR stages, bool src) {
+  auto legacy = static_cast<VkPipelineStageFlags>(stages & 0xFFFFFFFFull);
+  if (stages & (VK_PIPELINE_STAGE_2_COPY_BIT_KHR | VK_PIPELINE_STAGE_2_RESOLVE_BIT_KHR |
+                VK_PIPELINE_STAGE_2_BLIT_BIT_KHR | VK_PIPELINE_STAGE_2_CLEAR_BIT_KHR)) {
+    legacy |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+  }
+  if (stages & (VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT_KHR |
+                VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT_KHR)) {
+    legacy |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+  }
+  // the engine has no tessellation or geometry shaders
+  if (stages & VK_PIPELINE_STAGE_2_PRE_RASTERIZATION_SHADERS_BIT_KHR) {
+    legacy |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+  }
+  if (legacy == 0) {
+    return src ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+  }
+  return legacy;
+}
+
+VkAccessFlags to_legacy_access(VkAccessFlags2KHR access) {
+  VkAccessFlags legacy = static_cast<VkAccessFlags>(access & 0xFFFFFFFFull);
+  if (access & VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR) {
+    legacy |= VK_ACCESS_SHADER_WRITE_BIT;
+  }
+  if (access &
+      (VK_ACCESS_2_SHADER_SAMPLED_READ_BIT_KHR | VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR)) {
+    legacy |= VK_ACCESS_SHADER_READ_BIT;
+  }
+  return legacy;
+}
+}  // namespace
+
+ResourceStateTracker::ResourceStateTracker(const Device& device)
+    : m_use_sync2(device.get_features().supports_sync2) {}
+
+bool ResourceStateTracker::transition(AccessState& state, VkPipelineStageFlags2KHR stages,
+                                      VkAccessFlags2KHR access, VkImageLayout layout,
+                                      bool is_image, bool discard_contents, Transition& result) {
+  const bool layout_change = is_image && state.layout != layout;
+  const bool is_write      = (access & WRITE_ACCESS_MASK) != 0;
+
+  if (is_write || layout_change) {
+    const bool untouched = state.write_stages == VK_PIPELINE_STAGE_2_NONE_KHR &&
+                           state.read_stages == VK_PIPELINE_STAGE_2_NONE_KHR;
+    result = {
+        .src_stages = state.write_stages | state.read_stages,
+        // reads leave nothing to make available, waiting on them is enough
+        .src_access = state.write_access,
+        .dst_stages = stages,
+        .dst_access = access,
+        .old_layout = discard_contents ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout,
+        .new_layout = layout,
+    };
+    state = {
+        .layout         = layout,
+        .write_stages   = stages,
+        .write_access   = access & WRITE_ACCESS_MASK,
+        .read_stages    = VK_PIPELINE_STAGE_2_NONE_KHR,
+        .visible_stages = stages,
+        .visible_access = access,
+    };
+    // the first write to a buffer needs no barrier
+    return !untouched || layout_change;
+  }
+
+  state.read_stages |= stages;
+  if (state.write_stages == VK_PIPELINE_STAGE_2_NONE_KHR) {
+    return false;
+  }
+  const bool visible = (stages & ~state.visible_stages) == 0 &&
+                       (access & ~state.visible_access) == 0;
+  if (visible) {
+    return false;
+  }
+  result = {
+      .src_stages = state.write_stages,
+      .src_access = state.write_access,
+      .dst_stages = stages,
+      .dst_access = access,
+      .old_layout = state.layout,
+      .new_layout = layout,
+  };
+  state.visible_stages |= stages;
+  state.visible_access |= access;
+  return true;
+}
+
+void ResourceStateTracker::request_buffer_access(const Buffer& buffer,
+                                                 VkPipelineStageFlags2KHR stages,
+                                                 VkAccessFlags2KHR access) {
+  request_buffer_access(buffer.handle(), stages, access);
+}
+
+void ResourceStateTracker::request_buffer_access(VkBuffer buffer, VkPipelineStageFlags2KHR stages,
+                                                 VkAccessFlags2KHR access) {
+  Transition t{};
+  if (!transition(m_buffers[buffer], stages, access, VK_IMAGE_LAYOUT_UNDEFINED, false, false,
+                  t)) {
+    m_stats.skipped++;
+    return;
+  }
+  m_buffer_barriers.push_back({
+      .sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR,
+      .srcStageMask        = t.src_stages,
+      .srcAccessMask       = t.src_access,
+      .dstStageMask        = t.dst_stages,
+      .dstAccessMask       = t.dst_access,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .buffer              = buffer,
+      .offset              = 0,
+      .size                = VK_WHOLE_SIZE,
+  });
+}
+
+void ResourceStateTracker::request_image_access(const Image& image, VkImageLayout layout,
+                                                VkPipelineStageFlags2KHR stages,
+                                                VkAccessFlags2KHR access, bool discard_contents) {
+  const VkImageSubresourceRange range{image.get_aspect(), 0, image.get_mip_levels(), 0,
+                                      image.get_layer_count()};
+  request_image_access(image, range, layout, stages, access, discard_contents);
+}
+
+void ResourceStateTracker::request_image_access(const Image& image,
+                                                const VkImageSubresourceRange& range,
+                                                VkImageLayout layout,
+                                                VkPipelineStageFlags2KHR stages,
+                                                VkAccessFlags2KHR access, bool discard_contents) {
+  if (m_images.find(image.handle()) == m_images.end()) {
+    register_image(image.handle(), image.get_aspect(), image.get_mip_levels(),
+                   image.get_layer_count(), VK_IMAGE_LAYOUT_UNDEFINED);
+  }
+  request_image_access(image.handle(), range, layout, stages, access, discard_contents);
+}
+
+void ResourceStateTracker::register_image(VkImage image, VkImageAspectFlags aspect,
+                                          uint32_t mip_levels, uint32_t layer_count,
+                                          VkImageLayout current_layout) {
+  AccessState initial_state{};
+  initial_state.layout = current_layout;
+
+  auto& state       = m_images[image];
+  state.aspect      = aspect;
+  state.mip_levels  = mip_levels;
+  state.layer_count = layer_count;
+  state.subresources.assign(static_cast<size_t>(mip_levels) * layer_count, initial_state);
+}
+
+void ResourceStateTracker::request_image_access(VkImage image,
+                                                const VkImageSubresourceRange& range,
+                                                VkImageLayout layout,
+                                                VkPipelineStageFlags2KHR stages,
+                                                VkAccessFlags2KHR access, bool discard_contents) {
+  auto it = m_images.find(image);
+  if (it == m_images.end()) {
+    logger::error("Image was not registered for state tracking");
+    VK_ASSERT(false);
+    return;
+  }
+  auto& state              = it->second;
+  const uint32_t mip_end   = range.levelCount == VK_REMAINING_MIP_LEVELS
+                                 ? state.mip_levels
+                                 : range.baseMipLevel + range.levelCount;
+  const uint32_t layer_end = range.layerCount == VK_REMAINING_ARRAY_LAYERS
+                                 ? state.layer_count
+                                 : range.baseArrayLayer + range.layerCount;
+
+  for (uint32_t mip = range.baseMipLevel; mip < mip_end; mip++) {
+    for (uint32_t layer = range.baseArrayLayer; layer < layer_end; layer++) {
+      Transition t{};
+      if (!transition(state.subresources[mip * state.layer_count + layer], stages, access, layout,
+                      true, discard_contents, t)) {
+        m_stats.skipped++;
+        continue;
+      }
+      add_image_barrier(image, t, {state.aspect, mip, 1, layer, 1});
+    }
+  }
+}
+
+// Subresources with the same transition end up in one barrier: consecutive layers of a mip are
+// merged first, then mips covering the same layers.
+void ResourceStateTracker::add_image_barrier(VkImage image, const Transition& t,
+                                             const VkImageSubresourceRange& range) {
+  const auto same_transition = [&](const VkImageMemoryBarrier2KHR& b) {
+    return b.image == image && b.srcStageMask == t.src_stages &&
+           b.srcAccessMask == t.src_access && b.dstStageMask == t.dst_stages &&
+           b.dstAccessMask == t.dst_access && b.oldLayout == t.old_layout &&
+           b.newLayout == t.new_layout;
+  };
+  if (!m_image_barriers.empty() && same_transition(m_image_barriers.back())) {
+    auto& last = m_image_barriers.back().subresourceRange;
+    if (last.baseMipLevel == range.baseMipLevel && last.levelCount == range.levelCount &&
+        last.baseArrayLayer + last.layerCount == range.baseArrayLayer) {
+      last.layerCount += range.layerCount;
+      const size_t count = m_image_barriers.size();
+      if (count >= 2 && same_transition(m_image_barriers[count - 2])) {
+        auto& prev = m_image_barriers[count - 2].subresourceRange;
+        if (prev.baseArrayLayer == last.baseArrayLayer && prev.layerCount == last.layerCount &&
+            prev.baseMipLevel + prev.levelCount == last.baseMipLevel) {
+          prev.levelCount += last.levelCount;
+          m_image_barriers.pop_back();
+        }
+      }
+      return;
+    }
+  }
+  m_image_barriers.push_back({
+      .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR,
+      .srcStageMask        = t.src_stages,
+      .srcAccessMask       = t.src_access,
+      .dstStageMask        = t.dst_stages,
+      .dstAccessMask       = t.dst_access,
+      .oldLayout           = t.old_layout,
+      .newLayout           = t.new_layout,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image               = image,
+      .subresourceRange    = range,
+  });
+}
+
+void ResourceStateTracker::alias_image(VkImage image, VkImage previous) {
+  const auto it          = m_images.find(image);
+  const auto previous_it = m_images.find(previous);
+  if (it == m_images.end() || previous_it == m_images.end()) {
+    logger::error("Image was not registered for state tracking");
+    VK_ASSERT(false);
+    return;
+  }
+  VkPipelineStageFlags2KHR stages = VK_PIPELINE_STAGE_2_NONE_KHR;
+  VkAccessFlags2KHR access        = VK_ACCESS_2_NONE_KHR;
+  for (const auto& state : previous_it->second.subresources) {
+    stages |= state.write_stages | state.read_stages;
+    access |= state.write_access;
+  }
+  // counted as writes of image, so they end up in the source scope of its next barrier
+  for (auto& state : it->second.subresources) {
+    state.write_stages |= stages;
+    state.write_access |= access;
+    state.visible_stages = VK_PIPELINE_STAGE_2_NONE_KHR;
+    state.visible_access = VK_ACCESS_2_NONE_KHR;
+  }
+}
+
+void ResourceStateTracker::assume_image_access(VkImage image,
+                                               const VkImageSubresourceRange& range,
+                                               VkImageLayout layout,
+                                               VkPipelineStageFlags2KHR stages,
+                                               VkAccessFlags2KHR access) {
+  auto it = m_images.find(image);
+  if (it == m_images.end()) {
+    logger::error("Image was not registered for state tracking");
+    VK_ASSERT(false);
+    return;
+  }
+  auto& state              = it->second;
+  const uint32_t mip_end   = range.levelCount == VK_REMAINING_MIP_LEVELS
+                                 ? state.mip_levels
+                                 : range.baseMipLevel + range.levelCount;
+  const uint32_t layer_end = range.layerCount == VK_REMAINING_ARRAY_LAYERS
+                                 ? state.layer_count
+                                 : range.baseArrayLayer + range.layerCount;
+  for (uint32_t mip = range.baseMipLevel; mip < mip_end; mip++) {
+    for (uint32_t layer = range.baseArrayLayer; layer < layer_end; layer++) {
+      // later accesses wait on these stages, no matter if they wrote
+      state.subresources[mip * state.layer_count + layer] = {
+          .layout         = layout,
+          .write_stages   = stages,
+          .write_access   = access & WRITE_ACCESS_MASK,
+          .read_stages    = VK_PIPELINE_STAGE_2_NONE_KHR,
+          .visible_stages = stages,
+          .visible_access = access,
+      };
+    }
+  }
+}
+
+void ResourceStateTracker::forget(VkBuffer buffer) {
+  m_buffers.erase(buffer);
+}
+
+void ResourceStateTracker::forget(VkImage image) {
+  m_images.erase(image);
+}
+
+VkImageLayout ResourceStateTracker::get_layout(VkImage image, uint32_t mip_level,
+                                               uint32_t layer) const {
+  auto it = m_images.find(image);
+  if (it == m_images.end()) {
+    return VK_IMAGE_LAYOUT_UNDEFINED;
+  }
+  return it->second.subresources[mip_level * it->second.layer_count + layer].layout;
+}
+
+void ResourceStateTracker::flush(const CommandBuffer& cmd_buffer) {
+  flush(cmd_buffer.handle());
+}
+
+void ResourceStateTracker::flush(VkCommandBuffer cmd_buffer) {
+  if (!has_pending_barriers()) {
+    return;
+  }
+  m_stats.barrier_calls++;
+  m_stats.buffer_barriers += static_cast<uint32_t>(m_buffer_barriers.size());
+  m_stats.image_barriers += static_cast<uint32_t>(m_image_barriers.size());
+
+  if (m_use_sync2) {
+    const VkDependencyInfoKHR dependency_info = {
+        .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+        .bufferMemoryBarrierCount = static_cast<uint32_t>(m_buffer_barriers.size()),
+        .pBufferMemoryBarriers    = m_buffer_barriers.data(),
+        .imageMemoryBarrierCount  = static_cast<uint32_t>(m_image_barriers.size()),
+        .pImageMemoryBarriers     = m_image_barriers.data(),
+    };
+    vkCmdPipelineBarrier2KHR(cmd_buffer, &dependency_info);
+  } else {
+    // The legacy call has one stage mask pair for all barriers.
+    VkPipelineStageFlags2KHR src_stages = VK_PIPELINE_STAGE_2_NONE_KHR;
+    VkPipelineStageFlags2KHR dst_stages = VK_PIPELINE_STAGE_2_NONE_KHR;
+    std::vector<VkBufferMemoryBarrier> buffer_barriers;
+    std::vector<VkImageMemoryBarrier> image_barriers;
+    buffer_barriers.reserve(m_buffer_barriers.size());
+    image_barriers.reserve(m_image_barriers.size());
+    for (const auto& b : m_buffer_barriers) {
+      src_stages |= b.srcStageMask;
+      dst_stages |= b.dstStageMask;
+      buffer_barriers.push_back({
+          .sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+          .srcAccessMask       = to_legacy_access(b.srcAccessMask),
+          .dstAccessMask       = to_legacy_access(b.dstAccessMask),
+          .srcQueueFamilyIndex = b.srcQueueFamilyIndex,
+          .dstQueueFamilyIndex = b.dstQueueFamilyIndex,
+          .buffer              = b.buffer,
+          .offset              = b.offset,
+          .size                = b.size,
+      });
+    }
+    for (const auto& b : m_image_barriers) {
+      src_stages |= b.srcStageMask;
+      dst_stages |= b.dstStageMask;
+      image_barriers.push_back({
+          .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+          .srcAccessMask       = to_legacy_access(b.srcAccessMask),
+          .dstAccessMask       = to_legacy_access(b.dstAccessMask),
+          .oldLayout           = b.oldLayout,
+          .newLayout           = b.newLayout,
+          .srcQueueFamilyIndex = b.srcQueueFamilyIndex,
+          .dstQueueFamilyIndex = b.dstQueueFamilyIndex,
+          .image               = b.image,
+          .subresourceRange    = b.subresourceRange,
+      });
+    }
+    vkCmdPipelineBarrier(cmd_buffer, to_legacy_stages(src_stages, true),
+                         to_legacy_stages(dst_stages, false), 0, 0, nullptr,
+                         static_cast<uint32_t>(buffer_barriers.size()), buffer_barriers.data(),
+                         static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+  }
+  m_buffer_barriers.clear();
+  m_image_barriers.clear();
+}
+}  // namespace zen::vkh
@@ -0,0 +1,122 @@
+#ifndef ZENENGINE_RESOURCE_STATE_TRACKER_HPP
+#define ZENENGINE_RESOURCE_STATE_TRACKER_HPP
+#include <unordered_map>
+#include <vector>
+#include "base.hpp"
+
+namespace zen::vkh {
+class Buffer;
+class CommandBuffer;
+class Device;
+class Image;
+
+struct BarrierStats {
+  uint32_t barrier_calls{0};  // vkCmdPipelineBarrier(2) calls
+  uint32_t buffer_barriers{0};
+  uint32_t image_barriers{0};
+  uint32_t skipped{0};  // requested accesses which needed no barrier
+};
+
+/// Remembers the last access of every buffer and image subresource and turns requested
+/// accesses into the minimal set of barriers:
+/// - read after read in the same layout needs nothing,
+/// - read after write waits on the writer and makes its result visible once per reader stage,
+/// - write after read is an execution dependency only,
+/// - write after write and layout transitions wait on the writer and all readers since.
+///
+/// Barriers are collected until flush(), which records all of them with a single
+/// vkCmdPipelineBarrier2KHR (or vkCmdPipelineBarrier without synchronization2). Accesses must be
+/// requested in the order the GPU executes them, i.e. one tracker per queue and recording
+/// thread. Queue family ownership transfers are not handled here.
+class ResourceStateTracker {
+public:
+  ZEN_NO_COPY_MOVE(ResourceStateTracker)
+  explicit ResourceStateTracker(const Device& device);
+  ~ResourceStateTracker() = default;
+
+  void request_buffer_access(const Buffer& buffer, VkPipelineStageFlags2KHR stages,
+                             VkAccessFlags2KHR access);
+  void request_buffer_access(VkBuffer buffer, VkPipelineStageFlags2KHR stages,
+                             VkAccessFlags2KHR access);
+  // Accesses all subresources of the image. With discard_contents the previous contents may
+  // be dropped, the transition then starts from VK_IMAGE_LAYOUT_UNDEFINED.
+  void request_image_access(const Image& image, VkImageLayout layout,
+                            VkPipelineStageFlags2KHR stages, VkAccessFlags2KHR access,
+                            bool discard_contents = false);
+  void request_image_access(const Image& image, const VkImageSubresourceRange& range,
+                            VkImageLayout layout, VkPipelineStageFlags2KHR stages,
+                            VkAccessFlags2KHR access, bool discard_contents = false);
+  // Images not owned by an Image (e.g. swapchain images) must be registered first.
+  void register_image(VkImage image, VkImageAspectFlags aspect, uint32_t mip_levels,
+                      uint32_t layer_count, VkImageLayout current_layout);
+  void request_image_access(VkImage image, const VkImageSubresourceRange& range,
+                            VkImageLayout layout, VkPipelineStageFlags2KHR stages,
+                            VkAccessFlags2KHR access, bool discard_contents = false);
+  // Records an access done without a tracker barrier, e.g. the layout transitions and
+  // attachment writes of a render pass or a semaphore wait on a swapchain image.
+  void assume_image_access(VkImage image, const VkImageSubresourceRange& range,
+                           VkImageLayout layout, VkPipelineStageFlags2KHR stages,
+                           VkAccessFlags2KHR access);
+  // The memory of image was last used by previous, which aliases it. The next barrier of image,
+  // e.g. the transition discarding its contents, also waits on the last accesses of previous.
+  void alias_image(VkImage image, VkImage previous);
+  // Drops the state of a destroyed resource, its handle may be reused by a new one.
+  void forget(VkBuffer buffer);
+  void forget(VkImage image);
+
+  VkImageLayout get_layout(VkImage image, uint32_t mip_level = 0, uint32_t layer = 0) const;
+
+  // Records all pending barriers.
+  void flush(const CommandBuffer& cmd_buffer);
+  void flush(VkCommandBuffer cmd_buffer);
+  bool has_pending_barriers() const {
+    return !m_buffer_barriers.empty() || !m_image_barriers.empty();
+  }
+
+  const BarrierStats& stats() const { return m_stats; }
+  void reset_stats() { m_stats = {}; }
+
+private:
+  struct AccessState {
+    VkImageLayout layout{VK_IMAGE_LAYOUT_UNDEFINED};
+    // last write, a layout transition counts as one
+    VkPipelineStageFlags2KHR write_stages{VK_PIPELINE_STAGE_2_NONE_KHR};
+    VkAccessFlags2KHR write_access{VK_ACCESS_2_NONE_KHR};
+    // stages which read since the last write, later writes have to wait for them
+    VkPipelineStageFlags2KHR read_stages{VK_PIPELINE_STAGE_2_NONE_KHR};
+    // stages/accesses the last write was already made visible to
+    VkPipelineStageFlags2KHR visible_stages{VK_PIPELINE_STAGE_2_NONE_KHR};
+    VkAccessFlags2KHR visible_access{VK_ACCESS_2_NONE_KHR};
+  };
+  struct ImageState {
+    VkImageAspectFlags aspect;
+    uint32_t mip_levels;
+    uint32_t layer_count;
+    std::vector<AccessState> subresources;  // mip major
+  };
+  struct Transition {
+    VkPipelineStageFlags2KHR src_stages;
+    VkAccessFlags2KHR src_access;
+    VkPipelineStageFlags2KHR dst_stages;
+    VkAccessFlags2KHR dst_access;
+    VkImageLayout old_layout;
+    VkImageLayout new_layout;
+  };
+
+  // Updates state for the access, returns false if no barrier is needed.
+  static bool transition(AccessState& state, VkPipelineStageFlags2KHR stages,
+                         VkAccessFlags2KHR access, VkImageLayout layout, bool is_image,
+                         bool discard_contents, Transition& result);
+  void add_image_barrier(VkImage image, const Transition& t,
+                         const VkImageSubresourceRange& range);
+
+  const bool m_use_sync2;
+  std::unordered_map<VkBuffer, AccessState> m_buffers;
+  std::unordered_map<VkImage, ImageState> m_images;
+
+  std::vector<VkBufferMemoryBarrier2KHR> m_buffer_barriers;
+  std::vector<VkImageMemoryBarrier2KHR> m_image_barriers;
+  BarrierStats m_stats{};
+};
+}  // namespace zen::vkh
+#endif  //ZENENGINE_RESOURCE_STATE_TRACKER_HPP
@@ -11,7 +11,8 @@ class Device;
 
 enum class ShaderType : decltype(1) {
   Vertex   = VK_SHADER_STAGE_VERTEX_BIT,
-  Fragment = VK_SHADER_STAGE_FRAGMENT_BIT
+  Fragment = VK_SHADER_STAGE_FRAGMENT_BIT,
+  Compute  = VK_SHADER_STAGE_COMPUTE_BIT
 };
 
 struct ShaderStage {
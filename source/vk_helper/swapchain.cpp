@@ -1,22 +1,29 @@
 #include "swapchain.hpp"
+#include <limits>
 #include "device.hpp"
 #include "logging.hpp"
 
 namespace zen::vkh {
 Swapchain::Swapchain(const Device& device, VkSurfaceKHR surface, uint32_t width, uint32_t height,
-                     bool vsync)
-    : m_device(device), m_surface(surface), m_vsync(vsync) {
-  setup(width, height, vsync);
+                     PresentPolicy present_policy)
+    : m_device(device), m_surface(surface), m_present_policy(present_policy) {
+  setup(width, height);
 }
 
 Swapchain::~Swapchain() {
+  // the owner waited for all frames in flight, retired swapchains are unused
+  for (auto& retired : m_retired) {
+    for (auto& image_view : retired.image_views) {
+      m_device.destroy_image_view(image_view);
+    }
+    m_device.destroy_swapchain(retired.swapchain);
+  }
   m_device.destroy_swapchain(m_swapchain);
   for (auto& image_view : m_image_views) {
     m_device.destroy_image_view(image_view);
   }
   m_images.clear();
   m_image_views.clear();
-
 }
 
 VkImageView Swapchain::get_image_view(uint32_t index) {
@@ -24,13 +31,81 @@ VkImageView Swapchain::get_image_view(uint32_t index) {
   return m_image_views.at(index);
 }
 
-void Swapchain::setup(std::uint32_t width, std::uint32_t height, bool vsync_enabled,
-                      VkSwapchainKHR old_swapchain) {
+bool Swapchain::recreate(uint32_t width, uint32_t height) {
+  const auto caps         = m_device.get_surface_capabilities(m_surface);
+  const VkExtent2D extent = choose_swapchain_extent({width, height}, caps);
+  if (extent.width == 0 || extent.height == 0) {
+    return false;
+  }
+  collect_retired();
+  // Every frame presenting to the old swapchain was submitted before the next submission, once
+  // that one finished the old images are neither rendered to nor queued for presentation.
+  const auto& timeline = m_device.get_timeline(QUEUE_INDEX_GRAPHICS);
+  m_retired.push_back(
+      {m_swapchain, std::move(m_image_views), timeline.last_submitted_value() + 1});
+  m_image_views.clear();
+  m_images.clear();
+  setup(width, height, m_retired.back().swapchain);
+  logger::info("Recreated swapchain with extent {} x {}", m_extent.width, m_extent.height);
+  return true;
+}
+
+void Swapchain::collect_retired() {
+  const auto& timeline = m_device.get_timeline(QUEUE_INDEX_GRAPHICS);
+  auto it              = m_retired.begin();
+  // swapchains retire in submission order
+  for (; it != m_retired.end() && timeline.is_complete(it->retire_value); ++it) {
+    for (auto& image_view : it->image_views) {
+      m_device.destroy_image_view(image_view);
+    }
+    m_device.destroy_swapchain(it->swapchain);
+  }
+  m_retired.erase(m_retired.begin(), it);
+}
+
+VkResult Swapchain::acquire_next_image(VkSemaphore acquire_semaphore, uint32_t& image_index) const {
+  return vkAcquireNextImageKHR(m_device.handle(), m_swapchain,
+                               std::numeric_limits<uint64_t>::max(), acquire_semaphore,
+                               VK_NULL_HANDLE, &image_index);
+}
+
+VkResult Swapchain::present(uint32_t image_index, VkSemaphore wait_semaphore,
+                            uint64_t present_id) const {
+  const VkPresentIdKHR present_id_info = {
+      .sType          = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+      .swapchainCount = 1,
+      .pPresentIds    = &present_id,
+  };
+  VkPresentInfoKHR present_info = {
+      .sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+      .pNext              = present_id != 0 ? &present_id_info : nullptr,
+      .waitSemaphoreCount = wait_semaphore != VK_NULL_HANDLE ? 1u : 0u,
+      .pWaitSemaphores    = &wait_semaphore,
+      .swapchainCount     = 1,
+      .pSwapchains        = &m_swapchain,
+      .pImageIndices      = &image_index,
+  };
+  return m_device.present(present_info);
+}
+
+bool Swapchain::wait_for_present(uint64_t present_id, uint64_t timeout) const {
+  VK_ASSERT(m_device.get_features().supports_present_wait);
+  const VkResult result = vkWaitForPresentKHR(m_device.handle(), m_swapchain, present_id, timeout);
+  if (result == VK_TIMEOUT || result == VK_ERROR_OUT_OF_DATE_KHR) {
+    return false;
+  }
+  VK_CHECK(result, "vkWaitForPresentKHR");
+  return true;
+}
+
+void Swapchain::setup(std::uint32_t width, std::uint32_t height, VkSwapchainKHR old_swapchain) {
   const auto caps = m_device.get_surface_capabilities(m_surface);
-  m_extent = choose_swapchain_extent({width, height}, caps.minImageExtent, caps.maxImageExtent);
+  m_extent = choose_swapchain_extent({width, height}, caps);
   m_surface_format = choose_surface_format(m_device.get_surface_formats(m_surface));
   const auto composite_alpha =
       choose_composite_alpha(VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR, caps.supportedCompositeAlpha);
+  m_present_mode =
+      choose_present_mode(m_device.get_surface_present_modes(m_surface), m_present_policy);
   VkSwapchainCreateInfoKHR swapchain_ci = {
       .sType            = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
       .surface          = m_surface,
@@ -41,16 +116,15 @@ void Swapchain::setup(std::uint32_t width, std::uint32_t height, bool vsync_enab
       .imageColorSpace  = m_surface_format.colorSpace,
       .imageExtent      = m_extent,
       .imageArrayLayers = 1,
-      .imageUsage       = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+      .imageUsage       = m_image_usage,
       .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
       .preTransform     = ((VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR & caps.supportedTransforms) != 0u)
                               ? VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR
                               : caps.currentTransform,
       .compositeAlpha   = composite_alpha,
-      .presentMode =
-          choose_present_mode(m_device.get_surface_present_modes(m_surface), vsync_enabled),
-      .clipped      = VK_TRUE,
-      .oldSwapchain = old_swapchain,
+      .presentMode      = m_present_mode,
+      .clipped          = VK_TRUE,
+      .oldSwapchain     = old_swapchain,
   };
   spdlog::trace("Creating swapchain");
   m_device.create_swapchain(swapchain_ci, &m_swapchain, "swapchain");
@@ -97,11 +171,16 @@ std::vector<VkImage> Swapchain::get_swapchain_images() {
 }
 
 VkExtent2D Swapchain::choose_swapchain_extent(const VkExtent2D& requested_extent,
-                                              const VkExtent2D& min_extent,
-                                              const VkExtent2D& max_extent) {
+                                              const VkSurfaceCapabilitiesKHR& caps) {
+  // the surface size decides unless the platform leaves it to the swapchain
+  if (caps.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
+    return caps.currentExtent;
+  }
   VkExtent2D extent{};
-  extent.width  = std::clamp(requested_extent.width, min_extent.width, min_extent.width);
-  extent.height = std::clamp(requested_extent.height, max_extent.height, max_extent.height);
+  extent.width =
+      std::clamp(requested_extent.width, caps.minImageExtent.width, caps.maxImageExtent.width);
+  extent.height =
+      std::clamp(requested_extent.height, caps.minImageExtent.height, caps.maxImageExtent.height);
   return extent;
 }
 
@@ -125,16 +204,23 @@ VkCompositeAlphaFlagBitsKHR Swapchain::choose_composite_alpha(
 }
 
 VkPresentModeKHR Swapchain::choose_present_mode(
-    const std::vector<VkPresentModeKHR>& available_present_modes, bool vsync_enabled) {
-  static const std::vector<VkPresentModeKHR> default_present_mode_priorities{
-      VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR};
-  if (!vsync_enabled) {
-    for (const auto requested_present_mode : default_present_mode_priorities) {
-      const auto present_mode = std::find(available_present_modes.begin(),
-                                          available_present_modes.end(), requested_present_mode);
-      if (present_mode != available_present_modes.end()) {
-        return *present_mode;
-      }
+    const std::vector<VkPresentModeKHR>& available_present_modes, PresentPolicy present_policy) {
+  std::vector<VkPresentModeKHR> priorities;
+  switch (present_policy) {
+    case PresentPolicy::Vsync:
+      break;
+    case PresentPolicy::LowLatencyVsync:
+      priorities = {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+      break;
+    case PresentPolicy::Immediate:
+      priorities = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR};
+      break;
+  }
+  for (const auto requested_present_mode : priorities) {
+    const auto present_mode = std::find(available_present_modes.begin(),
+                                        available_present_modes.end(), requested_present_mode);
+    if (present_mode != available_present_modes.end()) {
+      return *present_mode;
     }
   }
   return VK_PRESENT_MODE_FIFO_KHR;
@@ -1,39 +1,80 @@
 #ifndef ZENENGINE_SWAPCHAIN_HPP
 #define ZENENGINE_SWAPCHAIN_HPP
+#include <limits>
 #include <vector>
 #include "base.hpp"
 
 namespace zen::vkh {
 class Device;
+
+// Present modes in order of preference, FIFO is the fallback every device supports.
+enum class PresentPolicy {
+  Vsync,            // FIFO, latency is bounded by frame pacing (see FramePacer)
+  LowLatencyVsync,  // MAILBOX, FIFO_RELAXED: newer frames replace queued ones
+  Immediate,        // IMMEDIATE, MAILBOX: lowest latency, may tear
+};
+
 class Swapchain {
 public:
   Swapchain(const Device& device, VkSurfaceKHR surface, uint32_t width, uint32_t height,
-            bool vsync);
+            PresentPolicy present_policy);
   ~Swapchain();
   auto get_image_count() const { return m_images.size(); }
   auto get_extent() const { return m_extent; }
+  auto get_format() const { return m_surface_format.format; }
+  VkImageUsageFlags get_image_usage() const { return m_image_usage; }
+  VkSwapchainKHR handle() const { return m_swapchain; }
+  VkImage get_image(uint32_t index) const { return m_images[index]; }
   VkImageView get_image_view(uint32_t index);
+  VkPresentModeKHR get_present_mode() const { return m_present_mode; }
+
+  // Creates a new swapchain for the extent and retires the current one without waiting for the
+  // GPU: frames in flight keep presenting to the retired swapchain, it is destroyed by
+  // collect_retired() once they finished. Returns false if the surface has a zero extent, e.g.
+  // while the window is minimized, the current swapchain is kept then.
+  bool recreate(uint32_t width, uint32_t height);
+  // Destroys retired swapchains and their image views whose frames finished on the GPU.
+  void collect_retired();
+
+  // Both return the raw result so callers can react to VK_ERROR_OUT_OF_DATE_KHR/VK_SUBOPTIMAL_KHR.
+  VkResult acquire_next_image(VkSemaphore acquire_semaphore, uint32_t& image_index) const;
+  // A non-zero present_id is chained with VkPresentIdKHR, it must increase with every present.
+  VkResult present(uint32_t image_index, VkSemaphore wait_semaphore,
+                   uint64_t present_id = 0) const;
+  // Blocks until the present with the given id is visible, needs VK_KHR_present_wait. Returns
+  // false on timeout or if the swapchain is out of date.
+  bool wait_for_present(uint64_t present_id,
+                        uint64_t timeout = std::numeric_limits<uint64_t>::max()) const;
 
 private:
-  void setup(std::uint32_t width, std::uint32_t height, bool vsync_enabled,
-             VkSwapchainKHR old_swapchain = nullptr);
+  struct RetiredSwapchain {
+    VkSwapchainKHR swapchain;
+    std::vector<VkImageView> image_views;
+    // graphics timeline value of the first submission after the retirement
+    uint64_t retire_value;
+  };
+
+  void setup(std::uint32_t width, std::uint32_t height, VkSwapchainKHR old_swapchain = nullptr);
   std::vector<VkImage> get_swapchain_images();
   VkSurfaceFormatKHR choose_surface_format(const std::vector<VkSurfaceFormatKHR>& available);
   VkExtent2D choose_swapchain_extent(const VkExtent2D& requested_extent,
-                                     const VkExtent2D& min_extent, const VkExtent2D& max_extent);
+                                     const VkSurfaceCapabilitiesKHR& caps);
   VkPresentModeKHR choose_present_mode(const std::vector<VkPresentModeKHR>& available_present_modes,
-                                       bool vsync_enabled);
+                                       PresentPolicy present_policy);
   VkCompositeAlphaFlagBitsKHR choose_composite_alpha(VkCompositeAlphaFlagBitsKHR request_alpha,
                                                      VkCompositeAlphaFlagsKHR supported_alpha);
 
   const Device& m_device;
   VkSwapchainKHR m_swapchain{nullptr};
+  std::vector<RetiredSwapchain> m_retired;
   VkSurfaceKHR m_surface{nullptr};
   VkSurfaceFormatKHR m_surface_format{};
   std::vector<VkImage> m_images;
   std::vector<VkImageView> m_image_views;
   VkExtent2D m_extent{};
-  bool m_vsync{true};
+  const VkImageUsageFlags m_image_usage{VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT};
+  PresentPolicy m_present_policy{PresentPolicy::Vsync};
+  VkPresentModeKHR m_present_mode{VK_PRESENT_MODE_FIFO_KHR};
 };
 }  // namespace zen::vkh
 #endif  //ZENENGINE_SWAPCHAIN_HPP
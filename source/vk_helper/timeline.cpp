@@ -0,0 +1,78 @@
+#include "timeline.hpp"
+#include "device.hpp"
+#include "logging.hpp"
+
+namespace zen::vkh {
+Timeline::Timeline(const Device& device, std::string name, uint64_t initial_value)
+    : m_device(device),
+      m_name(std::move(name)),
+      m_last_value(initial_value),
+      m_completed_value(initial_value) {
+  VkSemaphoreTypeCreateInfoKHR type_ci = {
+      .sType         = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR,
+      .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR,
+      .initialValue  = initial_value,
+  };
+  VkSemaphoreCreateInfo semaphore_ci{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+  semaphore_ci.pNext = &type_ci;
+  m_device.create_semaphore(semaphore_ci, &m_semaphore, m_name);
+}
+
+Timeline::~Timeline() {
+  m_device.destroy_semaphore(m_semaphore);
+}
+
+uint64_t Timeline::completed_value() const {
+  uint64_t value = 0;
+  VK_CHECK(vkGetSemaphoreCounterValueKHR(m_device.handle(), m_semaphore, &value),
+           "vkGetSemaphoreCounterValueKHR");
+  update_completed_value(value);
+  return value;
+}
+
+bool Timeline::is_complete(uint64_t value) const {
+  if (value <= m_completed_value) {
+    return true;
+  }
+  return value <= completed_value();
+}
+
+bool Timeline::wait(uint64_t value, uint64_t timeout) const {
+  if (value <= m_completed_value) {
+    return true;
+  }
+  VkSemaphoreWaitInfoKHR wait_info = {
+      .sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR,
+      .semaphoreCount = 1,
+      .pSemaphores    = &m_semaphore,
+      .pValues        = &value,
+  };
+  const VkResult result = vkWaitSemaphoresKHR(m_device.handle(), &wait_info, timeout);
+  if (result == VK_TIMEOUT) {
+    return false;
+  }
+  VK_CHECK(result, "vkWaitSemaphoresKHR");
+  update_completed_value(value);
+  return true;
+}
+
+void Timeline::update_completed_value(uint64_t value) const {
+  // another thread may have observed a later value in the meantime
+  uint64_t completed = m_completed_value;
+  while (completed < value && !m_completed_value.compare_exchange_weak(completed, value)) {
+  }
+}
+
+void Timeline::host_signal(uint64_t value) {
+  VkSemaphoreSignalInfoKHR signal_info = {
+      .sType     = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO_KHR,
+      .semaphore = m_semaphore,
+      .value     = value,
+  };
+  VK_CHECK(vkSignalSemaphoreKHR(m_device.handle(), &signal_info), "vkSignalSemaphoreKHR");
+  uint64_t last = m_last_value;
+  while (last < value && !m_last_value.compare_exchange_weak(last, value)) {
+  }
+  update_completed_value(value);
+}
+}  // namespace zen::vkh
@@ -0,0 +1,70 @@
+#ifndef ZENENGINE_TIMELINE_HPP
+#define ZENENGINE_TIMELINE_HPP
+#include <atomic>
+#include <limits>
+#include <string>
+#include <vector>
+#include "base.hpp"
+
+namespace zen::vkh {
+class Device;
+
+/// RAII wrapper for a timeline semaphore with a monotonically increasing value.
+/// Device owns one per queue and every submission to that queue signals the next value, so any
+/// system can ask "has submission N finished" without owning a fence.
+class Timeline {
+public:
+  ZEN_NO_COPY_MOVE(Timeline)
+  Timeline(const Device& device, std::string name, uint64_t initial_value = 0);
+  ~Timeline();
+
+  VkSemaphore handle() const { return m_semaphore; }
+
+  // Reserves the value the next submission will signal. Values must be signaled in order.
+  uint64_t next_value() { return ++m_last_value; }
+  uint64_t last_submitted_value() const { return m_last_value; }
+
+  // Queries the GPU counter, results are cached so already completed values cost no API call.
+  uint64_t completed_value() const;
+  bool is_complete(uint64_t value) const;
+  // Returns false on timeout.
+  bool wait(uint64_t value, uint64_t timeout = std::numeric_limits<uint64_t>::max()) const;
+  void wait_idle() const { wait(m_last_value); }
+  void host_signal(uint64_t value);
+
+private:
+  void update_completed_value(uint64_t value) const;
+
+  const Device& m_device;
+  VkSemaphore m_semaphore{VK_NULL_HANDLE};
+  std::string m_name;
+  std::atomic<uint64_t> m_last_value{0};
+  mutable std::atomic<uint64_t> m_completed_value{0};
+};
+
+/// A point on a timeline, e.g. a submission other work has to wait for.
+struct TimelinePoint {
+  const Timeline* timeline{nullptr};
+  uint64_t value{0};
+};
+
+struct TimelineWait {
+  TimelinePoint point;
+  VkPipelineStageFlags stages{VK_PIPELINE_STAGE_ALL_COMMANDS_BIT};
+};
+
+struct BinarySemaphoreWait {
+  VkSemaphore semaphore{VK_NULL_HANDLE};
+  VkPipelineStageFlags stages{VK_PIPELINE_STAGE_ALL_COMMANDS_BIT};
+};
+
+/// Work for one queue submission. The queue's timeline is signaled implicitly.
+struct SubmitBatch {
+  std::vector<VkCommandBuffer> cmd_buffers;
+  std::vector<TimelineWait> timeline_waits;
+  // binary semaphores are only needed for swapchain acquire/present
+  std::vector<BinarySemaphoreWait> binary_waits;
+  std::vector<VkSemaphore> binary_signals;
+};
+}  // namespace zen::vkh
+#endif  //ZENENGINE_TIMELINE_HPP
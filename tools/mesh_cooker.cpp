@@ -0,0 +1,57 @@
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <assets/cooked_mesh.hpp>
+#include <assets/gltf_importer.hpp>
+#include <logging.hpp>
+#include <utils/thread_pool.hpp>
+
+using namespace zen;
+using Milliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>;
+
+// Cooks the meshes of a glTF scene for shipping builds, then loads the cooked file once to
+// check it and compare the load times.
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    logger::error("Usage: mesh_cooker <input .gltf/.glb> <output .zmesh>");
+    return 1;
+  }
+  const std::string input  = argv[1];
+  const std::string output = argv[2];
+
+  util::ThreadPool thread_pool;
+  GltfImporter importer(&thread_pool);
+  auto start = std::chrono::steady_clock::now();
+  if (!importer.open(input)) {
+    return 1;
+  }
+  // the cooked file holds no images, they are not decoded
+  auto vertex_data = std::make_unique_for_overwrite<std::byte[]>(importer.get_vertex_data_size());
+  auto index_data  = std::make_unique_for_overwrite<std::byte[]>(importer.get_index_data_size());
+  importer.decode(vertex_data.get(), index_data.get(), nullptr);
+  const float import_ms = Milliseconds(std::chrono::steady_clock::now() - start).count();
+  if (!write_cooked_mesh(output, importer, vertex_data.get(), index_data.get())) {
+    return 1;
+  }
+
+  start = std::chrono::steady_clock::now();
+  CookedMeshFile cooked;
+  if (!cooked.open(output)) {
+    return 1;
+  }
+  // the copies into staging memory
+  const size_t vertex_size = cooked.get_vertex_data().size();
+  const size_t index_size  = cooked.get_index_data().size();
+  auto staging             = std::make_unique_for_overwrite<std::byte[]>(vertex_size + index_size);
+  std::memcpy(staging.get(), cooked.get_vertex_data().data(), vertex_size);
+  std::memcpy(staging.get() + vertex_size, cooked.get_index_data().data(), index_size);
+  const float load_ms = Milliseconds(std::chrono::steady_clock::now() - start).count();
+
+  const float megabytes = float(vertex_size + index_size) / (1024.0f * 1024.0f);
+  logger::info("Cooked {} meshes and {} instances to {}, {:.1f} MB of geometry",
+               cooked.get_meshes().size(), cooked.get_instances().size(), output, megabytes);
+  logger::info("  glTF import: {:8.1f} ms", import_ms);
+  logger::info("  cooked load: {:8.1f} ms, {:.1f} MB/s", load_ms, megabytes / load_ms * 1000.0f);
+  return 0;
+}